@@ -0,0 +1,42 @@
+﻿using ImageViewerNative;
+using System.Collections.Generic;
+
+namespace ImageViewer
+{
+    // The encodings an 8-bit image can be interpreted as. Images are shown
+    // and diffed in sRGB, so anything else is converted first.
+    public class ColorSpaceOption
+    {
+        public static IReadOnlyList<ColorSpaceOption> All { get; } = new List<ColorSpaceOption>()
+        {
+            new ColorSpaceOption("sRGB", ColorPrimaries.Bt709, TransferFunction.Srgb),
+            new ColorSpaceOption("Display P3", ColorPrimaries.DisplayP3, TransferFunction.Srgb),
+            new ColorSpaceOption("BT.709", ColorPrimaries.Bt709, TransferFunction.Bt1886),
+            new ColorSpaceOption("BT.2020", ColorPrimaries.Bt2020, TransferFunction.Bt1886),
+        };
+
+        public static ColorSpaceOption Srgb => All[0];
+
+        public string DisplayName { get; }
+        public ColorPrimaries Primaries { get; }
+        public TransferFunction Transfer { get; }
+        public bool IsSrgb => Primaries == ColorPrimaries.Bt709 && Transfer == TransferFunction.Srgb;
+
+        private ColorSpaceOption(string displayName, ColorPrimaries primaries, TransferFunction transfer)
+        {
+            DisplayName = displayName;
+            Primaries = primaries;
+            Transfer = transfer;
+        }
+
+        // Null for sRGB, which needs no conversion
+        public ColorTransform CreateTransformToSrgb()
+        {
+            if (IsSrgb)
+            {
+                return null;
+            }
+            return ColorTransform.CreateParametric(Primaries, Transfer, ColorPrimaries.Bt709, TransferFunction.Srgb);
+        }
+    }
+}
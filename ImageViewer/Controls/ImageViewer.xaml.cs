@@ -1,8 +1,11 @@
 ﻿using ImageViewer.System;
+using ImageViewerNative;
 using Microsoft.Graphics.Canvas;
-using Microsoft.Graphics.Canvas.Brushes;
 using Microsoft.Graphics.Canvas.UI.Composition;
 using System;
+using System.Collections.Generic;
+using System.Numerics;
+using System.Threading.Tasks;
 using Windows.Devices.Input;
 using Windows.Foundation;
 using Windows.Graphics;
@@ -13,6 +16,8 @@ using Windows.UI.Composition;
 using Windows.UI.Xaml;
 using Windows.UI.Xaml.Controls;
 using Windows.UI.Xaml.Input;
+using Windows.UI.Xaml.Media;
+using Windows.UI.Xaml.Shapes;
 
 namespace ImageViewer.Controls
 {
@@ -31,10 +36,10 @@ namespace ImageViewer.Controls
 
     public sealed partial class ImageViewer : UserControl
     {
-        private static readonly DependencyProperty MeasurePositionXProperty = DependencyProperty.Register(nameof(MeasurePositionX), typeof(int), typeof(ImageViewer), new PropertyMetadata(0));
-        private static readonly DependencyProperty MeasurePositionYProperty = DependencyProperty.Register(nameof(MeasurePositionY), typeof(int), typeof(ImageViewer), new PropertyMetadata(0));
-        private static readonly DependencyProperty MeasureWidthProperty = DependencyProperty.Register(nameof(MeasureWidth), typeof(int), typeof(ImageViewer), new PropertyMetadata(0));
-        private static readonly DependencyProperty MeasureHeightProperty = DependencyProperty.Register(nameof(MeasureHeight), typeof(int), typeof(ImageViewer), new PropertyMetadata(0));
+        private static readonly DependencyProperty MeasurePositionXProperty = DependencyProperty.Register(nameof(MeasurePositionX), typeof(int), typeof(ImageViewer), new PropertyMetadata(0, OnMeasureRectPropertyChanged));
+        private static readonly DependencyProperty MeasurePositionYProperty = DependencyProperty.Register(nameof(MeasurePositionY), typeof(int), typeof(ImageViewer), new PropertyMetadata(0, OnMeasureRectPropertyChanged));
+        private static readonly DependencyProperty MeasureWidthProperty = DependencyProperty.Register(nameof(MeasureWidth), typeof(int), typeof(ImageViewer), new PropertyMetadata(0, OnMeasureRectPropertyChanged));
+        private static readonly DependencyProperty MeasureHeightProperty = DependencyProperty.Register(nameof(MeasureHeight), typeof(int), typeof(ImageViewer), new PropertyMetadata(0, OnMeasureRectPropertyChanged));
         private static readonly DependencyProperty InputModeProperty = DependencyProperty.Register(nameof(InputMode), typeof(InputMode), typeof(ImageViewer), new PropertyMetadata(InputMode.Drag, OnInputModePropertyChanged));
         private static readonly DependencyProperty AreGridLinesVisibleProperty = DependencyProperty.Register(nameof(AreGridLinesVisible), typeof(bool), typeof(ImageViewer), new PropertyMetadata(false, OnAreGridLinesVisiblePropertyChanged));
         private static readonly DependencyProperty IsBorderVisibleProperty = DependencyProperty.Register(nameof(IsBorderVisible), typeof(bool), typeof(ImageViewer), new PropertyMetadata(true, OnIsBorderVisiblePropertyChanged));
@@ -44,6 +49,8 @@ namespace ImageViewer.Controls
         private static readonly DependencyProperty BorderColorProperty = DependencyProperty.Register(nameof(BorderColor), typeof(Color), typeof(ImageViewer), new PropertyMetadata(Colors.Black));
         private static readonly DependencyProperty MeasureColorProperty = DependencyProperty.Register(nameof(MeasureColor), typeof(Color), typeof(ImageViewer), new PropertyMetadata(Colors.Red));
         private static readonly DependencyProperty CurrentColorProperty = DependencyProperty.Register(nameof(CurrentColor), typeof(Color?), typeof(ImageViewer), new PropertyMetadata(null));
+        private static readonly DependencyProperty CurrentHdrValueProperty = DependencyProperty.Register(nameof(CurrentHdrValue), typeof(Vector4?), typeof(ImageViewer), new PropertyMetadata(null));
+        private static readonly DependencyProperty MeasureStatisticsProperty = DependencyProperty.Register(nameof(MeasureStatistics), typeof(RegionStatisticsResult?), typeof(ImageViewer), new PropertyMetadata(null));
 
         private static void OnInputModePropertyChanged(DependencyObject d, DependencyPropertyChangedEventArgs e)
         {
@@ -51,6 +58,13 @@ namespace ImageViewer.Controls
             viewer.OnInputModeChanged();
         }
 
+        private static void OnMeasureRectPropertyChanged(DependencyObject d, DependencyPropertyChangedEventArgs e)
+        {
+            var viewer = (ImageViewer)d;
+            viewer.UpdateMeasureStatistics();
+            viewer.MeasureRectChanged?.Invoke(viewer, EventArgs.Empty);
+        }
+
         private static void OnAreGridLinesVisiblePropertyChanged(DependencyObject d, DependencyPropertyChangedEventArgs e)
         {
             var viewer = (ImageViewer)d;
@@ -75,21 +89,25 @@ namespace ImageViewer.Controls
         private static void OnGridLinesColorChanged(DependencyObject d, DependencyPropertyChangedEventArgs e)
         {
             var viewer = (ImageViewer)d;
-            var color = (Color)e.NewValue;
-            var brush = viewer.CreateGridLinesBrush(viewer._canvasDevice, color);
-            viewer._gridLinesCavnasBrush = brush;
+            viewer.ReleaseGridLinesSurface();
             if (viewer.AreGridLinesVisible)
             {
                 viewer.GenerateGridLines();
             }
         }
 
+        // Past this the lines get wider on screen as you zoom in, like they
+        // did on the old 10x surface
+        private const float MaxGridLinesMagnification = 16;
+
         private Compositor _compositor;
         private CanvasDevice _canvasDevice;
         private CompositionGraphicsDevice _compositionGraphics;
 
-        private ICanvasBrush _backgroundCavnasBrush;
-        private ICanvasBrush _gridLinesCavnasBrush;
+        private ViewportTiledSurface _backgroundSurface;
+        private ViewportTiledSurface _gridLinesSurface;
+        private float _backgroundScale;
+        private float _gridLinesScale;
 
         private CompositionSurfaceBrush _backgroundBrush;
         private CompositionSurfaceBrush _imageBrush;
@@ -98,6 +116,22 @@ namespace ImageViewer.Controls
         private Point _lastPosition;
         private Point _startMeasurePoint;
 
+        private RegionStatistics _regionStatistics;
+        // Incremented when the statistics go stale, so that a build that
+        // started before then is thrown away when it finishes
+        private uint _regionStatisticsGeneration;
+        private uint? _buildingRegionStatisticsGeneration;
+
+        private MipPyramid _mipPyramid;
+        // The image the pyramid was started for, so it's only built once
+        private IImage _mipPyramidImage;
+        // The level shown. Above 0 it's drawn from _mipSurface, once built,
+        // and level 0 is the image's own surface.
+        private uint _mipLevel;
+        private CompositionDrawingSurface _mipSurface;
+
+        private SolidColorBrush _changedRegionBrush = new SolidColorBrush(Color.FromArgb(0x60, 0xFF, 0x00, 0x00));
+
         public ImageViewer()
         {
             this.InitializeComponent();
@@ -107,10 +141,6 @@ namespace ImageViewer.Controls
             _compositor = graphicsManager.Compositor;
             _compositionGraphics = graphicsManager.CompositionGraphicsDevice;
 
-            // Generate the background bitmap
-            _backgroundCavnasBrush = CreateBackgroundBrush(_canvasDevice);
-            _gridLinesCavnasBrush = CreateGridLinesBrush(_canvasDevice, GridLinesColor);
-
             // Create brushes
             _backgroundBrush = _compositor.CreateSurfaceBrush();
             _backgroundBrush.BitmapInterpolationMode = CompositionBitmapInterpolationMode.NearestNeighbor;
@@ -175,8 +205,8 @@ namespace ImageViewer.Controls
         {
             var graphicsManager = GraphicsManager.Current;
             _canvasDevice = graphicsManager.CanvasDevice;
-            _backgroundCavnasBrush = CreateBackgroundBrush(_canvasDevice);
-            _gridLinesCavnasBrush = CreateGridLinesBrush(_canvasDevice, GridLinesColor);
+            ReleaseBackgroundSurface();
+            ReleaseGridLinesSurface();
             GenerateBackground();
             UpdateGridLines();
             UpdateBorder();
@@ -185,6 +215,7 @@ namespace ImageViewer.Controls
             {
                 Image.RegenerateSurface();
             }
+            ResetMipSurfaces(ImageScrollViewer.ZoomFactor);
         }
 
         private void OnUnloaded(object sender, RoutedEventArgs e)
@@ -195,10 +226,14 @@ namespace ImageViewer.Controls
             graphicsManager.CaptureDeviceReplaced -= OnCaptureDeviceReplaced;
             var displayInfo = DisplayInformation.GetForCurrentView();
             displayInfo.DpiChanged -= OnDpiChanged;
+            ReleaseBackgroundSurface();
+            ReleaseGridLinesSurface();
         }
 
         public ScrollViewer ScrollViewer => ImageScrollViewer;
 
+        public event EventHandler MeasureRectChanged;
+
         public int MeasurePositionX
         {
             get { return (int)GetValue(MeasurePositionXProperty); }
@@ -277,52 +312,152 @@ namespace ImageViewer.Controls
             set { SetValue(CurrentColorProperty, value); }
         }
 
-        private ICanvasBrush CreateBackgroundBrush(ICanvasResourceCreator device)
+        // The stored value under the cursor, for float images
+        public Vector4? CurrentHdrValue
+        {
+            get { return (Vector4?)GetValue(CurrentHdrValueProperty); }
+            private set { SetValue(CurrentHdrValueProperty, value); }
+        }
+
+        public RegionStatisticsResult? MeasureStatistics
+        {
+            get { return (RegionStatisticsResult?)GetValue(MeasureStatisticsProperty); }
+            private set { SetValue(MeasureStatisticsProperty, value); }
+        }
+
+        public void InvalidateMeasureStatistics()
+        {
+            _regionStatisticsGeneration++;
+            _regionStatistics = null;
+            MeasureStatistics = null;
+            EnsureRegionStatistics();
+        }
+
+        // Highlights the given regions, in image coordinates. Pass null to
+        // clear the overlay.
+        public void SetChangedRegions(IReadOnlyList<RectInt32> regions)
         {
-            var bitmap = new CanvasRenderTarget(device, 16, 16, 96); // TODO: Dpi?
-            using (var drawingSession = bitmap.CreateDrawingSession())
+            var children = ChangedRegionsCanvas.Children;
+            var count = regions != null ? regions.Count : 0;
+            while (children.Count > count)
             {
-                drawingSession.Clear(Colors.Gray);
-                drawingSession.FillRectangle(0, 0, 8, 8, Colors.LightGray);
-                drawingSession.FillRectangle(8, 8, 8, 8, Colors.LightGray);
+                children.RemoveAt(children.Count - 1);
             }
 
-            var brush = new CanvasImageBrush(device, bitmap);
-            brush.ExtendX = CanvasEdgeBehavior.Wrap;
-            brush.ExtendY = CanvasEdgeBehavior.Wrap;
+            // Reuse the rectangles from the last update where we can
+            for (var i = 0; i < count; i++)
+            {
+                Rectangle rectangle;
+                if (i < children.Count)
+                {
+                    rectangle = (Rectangle)children[i];
+                }
+                else
+                {
+                    rectangle = new Rectangle() { Fill = _changedRegionBrush };
+                    children.Add(rectangle);
+                }
+                var region = regions[i];
+                Canvas.SetLeft(rectangle, region.X);
+                Canvas.SetTop(rectangle, region.Y);
+                rectangle.Width = region.Width;
+                rectangle.Height = region.Height;
+            }
+            ChangedRegionsCanvas.Visibility = count > 0 ? Visibility.Visible : Visibility.Collapsed;
+        }
 
-            return brush;
+        // Stretches the given image over the whole image, e.g. an analysis
+        // of it. Pass null to clear the overlay.
+        public void SetOverlay(ImageSource overlay)
+        {
+            OverlayImage.Source = overlay;
+            OverlayImage.Visibility = overlay != null ? Visibility.Visible : Visibility.Collapsed;
         }
 
-        private ICanvasBrush CreateGridLinesBrush(ICanvasResourceCreator device, Color gridLinesColor)
+        private async void EnsureRegionStatistics()
         {
-            var bitmap = new CanvasRenderTarget(device, 10, 10, 96); // TODO: Dpi?
-            using (var drawingSession = bitmap.CreateDrawingSession())
+            var image = Image;
+            var generation = _regionStatisticsGeneration;
+            if (InputMode != InputMode.Measure || image == null || _regionStatistics != null || _buildingRegionStatisticsGeneration == generation)
             {
-                drawingSession.Clear(Colors.Transparent);
-                drawingSession.DrawRectangle(-0.5f, -0.5f, 10, 10, gridLinesColor, 0.5f);
+                return;
             }
 
-            var brush = new CanvasImageBrush(device, bitmap);
-            brush.ExtendX = CanvasEdgeBehavior.Wrap;
-            brush.ExtendY = CanvasEdgeBehavior.Wrap;
+            var bytes = image.GetPixelBytes();
+            if (bytes == null)
+            {
+                return;
+            }
 
-            return brush;
+            _buildingRegionStatisticsGeneration = generation;
+            var size = image.Size;
+            var statistics = await Task.Run(() =>
+            {
+                // Without the tables there are just no statistics shown
+                try
+                {
+                    return new RegionStatistics(bytes, size.Width, size.Height);
+                }
+                catch (Exception)
+                {
+                    return null;
+                }
+            });
+
+            // Stale if the statistics were invalidated while we built them.
+            // InvalidateMeasureStatistics starts the next build if needed.
+            if (generation != _regionStatisticsGeneration)
+            {
+                return;
+            }
+            _buildingRegionStatisticsGeneration = null;
+            _regionStatistics = statistics;
+            UpdateMeasureStatistics();
+        }
+
+        private void UpdateMeasureStatistics()
+        {
+            if (_regionStatistics != null)
+            {
+                var rect = new RectInt32() { X = MeasurePositionX, Y = MeasurePositionY, Width = MeasureWidth, Height = MeasureHeight };
+                MeasureStatistics = _regionStatistics.Query(rect);
+            }
         }
 
         private void GenerateGridLines()
         {
             if (Image != null)
             {
-                var size = Image.Size;
-                var width = (int)size.Width;
-                var height = (int)size.Height;
-                var gridMultiplier = 10;
-                var surfaceWidth = width * gridMultiplier;
-                var surfaceHeight = height * gridMultiplier;
-
-                var gridLinesSurface = GenerateSurfaceFromTiledBrush(_gridLinesCavnasBrush, surfaceWidth, surfaceHeight);
-                _gridLinesBrush.Surface = gridLinesSurface;
+                var scale = GridLinesScaleForZoom(ImageScrollViewer.ZoomFactor);
+                if (_gridLinesSurface == null || _gridLinesScale != scale)
+                {
+                    var size = Image.Size;
+                    var surfaceSize = new SizeInt32()
+                    {
+                        Width = Math.Max(1, (int)Math.Ceiling(size.Width * scale)),
+                        Height = Math.Max(1, (int)Math.Ceiling(size.Height * scale))
+                    };
+                    var color = GridLinesColor;
+                    var spacing = 1;
+                    if (scale >= 2)
+                    {
+                        // The old brush drew a 0.5px stroke, keep it at half coverage
+                        spacing = (int)scale;
+                        color.A = (byte)(color.A / 2);
+                    }
+                    else
+                    {
+                        // Every pixel has a line through it, and the old
+                        // stroke covered about a tenth of each
+                        color.A = (byte)(color.A / 10);
+                    }
+                    var previous = _gridLinesSurface;
+                    _gridLinesSurface = new ViewportTiledSurface(_compositionGraphics, surfaceSize, (tile, pixels) => TileRasterizer.RasterizeGridLines(tile, spacing, color, pixels));
+                    _gridLinesScale = scale;
+                    _gridLinesBrush.Surface = _gridLinesSurface.Surface;
+                    previous?.Dispose();
+                }
+                _gridLinesSurface.UpdateViewport(_canvasDevice, GetViewportInImageSpace(scale));
             }
         }
 
@@ -330,59 +465,233 @@ namespace ImageViewer.Controls
         {
             if (Image != null)
             {
-                var size = Image.Size;
-                var width = (int)size.Width;
-                var height = (int)size.Height;
-                var backgroundSurface = _compositionGraphics.CreateDrawingSurface2(
-                    new SizeInt32() { Width = width, Height = height },
-                    DirectXPixelFormat.B8G8R8A8UIntNormalized,
-                    DirectXAlphaMode.Premultiplied);
-                using (var drawingSession = CanvasComposition.CreateDrawingSession(backgroundSurface))
+                var scale = BackgroundScaleForZoom(ImageScrollViewer.ZoomFactor);
+                if (_backgroundSurface == null || _backgroundScale != scale)
                 {
-                    drawingSession.FillRectangle(0, 0, size.Width, size.Height, _backgroundCavnasBrush);
+                    var size = Image.Size;
+                    var surfaceSize = new SizeInt32()
+                    {
+                        Width = Math.Max(1, (int)Math.Ceiling(size.Width * scale)),
+                        Height = Math.Max(1, (int)Math.Ceiling(size.Height * scale))
+                    };
+                    var cellSize = Math.Max(1, (int)(8 * scale));
+                    var previous = _backgroundSurface;
+                    _backgroundSurface = new ViewportTiledSurface(_compositionGraphics, surfaceSize, (tile, pixels) => TileRasterizer.RasterizeCheckerboard(tile, cellSize, Colors.LightGray, Colors.Gray, pixels));
+                    _backgroundScale = scale;
+                    _backgroundBrush.Surface = _backgroundSurface.Surface;
+                    previous?.Dispose();
                 }
-                _backgroundBrush.Surface = backgroundSurface;
+                _backgroundSurface.UpdateViewport(_canvasDevice, GetViewportInImageSpace(scale));
+            }
+        }
+
+        // The brush lets go first, so nothing draws from a disposed surface
+        private void ReleaseBackgroundSurface()
+        {
+            if (_backgroundBrush != null)
+            {
+                _backgroundBrush.Surface = null;
+            }
+            _backgroundSurface?.Dispose();
+            _backgroundSurface = null;
+        }
+
+        private void ReleaseGridLinesSurface()
+        {
+            if (_gridLinesBrush != null)
+            {
+                _gridLinesBrush.Surface = null;
+            }
+            _gridLinesSurface?.Dispose();
+            _gridLinesSurface = null;
+        }
+
+        private static float GridLinesScaleForZoom(float zoomFactor)
+        {
+            // Lines are a surface pixel wide, so the surface is magnified to
+            // keep them thin. With less than two screen pixels per image
+            // pixel the grid is drawn as the tint it averages out to, no
+            // finer than the screen.
+            if (zoomFactor < 2)
+            {
+                return BackgroundScaleForZoom(zoomFactor);
+            }
+            var magnification = 2.0f;
+            while (magnification * 2 <= zoomFactor && magnification < MaxGridLinesMagnification)
+            {
+                magnification *= 2;
+            }
+            return magnification;
+        }
+
+        private static float BackgroundScaleForZoom(float zoomFactor)
+        {
+            // Keep the checkerboard surface at or under screen resolution
+            var scale = 1.0f;
+            while (scale > zoomFactor && scale > 1.0f / 256.0f)
+            {
+                scale /= 2.0f;
+            }
+            return scale;
+        }
+
+        private RectInt32 GetViewportInImageSpace(float scale)
+        {
+            var transform = ImageScrollViewer.TransformToVisual(ImageRectangle);
+            var bounds = transform.TransformBounds(new Rect(0, 0, ImageScrollViewer.ViewportWidth, ImageScrollViewer.ViewportHeight));
+            var left = (int)Math.Floor(bounds.Left * scale);
+            var top = (int)Math.Floor(bounds.Top * scale);
+            var right = (int)Math.Ceiling(bounds.Right * scale);
+            var bottom = (int)Math.Ceiling(bounds.Bottom * scale);
+            return new RectInt32() { X = left, Y = top, Width = right - left, Height = bottom - top };
+        }
+
+        private void UpdateViewportTiles()
+        {
+            GenerateBackground();
+            if (AreGridLinesVisible)
+            {
+                GenerateGridLines();
             }
         }
 
         private void GenerateImage()
         {
-            if (Image != null)
+            if (Image != null && _mipLevel == 0)
             {
                 var surface = Image.CreateSurface(_compositionGraphics);
                 _imageBrush.Surface = surface;
             }
         }
 
-        private ICompositionSurface GenerateSurfaceFromTiledBrush(ICanvasBrush brush, int surfaceWidth, int surfaceHeight)
+        // Reading the image back is most of the cost, so this waits for
+        // the first zoom out, or for an image too big for one texture.
+        private async void BuildMipPyramid()
+        {
+            // Only still images benefit from a pyramid, everything
+            // else changes underneath us.
+            var image = Image;
+            if (image is CanvasBitmapImage && image != _mipPyramidImage)
+            {
+                _mipPyramidImage = image;
+                var size = image.Size;
+                var pyramid = await Task.Run(() =>
+                {
+                    try
+                    {
+                        return new MipPyramid(image.GetPixelBytes(), size.Width, size.Height);
+                    }
+                    catch (Exception)
+                    {
+                        return null;
+                    }
+                });
+                if (image == Image)
+                {
+                    _mipPyramid = pyramid;
+                    // The first coarse level has no surface yet. Without a
+                    // pyramid all we can show is the full size image.
+                    var level = pyramid != null ? MipLevelForView(ImageScrollViewer.ZoomFactor) : 0;
+                    if (level != 0 || _mipLevel != 0)
+                    {
+                        ShowMipLevel(level);
+                    }
+                }
+            }
+        }
+
+        // Only still images get a pyramid. Above the device's largest
+        // bitmap even 1:1 is drawn from a coarser level.
+        private uint MipLevelForView(float zoomFactor)
         {
-            ICompositionSurface resultSurface = null;
-            // We're picking 4000 arbitrarily here.
-            var tileWidth = 4000;
-            var tileHeight = 4000;
-            if (surfaceWidth > tileWidth || surfaceHeight > tileHeight)
+            if (!(Image is CanvasBitmapImage image))
             {
-                var surface = _compositionGraphics.CreateVirtualDrawingSurface(
-                    new SizeInt32() { Width = surfaceWidth, Height = surfaceHeight },
-                    DirectXPixelFormat.B8G8R8A8UIntNormalized,
-                    DirectXAlphaMode.Premultiplied);
-                TiledBrushRenderer.Render(surface, _gridLinesCavnasBrush, tileWidth, tileHeight);
-                resultSurface = surface;
+                return 0;
             }
-            else
+            var size = image.Size;
+            return MipPyramid.LevelForView(size.Width, size.Height, zoomFactor, (uint)_canvasDevice.MaximumBitmapSizeInPixels);
+        }
+
+        // The full size image stands in until the level for the zoom is
+        // built, so something is on screen straight away. Only an image too
+        // big for one texture waits for its first coarse level.
+        private void ResetMipSurfaces(float zoomFactor)
+        {
+            _mipSurface?.Dispose();
+            _mipSurface = null;
+            _imageBrush.Surface = null;
+            var level = MipLevelForView(zoomFactor);
+            _mipLevel = MipLevelForView(1);
+            if (_mipLevel == 0)
             {
-                var surface = _compositionGraphics.CreateDrawingSurface2(
-                    new SizeInt32() { Width = surfaceWidth, Height = surfaceHeight },
-                    DirectXPixelFormat.B8G8R8A8UIntNormalized,
-                    DirectXAlphaMode.Premultiplied);
-                using (var drawingSession = CanvasComposition.CreateDrawingSession(surface))
+                _imageBrush.BitmapInterpolationMode = CompositionBitmapInterpolationMode.NearestNeighbor;
+                GenerateImage();
+            }
+            if (level != 0 && _mipPyramid != null)
+            {
+                ShowMipLevel(level);
+            }
+        }
+
+        private void UpdateMipLevel()
+        {
+            var level = MipLevelForView(ImageScrollViewer.ZoomFactor);
+            if (_mipPyramid == null)
+            {
+                if (level != 0)
                 {
-                    drawingSession.Clear(Colors.Transparent);
-                    drawingSession.FillRectangle(0, 0, surfaceWidth, surfaceHeight, _gridLinesCavnasBrush);
+                    BuildMipPyramid();
                 }
-                resultSurface = surface;
+                return;
+            }
+
+            if (level != _mipLevel)
+            {
+                ShowMipLevel(level);
             }
-            return resultSurface;
+        }
+
+        // Only the shown level keeps a surface. The one it replaces is
+        // released once the new one is on the brush.
+        private async void ShowMipLevel(uint level)
+        {
+            _mipLevel = level;
+            if (level == 0)
+            {
+                _imageBrush.BitmapInterpolationMode = CompositionBitmapInterpolationMode.NearestNeighbor;
+                GenerateImage();
+                _mipSurface?.Dispose();
+                _mipSurface = null;
+                return;
+            }
+
+            // Coarser levels are built on first use
+            var pyramid = _mipPyramid;
+            var size = pyramid.GetLevelSize(level);
+            var pixels = await Task.Run(() => pyramid.GetLevelPixels(level));
+
+            // The image or the zoom may have moved on while we were building
+            if (pyramid != _mipPyramid || level != _mipLevel)
+            {
+                return;
+            }
+
+            var surface = _compositionGraphics.CreateDrawingSurface2(
+                size,
+                DirectXPixelFormat.B8G8R8A8UIntNormalized,
+                DirectXAlphaMode.Premultiplied);
+            using (var bitmap = CanvasBitmap.CreateFromBytes(_canvasDevice, pixels, size.Width, size.Height, DirectXPixelFormat.B8G8R8A8UIntNormalized))
+            using (var drawingSession = CanvasComposition.CreateDrawingSession(surface))
+            {
+                drawingSession.Clear(Colors.Transparent);
+                drawingSession.DrawImage(bitmap);
+            }
+
+            var previous = _mipSurface;
+            _mipSurface = surface;
+            _imageBrush.BitmapInterpolationMode = CompositionBitmapInterpolationMode.Linear;
+            _imageBrush.Surface = surface;
+            previous?.Dispose();
         }
 
         private void ImageRectangle_PointerMoved(object sender, PointerRoutedEventArgs e)
@@ -504,17 +813,35 @@ namespace ImageViewer.Controls
 
                 var color = Image.GetColorFromPixel((int)position.X, (int)position.Y);
                 CurrentColor = color;
+                CurrentHdrValue = (Image as HdrFileImage)?.GetValueFromPixel((int)position.X, (int)position.Y);
             }
         }
 
+        private void ScrollViewer_ViewChanged(object sender, ScrollViewerViewChangedEventArgs e)
+        {
+            UpdateViewportTiles();
+            if (!e.IsIntermediate)
+            {
+                UpdateMipLevel();
+            }
+        }
+
+        private void ScrollViewer_SizeChanged(object sender, SizeChangedEventArgs e)
+        {
+            UpdateViewportTiles();
+        }
+
         private void OnImageChanged()
         {
+            ReleaseBackgroundSurface();
+            ReleaseGridLinesSurface();
+            SetChangedRegions(null);
+            SetOverlay(null);
             if (Image != null)
             {
                 RefreshImageGridSize();
 
                 GenerateBackground();
-                GenerateImage();
                 UpdateGridLines();
                 UpdateBorder();
 
@@ -525,6 +852,16 @@ namespace ImageViewer.Controls
             {
                 ImageBorder.Visibility = Visibility.Collapsed;
             }
+            InvalidateMeasureStatistics();
+            // Creates the image's surface. Only an image too big for one
+            // texture needs its pyramid before it can be shown at all.
+            _mipPyramid = null;
+            _mipPyramidImage = null;
+            ResetMipSurfaces(1);
+            if (MipLevelForView(1) != 0)
+            {
+                BuildMipPyramid();
+            }
         }
 
         private void UpdateBorder()
@@ -548,7 +885,7 @@ namespace ImageViewer.Controls
             }
             else
             {
-                _gridLinesBrush.Surface = null;
+                ReleaseGridLinesSurface();
                 GridLinesRectangle.Visibility = Visibility.Collapsed;
             }
         }
@@ -562,6 +899,7 @@ namespace ImageViewer.Controls
                     break;
                 case InputMode.Measure:
                     MeasureCanvas.Visibility = Visibility.Visible;
+                    EnsureRegionStatistics();
                     break;
                 default:
                     MeasureCanvas.Visibility = Visibility.Collapsed;
@@ -0,0 +1,29 @@
+﻿using System;
+using System.Numerics;
+using Windows.UI.Xaml.Data;
+
+namespace ImageViewer.Converters
+{
+    class HdrValueToTextConverter : IValueConverter
+    {
+        public object Convert(object value, Type targetType, object parameter, string language)
+        {
+            var hdrValue = value as Vector4?;
+            if (hdrValue.HasValue)
+            {
+                // scRGB, so 1.0 is SDR white (80 nits)
+                var result = hdrValue.Value;
+                return $"A: {result.W:0.#####} R: {result.X:0.#####} G: {result.Y:0.#####} B: {result.Z:0.#####}";
+            }
+            else
+            {
+                return "";
+            }
+        }
+
+        public object ConvertBack(object value, Type targetType, object parameter, string language)
+        {
+            throw new NotImplementedException();
+        }
+    }
+}
@@ -0,0 +1,33 @@
+﻿using ImageViewerNative;
+using System;
+using Windows.UI.Xaml.Data;
+
+namespace ImageViewer.Converters
+{
+    class RegionStatisticsToTextConverter : IValueConverter
+    {
+        public object Convert(object value, Type targetType, object parameter, string language)
+        {
+            var statistics = value as RegionStatisticsResult?;
+            if (statistics.HasValue)
+            {
+                var result = statistics.Value;
+                return $"{FormatChannel("A", result.Alpha)}\n{FormatChannel("R", result.Red)}\n{FormatChannel("G", result.Green)}\n{FormatChannel("B", result.Blue)}";
+            }
+            else
+            {
+                return "";
+            }
+        }
+
+        private static string FormatChannel(string name, ChannelStatistics channel)
+        {
+            return $"{name}: mean {channel.Mean:0.00} sd {channel.StandardDeviation:0.00} min {channel.Minimum} max {channel.Maximum} non-zero {channel.NonZeroCount}";
+        }
+
+        public object ConvertBack(object value, Type targetType, object parameter, string language)
+        {
+            throw new NotImplementedException();
+        }
+    }
+}
@@ -8,7 +8,11 @@ namespace ImageViewer.Dialogs
         Unknown,
         BGRA8,
         RGB8,
-        R8
+        R8,
+        RGBA16F,
+        RGBA32F,
+        // R10G10B10A2, BT.2020 primaries with the PQ curve
+        HDR10
     }
 
     public sealed partial class BinaryDetailsInputDialog : ContentDialog
@@ -22,7 +26,10 @@ namespace ImageViewer.Dialogs
             {
                 BinaryImportPixelFormat.BGRA8,
                 BinaryImportPixelFormat.RGB8,
-                BinaryImportPixelFormat.R8
+                BinaryImportPixelFormat.R8,
+                BinaryImportPixelFormat.RGBA16F,
+                BinaryImportPixelFormat.RGBA32F,
+                BinaryImportPixelFormat.HDR10
             };
             BinaryDetailsPixelFormatComboBox.ItemsSource = _supportedFormats;
             ResetBinaryDetailsInputDialog(width, height, format);
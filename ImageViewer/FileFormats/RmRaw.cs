@@ -41,6 +41,8 @@ namespace ImageViewer.FileFormats
         // "rmraw\0"
         static byte[] MAGIC = new byte[] { 114, 109, 114, 97, 119, 0 };
         static uint MAX_SUPPORTED_VERSION = 2;
+        // Frame streams share the header, but are read by RmRawFrameStreamFile
+        static uint FRAME_STREAM_VERSION = 3;
 
         public static async Task WriteImageAsync(IRandomAccessStream stream, uint width, uint height, RmRawPixelFormat format, byte[] bytes)
         {
@@ -82,13 +84,7 @@ namespace ImageViewer.FileFormats
             {
                 header = await ReadHeaderAsync(reader);
 
-                if (header.Magic.Length != MAGIC.Length ||
-                    header.Magic[0] != MAGIC[0] ||
-                    header.Magic[1] != MAGIC[1] ||
-                    header.Magic[2] != MAGIC[2] ||
-                    header.Magic[3] != MAGIC[3] ||
-                    header.Magic[4] != MAGIC[4] ||
-                    header.Magic[5] != MAGIC[5])
+                if (!IsValidMagic(header.Magic))
                 {
                     throw new Exception();
                 }
@@ -108,6 +104,27 @@ namespace ImageViewer.FileFormats
             return new RmRawImage(header, bytes);
         }
         
+        public static async Task<bool> IsFrameStreamAsync(IRandomAccessStream stream)
+        {
+            using (var reader = new DataReader(stream))
+            {
+                var header = await ReadHeaderAsync(reader);
+                reader.DetachStream();
+                return IsValidMagic(header.Magic) && header.Version == FRAME_STREAM_VERSION;
+            }
+        }
+
+        static bool IsValidMagic(byte[] magic)
+        {
+            return magic.Length == MAGIC.Length &&
+                magic[0] == MAGIC[0] &&
+                magic[1] == MAGIC[1] &&
+                magic[2] == MAGIC[2] &&
+                magic[3] == MAGIC[3] &&
+                magic[4] == MAGIC[4] &&
+                magic[5] == MAGIC[5];
+        }
+
         static async Task<RmRawHeader> ReadHeaderAsync(DataReader reader)
         {
             await reader.LoadAsync(6 + 4 + 4 + 4 + 4);
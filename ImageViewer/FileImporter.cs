@@ -1,7 +1,9 @@
 ﻿using ImageViewer.Dialogs;
 using ImageViewer.FileFormats;
+using ImageViewerNative;
 using Microsoft.Graphics.Canvas;
 using System;
+using System.Buffers;
 using System.Runtime.InteropServices.WindowsRuntime;
 using System.Text.RegularExpressions;
 using System.Threading.Tasks;
@@ -65,36 +67,34 @@ namespace ImageViewer
                     }
                 // Other formats
                 case BinaryImportPixelFormat.RGB8:
+                case BinaryImportPixelFormat.R8:
                     {
-                        var bytes = buffer.ToArray();
-                        var bgraBytes = new byte[Width * Height * 4];
-                        for (var i = 0; i < Width * Height; i++)
+                        var bytesPerPixel = Format == BinaryImportPixelFormat.RGB8 ? 3 : 1;
+                        var bytes = ArrayPool<byte>.Shared.Rent((int)buffer.Length);
+                        try
                         {
-                            var sourceIndex = i * 3;
-                            var destIndex = i * 4;
-
-                            bgraBytes[destIndex + 0] = bytes[sourceIndex + 2];
-                            bgraBytes[destIndex + 1] = bytes[sourceIndex + 1];
-                            bgraBytes[destIndex + 2] = bytes[sourceIndex + 0];
-                            bgraBytes[destIndex + 3] = 255;
+                            buffer.CopyTo(0, bytes, 0, (int)buffer.Length);
+                            return PooledPixelConversion.CreateOpaqueBgra8Bitmap(device, bytes, Width, Height, bytesPerPixel);
+                        }
+                        finally
+                        {
+                            ArrayPool<byte>.Shared.Return(bytes);
                         }
-                        return CanvasBitmap.CreateFromBytes(device, bgraBytes, Width, Height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
                     }
-                case BinaryImportPixelFormat.R8:
+                // Float formats open as HDR images
+                case BinaryImportPixelFormat.RGBA16F:
+                    {
+                        return CanvasBitmap.CreateFromBytes(device, buffer, Width, Height, DirectXPixelFormat.R16G16B16A16Float);
+                    }
+                case BinaryImportPixelFormat.RGBA32F:
+                    {
+                        return CanvasBitmap.CreateFromBytes(device, buffer, Width, Height, DirectXPixelFormat.R32G32B32A32Float);
+                    }
+                case BinaryImportPixelFormat.HDR10:
                     {
                         var bytes = buffer.ToArray();
-                        var bgraBytes = new byte[Width * Height * 4];
-                        for (var i = 0; i < Width * Height; i++)
-                        {
-                            var sourceIndex = i;
-                            var destIndex = i * 4;
-
-                            bgraBytes[destIndex + 0] = bytes[sourceIndex];
-                            bgraBytes[destIndex + 1] = bytes[sourceIndex];
-                            bgraBytes[destIndex + 2] = bytes[sourceIndex];
-                            bgraBytes[destIndex + 3] = 255;
-                        }
-                        return CanvasBitmap.CreateFromBytes(device, bgraBytes, Width, Height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
+                        var halfBytes = await Task.Run(() => HdrImage.CreateFromHdr10Pixels(bytes, (uint)Width, (uint)Height).GetHalfPixelBytes());
+                        return CanvasBitmap.CreateFromBytes(device, halfBytes, Width, Height, DirectXPixelFormat.R16G16B16A16Float);
                     }
                 default:
                     throw new ArgumentException();
@@ -144,33 +144,11 @@ namespace ImageViewer
                 // Other formats
                 case RmRawPixelFormat.RGB8:
                     {
-                        var bgraBytes = new byte[Width * Height * 4];
-                        for (var i = 0; i < Width * Height; i++)
-                        {
-                            var sourceIndex = i * 3;
-                            var destIndex = i * 4;
-
-                            bgraBytes[destIndex + 0] = bytes[sourceIndex + 2];
-                            bgraBytes[destIndex + 1] = bytes[sourceIndex + 1];
-                            bgraBytes[destIndex + 2] = bytes[sourceIndex + 0];
-                            bgraBytes[destIndex + 3] = 255;
-                        }
-                        return CanvasBitmap.CreateFromBytes(device, bgraBytes, Width, Height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
+                        return PooledPixelConversion.CreateOpaqueBgra8Bitmap(device, bytes, Width, Height, 3);
                     }
                 case RmRawPixelFormat.R8:
                     {
-                        var bgraBytes = new byte[Width * Height * 4];
-                        for (var i = 0; i < Width * Height; i++)
-                        {
-                            var sourceIndex = i;
-                            var destIndex = i * 4;
-
-                            bgraBytes[destIndex + 0] = bytes[sourceIndex];
-                            bgraBytes[destIndex + 1] = bytes[sourceIndex];
-                            bgraBytes[destIndex + 2] = bytes[sourceIndex];
-                            bgraBytes[destIndex + 3] = 255;
-                        }
-                        return CanvasBitmap.CreateFromBytes(device, bgraBytes, Width, Height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
+                        return PooledPixelConversion.CreateOpaqueBgra8Bitmap(device, bytes, Width, Height, 1);
                     }
                 default:
                     throw new ArgumentException();
@@ -178,6 +156,70 @@ namespace ImageViewer
         }
     }
 
+    // Recorded captures. Imported as a still image, this is the first frame.
+    class ImportedRmRawFrameStreamFile : IImportedFile
+    {
+        public StorageFile File { get; }
+
+        public ImportedRmRawFrameStreamFile(StorageFile file)
+        {
+            File = file;
+        }
+
+        public async Task<CanvasBitmap> ImportFileAsync(CanvasDevice device)
+        {
+            using (var stream = await File.OpenReadAsync())
+            {
+                var frameStream = await Task.Run(() => new RmRawFrameStreamFile(stream));
+                var size = frameStream.Size;
+                var bytes = await Task.Run(() => frameStream.DecodeFrame(0));
+                return CanvasBitmap.CreateFromBytes(device, bytes, size.Width, size.Height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
+            }
+        }
+    }
+
+    // Imports expand their pixels into arrays rented from the shared
+    // ArrayPool. The bitmap copies the pixels as it's created, so the
+    // arrays go back straight away and the next import reuses them.
+    static class PooledPixelConversion
+    {
+        // RGB8 (3 bytes per pixel) or R8 (1) to opaque BGRA8
+        public static CanvasBitmap CreateOpaqueBgra8Bitmap(CanvasDevice device, byte[] bytes, int width, int height, int bytesPerPixel)
+        {
+            var pixelCount = width * height;
+            var bgraLength = pixelCount * 4;
+            var bgraBytes = ArrayPool<byte>.Shared.Rent(bgraLength);
+            try
+            {
+                for (var i = 0; i < pixelCount; i++)
+                {
+                    var sourceIndex = i * bytesPerPixel;
+                    var destIndex = i * 4;
+
+                    if (bytesPerPixel == 3)
+                    {
+                        bgraBytes[destIndex + 0] = bytes[sourceIndex + 2];
+                        bgraBytes[destIndex + 1] = bytes[sourceIndex + 1];
+                        bgraBytes[destIndex + 2] = bytes[sourceIndex + 0];
+                    }
+                    else
+                    {
+                        bgraBytes[destIndex + 0] = bytes[sourceIndex];
+                        bgraBytes[destIndex + 1] = bytes[sourceIndex];
+                        bgraBytes[destIndex + 2] = bytes[sourceIndex];
+                    }
+                    bgraBytes[destIndex + 3] = 255;
+                }
+                // Rented arrays can be longer than asked for
+                return CanvasBitmap.CreateFromBytes(device, bgraBytes.AsBuffer(0, bgraLength), width, height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
+            }
+            finally
+            {
+                ArrayPool<byte>.Shared.Return(bgraBytes);
+            }
+        }
+    }
+
     static class FileImporter
     {
         public static async Task<IImportedFile> OpenFileAsync()
@@ -188,6 +230,7 @@ namespace ImageViewer
             picker.FileTypeFilter.Add(".jpeg");
             picker.FileTypeFilter.Add(".png");
             picker.FileTypeFilter.Add(".bmp");
+            picker.FileTypeFilter.Add(".jxr");
             picker.FileTypeFilter.Add(".bin");
             picker.FileTypeFilter.Add(".rmraw");
 
@@ -231,7 +274,15 @@ namespace ImageViewer
                             var basiProperties = await file.GetBasicPropertiesAsync();
                             var size = basiProperties.Size;
                             var pixels = (ulong)(width * height);
-                            if (pixels * 4 == size)
+                            if (pixels * 16 == size)
+                            {
+                                format = BinaryImportPixelFormat.RGBA32F;
+                            }
+                            else if (pixels * 8 == size)
+                            {
+                                format = BinaryImportPixelFormat.RGBA16F;
+                            }
+                            else if (pixels * 4 == size)
                             {
                                 format = BinaryImportPixelFormat.BGRA8;
                             }
@@ -256,12 +307,23 @@ namespace ImageViewer
                     break;
                 case ".rmraw":
                     {
-                        RmRawImage rawImage;
+                        RmRawImage rawImage = null;
                         using (var stream = await file.OpenReadAsync())
                         {
-                            rawImage = await RmRaw.ReadImageAsync(stream);
+                            if (!await RmRaw.IsFrameStreamAsync(stream))
+                            {
+                                stream.Seek(0);
+                                rawImage = await RmRaw.ReadImageAsync(stream);
+                            }
+                        }
+                        if (rawImage != null)
+                        {
+                            result = new ImportedRmRawFile(file, rawImage);
+                        }
+                        else
+                        {
+                            result = new ImportedRmRawFrameStreamFile(file);
                         }
-                        result = new ImportedRmRawFile(file, rawImage);
                     }
                     break;
                 default:
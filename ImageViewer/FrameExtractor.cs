@@ -19,7 +19,21 @@ namespace ImageViewer
         public TimeSpan Timestamp { get; }
         public ulong FrameId { get; }
 
-        public static async Task<List<VideoFrame>> ExtractFramesAsync(IRandomAccessStream stream, Direct3D11Device device, CompositionGraphicsDevice compGraphics)
+        public static Task<List<VideoFrame>> ExtractFramesAsync(IRandomAccessStream stream, Direct3D11Device device, CompositionGraphicsDevice compGraphics, FrameExtractionOptions options)
+        {
+            return ExtractFramesAsync(callback => VideoFrameExtractor.ExtractFromStream(stream, device, options, callback), device, compGraphics);
+        }
+
+        public static Task<List<VideoFrame>> ExtractRmRawFramesAsync(IRandomAccessStream stream, Direct3D11Device device, CompositionGraphicsDevice compGraphics, FrameExtractionOptions options)
+        {
+            return ExtractFramesAsync(callback =>
+            {
+                var file = new RmRawFrameStreamFile(stream);
+                file.ExtractFrames(device, options, callback);
+            }, device, compGraphics);
+        }
+
+        private static async Task<List<VideoFrame>> ExtractFramesAsync(Action<EventHandler<VideoFrameArgs>> extract, Direct3D11Device device, CompositionGraphicsDevice compGraphics)
         {
             var frames = await Task.Run(() =>
             {
@@ -28,7 +42,7 @@ namespace ImageViewer
                 var multithread = device.Multithread;
                 multithread.IsMultithreadProtected = true;
 
-                VideoFrameExtractor.ExtractFromStream(stream, device, (s, args) =>
+                extract((s, args) =>
                 {
                     var sourceSurface = args.Surface;
                     var sourceDescription = sourceSurface.Description;
@@ -49,7 +63,7 @@ namespace ImageViewer
                         description.CpuAccessFlags = 0;
                         description.MiscFlags = 0;
                         description.MipLevels = 1;
-                        texture = device.CreateTexture2D(description);
+                        texture = TexturePool.Shared.Acquire(device, description);
                         context.CopyResource(texture, sourceSurface);
                     }
 
@@ -59,6 +73,8 @@ namespace ImageViewer
                     result.Add(new VideoFrame(null, texture, args.Timestamp, args.FrameId));
                 });
 
+                // Only keep as many idle textures as this video used
+                TexturePool.Shared.Trim();
                 return result;
             });
 
@@ -1,10 +1,12 @@
 ﻿using ImageViewer.FileFormats;
 using ImageViewer.ScreenCapture;
 using ImageViewer.System;
+using ImageViewerNative;
 using Microsoft.Graphics.Canvas;
 using Microsoft.Graphics.Canvas.UI.Composition;
 using System;
 using System.Collections.Generic;
+using System.Numerics;
 using System.Threading;
 using System.Threading.Tasks;
 using Windows.Foundation;
@@ -39,6 +41,7 @@ namespace ImageViewer
         ICompositionSurface CreateSurface(CompositionGraphicsDevice graphics);
         void RegenerateSurface();
         Color? GetColorFromPixel(int x, int y);
+        byte[] GetPixelBytes();
     }
 
     static class BitmapHelpers
@@ -48,7 +51,7 @@ namespace ImageViewer
             switch (format)
             {
                 case ImageFormat.Png:
-                    await bitmap.SaveAsync(stream, CanvasBitmapFileFormat.Png);
+                    await SaveToPngStreamAsync(bitmap, stream, PngWriter.DefaultCompressionLevel);
                     break;
                 case ImageFormat.RawBgra8:
                     {
@@ -61,6 +64,47 @@ namespace ImageViewer
                     throw new ArgumentException();
             }
         }
+
+        // Level 0 skips compression, for scratch output. 1-9 trade speed
+        // for size like zlib.
+        public static async Task SaveToPngStreamAsync(CanvasBitmap bitmap, IRandomAccessStream stream, uint compressionLevel)
+        {
+            // The native encoder only takes BGRA8, anything else goes through WIC
+            if (bitmap.Format != DirectXPixelFormat.B8G8R8A8UIntNormalized)
+            {
+                await bitmap.SaveAsync(stream, CanvasBitmapFileFormat.Png);
+                return;
+            }
+
+            var size = bitmap.SizeInPixels;
+            var premultiplied = bitmap.AlphaMode == CanvasAlphaMode.Premultiplied;
+            await SaveToPngStreamAsync(bitmap.GetPixelBytes(), size.Width, size.Height, premultiplied, stream, compressionLevel);
+        }
+
+        public static Task SaveToPngStreamAsync(byte[] bgraBytes, uint width, uint height, bool premultiplied, IRandomAccessStream stream, uint compressionLevel)
+        {
+            return Task.Run(() => PngWriter.WriteToStream(bgraBytes, width, height, premultiplied, compressionLevel, stream));
+        }
+
+        public static byte[] GetBgra8PixelBytes(CanvasBitmap bitmap)
+        {
+            if (bitmap.Format == DirectXPixelFormat.B8G8R8A8UIntNormalized)
+            {
+                return bitmap.GetPixelBytes();
+            }
+
+            var colors = bitmap.GetPixelColors();
+            var bytes = new byte[colors.Length * 4];
+            for (var i = 0; i < colors.Length; i++)
+            {
+                var color = colors[i];
+                bytes[(i * 4) + 0] = color.B;
+                bytes[(i * 4) + 1] = color.G;
+                bytes[(i * 4) + 2] = color.R;
+                bytes[(i * 4) + 3] = color.A;
+            }
+            return bytes;
+        }
     }
 
     class CanvasBitmapImage : IImage
@@ -68,8 +112,13 @@ namespace ImageViewer
         private CompositionDrawingSurface _surface;
         private Color[] _colors;
         private BitmapSize _size;
+        // Set when a display transform is applied
+        private byte[] _displayPixels;
+        private CanvasBitmap _displayBitmap;
+        private int _displayTransformVersion = 0;
 
         public CanvasBitmap Bitmap { get; private set; }
+        public ColorTransform DisplayTransform { get; private set; }
 
         public string DisplayName { get; }
         public BitmapSize Size => _size;
@@ -87,7 +136,48 @@ namespace ImageViewer
             using (var drawingSession = CanvasComposition.CreateDrawingSession(_surface))
             {
                 drawingSession.Clear(Colors.Transparent);
-                drawingSession.DrawImage(Bitmap);
+                drawingSession.DrawImage(_displayBitmap ?? Bitmap);
+            }
+        }
+
+        // Changes how the image is shown, not the pixels that are probed
+        // or saved. Null shows the pixels as they are.
+        public async Task SetDisplayTransformAsync(ColorTransform transform)
+        {
+            if (transform?.Key == DisplayTransform?.Key)
+            {
+                return;
+            }
+            DisplayTransform = transform;
+
+            // Only the latest of several quick changes is shown
+            var version = ++_displayTransformVersion;
+            byte[] pixels = null;
+            if (transform != null)
+            {
+                var bytes = BitmapHelpers.GetBgra8PixelBytes(Bitmap);
+                pixels = await Task.Run(() => transform.Apply(bytes, _size.Width, _size.Height));
+                if (version != _displayTransformVersion)
+                {
+                    return;
+                }
+            }
+
+            _displayPixels = pixels;
+            CreateDisplayBitmap();
+            if (_surface != null)
+            {
+                UpdateSurface();
+            }
+        }
+
+        private void CreateDisplayBitmap()
+        {
+            _displayBitmap?.Dispose();
+            _displayBitmap = null;
+            if (_displayPixels != null)
+            {
+                _displayBitmap = CanvasBitmap.CreateFromBytes(GraphicsManager.Current.CanvasDevice, _displayPixels, (int)_size.Width, (int)_size.Height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
             }
         }
 
@@ -115,11 +205,14 @@ namespace ImageViewer
         public void Dispose()
         {
             Bitmap.Dispose();
+            _displayBitmap?.Dispose();
+            _displayBitmap = null;
         }
 
         public void RegenerateSurface()
         {
             Bitmap = CanvasBitmap.CreateFromColors(GraphicsManager.Current.CanvasDevice, _colors, (int)_size.Width, (int)_size.Height);
+            CreateDisplayBitmap();
             if (_surface != null)
             {
                 UpdateSurface();
@@ -135,13 +228,26 @@ namespace ImageViewer
             }
             return null;
         }
+
+        public byte[] GetPixelBytes()
+        {
+            return Bitmap.GetPixelBytes();
+        }
     }
 
     class FileImage : CanvasBitmapImage
     {
-        public static async Task<FileImage> CreateAsync(IImportedFile file)
+        // Float images open as an HdrFileImage
+        public static async Task<IImage> CreateAsync(IImportedFile file)
         {
             var bitmap = await file.ImportFileAsync(GraphicsManager.Current.CanvasDevice);
+            if (HdrFileImage.IsHdrFormat(bitmap.Format))
+            {
+                using (bitmap)
+                {
+                    return await HdrFileImage.CreateAsync(bitmap, file);
+                }
+            }
             var image = new FileImage(bitmap, file);
             return image;
         }
@@ -154,6 +260,170 @@ namespace ImageViewer
         }
     }
 
+    // Half and full float images are tone mapped to BGRA8 for display. The
+    // original values are kept as half floats, so probing and diffing see
+    // exactly what was in the file.
+    class HdrFileImage : IImage
+    {
+        public static bool IsHdrFormat(DirectXPixelFormat format)
+        {
+            return format == DirectXPixelFormat.R16G16B16A16Float || format == DirectXPixelFormat.R32G32B32A32Float;
+        }
+
+        public static Task<HdrImage> CreateHdrImageAsync(CanvasBitmap bitmap)
+        {
+            var bytes = bitmap.GetPixelBytes();
+            var size = bitmap.SizeInPixels;
+            if (bitmap.Format == DirectXPixelFormat.R32G32B32A32Float)
+            {
+                return Task.Run(() => HdrImage.CreateFromFloatPixels(bytes, size.Width, size.Height));
+            }
+            return Task.Run(() => new HdrImage(bytes, size.Width, size.Height));
+        }
+
+        public static async Task<HdrFileImage> CreateAsync(CanvasBitmap bitmap, IImportedFile file)
+        {
+            var pixels = await CreateHdrImageAsync(bitmap);
+            var image = new HdrFileImage(pixels, file);
+            await image.UpdateDisplayPixelsAsync();
+            return image;
+        }
+
+        private CompositionDrawingSurface _surface;
+        private CanvasBitmap _displayBitmap;
+        private byte[] _displayPixels;
+        private float _exposureStops = 0.0f;
+        private ToneMapOperator _toneMapOperator = ToneMapOperator.Filmic;
+        private int _toneMapVersion = 0;
+
+        public HdrImage Pixels { get; }
+        public IImportedFile File { get; }
+        public string DisplayName { get; }
+        public BitmapSize Size { get; }
+        public float ExposureStops => _exposureStops;
+        public ToneMapOperator ToneMapOperator => _toneMapOperator;
+
+        private HdrFileImage(HdrImage pixels, IImportedFile file)
+        {
+            Pixels = pixels;
+            File = file;
+            DisplayName = file.File.Name;
+            Size = new BitmapSize() { Width = pixels.Width, Height = pixels.Height };
+        }
+
+        public async Task SetToneMappingAsync(float exposureStops, ToneMapOperator toneMapOperator)
+        {
+            if (exposureStops == _exposureStops && toneMapOperator == _toneMapOperator)
+            {
+                return;
+            }
+            _exposureStops = exposureStops;
+            _toneMapOperator = toneMapOperator;
+            await UpdateDisplayPixelsAsync();
+        }
+
+        private async Task UpdateDisplayPixelsAsync()
+        {
+            // Slider drags queue up several of these, only the latest is shown
+            var version = ++_toneMapVersion;
+            var exposureStops = _exposureStops;
+            var toneMapOperator = _toneMapOperator;
+            var pixels = await Task.Run(() => Pixels.ToneMap(exposureStops, toneMapOperator));
+            if (version != _toneMapVersion)
+            {
+                return;
+            }
+
+            _displayPixels = pixels;
+            CreateDisplayBitmap();
+            if (_surface != null)
+            {
+                UpdateSurface();
+            }
+        }
+
+        private void CreateDisplayBitmap()
+        {
+            _displayBitmap?.Dispose();
+            _displayBitmap = CanvasBitmap.CreateFromBytes(GraphicsManager.Current.CanvasDevice, _displayPixels, (int)Size.Width, (int)Size.Height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
+        }
+
+        private void UpdateSurface()
+        {
+            using (var drawingSession = CanvasComposition.CreateDrawingSession(_surface))
+            {
+                drawingSession.Clear(Colors.Transparent);
+                drawingSession.DrawImage(_displayBitmap);
+            }
+        }
+
+        public ICompositionSurface CreateSurface(CompositionGraphicsDevice graphics)
+        {
+            if (_surface == null)
+            {
+                _surface = graphics.CreateDrawingSurface2(
+                    Size.ToSizeInt32(),
+                    DirectXPixelFormat.B8G8R8A8UIntNormalized,
+                    DirectXAlphaMode.Premultiplied);
+                UpdateSurface();
+            }
+            return _surface;
+        }
+
+        public void RegenerateSurface()
+        {
+            CreateDisplayBitmap();
+            if (_surface != null)
+            {
+                UpdateSurface();
+            }
+        }
+
+        // Snapshots are of the tone mapped image
+        public async Task SaveSnapshotToStreamAsync(IRandomAccessStream stream, ImageFormat format)
+        {
+            switch (format)
+            {
+                case ImageFormat.Png:
+                    await BitmapHelpers.SaveToPngStreamAsync(_displayPixels, Size.Width, Size.Height, true, stream, PngWriter.DefaultCompressionLevel);
+                    break;
+                case ImageFormat.RawBgra8:
+                    await RmRaw.WriteImageAsync(stream, Size.Width, Size.Height, RmRawPixelFormat.BGRA8, _displayPixels);
+                    break;
+                default:
+                    throw new ArgumentException();
+            }
+        }
+
+        public void Dispose()
+        {
+            _displayBitmap?.Dispose();
+            _displayBitmap = null;
+        }
+
+        // The displayed color
+        public Color? GetColorFromPixel(int x, int y)
+        {
+            if (x >= 0 && x < Size.Width && y >= 0 && y < Size.Height)
+            {
+                var i = (int)((y * Size.Width) + x);
+                return DiffResult.GetColor(_displayPixels, i);
+            }
+            return null;
+        }
+
+        // The stored value, before tone mapping
+        public Vector4? GetValueFromPixel(int x, int y)
+        {
+            return Pixels.GetPixel(x, y);
+        }
+
+        public byte[] GetPixelBytes()
+        {
+            return _displayPixels;
+        }
+    }
+
     public enum DiffViewMode
     {
         Color,
@@ -251,17 +521,22 @@ namespace ImageViewer
         {
             if (x >= 0 && x < Size.Width && y >= 0 && y < Size.Height)
             {
-                var i = (y * Size.Width) + x;
+                var i = (int)((y * Size.Width) + x);
                 switch (_viewMode)
                 {
                     case DiffViewMode.Color:
-                        return Diff.ColorDiffPixels[i];
+                        return DiffResult.GetColor(Diff.ColorDiffPixels, i);
                     case DiffViewMode.Alpha:
-                        return Diff.AlphaDiffPixels[i];
+                        return DiffResult.GetColor(Diff.AlphaDiffPixels, i);
                 }
             }
             return null;
         }
+
+        public byte[] GetPixelBytes()
+        {
+            return GetBitmapForViewMode(_viewMode).GetPixelBytes();
+        }
     }
 
     class CaptureImage : IImage
@@ -270,7 +545,13 @@ namespace ImageViewer
         private SimpleCapture _capture;
         private bool _showCursor = true;
         private bool _isPlaying = true;
-        private byte[] _pauseData = null;
+        private Direct3D11Texture2D _pauseFrame = null;
+        private PixelProbe _probe = null;
+        private VideoScopes _pauseFrameScopes = null;
+
+        // Live scopes look at about this many pixels of each frame, so that
+        // they keep up with 60 fps at 4K
+        private const double LiveScopesSampleBudget = 2100000;
 
         public GraphicsCaptureItem Item { get; }
 
@@ -302,23 +583,14 @@ namespace ImageViewer
             }
             else
             {
-                bytes = (byte[])_pauseData.Clone();
+                bytes = _pauseFrame.GetBytes();
             }
 
             switch (format)
             {
                 case ImageFormat.Png:
                     {
-                        var encoder = await BitmapEncoder.CreateAsync(BitmapEncoder.PngEncoderId, stream);
-                        encoder.SetPixelData(
-                            BitmapPixelFormat.Bgra8,
-                            BitmapAlphaMode.Premultiplied,
-                            Size.Width,
-                            Size.Height,
-                            1.0,
-                            1.0,
-                            bytes);
-                        await encoder.FlushAsync();
+                        await BitmapHelpers.SaveToPngStreamAsync(bytes, Size.Width, Size.Height, true, stream, PngWriter.DefaultCompressionLevel);
                     }
                     break;
                 case ImageFormat.RawBgra8:
@@ -343,7 +615,7 @@ namespace ImageViewer
             if (!_isPlaying)
             {
                 _isPlaying = true;
-                _pauseData = null;
+                SetPauseFrame(null);
                 _capture.Continue();
             }
         }
@@ -353,13 +625,34 @@ namespace ImageViewer
             if (_isPlaying)
             {
                 _isPlaying = false;
-                _pauseData = _capture.Pause();
+                SetPauseFrame(_capture.Pause());
+            }
+        }
+
+        private void SetPauseFrame(Direct3D11Texture2D frame)
+        {
+            _pauseFrame?.Dispose();
+            _pauseFrame = frame;
+            _pauseFrameScopes = null;
+            if (frame != null)
+            {
+                if (_probe == null)
+                {
+                    _probe = new PixelProbe(_device, frame);
+                }
+                else
+                {
+                    _probe.SetSurface(frame);
+                }
             }
         }
 
         public void Dispose()
         {
             _capture.Dispose();
+            SetPauseFrame(null);
+            _probe?.Dispose();
+            _probe = null;
         }
 
         public bool ShowCursor
@@ -377,29 +670,86 @@ namespace ImageViewer
             await _capture.SetIsBorderRequiredAsync(showBorder);
         }
 
+        public CaptureChangeSnapshot TakeChangeSnapshot()
+        {
+            return _capture.TakeChangeSnapshot();
+        }
+
+        public void SetChangeTrackingEnabled(bool enabled)
+        {
+            _capture.SetChangeTrackingEnabled(enabled);
+        }
+
+        public bool IsRecording => _capture.IsRecording;
+
+        public void StartRecording(IRandomAccessStream stream)
+        {
+            _capture.StartRecording(stream);
+        }
+
+        public Task<CaptureRecorder> StopRecordingAsync()
+        {
+            return _capture.StopRecordingAsync();
+        }
+
+        public bool AreScopesEnabled => _capture.Scopes != null;
+
+        public void SetScopesEnabled(bool enabled)
+        {
+            if (enabled)
+            {
+                var step = Math.Ceiling(Math.Sqrt((double)Size.Width * Size.Height / LiveScopesSampleBudget));
+                _capture.StartScopes((uint)Math.Max(1.0, step));
+            }
+            else
+            {
+                _capture.StopScopes();
+            }
+        }
+
+        // The scopes of the latest analyzed frame while playing. A paused
+        // frame holds still, so all of its pixels are analyzed once.
+        public VideoScopes TryGetScopes()
+        {
+            if (_isPlaying)
+            {
+                return _capture.Scopes?.TryGetLatest();
+            }
+            if (_pauseFrameScopes == null && _pauseFrame != null)
+            {
+                _pauseFrameScopes = VideoScopes.Analyze(_pauseFrame.GetBytes(), Size.Width, Size.Height, 1);
+            }
+            return _pauseFrameScopes;
+        }
+
         public void RegenerateSurface()
         {
             _device = GraphicsManager.Current.CaptureDevice;
             _capture.Recreate(_device);
+
+            // The paused frame and the probe belong to the old device
+            _probe?.Dispose();
+            _probe = null;
+            if (!_isPlaying)
+            {
+                SetPauseFrame(_capture.Pause());
+            }
         }
 
         public Color? GetColorFromPixel(int x, int y)
         {
-            if (!_isPlaying)
+            if (!_isPlaying && _probe != null)
             {
-                if (x >= 0 && x < Size.Width && y >= 0 && y < Size.Height)
-                {
-                    var i = (y * Size.Width) + x;
-                    i *= 4; // BGRA8
-                    var b = _pauseData[i];
-                    var g = _pauseData[i + 1];
-                    var r = _pauseData[i + 2];
-                    var a = _pauseData[i + 3];
-                    return new Color { A = a, R = r, G = g, B = b };
-                }
+                return _probe.GetColorFromPixel(x, y);
             }
             return null;
         }
+
+        public byte[] GetPixelBytes()
+        {
+            // Only a paused capture holds still long enough to measure
+            return _isPlaying ? null : _pauseFrame?.GetBytes();
+        }
     }
 
     class VideoImage : IImage
@@ -417,7 +767,8 @@ namespace ImageViewer
         private MediaPlayer _player;
         private MediaPlayerSurface _surface;
         private bool _isPlaying = false;
-        private Color[] _pauseData = null;
+        private CanvasBitmap _pauseFrame = null;
+        private PixelProbe _probe = null;
         private Timer _pauseDataUpdateTimer = null;
         private DispatcherQueue _dispatcherQueue = null;
         private DispatcherQueueTimer _playbackTimer = null;
@@ -470,7 +821,8 @@ namespace ImageViewer
             if (!_isPlaying)
             {
                 _isPlaying = true;
-                _pauseData = null;
+                _pauseFrame?.Dispose();
+                _pauseFrame = null;
                 _player.Play();
             }
         }
@@ -554,9 +906,16 @@ namespace ImageViewer
 
         private void UpdatePauseData()
         {
-            using (var bitmap = GetCurrentBitmap())
+            var frame = GetCurrentBitmap();
+            _pauseFrame?.Dispose();
+            _pauseFrame = frame;
+            if (_probe == null)
             {
-                _pauseData = bitmap.GetPixelColors();
+                _probe = new PixelProbe(GraphicsManager.Current.CanvasDevice, frame);
+            }
+            else
+            {
+                _probe.SetSurface(frame);
             }
         }
 
@@ -591,17 +950,29 @@ namespace ImageViewer
                 _player.Dispose();
                 _player = null;
                 _pauseDataUpdateTimer.Dispose();
+                _pauseFrame?.Dispose();
+                _pauseFrame = null;
+                _probe?.Dispose();
+                _probe = null;
             }
         }
 
         public Color? GetColorFromPixel(int x, int y)
         {
-            if (!_isPlaying && _pauseData != null)
+            if (!_isPlaying && _pauseFrame != null)
             {
-                if (x >= 0 && x < Size.Width && y >= 0 && y < Size.Height)
+                return _probe.GetColorFromPixel(x, y);
+            }
+            return null;
+        }
+
+        public byte[] GetPixelBytes()
+        {
+            if (!_isPlaying)
+            {
+                using (var bitmap = GetCurrentBitmap())
                 {
-                    var i = (y * Size.Width) + x;
-                    return _pauseData[i];
+                    return bitmap.GetPixelBytes();
                 }
             }
             return null;
@@ -609,7 +980,13 @@ namespace ImageViewer
 
         public void RegenerateSurface()
         {
-            // Do nothing
+            // The paused frame and the probe belong to the old device
+            _probe?.Dispose();
+            _probe = null;
+            if (!_isPlaying)
+            {
+                UpdatePauseData();
+            }
         }
 
         public async Task SaveSnapshotToStreamAsync(IRandomAccessStream stream, ImageFormat format)
@@ -620,19 +997,30 @@ namespace ImageViewer
             }
         }
 
-        public Task<FrameByFrameVideoImage> CreateFrameByFrameVideoImageAsync(Direct3D11Device device, CompositionGraphicsDevice compGraphics)
+        public Task<FrameByFrameVideoImage> CreateFrameByFrameVideoImageAsync(Direct3D11Device device, CompositionGraphicsDevice compGraphics, FrameExtractionOptions options)
         {
-            return FrameByFrameVideoImage.CreateAsync(_file, device, compGraphics);
+            return FrameByFrameVideoImage.CreateAsync(_file, device, compGraphics, options);
         }
     }
 
     class FrameByFrameVideoImage : IImage
     {
-        public static async Task<FrameByFrameVideoImage> CreateAsync(StorageFile file, Direct3D11Device device, CompositionGraphicsDevice compGraphics)
+        // The options crop and scale every frame as it is extracted. The
+        // default options keep the full frame.
+        public static async Task<FrameByFrameVideoImage> CreateAsync(StorageFile file, Direct3D11Device device, CompositionGraphicsDevice compGraphics, FrameExtractionOptions options)
+        {
+            using (var stream = await file.OpenReadAsync())
+            {
+                var videoFrames = await VideoFrame.ExtractFramesAsync(stream, device, compGraphics, options);
+                return new FrameByFrameVideoImage(file, device, compGraphics, videoFrames);
+            }
+        }
+
+        public static async Task<FrameByFrameVideoImage> CreateFromRmRawAsync(StorageFile file, Direct3D11Device device, CompositionGraphicsDevice compGraphics)
         {
             using (var stream = await file.OpenReadAsync())
             {
-                var videoFrames = await VideoFrame.ExtractFramesAsync(stream, device, compGraphics);
+                var videoFrames = await VideoFrame.ExtractRmRawFramesAsync(stream, device, compGraphics, new FrameExtractionOptions());
                 return new FrameByFrameVideoImage(file, device, compGraphics, videoFrames);
             }
         }
@@ -643,9 +1031,20 @@ namespace ImageViewer
         private CompositionDrawingSurface _surface;
         private int _selectedIndex = -1;
 
-        private Direct3D11Texture2D _stagingTexture;
-        private byte[] _cachedBytes;
-        private int _cachedFrameIndex = -1;
+        private PixelProbe _probe;
+        private int _probedFrameIndex = -1;
+
+        private VideoScopes _scopes;
+        private int _scopedFrameIndex = -1;
+
+        private MotionAnalysis _motion;
+        private int _motionFrameIndex = -1;
+
+        // The frames read back most recently for the scopes and motion,
+        // oldest first. Stepping forward reuses the current frame as the
+        // next one's previous frame.
+        private List<KeyValuePair<int, Task<byte[]>>> _frameReadbacks = new List<KeyValuePair<int, Task<byte[]>>>();
+        private const int FrameReadbackCapacity = 2;
 
         public IReadOnlyList<VideoFrame> VideoFrames => _videoFrames;
         public int SelectedIndex
@@ -677,13 +1076,6 @@ namespace ImageViewer
             Size = new BitmapSize() { Width = (uint)description.Base.Width, Height = (uint)description.Base.Height };
 
             _surface = compGraphics.CreateDrawingSurface2(Size.ToSizeInt32(), DirectXPixelFormat.B8G8R8A8UIntNormalized, DirectXAlphaMode.Premultiplied);
-
-            // Create our staging texture
-            description.Usage = Direct3DUsage.Staging;
-            description.BindFlags = 0;
-            description.CpuAccessFlags = Direct3D11CpuAccessFlag.AccessRead;
-            description.MiscFlags = 0;
-            _stagingTexture = device.CreateTexture2D(description);
         }
 
         public string DisplayName { get; }
@@ -697,7 +1089,25 @@ namespace ImageViewer
 
         public void Dispose()
         {
-            // TODO
+            _probe?.Dispose();
+            _probe = null;
+            _scopes = null;
+            _motion = null;
+            _frameReadbacks.Clear();
+            // Everything drawn from the frames has to be gone before they go
+            // back to the pool, see TexturePool.Return
+            _surface?.Dispose();
+            _surface = null;
+            foreach (var frame in _videoFrames)
+            {
+                frame.Thumbnail?.Dispose();
+            }
+            foreach (var frame in _videoFrames)
+            {
+                TexturePool.Shared.Return(frame.Surface);
+            }
+            _videoFrames.Clear();
+            _selectedIndex = -1;
         }
 
         public Color? GetColorFromPixel(int x, int y)
@@ -705,26 +1115,104 @@ namespace ImageViewer
             var frame = TryGetCurrentFrame();
             if (frame != null)
             {
-                var desc = frame.Surface.Description;
-                if (x >= 0 && x < desc.Width && y >= 0 && y < desc.Height)
+                // Only the tiles around the cursor are read back
+                if (_probe == null)
                 {
-                    // If we've successfully acquired the current frame,
-                    // we should always be able to get the bytes. No need
-                    // to check for null.
-                    var bytes = TryGetCachedBytes();
-
-                    var index = ((y * desc.Width) + x) * 4; // BGRA8
-                    var blue = bytes[index + 0];
-                    var green = bytes[index + 1];
-                    var red = bytes[index + 2];
-                    var alpha = bytes[index + 3];
-
-                    return new Color() { B = blue, G = green, R = red, A = alpha };
+                    _probe = new PixelProbe(_device, frame.Surface);
                 }
+                else if (_probedFrameIndex != _selectedIndex)
+                {
+                    _probe.SetSurface(frame.Surface);
+                }
+                _probedFrameIndex = _selectedIndex;
+                return _probe.GetColorFromPixel(x, y);
             }
             return null;
         }
 
+        public byte[] GetPixelBytes()
+        {
+            return TryGetCurrentFrame()?.Surface.GetBytes();
+        }
+
+        // Analyzes every pixel of the selected frame, once per frame.
+        public async Task<VideoScopes> GetScopesAsync()
+        {
+            var frame = TryGetCurrentFrame();
+            if (frame == null)
+            {
+                return null;
+            }
+            if (_scopes != null && _scopedFrameIndex == _selectedIndex)
+            {
+                return _scopes;
+            }
+
+            var index = _selectedIndex;
+            var bytes = await ReadFrameBytesAsync(index);
+            var size = Size;
+            var scopes = await Task.Run(() => VideoScopes.Analyze(bytes, size.Width, size.Height, 1));
+            _scopes = scopes;
+            _scopedFrameIndex = index;
+            return scopes;
+        }
+
+        // Matches the selected frame against the one before it, once per
+        // frame. The first frame has nothing to match against.
+        public async Task<MotionAnalysis> GetMotionAsync()
+        {
+            var frame = TryGetCurrentFrame();
+            if (frame == null || _selectedIndex < 1)
+            {
+                return null;
+            }
+            if (_motion != null && _motionFrameIndex == _selectedIndex)
+            {
+                return _motion;
+            }
+
+            var index = _selectedIndex;
+            var previousBytes = await ReadFrameBytesAsync(index - 1);
+            var bytes = await ReadFrameBytesAsync(index);
+            var size = Size;
+            var motion = await Task.Run(() => MotionAnalysis.Estimate(previousBytes, bytes, size.Width, size.Height, MotionAnalysis.DefaultSearchRange));
+            _motion = motion;
+            _motionFrameIndex = index;
+            return motion;
+        }
+
+        // Reads the frame back on the thread pool. The device is already
+        // multithread protected for the frame extraction.
+        private Task<byte[]> ReadFrameBytesAsync(int index)
+        {
+            for (var i = 0; i < _frameReadbacks.Count; i++)
+            {
+                var readback = _frameReadbacks[i];
+                if (readback.Key == index)
+                {
+                    _frameReadbacks.RemoveAt(i);
+                    _frameReadbacks.Add(readback);
+                    return readback.Value;
+                }
+            }
+
+            var surface = _videoFrames[index].Surface;
+            var device = _device;
+            var task = Task.Run(() =>
+            {
+                using (var lockSession = device.Multithread.Lock())
+                {
+                    return surface.GetBytes();
+                }
+            });
+            _frameReadbacks.Add(new KeyValuePair<int, Task<byte[]>>(index, task));
+            if (_frameReadbacks.Count > FrameReadbackCapacity)
+            {
+                _frameReadbacks.RemoveAt(0);
+            }
+            return task;
+        }
+
         public void RegenerateSurface()
         {
             var frame = TryGetCurrentFrame();
@@ -740,10 +1228,8 @@ namespace ImageViewer
             {
                 case ImageFormat.Png:
                     {
-                        var bitmap = await SoftwareBitmap.CreateCopyFromSurfaceAsync(TryGetCurrentFrame().Surface);
-                        var encoder = await BitmapEncoder.CreateAsync(BitmapEncoder.PngEncoderId, stream);
-                        encoder.SetSoftwareBitmap(bitmap);
-                        await encoder.FlushAsync();
+                        var bytes = TryGetCurrentFrame().Surface.GetBytes();
+                        await BitmapHelpers.SaveToPngStreamAsync(bytes, Size.Width, Size.Height, true, stream, PngWriter.DefaultCompressionLevel);
                     }
                     break;
                 case ImageFormat.RawBgra8:
@@ -768,24 +1254,5 @@ namespace ImageViewer
                 return _videoFrames[_selectedIndex];
             }
         }
-
-        private byte[] TryGetCachedBytes()
-        {
-            var frame = TryGetCurrentFrame();
-            if (frame != null)
-            {
-                if (_cachedFrameIndex != _selectedIndex)
-                {
-                    _device.ImmediateContext.CopyResource(_stagingTexture, frame.Surface);
-                    _cachedBytes = _stagingTexture.GetBytes();
-                    _cachedFrameIndex = _selectedIndex;
-                }
-                return _cachedBytes;
-            }
-            else
-            {
-                return null;
-            }
-        }
     }
 }
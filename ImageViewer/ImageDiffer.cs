@@ -1,8 +1,9 @@
-﻿using Microsoft.Graphics.Canvas;
+﻿using ImageViewerNative;
+using Microsoft.Graphics.Canvas;
 using System;
-using System.Collections.Generic;
 using System.Diagnostics;
 using System.Threading.Tasks;
+using Windows.Graphics.DirectX;
 using Windows.UI;
 using Windows.UI.Popups;
 
@@ -13,14 +14,15 @@ namespace ImageViewer
         private int _width;
         private int _height;
 
-        public Color[] ColorDiffPixels { get; }
-        public Color[] AlphaDiffPixels { get; }
+        // BGRA8
+        public byte[] ColorDiffPixels { get; }
+        public byte[] AlphaDiffPixels { get; }
         public CanvasBitmap ColorDiffBitmap { get; private set; }
         public CanvasBitmap AlphaDiffBitmap { get; private set; }
         public bool ColorChannelsMatch { get; }
         public bool AlphaChannelsMatch { get; }
 
-        public DiffResult(CanvasDevice device, Color[] colorPixels, Color[] alphaPixels, int width, int height, bool colorsMatch, bool alphasMatch)
+        public DiffResult(CanvasDevice device, byte[] colorPixels, byte[] alphaPixels, int width, int height, bool colorsMatch, bool alphasMatch)
         {
             _width = width;
             _height = height;
@@ -35,14 +37,23 @@ namespace ImageViewer
         {
             ColorDiffBitmap?.Dispose();
             AlphaDiffBitmap?.Dispose();
-            ColorDiffBitmap = CanvasBitmap.CreateFromColors(device, ColorDiffPixels, _width, _height);
-            AlphaDiffBitmap = CanvasBitmap.CreateFromColors(device, AlphaDiffPixels, _width, _height);
+            ColorDiffBitmap = CanvasBitmap.CreateFromBytes(device, ColorDiffPixels, _width, _height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
+            AlphaDiffBitmap = CanvasBitmap.CreateFromBytes(device, AlphaDiffPixels, _width, _height, DirectXPixelFormat.B8G8R8A8UIntNormalized);
+        }
+
+        public static Color GetColor(byte[] pixels, int index)
+        {
+            var offset = index * 4;
+            return Color.FromArgb(pixels[offset + 3], pixels[offset + 2], pixels[offset + 1], pixels[offset]);
         }
     }
 
     static class ImageDiffer
     {
-        public static async Task<DiffResult> GenerateDiff(CanvasDevice device, IImportedFile file1, IImportedFile file2)
+        // 8-bit images are converted from their color spaces to sRGB before
+        // comparing, so the same picture in two encodings diffs as equal
+        // (give or take rounding).
+        public static async Task<DiffResult> GenerateDiff(CanvasDevice device, IImportedFile file1, IImportedFile file2, ColorSpaceOption colorSpace1, ColorSpaceOption colorSpace2)
         {
             var image1 = await file1.ImportFileAsync(device);
             var image2 = await file2.ImportFileAsync(device);
@@ -57,62 +68,53 @@ namespace ImageViewer
                 return null;
             }
 
-            var result = GenerateDiffBitmap(device, image1, image2);
+            var result = await GenerateDiffBitmapAsync(device, image1, image2, colorSpace1, colorSpace2);
             return result;
         }
 
-        private static DiffResult GenerateDiffBitmap(CanvasDevice device, CanvasBitmap image1, CanvasBitmap image2)
+        private static async Task<DiffResult> GenerateDiffBitmapAsync(CanvasDevice device, CanvasBitmap image1, CanvasBitmap image2, ColorSpaceOption colorSpace1, ColorSpaceOption colorSpace2)
         {
-            var pixels1 = image1.GetPixelColors();
-            var pixels2 = image2.GetPixelColors();
-            Debug.Assert(pixels1.Length == pixels2.Length);
-
-            var colorDiffPixels = new List<Color>();
-            var identicalColors = true;
-            var alphaDiffPixels = new List<Color>();
-            var identicalAlpha = true;
-            for (var i = 0; i < pixels1.Length; i++)
+            // Float images are compared by value, so differences too small
+            // to survive conversion to BGRA8 still show up
+            if (HdrFileImage.IsHdrFormat(image1.Format) && HdrFileImage.IsHdrFormat(image2.Format))
             {
-                var pixel1 = pixels1[i];
-                var pixel2 = pixels2[i];
+                return await GenerateHdrDiffBitmapAsync(device, image1, image2);
+            }
 
-                var diffB = Math.Abs(pixel1.B - pixel2.B);
-                var diffG = Math.Abs(pixel1.G - pixel2.G);
-                var diffR = Math.Abs(pixel1.R - pixel2.R);
-                var diffA = Math.Abs(pixel1.A - pixel2.A);
+            var pixels1 = BitmapHelpers.GetBgra8PixelBytes(image1);
+            var pixels2 = BitmapHelpers.GetBgra8PixelBytes(image2);
+            Debug.Assert(pixels1.Length == pixels2.Length);
 
-                if (diffB != 0 || diffG != 0 || diffR != 0)
+            // The native kernels run on the shared scheduler's threads,
+            // keep the calling thread free while they do
+            var size = image1.SizeInPixels;
+            var transform1 = colorSpace1.CreateTransformToSrgb();
+            var transform2 = colorSpace2.CreateTransformToSrgb();
+            var diff = await Task.Run(() =>
+            {
+                if (transform1 != null)
                 {
-                    identicalColors = false;
+                    pixels1 = transform1.Apply(pixels1, size.Width, size.Height);
                 }
-
-                if (diffA != 0)
+                if (transform2 != null)
                 {
-                    identicalAlpha = false;
+                    pixels2 = transform2.Apply(pixels2, size.Width, size.Height);
                 }
+                return new ImageDiff(pixels1, pixels2, size.Width, size.Height);
+            });
+            return new DiffResult(device, diff.GetColorDiffPixels(), diff.GetAlphaDiffPixels(), (int)size.Width, (int)size.Height, diff.ColorChannelsMatch, diff.AlphaChannelsMatch);
+        }
 
-                var newColorPixel = new Color
-                {
-                    B = (byte)diffB,
-                    G = (byte)diffG,
-                    R = (byte)diffR,
-                    A = 255
-                };
-                colorDiffPixels.Add(newColorPixel);
-                var newAlphaPixel = new Color
-                {
-                    B = (byte)diffA,
-                    G = (byte)diffA,
-                    R = (byte)diffA,
-                    A = 255
-                };
-                alphaDiffPixels.Add(newAlphaPixel);
-            }
+        private static async Task<DiffResult> GenerateHdrDiffBitmapAsync(CanvasDevice device, CanvasBitmap image1, CanvasBitmap image2)
+        {
+            var hdrImage1 = await HdrFileImage.CreateHdrImageAsync(image1);
+            var hdrImage2 = await HdrFileImage.CreateHdrImageAsync(image2);
+            var pixels1 = hdrImage1.GetHalfPixelBytes();
+            var pixels2 = hdrImage2.GetHalfPixelBytes();
 
             var size = image1.SizeInPixels;
-            var colorDiff = colorDiffPixels.ToArray();
-            var alphaDiff = alphaDiffPixels.ToArray();
-            return new DiffResult(device, colorDiff, alphaDiff, (int)size.Width, (int)size.Height, identicalColors, identicalAlpha);
+            var diff = await Task.Run(() => ImageDiff.FromHalfPixels(pixels1, pixels2, size.Width, size.Height));
+            return new DiffResult(device, diff.GetColorDiffPixels(), diff.GetAlphaDiffPixels(), (int)size.Width, (int)size.Height, diff.ColorChannelsMatch, diff.AlphaChannelsMatch);
         }
     }
 }
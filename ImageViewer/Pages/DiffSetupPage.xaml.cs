@@ -8,11 +8,16 @@ namespace ImageViewer.Pages
     {
         public IImportedFile SelectedFile1 { get; }
         public IImportedFile SelectedFile2 { get; }
+        // How each file's 8-bit values are encoded
+        public ColorSpaceOption ColorSpace1 { get; }
+        public ColorSpaceOption ColorSpace2 { get; }
 
-        public DiffSetupResult(IImportedFile file1, IImportedFile file2)
+        public DiffSetupResult(IImportedFile file1, IImportedFile file2, ColorSpaceOption colorSpace1, ColorSpaceOption colorSpace2)
         {
             SelectedFile1 = file1;
             SelectedFile2 = file2;
+            ColorSpace1 = colorSpace1;
+            ColorSpace2 = colorSpace2;
         }
     }
 
@@ -26,6 +31,10 @@ namespace ImageViewer.Pages
         {
             this.InitializeComponent();
             _task = task;
+            ColorSpace1ComboBox.ItemsSource = ColorSpaceOption.All;
+            ColorSpace1ComboBox.SelectedItem = ColorSpaceOption.Srgb;
+            ColorSpace2ComboBox.ItemsSource = ColorSpaceOption.All;
+            ColorSpace2ComboBox.SelectedItem = ColorSpaceOption.Srgb;
         }
 
         // This is terrible and hacky, but I needed something that behaved like
@@ -57,7 +66,11 @@ namespace ImageViewer.Pages
 
         private void DiffButton_Click(object sender, RoutedEventArgs e)
         {
-            var result = new DiffSetupResult(ImageFile1.SelectedFile, ImageFile2.SelectedFile);
+            var result = new DiffSetupResult(
+                ImageFile1.SelectedFile,
+                ImageFile2.SelectedFile,
+                (ColorSpaceOption)ColorSpace1ComboBox.SelectedItem,
+                (ColorSpaceOption)ColorSpace2ComboBox.SelectedItem);
             _task.SetResult(result);
         }
 
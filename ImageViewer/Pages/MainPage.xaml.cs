@@ -1,15 +1,19 @@
 ﻿using ImageViewer.Controls;
 using ImageViewer.Dialogs;
 using ImageViewer.System;
+using ImageViewerNative;
 using Microsoft.Graphics.Canvas;
 using Microsoft.Toolkit.Uwp.UI.Controls;
 using System;
 using System.Collections.Generic;
 using System.Collections.ObjectModel;
 using System.Linq;
+using System.Runtime.InteropServices.WindowsRuntime;
 using System.Threading.Tasks;
 using Windows.ApplicationModel.DataTransfer;
+using Windows.Graphics;
 using Windows.Graphics.Capture;
+using Windows.Graphics.Imaging;
 using Windows.Storage;
 using Windows.Storage.Pickers;
 using Windows.Storage.Streams;
@@ -20,6 +24,7 @@ using Windows.UI.Popups;
 using Windows.UI.ViewManagement;
 using Windows.UI.Xaml;
 using Windows.UI.Xaml.Controls;
+using Windows.UI.Xaml.Media.Imaging;
 
 namespace ImageViewer.Pages
 {
@@ -62,6 +67,18 @@ namespace ImageViewer.Pages
         }
     }
 
+    class FrameExtractionScaleItem
+    {
+        public string DisplayName { get; }
+        public double Scale { get; }
+
+        public FrameExtractionScaleItem(string displayName, double scale)
+        {
+            DisplayName = displayName;
+            Scale = scale;
+        }
+    }
+
 
     public sealed partial class MainPage : Page
     {
@@ -72,11 +89,28 @@ namespace ImageViewer.Pages
             Capture,
             Video,
             FrameByFrameVideo,
+            Hdr,
         }
         private ViewMode _viewMode = ViewMode.Image;
         private BottomBarSegment[] _bottomBarSegments;
         private int _currentBottomBarSegmentLevel = 0;
         private Range[] _bottomBarLayoutRanges;
+        private DispatcherQueueTimer _captureChangeTimer;
+        private DispatcherQueueTimer _captureScopesTimer;
+        private VideoScopes _shownScopes;
+        private int _frameScopesVersion = 0;
+        private int _frameMotionVersion = 0;
+        private WriteableBitmap _motionOverlayBitmap;
+        private WriteableBitmap _histogramScopeBitmap;
+        private WriteableBitmap _waveformScopeBitmap;
+        private WriteableBitmap _vectorscopeBitmap;
+
+        private const int ScopeHistogramHeight = 128;
+        // Decoded repeats of a frame still differ a little
+        private const double RepeatedFrameStillSad = 0.5;
+        // The limited range black and white levels
+        private const uint VideoBlack = 16;
+        private const uint VideoWhite = 235;
 
         public MainPage()
         {
@@ -113,6 +147,20 @@ namespace ImageViewer.Pages
             VideoPlayerPlaybackSpeedComboBox.SelectedIndex = 3;
             VideoPlayerPlaybackSpeedComboBox.SelectionChanged += VideoPlayerPlaybackSpeedComboBox_SelectionChanged;
 
+            FrameExtractionScaleComboBox.ItemsSource = new ObservableCollection<FrameExtractionScaleItem>()
+            {
+                new FrameExtractionScaleItem("Full", 1.0),
+                new FrameExtractionScaleItem("Half", 0.5),
+                new FrameExtractionScaleItem("Quarter", 0.25),
+            };
+            FrameExtractionScaleComboBox.SelectedIndex = 0;
+            FrameExtractionScaleComboBox.SelectionChanged += FrameExtractionScaleComboBox_SelectionChanged;
+            MainImageViewer.MeasureRectChanged += MainImageViewer_MeasureRectChanged;
+
+            ColorSpaceComboBox.ItemsSource = ColorSpaceOption.All;
+            ColorSpaceComboBox.SelectedItem = ColorSpaceOption.Srgb;
+            ColorSpaceComboBox.SelectionChanged += ColorSpaceComboBox_SelectionChanged;
+
             var applicationView = ApplicationView.GetForCurrentView();
             if (applicationView.IsViewModeSupported(ApplicationViewMode.CompactOverlay))
             {
@@ -138,10 +186,78 @@ namespace ImageViewer.Pages
             }
         }
 
+        private void FrameExtractionScaleComboBox_SelectionChanged(object sender, SelectionChangedEventArgs e)
+        {
+            UpdateFrameExtractionSize();
+        }
+
+        private void FrameExtractionCropButton_Toggled(object sender, RoutedEventArgs e)
+        {
+            UpdateFrameExtractionSize();
+        }
+
+        private void MainImageViewer_MeasureRectChanged(object sender, EventArgs e)
+        {
+            UpdateFrameExtractionSize();
+        }
+
+        // Frames are only cropped and scaled as chosen in the video menu
+        private FrameExtractionOptions GetFrameExtractionOptions(BitmapSize videoSize)
+        {
+            var options = new FrameExtractionOptions();
+            var item = (FrameExtractionScaleItem)FrameExtractionScaleComboBox.SelectedItem;
+            options.Scale = item != null ? item.Scale : 1.0;
+            if (FrameExtractionCropButton.IsChecked == true)
+            {
+                // Clamped to the frame. An empty rect extracts the whole frame.
+                var x = Math.Max(0, Math.Min(MainImageViewer.MeasurePositionX, (int)videoSize.Width));
+                var y = Math.Max(0, Math.Min(MainImageViewer.MeasurePositionY, (int)videoSize.Height));
+                var width = Math.Max(0, Math.Min(MainImageViewer.MeasureWidth, (int)videoSize.Width - x));
+                var height = Math.Max(0, Math.Min(MainImageViewer.MeasureHeight, (int)videoSize.Height - y));
+                options.SourceRect = new RectInt32() { X = x, Y = y, Width = width, Height = height };
+            }
+            return options;
+        }
+
+        // Rounds like the native FrameExtractionRegion
+        private static BitmapSize GetExtractedSize(BitmapSize videoSize, FrameExtractionOptions options)
+        {
+            var sourceRect = options.SourceRect;
+            var isEmpty = sourceRect.Width == 0 || sourceRect.Height == 0;
+            var width = isEmpty ? videoSize.Width : (uint)sourceRect.Width;
+            var height = isEmpty ? videoSize.Height : (uint)sourceRect.Height;
+            var scale = options.Scale == 0.0 ? 1.0 : options.Scale;
+            return new BitmapSize()
+            {
+                Width = (uint)Math.Max(1.0, Math.Round(width * scale, MidpointRounding.AwayFromZero)),
+                Height = (uint)Math.Max(1.0, Math.Round(height * scale, MidpointRounding.AwayFromZero)),
+            };
+        }
+
+        private void UpdateFrameExtractionSize()
+        {
+            if (MainImageViewer != null && MainImageViewer.Image is VideoImage image)
+            {
+                var size = GetExtractedSize(image.Size, GetFrameExtractionOptions(image.Size));
+                FrameExtractionSizeTextBlock.Text = $"{size.Width} x {size.Height}px";
+            }
+            else
+            {
+                FrameExtractionSizeTextBlock.Text = "";
+            }
+        }
+
         public async Task OpenFileAsync(IImportedFile file)
         {
+            if (file is ImportedRmRawFrameStreamFile frameStreamFile)
+            {
+                var videoImage = await FrameByFrameVideoImage.CreateFromRmRawAsync(frameStreamFile.File, GraphicsManager.Current.CaptureDevice, GraphicsManager.Current.CompositionGraphicsDeviceForCapture);
+                OpenImage(videoImage, ViewMode.FrameByFrameVideo);
+                return;
+            }
+
             var image = await FileImage.CreateAsync(file);
-            OpenImage(image, ViewMode.Image);
+            OpenImage(image, image is HdrFileImage ? ViewMode.Hdr : ViewMode.Image);
         }
 
         public async Task OpenDiffAsync(DiffSetupResult diffSetup)
@@ -149,7 +265,7 @@ namespace ImageViewer.Pages
             var device = GraphicsManager.Current.CanvasDevice;
             var file1 = diffSetup.SelectedFile1;
             var file2 = diffSetup.SelectedFile2;
-            var diff = await ImageDiffer.GenerateDiff(device, file1, file2);
+            var diff = await ImageDiffer.GenerateDiff(device, file1, file2, diffSetup.ColorSpace1, diffSetup.ColorSpace2);
             OpenImage(new DiffImage(diff, file1.File.Name, file2.File.Name), ViewMode.Diff);
             ColorChannelsDiffStatus.IsChecked = diff.ColorChannelsMatch;
             AlphaChannelsDiffStatus.IsChecked = diff.AlphaChannelsMatch;
@@ -176,7 +292,7 @@ namespace ImageViewer.Pages
                     {
                         var importedFile1 = await FileImporter.ProcessStorageFileAsync(file1);
                         var importedFile2 = await FileImporter.ProcessStorageFileAsync(file2);
-                        var diffSetup = new DiffSetupResult(importedFile1, importedFile2);
+                        var diffSetup = new DiffSetupResult(importedFile1, importedFile2, ColorSpaceOption.Srgb, ColorSpaceOption.Srgb);
                         await OpenDiffAsync(diffSetup);
                         opened = true;
                     }
@@ -223,6 +339,14 @@ namespace ImageViewer.Pages
 
         private void OpenImage(IImage image, ViewMode viewMode)
         {
+            // The viewer disposes the capture it replaces, which can't wait
+            // for a recording to be written out
+            if (MainImageViewer.Image is CaptureImage capture && capture.IsRecording)
+            {
+                FinishRecording(capture);
+            }
+            // The old image is disposed, thumbnails and all
+            VideoTimelineListView.ItemsSource = null;
             MainImageViewer.Image = image;
             var titleBar = ApplicationView.GetForCurrentView().Title = image.DisplayName;
             _viewMode = viewMode;
@@ -241,6 +365,8 @@ namespace ImageViewer.Pages
                     return VideoMenu;
                 case ViewMode.FrameByFrameVideo:
                     return FrameByFrameVideoMenu;
+                case ViewMode.Hdr:
+                    return HdrMenu;
                 default:
                     return ViewMenu;
             }
@@ -253,10 +379,21 @@ namespace ImageViewer.Pages
             CaptureMenu.Visibility = viewMode == ViewMode.Capture ? Visibility.Visible : Visibility.Collapsed;
             VideoMenu.Visibility = viewMode == ViewMode.Video ? Visibility.Visible : Visibility.Collapsed;
             FrameByFrameVideoMenu.Visibility = viewMode == ViewMode.FrameByFrameVideo ? Visibility.Visible : Visibility.Collapsed;
+            HdrMenu.Visibility = viewMode == ViewMode.Hdr ? Visibility.Visible : Visibility.Collapsed;
             MainMenu.SelectedItem = GetMenuForViewMode(viewMode);
             VideoTimelineGrid.Visibility = viewMode == ViewMode.FrameByFrameVideo ? Visibility.Visible : Visibility.Collapsed;
+            CaptureScopesButton.IsChecked = false;
+            FrameByFrameScopesButton.IsChecked = false;
+            FrameByFrameMotionButton.IsChecked = false;
+            // Only plain 8-bit images can be shown in another color space
+            var isBitmapImage = MainImageViewer.Image is CanvasBitmapImage;
+            ColorSpaceComboBox.IsEnabled = isBitmapImage;
+            LoadLutButton.IsEnabled = isBitmapImage;
+            ColorSpaceComboBox.SelectedItem = ColorSpaceOption.Srgb;
+            LutNameTextBlock.Text = "";
             var size = MainImageViewer.Image.Size;
             ImageSizeTextBlock.Text = $"{size.Width} x {size.Height}px";
+            UpdateFrameExtractionSize();
             ZoomSlider.IsEnabled = true;
             SaveAsButton.IsEnabled = true;
             CopyButton.IsEnabled = true;
@@ -264,6 +401,9 @@ namespace ImageViewer.Pages
             {
                 ShowCursorButton.IsChecked = true;
                 CapturePlayPauseButton.IsChecked = true;
+                CaptureChangesButton.IsChecked = false;
+                CaptureRecordButton.IsChecked = false;
+                CaptureRecordingStatusTextBlock.Text = "";
             }
             else if (viewMode == ViewMode.Video)
             {
@@ -280,6 +420,13 @@ namespace ImageViewer.Pages
                 VideoTimelineListView.ItemsSource = videoImage.VideoFrames;
                 VideoTimelineListView.SelectedIndex = 0;
             }
+            else if (viewMode == ViewMode.Hdr)
+            {
+                var hdrImage = (HdrFileImage)MainImageViewer.Image;
+                HdrExposureSlider.Value = hdrImage.ExposureStops;
+                FilmicToneMapButton.IsChecked = hdrImage.ToneMapOperator == ToneMapOperator.Filmic;
+                ClipToneMapButton.IsChecked = hdrImage.ToneMapOperator == ToneMapOperator.Clip;
+            }
         }
 
         private async Task SaveToFileAsync(StorageFile file, ImageFormat format)
@@ -325,6 +472,11 @@ namespace ImageViewer.Pages
                     currentName = fileImage.File.File.Name;
                     currentName = $"{currentName.Substring(0, currentName.LastIndexOf('.'))}.modified";
                 }
+                else if (MainImageViewer.Image is HdrFileImage hdrImage)
+                {
+                    currentName = hdrImage.File.File.Name;
+                    currentName = $"{currentName.Substring(0, currentName.LastIndexOf('.'))}.tonemapped";
+                }
                 else if (MainImageViewer.Image is CaptureImage captureImage)
                 {
                     currentName = "capture";
@@ -383,6 +535,134 @@ namespace ImageViewer.Pages
             await dialog.ShowAsync();
         }
 
+        private void TraceButton_Checked(object sender, RoutedEventArgs e)
+        {
+            PipelineProfiler.Reset();
+            PipelineProfiler.IsEnabled = true;
+        }
+
+        private async void TraceButton_Unchecked(object sender, RoutedEventArgs e)
+        {
+            PipelineProfiler.IsEnabled = false;
+            var trace = PipelineProfiler.ExportChromeTrace();
+            var summary = PipelineProfiler.GetSummary();
+
+            var picker = new FileSavePicker();
+            picker.SuggestedStartLocation = PickerLocationId.DocumentsLibrary;
+            picker.SuggestedFileName = "trace";
+            picker.DefaultFileExtension = ".json";
+            picker.FileTypeChoices.Add("Chrome Trace", new List<string> { ".json" });
+
+            var file = await picker.PickSaveFileAsync();
+            if (file != null)
+            {
+                await FileIO.WriteTextAsync(file, trace);
+            }
+
+            var dialog = new MessageDialog(string.IsNullOrEmpty(summary) ? "Nothing was recorded." : summary, "Trace summary");
+            await dialog.ShowAsync();
+        }
+
+        private async void BenchmarkButton_Click(object sender, RoutedEventArgs e)
+        {
+            const double minimumSecondsPerBenchmark = 0.5;
+
+            BenchmarkButton.IsEnabled = false;
+            var benchmark = await Task.Run(() => new PipelineBenchmark(minimumSecondsPerBenchmark));
+            BenchmarkButton.IsEnabled = true;
+
+            var saveCommand = new UICommand("Save Results");
+            var compareCommand = new UICommand("Compare to Baseline");
+            var dialog = new MessageDialog(benchmark.Summary, "Benchmark results");
+            dialog.Commands.Add(saveCommand);
+            dialog.Commands.Add(compareCommand);
+            dialog.Commands.Add(new UICommand("Close"));
+            var command = await dialog.ShowAsync();
+
+            if (command == saveCommand)
+            {
+                var picker = new FileSavePicker();
+                picker.SuggestedStartLocation = PickerLocationId.DocumentsLibrary;
+                picker.SuggestedFileName = "benchmark";
+                picker.DefaultFileExtension = ".json";
+                picker.FileTypeChoices.Add("Benchmark Results", new List<string> { ".json" });
+
+                var file = await picker.PickSaveFileAsync();
+                if (file != null)
+                {
+                    await FileIO.WriteTextAsync(file, benchmark.ResultsJson);
+                }
+            }
+            else if (command == compareCommand)
+            {
+                var picker = new FileOpenPicker();
+                picker.SuggestedStartLocation = PickerLocationId.DocumentsLibrary;
+                picker.FileTypeFilter.Add(".json");
+
+                var file = await picker.PickSingleFileAsync();
+                if (file != null)
+                {
+                    var baseline = await FileIO.ReadTextAsync(file);
+                    string message;
+                    try
+                    {
+                        var threshold = PipelineBenchmark.DefaultRegressionThreshold;
+                        var regressions = benchmark.FindRegressions(baseline, threshold);
+                        message = regressions.Length == 0 ? $"Nothing got more than {threshold:P0} slower." : string.Join("\n", regressions);
+                    }
+                    catch (ArgumentException)
+                    {
+                        message = "The file is not a saved benchmark result.";
+                    }
+                    var regressionDialog = new MessageDialog(message, "Regressions");
+                    await regressionDialog.ShowAsync();
+                }
+            }
+        }
+
+        private async void ColorSpaceComboBox_SelectionChanged(object sender, SelectionChangedEventArgs e)
+        {
+            // Loading a LUT clears the selection
+            if (MainImageViewer.Image is CanvasBitmapImage image && ColorSpaceComboBox.SelectedItem is ColorSpaceOption colorSpace)
+            {
+                LutNameTextBlock.Text = "";
+                await image.SetDisplayTransformAsync(colorSpace.CreateTransformToSrgb());
+            }
+        }
+
+        private async void LoadLutButton_Click(object sender, RoutedEventArgs e)
+        {
+            if (!(MainImageViewer.Image is CanvasBitmapImage image))
+            {
+                return;
+            }
+
+            var picker = new FileOpenPicker();
+            picker.SuggestedStartLocation = PickerLocationId.DocumentsLibrary;
+            picker.FileTypeFilter.Add(".cube");
+
+            var file = await picker.PickSingleFileAsync();
+            if (file != null)
+            {
+                var text = await FileIO.ReadTextAsync(file);
+                ColorTransform transform;
+                try
+                {
+                    transform = await Task.Run(() => ColorTransform.CreateFromCube(text));
+                }
+                catch (ArgumentException error)
+                {
+                    var dialog = new MessageDialog(error.Message, "Couldn't load the LUT");
+                    await dialog.ShowAsync();
+                    return;
+                }
+
+                ColorSpaceComboBox.SelectedItem = null;
+                LutNameTextBlock.Text = file.Name;
+                await image.SetDisplayTransformAsync(transform);
+            }
+        }
+
         private void ColorDiffButton_Checked(object sender, RoutedEventArgs e)
         {
             if (MainImageViewer != null && MainImageViewer.Image is DiffImage image)
@@ -399,6 +679,27 @@ namespace ImageViewer.Pages
             }
         }
 
+        private async void UpdateToneMapping()
+        {
+            if (MainImageViewer != null && MainImageViewer.Image is HdrFileImage image)
+            {
+                var toneMapOperator = ClipToneMapButton.IsChecked == true ? ToneMapOperator.Clip : ToneMapOperator.Filmic;
+                await image.SetToneMappingAsync((float)HdrExposureSlider.Value, toneMapOperator);
+                // Statistics are of the displayed pixels
+                MainImageViewer.InvalidateMeasureStatistics();
+            }
+        }
+
+        private void HdrExposureSlider_ValueChanged(object sender, Windows.UI.Xaml.Controls.Primitives.RangeBaseValueChangedEventArgs e)
+        {
+            UpdateToneMapping();
+        }
+
+        private void HdrToneMapButton_Checked(object sender, RoutedEventArgs e)
+        {
+            UpdateToneMapping();
+        }
+
         private async void ScreenCaptureButton_Click(object sender, RoutedEventArgs e)
         {
             var picker = new GraphicsCapturePicker();
@@ -409,6 +710,19 @@ namespace ImageViewer.Pages
             }
         }
 
+        private async void FinishRecording(CaptureImage image)
+        {
+            try
+            {
+                await image.StopRecordingAsync();
+            }
+            catch (Exception error)
+            {
+                var dialog = new MessageDialog($"The recording could not be finished: {error.Message}", "Recording error");
+                await dialog.ShowAsync();
+            }
+        }
+
         private void ShowCursorButton_Checked(object sender, RoutedEventArgs e)
         {
             if (MainImageViewer != null && MainImageViewer.Image is CaptureImage image)
@@ -430,6 +744,7 @@ namespace ImageViewer.Pages
             if (MainImageViewer != null && MainImageViewer.Image is CaptureImage image)
             {
                 image.Play();
+                MainImageViewer.InvalidateMeasureStatistics();
             }
         }
 
@@ -438,6 +753,280 @@ namespace ImageViewer.Pages
             if (MainImageViewer != null && MainImageViewer.Image is CaptureImage image)
             {
                 image.Pause();
+                MainImageViewer.InvalidateMeasureStatistics();
+            }
+        }
+
+        private void CaptureChangesButton_Checked(object sender, RoutedEventArgs e)
+        {
+            if (_captureChangeTimer == null)
+            {
+                _captureChangeTimer = DispatcherQueue.GetForCurrentThread().CreateTimer();
+                _captureChangeTimer.Interval = TimeSpan.FromMilliseconds(250);
+                _captureChangeTimer.Tick += OnCaptureChangeTimerTick;
+            }
+            if (MainImageViewer != null && MainImageViewer.Image is CaptureImage image)
+            {
+                image.SetChangeTrackingEnabled(true);
+                // Start the first interval fresh
+                image.TakeChangeSnapshot();
+            }
+            _captureChangeTimer.Start();
+        }
+
+        private void CaptureChangesButton_Unchecked(object sender, RoutedEventArgs e)
+        {
+            _captureChangeTimer?.Stop();
+            if (MainImageViewer?.Image is CaptureImage image)
+            {
+                image.SetChangeTrackingEnabled(false);
+            }
+            MainImageViewer?.SetChangedRegions(null);
+            CaptureChangeRateTextBlock.Text = "";
+        }
+
+        private async void CaptureRecordButton_Checked(object sender, RoutedEventArgs e)
+        {
+            if (MainImageViewer == null || !(MainImageViewer.Image is CaptureImage image) || image.IsRecording)
+            {
+                return;
+            }
+
+            var picker = new FileSavePicker();
+            picker.SuggestedStartLocation = PickerLocationId.VideosLibrary;
+            picker.SuggestedFileName = "capture";
+            picker.DefaultFileExtension = ".rmraw";
+            picker.FileTypeChoices.Add("Raw BGRA8 Frame Stream", new List<string> { ".rmraw" });
+
+            var file = await picker.PickSaveFileAsync();
+            // The capture may have been closed while the picker was up
+            if (file == null || MainImageViewer.Image != image)
+            {
+                CaptureRecordButton.IsChecked = false;
+                return;
+            }
+
+            var stream = await file.OpenAsync(FileAccessMode.ReadWrite);
+            stream.Size = 0;
+            image.StartRecording(stream);
+            CaptureRecordingStatusTextBlock.Text = "Recording...";
+        }
+
+        private async void CaptureRecordButton_Unchecked(object sender, RoutedEventArgs e)
+        {
+            if (MainImageViewer == null || !(MainImageViewer.Image is CaptureImage image) || !image.IsRecording)
+            {
+                return;
+            }
+
+            CaptureRecordingStatusTextBlock.Text = "Finishing...";
+            try
+            {
+                var recorder = await image.StopRecordingAsync();
+                CaptureRecordingStatusTextBlock.Text = $"Recorded {recorder.WrittenFrameCount} frames, {recorder.DroppedFrameCount} dropped";
+            }
+            catch (Exception error)
+            {
+                CaptureRecordingStatusTextBlock.Text = "";
+                var dialog = new MessageDialog($"The recording could not be finished: {error.Message}", "Recording error");
+                await dialog.ShowAsync();
+            }
+        }
+
+        private void CaptureScopesButton_Checked(object sender, RoutedEventArgs e)
+        {
+            if (MainImageViewer == null || !(MainImageViewer.Image is CaptureImage image))
+            {
+                return;
+            }
+            if (_captureScopesTimer == null)
+            {
+                // Frames are analyzed as they arrive, the panel only needs
+                // to keep up with what the eye can follow
+                _captureScopesTimer = DispatcherQueue.GetForCurrentThread().CreateTimer();
+                _captureScopesTimer.Interval = TimeSpan.FromMilliseconds(100);
+                _captureScopesTimer.Tick += OnCaptureScopesTimerTick;
+            }
+            image.SetScopesEnabled(true);
+            ScopesPanel.Visibility = Visibility.Visible;
+            _captureScopesTimer.Start();
+        }
+
+        private void FrameByFrameScopesButton_Checked(object sender, RoutedEventArgs e)
+        {
+            ScopesPanel.Visibility = Visibility.Visible;
+            UpdateFrameByFrameScopes();
+        }
+
+        private void ScopesButton_Unchecked(object sender, RoutedEventArgs e)
+        {
+            if (CaptureScopesButton.IsChecked == true || FrameByFrameScopesButton.IsChecked == true)
+            {
+                return;
+            }
+            _captureScopesTimer?.Stop();
+            if (MainImageViewer?.Image is CaptureImage image && image.AreScopesEnabled)
+            {
+                image.SetScopesEnabled(false);
+            }
+            _frameScopesVersion++;
+            _shownScopes = null;
+            ScopesPanel.Visibility = Visibility.Collapsed;
+        }
+
+        private void OnCaptureScopesTimerTick(DispatcherQueueTimer sender, object args)
+        {
+            if (MainImageViewer.Image is CaptureImage image)
+            {
+                var scopes = image.TryGetScopes();
+                if (scopes != null)
+                {
+                    ShowScopes(scopes);
+                }
+            }
+            else
+            {
+                CaptureScopesButton.IsChecked = false;
+            }
+        }
+
+        private async void UpdateFrameByFrameScopes()
+        {
+            if (FrameByFrameScopesButton.IsChecked != true || !(MainImageViewer.Image is FrameByFrameVideoImage image))
+            {
+                return;
+            }
+
+            // Stepping through frames faster than they're analyzed only
+            // shows the last one
+            var version = ++_frameScopesVersion;
+            var scopes = await image.GetScopesAsync();
+            if (scopes != null && version == _frameScopesVersion)
+            {
+                ShowScopes(scopes);
+            }
+        }
+
+        private void ShowScopes(VideoScopes scopes)
+        {
+            if (scopes == _shownScopes)
+            {
+                return;
+            }
+            _shownScopes = scopes;
+
+            _histogramScopeBitmap = WriteScopeBitmap(_histogramScopeBitmap, scopes.RenderHistogram(ScopeHistogramHeight), 256, ScopeHistogramHeight);
+            _waveformScopeBitmap = WriteScopeBitmap(_waveformScopeBitmap, scopes.RenderWaveform(), (int)scopes.WaveformWidth, 256);
+            _vectorscopeBitmap = WriteScopeBitmap(_vectorscopeBitmap, scopes.RenderVectorscope(), 256, 256);
+            HistogramScopeImage.Source = _histogramScopeBitmap;
+            WaveformScopeImage.Source = _waveformScopeBitmap;
+            VectorscopeImage.Source = _vectorscopeBitmap;
+            ScopesSummaryTextBlock.Text = DescribeScopes(scopes);
+        }
+
+        private static WriteableBitmap WriteScopeBitmap(WriteableBitmap bitmap, byte[] pixels, int width, int height)
+        {
+            if (bitmap == null || bitmap.PixelWidth != width || bitmap.PixelHeight != height)
+            {
+                bitmap = new WriteableBitmap(width, height);
+            }
+            pixels.CopyTo(bitmap.PixelBuffer);
+            bitmap.Invalidate();
+            return bitmap;
+        }
+
+        private void FrameByFrameMotionButton_Checked(object sender, RoutedEventArgs e)
+        {
+            UpdateFrameByFrameMotion();
+        }
+
+        private void FrameByFrameMotionButton_Unchecked(object sender, RoutedEventArgs e)
+        {
+            _frameMotionVersion++;
+            MainImageViewer?.SetOverlay(null);
+            FrameByFrameMotionTextBlock.Text = "";
+        }
+
+        private async void UpdateFrameByFrameMotion()
+        {
+            if (FrameByFrameMotionButton.IsChecked != true || !(MainImageViewer.Image is FrameByFrameVideoImage image))
+            {
+                return;
+            }
+
+            var version = ++_frameMotionVersion;
+            var motion = await image.GetMotionAsync();
+            if (version != _frameMotionVersion)
+            {
+                return;
+            }
+            if (motion == null)
+            {
+                MainImageViewer.SetOverlay(null);
+                FrameByFrameMotionTextBlock.Text = "No previous frame";
+                return;
+            }
+
+            // Half size is plenty for block sized tints and vectors, and
+            // keeps stepping through 4K frames quick
+            var size = image.Size;
+            var width = Math.Max(1, (int)size.Width / 2);
+            var height = Math.Max(1, (int)size.Height / 2);
+            _motionOverlayBitmap = WriteScopeBitmap(_motionOverlayBitmap, motion.RenderOverlay((uint)width, (uint)height), width, height);
+            MainImageViewer.SetOverlay(_motionOverlayBitmap);
+            FrameByFrameMotionTextBlock.Text = DescribeMotion(motion);
+        }
+
+        private static string DescribeMotion(MotionAnalysis motion)
+        {
+            if (motion.MeanStillSad < RepeatedFrameStillSad)
+            {
+                return "Repeated frame";
+            }
+            if (motion.TexturedBlockCount == 0)
+            {
+                return $"Too little detail to find the global motion, mean error {motion.MeanSad:F1}";
+            }
+            var global = motion.GlobalMotion;
+            return $"Global motion {global.X}, {global.Y} ({motion.GlobalConfidence:P0} of blocks agree), mean error {motion.MeanSad:F1}";
+        }
+
+        private static string DescribeScopes(VideoScopes scopes)
+        {
+            var lowest = scopes.GetLowestLevel(ScopeChannel.Luma);
+            var highest = scopes.GetHighestLevel(ScopeChannel.Luma);
+            var sampleCount = (double)scopes.SampleCount;
+            var red = scopes.GetHistogram(ScopeChannel.Red);
+            var green = scopes.GetHistogram(ScopeChannel.Green);
+            var blue = scopes.GetHistogram(ScopeChannel.Blue);
+
+            var lines = new List<string>()
+            {
+                $"{scopes.SampledWidth} x {scopes.SampledHeight} samples",
+                $"Luma from {lowest} to {highest}",
+                $"At 0: R {red[0] / sampleCount:P1} G {green[0] / sampleCount:P1} B {blue[0] / sampleCount:P1}",
+                $"At 255: R {red[255] / sampleCount:P1} G {green[255] / sampleCount:P1} B {blue[255] / sampleCount:P1}",
+            };
+            // Limited range video that was never expanded can't reach
+            // either end
+            if (lowest >= VideoBlack && highest <= VideoWhite && highest > lowest)
+            {
+                lines.Add($"Luma stays within {VideoBlack} to {VideoWhite}, the frame may be limited range");
+            }
+            return string.Join("\n", lines);
+        }
+
+        private void OnCaptureChangeTimerTick(DispatcherQueueTimer sender, object args)
+        {
+            if (MainImageViewer.Image is CaptureImage image)
+            {
+                var snapshot = image.TakeChangeSnapshot();
+                MainImageViewer.SetChangedRegions(snapshot.ChangedRegions);
+                CaptureChangeRateTextBlock.Text = $"{snapshot.ChangedFramesPerSecond:0.#} of {snapshot.FramesPerSecond:0.#} fps changed, {snapshot.ChangedAreaFraction:P1} of the frame";
+            }
+            else
+            {
+                CaptureChangesButton.IsChecked = false;
             }
         }
 
@@ -660,6 +1249,7 @@ namespace ImageViewer.Pages
             if (MainImageViewer != null && MainImageViewer.Image is VideoImage image)
             {
                 image.Play();
+                MainImageViewer.InvalidateMeasureStatistics();
             }
         }
 
@@ -668,6 +1258,7 @@ namespace ImageViewer.Pages
             if (MainImageViewer != null && MainImageViewer.Image is VideoImage image)
             {
                 image.Pause();
+                MainImageViewer.InvalidateMeasureStatistics();
             }
         }
 
@@ -762,6 +1353,7 @@ namespace ImageViewer.Pages
                 case ".jpeg":
                 case ".png":
                 case ".bmp":
+                case ".jxr":
                 case ".bin":
                 case ".rmraw":
                     return FileType.Image;
@@ -780,8 +1372,12 @@ namespace ImageViewer.Pages
             if (MainImageViewer != null && MainImageViewer.Image is VideoImage image)
             {
                 image.Pause();
+
+                // The image size in the bottom bar shows the extracted size
+                // once the frames are open
+                var options = GetFrameExtractionOptions(image.Size);
                 IsEnabled = false;
-                var newImage = await image.CreateFrameByFrameVideoImageAsync(GraphicsManager.Current.CaptureDevice, GraphicsManager.Current.CompositionGraphicsDeviceForCapture);
+                var newImage = await image.CreateFrameByFrameVideoImageAsync(GraphicsManager.Current.CaptureDevice, GraphicsManager.Current.CompositionGraphicsDeviceForCapture, options);
                 IsEnabled = true;
                 OpenImage(newImage, ViewMode.FrameByFrameVideo);
             }
@@ -792,6 +1388,9 @@ namespace ImageViewer.Pages
             if (MainImageViewer != null && MainImageViewer.Image is FrameByFrameVideoImage image)
             {
                 image.SelectedIndex = ((ListView)sender).SelectedIndex;
+                MainImageViewer.InvalidateMeasureStatistics();
+                UpdateFrameByFrameScopes();
+                UpdateFrameByFrameMotion();
             }
         }
 
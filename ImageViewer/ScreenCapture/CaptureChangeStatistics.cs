@@ -0,0 +1,95 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using Windows.Graphics;
+
+namespace ImageViewer.ScreenCapture
+{
+    class CaptureChangeSnapshot
+    {
+        // Everything that changed since the previous snapshot
+        public IReadOnlyList<RectInt32> ChangedRegions { get; set; }
+        public double FramesPerSecond { get; set; }
+        public double ChangedFramesPerSecond { get; set; }
+        // The average fraction of the content that changed per frame
+        public double ChangedAreaFraction { get; set; }
+    }
+
+    class CaptureChangeStatistics
+    {
+        // Past this many regions they are collapsed into their bounds to
+        // keep the overlay cheap
+        private const int MaxRegions = 256;
+
+        private object _lock = new object();
+        private List<RectInt32> _regions = new List<RectInt32>();
+        private long _frameCount = 0;
+        private long _changedFrameCount = 0;
+        private double _changedAreaSum = 0;
+        private Stopwatch _stopwatch = Stopwatch.StartNew();
+
+        public void AddFrame(IReadOnlyList<RectInt32> dirtyRects, long contentArea)
+        {
+            long dirtyArea = 0;
+            foreach (var rect in dirtyRects)
+            {
+                dirtyArea += (long)rect.Width * rect.Height;
+            }
+
+            lock (_lock)
+            {
+                _frameCount++;
+                if (dirtyRects.Count > 0)
+                {
+                    _changedFrameCount++;
+                    _changedAreaSum += contentArea > 0 ? (double)dirtyArea / contentArea : 0;
+                    _regions.AddRange(dirtyRects);
+                    if (_regions.Count > MaxRegions)
+                    {
+                        var bounds = GetBounds(_regions);
+                        _regions.Clear();
+                        _regions.Add(bounds);
+                    }
+                }
+            }
+        }
+
+        public CaptureChangeSnapshot TakeSnapshot()
+        {
+            lock (_lock)
+            {
+                var seconds = Math.Max(_stopwatch.Elapsed.TotalSeconds, 0.001);
+                var snapshot = new CaptureChangeSnapshot()
+                {
+                    ChangedRegions = _regions,
+                    FramesPerSecond = _frameCount / seconds,
+                    ChangedFramesPerSecond = _changedFrameCount / seconds,
+                    ChangedAreaFraction = _frameCount > 0 ? _changedAreaSum / _frameCount : 0,
+                };
+
+                _regions = new List<RectInt32>();
+                _frameCount = 0;
+                _changedFrameCount = 0;
+                _changedAreaSum = 0;
+                _stopwatch.Restart();
+                return snapshot;
+            }
+        }
+
+        private static RectInt32 GetBounds(List<RectInt32> rects)
+        {
+            var left = int.MaxValue;
+            var top = int.MaxValue;
+            var right = int.MinValue;
+            var bottom = int.MinValue;
+            foreach (var rect in rects)
+            {
+                left = Math.Min(left, rect.X);
+                top = Math.Min(top, rect.Y);
+                right = Math.Max(right, rect.X + rect.Width);
+                bottom = Math.Max(bottom, rect.Y + rect.Height);
+            }
+            return new RectInt32() { X = left, Y = top, Width = right - left, Height = bottom - top };
+        }
+    }
+}
@@ -1,10 +1,15 @@
 ﻿using ImageViewer.System;
+using ImageViewerNative;
 using System;
+using System.Collections.Generic;
+using System.Diagnostics;
 using System.Threading;
 using System.Threading.Tasks;
 using Windows.Graphics;
 using Windows.Graphics.Capture;
 using Windows.Graphics.DirectX;
+using Windows.Graphics.DirectX.Direct3D11;
+using Windows.Storage.Streams;
 using Windows.UI.Composition;
 using WinRTInteropTools;
 
@@ -21,17 +26,20 @@ namespace ImageViewer.ScreenCapture
             _pauseEvent = new ManualResetEvent(true);
             _lastSize = item.Size;
             _stateLock = new object();
+            _frameLock = new object();
+            _flushTimer = new Timer(_ => FlushUnreadFrame(), null, Timeout.Infinite, Timeout.Infinite);
 
             _swapChain = new SwapChain(
                 _device,
                 DirectXPixelFormat.B8G8R8A8UIntNormalized,
-                2,
+                SwapChainBufferCount,
                 new SizeInt32() { Width = _lastSize.Width, Height = _lastSize.Height });
+            _differ = new FrameDiffer(_device, _lastSize);
 
             _framePool = Direct3D11CaptureFramePool.CreateFreeThreaded(
                     _device,
                     DirectXPixelFormat.B8G8R8A8UIntNormalized,
-                    2,
+                    FramePoolBufferCount,
                     _lastSize);
             _session = _framePool.CreateCaptureSession(item);
 
@@ -43,15 +51,111 @@ namespace ImageViewer.ScreenCapture
             _pauseEvent.Set();
         }
 
-        public byte[] Pause()
+        // Returns a copy of the last presented frame. It stays on the GPU,
+        // callers read back only what they need.
+        public Direct3D11Texture2D Pause()
         {
             _pauseEvent.Reset();
+            // The last frame may not have been shown yet
+            FlushUnreadFrame();
             lock (_stateLock)
             using (var lockSession = _multithread.Lock())
             using (var frontBuffer = _swapChain.GetBuffer(1))
             using (var texture = Direct3D11Texture2D.CreateFromDirect3DSurface(frontBuffer))
             {
-                return texture.GetBytes();
+                var description = texture.Description2D;
+                description.MiscFlags = 0;
+                var copy = _device.CreateTexture2D(description);
+                _deviceContext.CopyResource(copy, texture);
+                return copy;
+            }
+        }
+
+        public CaptureChangeSnapshot TakeChangeSnapshot()
+        {
+            return _changeStatistics.TakeSnapshot();
+        }
+
+        // Changes are only found by reading frames back, so this is off
+        // until something shows them.
+        public void SetChangeTrackingEnabled(bool enabled)
+        {
+            lock (_stateLock)
+            {
+                _isTrackingChanges = enabled;
+            }
+        }
+
+        public bool IsRecording => _recorder != null;
+
+        // The stream belongs to the recording until it's stopped.
+        public void StartRecording(IRandomAccessStream stream)
+        {
+            lock (_stateLock)
+            {
+                if (_recorder != null)
+                {
+                    throw new InvalidOperationException("Already recording");
+                }
+                _recorder = new CaptureRecorder(stream, _lastSize, RecordingQueueCapacity);
+                _recordingStream = stream;
+                _differ.Recorder = _recorder;
+            }
+        }
+
+        public async Task<CaptureRecorder> StopRecordingAsync()
+        {
+            // The last frame is only recorded once it's read back
+            FlushUnreadFrame();
+            CaptureRecorder recorder;
+            IRandomAccessStream stream;
+            lock (_stateLock)
+            {
+                recorder = _recorder;
+                stream = _recordingStream;
+                _recorder = null;
+                _recordingStream = null;
+                if (_differ != null)
+                {
+                    _differ.Recorder = null;
+                }
+            }
+
+            if (recorder != null)
+            {
+                try
+                {
+                    await Task.Run(() => recorder.Finish());
+                }
+                finally
+                {
+                    stream.Dispose();
+                }
+            }
+            return recorder;
+        }
+
+        public ScopeAnalyzer Scopes => _scopes;
+
+        // Changed frames are analyzed until the scopes are stopped.
+        public void StartScopes(uint sampleStep)
+        {
+            lock (_stateLock)
+            {
+                _scopes = new ScopeAnalyzer(_lastSize, sampleStep);
+                _differ.Scopes = _scopes;
+            }
+        }
+
+        public void StopScopes()
+        {
+            lock (_stateLock)
+            {
+                _scopes = null;
+                if (_differ != null)
+                {
+                    _differ.Scopes = null;
+                }
             }
         }
 
@@ -81,8 +185,20 @@ namespace ImageViewer.ScreenCapture
 
         public void Dispose()
         {
+            // Nothing can wait on Dispose, so callers that care how the
+            // recording ends stop it first. This only makes sure a failure
+            // to write it out isn't lost.
+            StopRecordingAsync().ContinueWith(
+                task => Debug.WriteLine($"The recording could not be finished: {task.Exception.InnerException}"),
+                TaskContinuationOptions.OnlyOnFaulted);
             _session?.Dispose();
             _framePool?.Dispose();
+            lock (_frameLock)
+            {
+                _flushTimer.Dispose();
+                _unreadFrame?.Dispose();
+                _unreadFrame = null;
+            }
             _swapChain?.Dispose();
 
             _swapChain = null;
@@ -94,7 +210,8 @@ namespace ImageViewer.ScreenCapture
         public void Recreate(Direct3D11Device device)
         {
             var isPlaying = _pauseEvent.WaitOne(0);
-            Pause();
+            Pause().Dispose();
+            lock (_frameLock)
             lock (_stateLock)
             using (var lockSession = _multithread.Lock())
             {
@@ -105,15 +222,23 @@ namespace ImageViewer.ScreenCapture
                 _swapChain = new SwapChain(
                     device,
                     DirectXPixelFormat.B8G8R8A8UIntNormalized,
-                    2,
+                    SwapChainBufferCount,
                     new SizeInt32() { Width = _lastSize.Width, Height = _lastSize.Height });
-                _framePool.Recreate(device, DirectXPixelFormat.B8G8R8A8UIntNormalized, 2, _lastSize);
+                _unreadFrame?.Dispose();
+                _unreadFrame = null;
+                _framePool.Recreate(device, DirectXPixelFormat.B8G8R8A8UIntNormalized, FramePoolBufferCount, _lastSize);
+                _differ = new FrameDiffer(device, _lastSize);
+                _differ.Recorder = _recorder;
+                _differ.Scopes = _scopes;
+                _isDiffing = false;
+                _fullUpdatesRemaining = SwapChainBufferCount;
+                _staleBackBufferRects = new List<RectInt32>();
             }
             Continue();
             if (!isPlaying)
             {
                 Task.WaitAll(Task.Delay(30));
-                Pause();
+                Pause().Dispose();
             }
         }
 
@@ -121,35 +246,186 @@ namespace ImageViewer.ScreenCapture
         {
             _pauseEvent.WaitOne();
 
+            lock (_frameLock)
+            {
+                var frame = sender.TryGetNextFrame();
+                FrameDiffer differ;
+                bool needsReadback;
+                lock (_stateLock)
+                {
+                    differ = _differ;
+                    needsReadback = _recorder != null || _scopes != null || _isTrackingChanges;
+                }
+
+                if (!needsReadback)
+                {
+                    // Nothing reads the frames, so they stay on the GPU and
+                    // are copied whole, as soon as they arrive
+                    using (frame)
+                    {
+                        if (_isDiffing)
+                        {
+                            FlushUnreadFrame();
+                            _isDiffing = false;
+                        }
+                        Present(frame, null);
+                    }
+                    return;
+                }
+
+                try
+                {
+                    // The differ's reference is stale if frames were last
+                    // copied whole
+                    if (!_isDiffing)
+                    {
+                        differ.Reset();
+                        _isDiffing = true;
+                    }
+                    // Reading the frame back and copying it for the recording
+                    // take the differ's own locks, so they hold up neither the
+                    // calls that change our state nor the device
+                    var changedRects = differ.Update(frame.Surface, frame.SystemRelativeTime);
+                    Present(frame, changedRects);
+                }
+                catch
+                {
+                    frame.Dispose();
+                    throw;
+                }
+
+                // The differ usually reads a frame back with the next one,
+                // but capture only raises frames when something changes.
+                // Keep this one until then, or show it once nothing follows.
+                _unreadFrame?.Dispose();
+                _unreadFrame = frame;
+                _flushTimer.Change(FlushDelayMilliseconds, Timeout.Infinite);
+            }
+        }
+
+        private void FlushUnreadFrame()
+        {
+            lock (_frameLock)
+            {
+                if (_unreadFrame == null)
+                {
+                    return;
+                }
+
+                FrameDiffer differ;
+                lock (_stateLock)
+                {
+                    differ = _differ;
+                }
+                var changedRects = differ.Flush();
+                Present(_unreadFrame, changedRects);
+                _unreadFrame.Dispose();
+                _unreadFrame = null;
+            }
+        }
+
+        // Copies the rects that changed in the frames read back so far.
+        // The frame has all of them, since it's the newest. Without rects
+        // the whole frame is copied.
+        private void Present(Direct3D11CaptureFrame frame, RectInt32[] changedRects)
+        {
             lock (_stateLock)
+            using (var deviceLock = _device.Multithread.Lock())
             {
-                using (var frame = sender.TryGetNextFrame())
-                using (var deviceLock = _device.Multithread.Lock())
+                var contentSize = frame.ContentSize;
+                if (contentSize.Width != _lastContentSize.Width || contentSize.Height != _lastContentSize.Height)
+                {
+                    _lastContentSize = contentSize;
+                    _fullUpdatesRemaining = SwapChainBufferCount;
+                }
+                var contentRect = new RectInt32()
+                {
+                    X = 0,
+                    Y = 0,
+                    Width = Math.Min(_lastSize.Width, contentSize.Width),
+                    Height = Math.Min(_lastSize.Height, contentSize.Height),
+                };
+
+                var isFullUpdate = _fullUpdatesRemaining > 0 || changedRects == null;
+                List<RectInt32> dirtyRects;
+                if (changedRects != null)
+                {
+                    dirtyRects = ClipRects(changedRects, contentRect);
+                    _changeStatistics.AddFrame(dirtyRects, (long)contentRect.Width * contentRect.Height);
+                }
+                else
+                {
+                    dirtyRects = new List<RectInt32>() { contentRect };
+                }
+
+                // A mostly static desktop produces no dirty rects at all,
+                // in which case there's nothing to copy or present
+                if (!isFullUpdate && dirtyRects.Count == 0)
                 {
-                    var contentSize = frame.ContentSize;
+                    return;
+                }
 
-                    using (var lockSession = _device.Multithread.Lock())
-                    using (var sourceTexture = Direct3D11Texture2D.CreateFromDirect3DSurface(frame.Surface))
-                    using (var backBuffer = _swapChain.GetBuffer(0))
-                    using (var renderTargetView = _device.CreateRenderTargetView(backBuffer))
+                using (var sourceTexture = Direct3D11Texture2D.CreateFromDirect3DSurface(frame.Surface))
+                using (var backBuffer = _swapChain.GetBuffer(0))
+                {
+                    if (isFullUpdate)
+                    {
+                        using (var renderTargetView = _device.CreateRenderTargetView(backBuffer))
+                        {
+                            _deviceContext.ClearRenderTargetView(renderTargetView, ClearColor);
+                        }
+                        CopyRect(backBuffer, sourceTexture, contentRect);
+                        _fullUpdatesRemaining = Math.Max(_fullUpdatesRemaining - 1, 0);
+                    }
+                    else
                     {
-                        _deviceContext.ClearRenderTargetView(renderTargetView, ClearColor);
-                        var sourceBox = new Direct3D11Box()
+                        // The back buffer was last presented before the
+                        // previous update, so it's also missing those rects
+                        foreach (var rect in _staleBackBufferRects)
+                        {
+                            CopyRect(backBuffer, sourceTexture, rect);
+                        }
+                        foreach (var rect in dirtyRects)
                         {
-                            Left = 0,
-                            Top = 0,
-                            Front = 0,
-                            Right = (uint)Math.Min(_lastSize.Width, contentSize.Width),
-                            Bottom = (uint)Math.Min(_lastSize.Height, contentSize.Height),
-                            Back = 1
-                        };
-                        _deviceContext.CopySubresourceRegion(backBuffer, 0, new PositionUInt32(), sourceTexture, 0, sourceBox);
+                            CopyRect(backBuffer, sourceTexture, rect);
+                        }
                     }
+                }
 
-                    _swapChain.Present();
+                _swapChain.Present();
+                _staleBackBufferRects = dirtyRects;
+            }
+        }
+
+        private void CopyRect(IDirect3DSurface dest, IDirect3DSurface source, RectInt32 rect)
+        {
+            var sourceBox = new Direct3D11Box()
+            {
+                Left = (uint)rect.X,
+                Top = (uint)rect.Y,
+                Front = 0,
+                Right = (uint)(rect.X + rect.Width),
+                Bottom = (uint)(rect.Y + rect.Height),
+                Back = 1
+            };
+            _deviceContext.CopySubresourceRegion(dest, 0, new PositionUInt32() { X = (uint)rect.X, Y = (uint)rect.Y }, source, 0, sourceBox);
+        }
 
-                } // retire the frame
+        private static List<RectInt32> ClipRects(RectInt32[] rects, RectInt32 bounds)
+        {
+            var result = new List<RectInt32>(rects.Length);
+            foreach (var rect in rects)
+            {
+                var right = Math.Min(rect.X + rect.Width, bounds.X + bounds.Width);
+                var bottom = Math.Min(rect.Y + rect.Height, bounds.Y + bounds.Height);
+                var x = Math.Max(rect.X, bounds.X);
+                var y = Math.Max(rect.Y, bounds.Y);
+                if (right > x && bottom > y)
+                {
+                    result.Add(new RectInt32() { X = x, Y = y, Width = right - x, Height = bottom - y });
+                }
             }
+            return result;
         }
 
         private GraphicsCaptureItem _item;
@@ -162,9 +438,38 @@ namespace ImageViewer.ScreenCapture
         private Direct3D11DeviceContext _deviceContext;
         private SwapChain _swapChain;
 
+        private FrameDiffer _differ;
+        private CaptureChangeStatistics _changeStatistics = new CaptureChangeStatistics();
+        private SizeInt32 _lastContentSize;
+        // The first presents after a (re)start have nothing to build on
+        private int _fullUpdatesRemaining = SwapChainBufferCount;
+        private List<RectInt32> _staleBackBufferRects = new List<RectInt32>();
+
+        private CaptureRecorder _recorder;
+        private IRandomAccessStream _recordingStream;
+        private ScopeAnalyzer _scopes;
+        private bool _isTrackingChanges;
+
         private ManualResetEvent _pauseEvent;
         private object _stateLock;
+        // Keeps frames in order now that they're read back outside of
+        // _stateLock. Taken before it.
+        private object _frameLock;
+        // Whether frames go through the differ, which reads them back.
+        // Only while the recorder, the scopes or the change overlay use
+        // them. Guarded by _frameLock.
+        private bool _isDiffing;
+        // The newest frame, until the differ has read it back
+        private Direct3D11CaptureFrame _unreadFrame;
+        private Timer _flushTimer;
 
+        private const int SwapChainBufferCount = 2;
+        // One of them is held as the unread frame
+        private const int FramePoolBufferCount = 3;
+        // A few frames at 60Hz without a new one
+        private const int FlushDelayMilliseconds = 50;
+        // Each queued frame is a full copy, about 33 MB at 4K
+        private const uint RecordingQueueCapacity = 8;
         private static readonly float[] ClearColor = new float[] { 0.0f, 0.0f, 0.0f, 0.0f };
     }
 }
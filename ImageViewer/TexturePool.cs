@@ -0,0 +1,149 @@
+﻿using ImageViewerNative;
+using System;
+using System.Collections.Generic;
+using WinRTInteropTools;
+
+namespace ImageViewer
+{
+    // Recycles textures with the same device and description. Frame by
+    // frame video keeps a copy of every frame, so reopening a video of the
+    // same size reuses the textures of the last one instead of allocating.
+    //
+    // Like the native KeyedPool, Trim keeps only as many idle textures
+    // per description as were out at once since the last Trim. Its
+    // counters are reported to the native PipelineProfiler.
+    class TexturePool
+    {
+        // Textures are assumed to be 4 bytes per pixel
+        private const long DefaultMaxIdleBytes = 512L * 1024 * 1024;
+
+        private class Bucket
+        {
+            public Stack<Direct3D11Texture2D> Idle = new Stack<Direct3D11Texture2D>();
+            public int Outstanding;
+            public int PeakOutstanding;
+        }
+
+        private struct TextureKey : IEquatable<TextureKey>
+        {
+            public Direct3D11Device Device;
+            public Direct3D11Texture2DDescription Description;
+
+            public bool Equals(TextureKey other) => Device == other.Device && Description.Equals(other.Description);
+            public override bool Equals(object obj) => obj is TextureKey other && Equals(other);
+            public override int GetHashCode() => (Description.Base.Width * 31 + Description.Base.Height) * 31 + (int)Description.Base.Format;
+        }
+
+        public static TexturePool Shared { get; } = new TexturePool(DefaultMaxIdleBytes);
+
+        private object _lock = new object();
+        private Dictionary<TextureKey, Bucket> _buckets = new Dictionary<TextureKey, Bucket>();
+        private Dictionary<Direct3D11Texture2D, TextureKey> _outstanding = new Dictionary<Direct3D11Texture2D, TextureKey>();
+        private long _maxIdleBytes;
+        private long _idleBytes;
+
+        public long Allocations { get; private set; }
+        public long Reuses { get; private set; }
+
+        public TexturePool(long maxIdleBytes)
+        {
+            _maxIdleBytes = maxIdleBytes;
+        }
+
+        // The caller must hold the device's multithread lock.
+        public Direct3D11Texture2D Acquire(Direct3D11Device device, Direct3D11Texture2DDescription description)
+        {
+            var key = new TextureKey { Device = device, Description = description };
+            Direct3D11Texture2D texture = null;
+            lock (_lock)
+            {
+                if (!_buckets.TryGetValue(key, out var bucket))
+                {
+                    bucket = new Bucket();
+                    _buckets.Add(key, bucket);
+                }
+                bucket.Outstanding++;
+                bucket.PeakOutstanding = Math.Max(bucket.PeakOutstanding, bucket.Outstanding);
+                if (bucket.Idle.Count > 0)
+                {
+                    texture = bucket.Idle.Pop();
+                    _idleBytes -= GetSize(description);
+                    Reuses++;
+                    PipelineProfiler.AddCounter("TexturePool.Reuses", 1);
+                }
+                else
+                {
+                    Allocations++;
+                    PipelineProfiler.AddCounter("TexturePool.Allocations", 1);
+                }
+                PipelineProfiler.SetCounter("TexturePool.IdleBytes", _idleBytes);
+            }
+
+            if (texture == null)
+            {
+                texture = device.CreateTexture2D(description);
+            }
+            lock (_lock)
+            {
+                _outstanding.Add(texture, key);
+            }
+            return texture;
+        }
+
+        // Textures that didn't come from the pool are disposed. The next
+        // Acquire may write to the texture right away, so whatever was
+        // drawn from it (composition surfaces, thumbnails) must be disposed
+        // first. Their copies are queued on the same device, which keeps
+        // them ahead of the next user's writes.
+        public void Return(Direct3D11Texture2D texture)
+        {
+            lock (_lock)
+            {
+                if (_outstanding.TryGetValue(texture, out var key))
+                {
+                    _outstanding.Remove(texture);
+                    var bucket = _buckets[key];
+                    bucket.Outstanding--;
+                    var size = GetSize(key.Description);
+                    if (_idleBytes + size <= _maxIdleBytes)
+                    {
+                        bucket.Idle.Push(texture);
+                        _idleBytes += size;
+                        PipelineProfiler.SetCounter("TexturePool.IdleBytes", _idleBytes);
+                        return;
+                    }
+                }
+            }
+            texture.Dispose();
+        }
+
+        public void Trim()
+        {
+            var freed = new List<Direct3D11Texture2D>();
+            lock (_lock)
+            {
+                foreach (var pair in _buckets)
+                {
+                    var bucket = pair.Value;
+                    var keep = bucket.PeakOutstanding - bucket.Outstanding;
+                    while (bucket.Idle.Count > keep)
+                    {
+                        freed.Add(bucket.Idle.Pop());
+                        _idleBytes -= GetSize(pair.Key.Description);
+                    }
+                    bucket.PeakOutstanding = bucket.Outstanding;
+                }
+                PipelineProfiler.SetCounter("TexturePool.IdleBytes", _idleBytes);
+            }
+            foreach (var texture in freed)
+            {
+                texture.Dispose();
+            }
+        }
+
+        private static long GetSize(Direct3D11Texture2DDescription description)
+        {
+            return (long)description.Base.Width * description.Base.Height * 4;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+﻿using ImageViewerNative;
+using Microsoft.Graphics.Canvas;
+using Microsoft.Graphics.Canvas.UI.Composition;
+using System;
+using Windows.Foundation;
+using Windows.Graphics;
+using Windows.Graphics.DirectX;
+using Windows.UI;
+using Windows.UI.Composition;
+
+namespace ImageViewer
+{
+    // A virtual surface that only ever holds the tiles that have recently
+    // been on screen. Tiles are produced on demand by the rasterize
+    // callback and trimmed once they fall out of the tile cache. Dispose
+    // it to release the tiles it holds.
+    class ViewportTiledSurface : IDisposable
+    {
+        // 256x256 BGRA8 tiles, so the cache tops out around 16 MB.
+        private const int TileSize = 256;
+        private const uint TileCapacity = 64;
+
+        private CompositionVirtualDrawingSurface _surface;
+        private ViewportTiles _tiles;
+        // Fills the buffer with the pixels of the bounds
+        private Action<RectInt32, byte[]> _rasterize;
+        // Every tile is rasterized whole into the same buffer and bitmap,
+        // edge tiles are clipped when drawn
+        private byte[] _tilePixels = new byte[TileSize * TileSize * 4];
+        private CanvasBitmap _tileBitmap;
+
+        public ICompositionSurface Surface => _surface;
+        public SizeInt32 Size { get; }
+
+        public ViewportTiledSurface(CompositionGraphicsDevice graphics, SizeInt32 size, Action<RectInt32, byte[]> rasterize)
+        {
+            Size = size;
+            _rasterize = rasterize;
+            _surface = graphics.CreateVirtualDrawingSurface(
+                size,
+                DirectXPixelFormat.B8G8R8A8UIntNormalized,
+                DirectXAlphaMode.Premultiplied);
+            _tiles = new ViewportTiles(size, TileSize, TileCapacity);
+        }
+
+        public void UpdateViewport(CanvasDevice device, RectInt32 viewport)
+        {
+            var tilesToRender = _tiles.Update(viewport, out var evicted);
+            if (evicted.Length > 0)
+            {
+                _surface.Trim(evicted);
+            }
+
+            if (tilesToRender.Length > 0 && (_tileBitmap == null || _tileBitmap.Device != device))
+            {
+                _tileBitmap?.Dispose();
+                _tileBitmap = CanvasBitmap.CreateFromBytes(device, _tilePixels, TileSize, TileSize, DirectXPixelFormat.B8G8R8A8UIntNormalized, 96.0f, CanvasAlphaMode.Premultiplied);
+            }
+
+            foreach (var tile in tilesToRender)
+            {
+                _rasterize(new RectInt32() { X = tile.X, Y = tile.Y, Width = TileSize, Height = TileSize }, _tilePixels);
+                _tileBitmap.SetPixelBytes(_tilePixels);
+                var updateRect = new Rect(tile.X, tile.Y, tile.Width, tile.Height);
+                using (var drawingSession = CanvasComposition.CreateDrawingSession(_surface, updateRect))
+                {
+                    drawingSession.Clear(Colors.Transparent);
+                    drawingSession.DrawImage(_tileBitmap);
+                }
+            }
+        }
+
+        public void Dispose()
+        {
+            _tileBitmap?.Dispose();
+            _tileBitmap = null;
+            _surface?.Dispose();
+            _surface = null;
+        }
+    }
+}
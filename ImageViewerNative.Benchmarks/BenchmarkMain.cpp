@@ -0,0 +1,340 @@
+#include "pch.h"
+#include "PipelineBenchmarks.h"
+#include "PngEncoder.h"
+#include "RmRawFrameStream.h"
+#include <fstream>
+#include <iostream>
+#ifdef IMAGEVIEWER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Runs the pipeline benchmarks headless. Exits with 1 if any benchmark
+// regressed from the baseline, and 2 for bad arguments or files.
+
+static char const Usage[] =
+    "Usage: ImageViewerBenchmarks [options]\n"
+    "  --seconds S         minimum seconds per benchmark (default 0.5)\n"
+    "  --resolutions LIST  comma separated, from 1080p, 4K and 8K (default all)\n"
+    "  --benchmarks LIST   comma separated benchmark names (default all)\n"
+    "  --image FILE        RmRaw image tiled into the frames\n"
+    "  --clip FILE         NV12 clip, frames back to back\n"
+    "  --clip-size WxH     size of the clip's frames\n"
+    "  --synthetic         generated frames and no clip instead of the fixtures\n"
+    "  --output FILE       save the results as JSON\n"
+    "  --baseline FILE     compare the results with an earlier run\n"
+    "  --threshold T       allowed drop in frames/s from the baseline (default 0.1)\n"
+    "  --threads N         run the kernels on N threads (default every core)\n"
+    "  --scaling           run on 1 to N threads, or to every core, and report\n"
+    "                      the speedup, then save and compare the last run\n";
+
+static char const DefaultImage[] = IMAGEVIEWER_FIXTURES_DIR "/desktop.rmraw";
+static char const DefaultClip[] = IMAGEVIEWER_FIXTURES_DIR "/clip-256x144.nv12";
+static const uint32_t DefaultClipWidth = 256;
+static const uint32_t DefaultClipHeight = 144;
+
+static std::vector<uint8_t> ReadFile(std::string const& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Can't open " + path);
+    }
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteFile(std::string const& path, std::string const& text)
+{
+    std::ofstream file(path, std::ios::binary);
+    file << text;
+    if (!file)
+    {
+        throw std::runtime_error("Can't write " + path);
+    }
+}
+
+static std::vector<std::string> SplitList(std::string const& list)
+{
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// The first frame of an RmRaw frame stream
+static void LoadImage(std::string const& path, BenchmarkFixtures& fixtures)
+{
+    auto bytes = ReadFile(path);
+    if (!RmRawFrameStreamReader::IsFrameStream(bytes.data(), bytes.size()))
+    {
+        throw std::runtime_error(path + " is not an RmRaw frame stream");
+    }
+    RmRawFrameStreamReader reader([&](uint64_t offset, uint8_t* data, size_t size)
+    {
+        memcpy(data, bytes.data() + offset, size);
+    }, bytes.size());
+    if (reader.FrameCount() == 0)
+    {
+        throw std::runtime_error(path + " has no frames");
+    }
+    fixtures.ImageWidth = reader.Width();
+    fixtures.ImageHeight = reader.Height();
+    fixtures.Image = reader.DecodeFrame(0);
+}
+
+static void LoadClip(std::string const& path, uint32_t width, uint32_t height, BenchmarkFixtures& fixtures)
+{
+    if (width == 0 || height == 0 || width % 2 != 0 || height % 2 != 0)
+    {
+        throw std::runtime_error("NV12 clips need an even, non-zero size");
+    }
+    auto bytes = ReadFile(path);
+    auto frameSize = static_cast<size_t>(width) * height * 3 / 2;
+    if (bytes.empty() || bytes.size() % frameSize != 0)
+    {
+        throw std::runtime_error(path + " is not a whole number of frames of the given size");
+    }
+    fixtures.ClipWidth = width;
+    fixtures.ClipHeight = height;
+    for (size_t offset = 0; offset < bytes.size(); offset += frameSize)
+    {
+        fixtures.ClipFrames.emplace_back(bytes.begin() + offset, bytes.begin() + offset + frameSize);
+    }
+}
+
+#ifdef IMAGEVIEWER_HAVE_ZLIB
+// What a simple PNG writer does on one thread with zlib, for comparison
+// with PngEncode: the same color type and level, with every row Paeth
+// filtered and deflated in one stream. Returns the size of the IDAT data.
+static size_t EncodePngWithZlib(uint8_t const* bgraPixels, uint32_t width, uint32_t height)
+{
+    auto pixelCount = static_cast<size_t>(width) * height;
+    auto opaque = true;
+    for (size_t i = 0; i < pixelCount && opaque; i++)
+    {
+        opaque = bgraPixels[(i * 4) + 3] == 255;
+    }
+    auto channels = opaque ? 3u : 4u;
+    auto rowBytes = static_cast<size_t>(width) * channels;
+
+    std::vector<uint8_t> previous(rowBytes);
+    std::vector<uint8_t> current(rowBytes);
+    std::vector<uint8_t> filtered((rowBytes + 1) * height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto source = bgraPixels + (static_cast<size_t>(y) * width * 4);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            auto target = current.data() + (x * channels);
+            target[0] = source[(x * 4) + 2];
+            target[1] = source[(x * 4) + 1];
+            target[2] = source[x * 4];
+            if (!opaque)
+            {
+                target[3] = source[(x * 4) + 3];
+            }
+        }
+
+        auto output = filtered.data() + (y * (rowBytes + 1));
+        output[0] = 4;
+        for (size_t i = 0; i < rowBytes; i++)
+        {
+            int32_t left = i >= channels ? current[i - channels] : 0;
+            int32_t up = previous[i];
+            int32_t upLeft = i >= channels ? previous[i - channels] : 0;
+            auto pa = std::abs(up - upLeft);
+            auto pb = std::abs(left - upLeft);
+            auto pc = std::abs(left + up - (2 * upLeft));
+            auto predictor = (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+            output[i + 1] = static_cast<uint8_t>(current[i] - predictor);
+        }
+        std::swap(previous, current);
+    }
+
+    auto compressedSize = compressBound(static_cast<uLong>(filtered.size()));
+    std::vector<uint8_t> compressed(compressedSize);
+    if (compress2(compressed.data(), &compressedSize, filtered.data(), static_cast<uLong>(filtered.size()), PngEncoder::DefaultLevel) != Z_OK)
+    {
+        throw std::runtime_error("zlib failed to compress");
+    }
+    return compressedSize;
+}
+#endif
+
+static int Run(int argc, char** argv)
+{
+    PipelineBenchmarks::Options options;
+    std::string imagePath = DefaultImage;
+    std::string clipPath = DefaultClip;
+    auto clipWidth = DefaultClipWidth;
+    auto clipHeight = DefaultClipHeight;
+    auto synthetic = false;
+    std::string outputPath;
+    std::string baselinePath;
+    auto threshold = PipelineBenchmarks::DefaultRegressionThreshold;
+    auto scaling = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        auto value = [&]()
+        {
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument(argument + " needs a value");
+            }
+            return std::string(argv[++i]);
+        };
+
+        if (argument == "--seconds")
+        {
+            options.MinimumSeconds = std::stod(value());
+        }
+        else if (argument == "--resolutions")
+        {
+            options.ResolutionNames = SplitList(value());
+        }
+        else if (argument == "--benchmarks")
+        {
+            options.BenchmarkNames = SplitList(value());
+        }
+        else if (argument == "--image")
+        {
+            imagePath = value();
+        }
+        else if (argument == "--clip")
+        {
+            clipPath = value();
+        }
+        else if (argument == "--clip-size")
+        {
+            auto size = value();
+            if (sscanf(size.c_str(), "%ux%u", &clipWidth, &clipHeight) != 2)
+            {
+                throw std::invalid_argument("The clip size must be WxH");
+            }
+        }
+        else if (argument == "--synthetic")
+        {
+            synthetic = true;
+        }
+        else if (argument == "--output")
+        {
+            outputPath = value();
+        }
+        else if (argument == "--baseline")
+        {
+            baselinePath = value();
+        }
+        else if (argument == "--threshold")
+        {
+            threshold = std::stod(value());
+        }
+        else if (argument == "--threads")
+        {
+            auto threadCount = std::stoi(value());
+            if (threadCount <= 0)
+            {
+                throw std::invalid_argument("There has to be at least one thread");
+            }
+            options.ThreadCount = static_cast<uint32_t>(threadCount);
+        }
+        else if (argument == "--scaling")
+        {
+            scaling = true;
+        }
+        else if (argument == "--help")
+        {
+            std::cout << Usage;
+            return 0;
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown option " + argument);
+        }
+    }
+    if (!(options.MinimumSeconds >= 0) || !(threshold >= 0))
+    {
+        throw std::invalid_argument("The duration and threshold can't be negative");
+    }
+
+    if (!synthetic)
+    {
+        LoadImage(imagePath, options.Fixtures);
+        LoadClip(clipPath, clipWidth, clipHeight, options.Fixtures);
+    }
+#ifdef IMAGEVIEWER_HAVE_ZLIB
+    options.ExternalBenchmarks.push_back({ "PngEncodeZlib", [](uint8_t const* bgraPixels, uint32_t width, uint32_t height)
+    {
+        EncodePngWithZlib(bgraPixels, width, height);
+        return 1u;
+    } });
+#endif
+    // Read the baseline first so that a bad path fails before the run
+    std::optional<BenchmarkRun> baseline;
+    if (!baselinePath.empty())
+    {
+        auto json = ReadFile(baselinePath);
+        baseline = PipelineBenchmarks::FromJson(std::string(json.begin(), json.end()));
+    }
+
+    BenchmarkRun run;
+    if (scaling)
+    {
+        auto maxThreadCount = options.ThreadCount != 0 ? options.ThreadCount : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<BenchmarkRun> runs;
+        for (uint32_t threadCount = 1; threadCount <= maxThreadCount; threadCount++)
+        {
+            options.ThreadCount = threadCount;
+            runs.push_back(PipelineBenchmarks::Run(options));
+            std::cout << PipelineBenchmarks::Summary(runs.back());
+        }
+        std::cout << PipelineBenchmarks::ScalingSummary(runs);
+        run = runs.back();
+    }
+    else
+    {
+        run = PipelineBenchmarks::Run(options);
+        std::cout << PipelineBenchmarks::Summary(run);
+    }
+    if (!outputPath.empty())
+    {
+        WriteFile(outputPath, PipelineBenchmarks::ToJson(run));
+    }
+
+    if (baseline)
+    {
+        auto regressions = PipelineBenchmarks::FindRegressions(run, *baseline, threshold);
+        for (auto& regression : regressions)
+        {
+            printf("Regressed: %s, %.1f -> %.1f frames/s (%.1f%%)\n",
+                regression.Name.c_str(), regression.BaselineFramesPerSecond, regression.FramesPerSecond,
+                (regression.FramesPerSecond / regression.BaselineFramesPerSecond - 1.0) * 100.0);
+        }
+        if (!regressions.empty())
+        {
+            return 1;
+        }
+        printf("No regressions from %s\n", baselinePath.c_str());
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        return Run(argc, argv);
+    }
+    catch (std::exception const& error)
+    {
+        std::cerr << error.what() << "\n\n" << Usage;
+        return 2;
+    }
+}
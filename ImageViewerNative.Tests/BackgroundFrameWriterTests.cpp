@@ -0,0 +1,144 @@
+#include "pch.h"
+#include "BackgroundFrameWriter.h"
+#include "Profiler.h"
+#include "TestHarness.h"
+#include <random>
+
+static const uint32_t FrameWidth = 97;
+static const uint32_t FrameHeight = 61;
+static const uint32_t FrameStride = (FrameWidth * 4) + 12;
+
+// Frames whose first pixel holds their number, so they can be told apart
+// once written
+static std::vector<uint8_t> NumberedFrame(uint32_t number)
+{
+    std::vector<uint8_t> pixels(static_cast<size_t>(FrameStride) * FrameHeight);
+    std::mt19937 random(number);
+    for (auto& value : pixels)
+    {
+        value = static_cast<uint8_t>(random());
+    }
+    memcpy(pixels.data(), &number, sizeof(number));
+    return pixels;
+}
+
+static std::vector<uint8_t> Packed(std::vector<uint8_t> const& frame)
+{
+    std::vector<uint8_t> packed(static_cast<size_t>(FrameWidth) * FrameHeight * 4);
+    for (uint32_t y = 0; y < FrameHeight; y++)
+    {
+        memcpy(packed.data() + (static_cast<size_t>(y) * FrameWidth * 4), frame.data() + (static_cast<size_t>(y) * FrameStride), FrameWidth * 4);
+    }
+    return packed;
+}
+
+static RmRawFrameStreamReader ReadBack(std::vector<uint8_t> const& stream)
+{
+    return RmRawFrameStreamReader([&stream](uint64_t offset, uint8_t* data, size_t size) { memcpy(data, stream.data() + offset, size); }, stream.size());
+}
+
+// Writes 100 frames while the stream takes the given time per write
+static std::unique_ptr<BackgroundFrameWriter> WriteFrames(std::chrono::microseconds writeDelay, std::vector<uint8_t>& stream, std::vector<std::vector<uint8_t>>& enqueued)
+{
+    auto writer = std::make_unique<BackgroundFrameWriter>(std::make_unique<RmRawFrameStreamWriter>([&stream, writeDelay](uint8_t const* data, size_t size)
+    {
+        std::this_thread::sleep_for(writeDelay);
+        stream.insert(stream.end(), data, data + size);
+    }, FrameWidth, FrameHeight), 4);
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        auto frame = NumberedFrame(i);
+        if (writer->TryEnqueue(frame.data(), FrameStride, i))
+        {
+            enqueued.push_back(Packed(frame));
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    writer->Finish();
+    return writer;
+}
+
+TEST(BackgroundFrameWriterTests, EnqueuedFramesAreWrittenInOrder)
+{
+    std::vector<uint8_t> stream;
+    std::vector<std::vector<uint8_t>> enqueued;
+    auto writer = WriteFrames(std::chrono::microseconds(0), stream, enqueued);
+
+    EXPECT_EQ(writer->WrittenFrameCount(), static_cast<uint64_t>(enqueued.size()));
+    EXPECT_EQ(writer->WrittenFrameCount() + writer->DroppedFrameCount(), 100u);
+    auto reader = ReadBack(stream);
+    ASSERT_EQ(reader.FrameCount(), static_cast<uint32_t>(enqueued.size()));
+    int64_t lastTimestamp = -1;
+    for (uint32_t i = 0; i < reader.FrameCount(); i++)
+    {
+        EXPECT_TRUE(reader.DecodeFrame(i) == enqueued[i]) << "frame " << i;
+        EXPECT_GT(reader.Entry(i).Timestamp, lastTimestamp);
+        lastTimestamp = reader.Entry(i).Timestamp;
+    }
+}
+
+TEST(BackgroundFrameWriterTests, SlowWritesDropFramesInsteadOfWaiting)
+{
+    std::vector<uint8_t> stream;
+    std::vector<std::vector<uint8_t>> enqueued;
+    auto writer = WriteFrames(std::chrono::microseconds(3000), stream, enqueued);
+
+    EXPECT_GT(writer->DroppedFrameCount(), 0u);
+    EXPECT_EQ(writer->WrittenFrameCount() + writer->DroppedFrameCount(), 100u);
+    auto reader = ReadBack(stream);
+    ASSERT_EQ(reader.FrameCount(), static_cast<uint32_t>(enqueued.size()));
+    for (uint32_t i = 0; i < reader.FrameCount(); i++)
+    {
+        EXPECT_TRUE(reader.DecodeFrame(i) == enqueued[i]) << "frame " << i;
+    }
+}
+
+TEST(BackgroundFrameWriterTests, StallsAreCounted)
+{
+    Profiler::SetEnabled(true);
+    Profiler::Reset();
+    std::vector<uint8_t> stream;
+    std::vector<std::vector<uint8_t>> enqueued;
+    WriteFrames(std::chrono::microseconds(3000), stream, enqueued);
+    auto summary = Profiler::Summary();
+    Profiler::SetEnabled(false);
+    Profiler::Reset();
+
+    EXPECT_NE(summary.find("BackgroundFrameWriter.QueueFullNanoseconds: "), std::string::npos) << summary;
+    EXPECT_NE(summary.find("BackgroundFrameWriter.FinishWaitNanoseconds: "), std::string::npos) << summary;
+    EXPECT_NE(summary.find("BackgroundFrameWriter.Finish: 1 runs"), std::string::npos) << summary;
+}
+
+TEST(BackgroundFrameWriterTests, WriteErrorsAreRethrownByFinish)
+{
+    uint32_t writeCount = 0;
+    BackgroundFrameWriter writer(std::make_unique<RmRawFrameStreamWriter>([&](uint8_t const*, size_t)
+    {
+        // The header goes through, the first frame doesn't
+        if (++writeCount > 1)
+        {
+            throw std::runtime_error("Disk full");
+        }
+    }, FrameWidth, FrameHeight), 4);
+
+    auto frame = NumberedFrame(0);
+    EXPECT_TRUE(writer.TryEnqueue(frame.data(), FrameStride, 0));
+    EXPECT_THROW(writer.Finish(), std::runtime_error);
+    EXPECT_FALSE(writer.TryEnqueue(frame.data(), FrameStride, 1));
+    EXPECT_EQ(writer.WrittenFrameCount(), 0u);
+    // The error is only reported once
+    EXPECT_NO_THROW(writer.Finish());
+}
+
+TEST(BackgroundFrameWriterTests, FramesAfterFinishAreDropped)
+{
+    std::vector<uint8_t> stream;
+    BackgroundFrameWriter writer(std::make_unique<RmRawFrameStreamWriter>([&](uint8_t const* data, size_t size) { stream.insert(stream.end(), data, data + size); }, FrameWidth, FrameHeight), 4);
+    auto frame = NumberedFrame(0);
+    EXPECT_TRUE(writer.TryEnqueue(frame.data(), FrameStride, 0));
+    writer.Finish();
+    EXPECT_FALSE(writer.TryEnqueue(frame.data(), FrameStride, 1));
+    EXPECT_EQ(writer.WrittenFrameCount(), 1u);
+    EXPECT_EQ(writer.DroppedFrameCount(), 1u);
+    EXPECT_EQ(ReadBack(stream).FrameCount(), 1u);
+}
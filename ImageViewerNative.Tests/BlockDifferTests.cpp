@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "BlockDiffer.h"
+#include "TestHarness.h"
+#include <random>
+
+static uint64_t Area(std::vector<PixelRect> const& rects)
+{
+    uint64_t area = 0;
+    for (auto& rect : rects)
+    {
+        area += static_cast<uint64_t>(rect.Width) * rect.Height;
+    }
+    return area;
+}
+
+static bool Contains(std::vector<PixelRect> const& rects, uint32_t x, uint32_t y)
+{
+    return std::any_of(rects.begin(), rects.end(), [&](auto const& rect)
+    {
+        return x >= rect.X && x < rect.X + rect.Width && y >= rect.Y && y < rect.Y + rect.Height;
+    });
+}
+
+// Random pixels, with rows padded past the frame
+struct TestFrame
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Stride;
+    std::vector<uint8_t> Pixels;
+
+    TestFrame(uint32_t width, uint32_t height, uint32_t seed) :
+        Width(width), Height(height), Stride((width * 4) + 64), Pixels(static_cast<size_t>(Stride) * height)
+    {
+        std::mt19937 random(seed);
+        for (auto& value : Pixels)
+        {
+            value = static_cast<uint8_t>(random());
+        }
+    }
+
+    uint8_t& At(uint32_t x, uint32_t y, uint32_t channel) { return Pixels[(static_cast<size_t>(y) * Stride) + (x * 4) + channel]; }
+};
+
+TEST(BlockDifferTests, FirstFrameIsEntirelyDirty)
+{
+    TestFrame frame(1000, 700, 1);
+    BlockDiffer differ(frame.Width, frame.Height);
+    auto& rects = differ.Compare(frame.Pixels.data(), frame.Stride);
+    EXPECT_EQ(Area(rects), static_cast<uint64_t>(frame.Width) * frame.Height);
+    EXPECT_EQ(differ.DirtyPixelCount(), static_cast<uint64_t>(frame.Width) * frame.Height);
+
+    EXPECT_TRUE(differ.Compare(frame.Pixels.data(), frame.Stride).empty());
+    EXPECT_EQ(differ.DirtyPixelCount(), 0u);
+
+    differ.Reset();
+    EXPECT_EQ(Area(differ.Compare(frame.Pixels.data(), frame.Stride)), static_cast<uint64_t>(frame.Width) * frame.Height);
+}
+
+TEST(BlockDifferTests, ChangesAreFoundInTheirBlocks)
+{
+    TestFrame frame(1000, 700, 2);
+    BlockDiffer differ(frame.Width, frame.Height);
+    differ.Compare(frame.Pixels.data(), frame.Stride);
+
+    // A corner, the partial blocks on the far edges, and any channel
+    frame.At(0, 0, 0) ^= 1;
+    frame.At(999, 699, 3) ^= 1;
+    frame.At(500, 100, 2) ^= 0x80;
+    auto rects = differ.Compare(frame.Pixels.data(), frame.Stride);
+    EXPECT_TRUE(Contains(rects, 0, 0));
+    EXPECT_TRUE(Contains(rects, 999, 699));
+    EXPECT_TRUE(Contains(rects, 500, 100));
+    EXPECT_LE(Area(rects), 3u * BlockDiffer::BlockSize * BlockDiffer::BlockSize);
+    EXPECT_EQ(differ.DirtyPixelCount(), Area(rects));
+    for (auto& rect : rects)
+    {
+        EXPECT_LE(rect.X + rect.Width, frame.Width);
+        EXPECT_LE(rect.Y + rect.Height, frame.Height);
+    }
+
+    // Only the changed blocks were refreshed, and that's enough
+    EXPECT_TRUE(differ.Compare(frame.Pixels.data(), frame.Stride).empty());
+}
+
+TEST(BlockDifferTests, RowPaddingIsIgnored)
+{
+    TestFrame frame(100, 50, 3);
+    BlockDiffer differ(frame.Width, frame.Height);
+    differ.Compare(frame.Pixels.data(), frame.Stride);
+    for (uint32_t y = 0; y < frame.Height; y++)
+    {
+        frame.Pixels[(static_cast<size_t>(y) * frame.Stride) + (frame.Width * 4)] ^= 0xFF;
+    }
+    EXPECT_TRUE(differ.Compare(frame.Pixels.data(), frame.Stride).empty());
+}
+
+TEST(BlockDifferTests, MatchesABruteForceDiff)
+{
+    std::mt19937 random(4);
+    TestFrame frame(333, 257, 5);
+    BlockDiffer differ(frame.Width, frame.Height);
+    differ.Compare(frame.Pixels.data(), frame.Stride);
+    for (uint32_t iteration = 0; iteration < 200; iteration++)
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> changes;
+        auto changeCount = random() % 5;
+        for (uint32_t i = 0; i < changeCount; i++)
+        {
+            auto x = random() % frame.Width;
+            auto y = random() % frame.Height;
+            frame.At(x, y, random() % 4) ^= static_cast<uint8_t>(1 + (random() % 255));
+            changes.push_back({ x, y });
+        }
+
+        auto& rects = differ.Compare(frame.Pixels.data(), frame.Stride);
+        for (auto& change : changes)
+        {
+            EXPECT_TRUE(Contains(rects, change.first, change.second)) << "iteration " << iteration;
+        }
+        EXPECT_EQ(differ.DirtyPixelCount(), Area(rects));
+        EXPECT_LE(Area(rects), static_cast<uint64_t>(changeCount) * BlockDiffer::BlockSize * BlockDiffer::BlockSize);
+    }
+}
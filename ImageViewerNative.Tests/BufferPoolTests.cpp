@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "BufferPool.h"
+#include "TestHarness.h"
+
+TEST(BufferPoolTests, ClassesAreAQuarterOfAPowerOfTwoApart)
+{
+    // Nothing is smaller than MinimumClassSize
+    EXPECT_EQ(BufferPool::ClassSize(0), 4096u);
+    EXPECT_EQ(BufferPool::ClassSize(1), 4096u);
+    EXPECT_EQ(BufferPool::ClassSize(4096), 4096u);
+    EXPECT_EQ(BufferPool::ClassSize(4097), 5120u);
+    EXPECT_EQ(BufferPool::ClassSize(8191), 8192u);
+    EXPECT_EQ(BufferPool::ClassSize(8193), 10240u);
+    // A 1080p BGRA frame
+    EXPECT_EQ(BufferPool::ClassSize(1920 * 1080 * 4), 8388608u);
+
+    for (size_t size = 4096; size < 64 * 1024 * 1024; size = (size * 7) / 5)
+    {
+        auto classSize = BufferPool::ClassSize(size);
+        EXPECT_GE(classSize, size);
+        EXPECT_LE(classSize, size + (size / 4)) << "size " << size;
+        EXPECT_EQ(BufferPool::ClassSize(classSize), classSize);
+    }
+}
+
+TEST(BufferPoolTests, ReleasedBuffersAreReused)
+{
+    BufferPool pool;
+    uint8_t* data = nullptr;
+    {
+        auto buffer = pool.Acquire(10000);
+        EXPECT_EQ(buffer.Size(), 10000u);
+        EXPECT_EQ(buffer.Capacity(), BufferPool::ClassSize(10000));
+        data = buffer.Data();
+        memset(buffer.Data(), 0xCD, buffer.Capacity());
+    }
+
+    // Any size in the same class gets the same buffer back
+    auto buffer = pool.Acquire(9000);
+    EXPECT_EQ(buffer.Data(), data);
+    EXPECT_EQ(buffer.Size(), 9000u);
+    auto other = pool.Acquire(100000);
+    EXPECT_NE(other.Data(), data);
+
+    auto statistics = pool.Statistics();
+    EXPECT_EQ(statistics.Allocations, 2u);
+    EXPECT_EQ(statistics.Reuses, 1u);
+    EXPECT_EQ(statistics.OutstandingCost, buffer.Capacity() + other.Capacity());
+}
+
+TEST(BufferPoolTests, MovedLeasesAreReturnedOnce)
+{
+    BufferPool pool;
+    auto buffer = pool.Acquire(5000);
+    auto moved = std::move(buffer);
+    EXPECT_TRUE(buffer.Empty());
+    EXPECT_EQ(buffer.Size(), 0u);
+    EXPECT_FALSE(moved.Empty());
+
+    PooledBuffer assigned;
+    assigned = std::move(moved);
+    EXPECT_FALSE(assigned.Empty());
+
+    // Assigning over a lease returns it
+    assigned = pool.Acquire(5000);
+    auto statistics = pool.Statistics();
+    EXPECT_EQ(statistics.Allocations, 2u);
+    EXPECT_EQ(statistics.IdleCost, BufferPool::ClassSize(5000));
+
+    assigned.Release();
+    assigned.Release();
+    statistics = pool.Statistics();
+    EXPECT_EQ(statistics.OutstandingCost, 0u);
+    EXPECT_EQ(statistics.IdleCost, 2 * BufferPool::ClassSize(5000));
+}
+
+TEST(BufferPoolTests, LeasesCanOutliveThePool)
+{
+    PooledBuffer buffer;
+    {
+        BufferPool pool;
+        buffer = pool.Acquire(4096);
+    }
+    memset(buffer.Data(), 0, buffer.Size());
+    buffer.Release();
+    EXPECT_TRUE(buffer.Empty());
+}
+
+TEST(BufferPoolTests, IdleBuffersStayWithinBudget)
+{
+    BufferPool pool(3 * 8192);
+    std::vector<PooledBuffer> buffers;
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        buffers.push_back(pool.Acquire(8192));
+    }
+    buffers.clear();
+
+    auto statistics = pool.Statistics();
+    EXPECT_EQ(statistics.IdleCost, 3u * 8192);
+    EXPECT_EQ(statistics.Discards, 2u);
+
+    pool.Trim();
+    pool.Trim();
+    EXPECT_EQ(pool.Statistics().IdleCost, 0u);
+}
@@ -0,0 +1,49 @@
+#include "pch.h"
+#include "Checksums.h"
+#include "TestHarness.h"
+#include <random>
+#include <zlib.h>
+
+static std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::vector<uint8_t> data(size);
+    for (auto& value : data)
+    {
+        value = static_cast<uint8_t>(random());
+    }
+    return data;
+}
+
+TEST(ChecksumsTests, MatchZlib)
+{
+    // Long enough for the blocked Adler-32 loop, odd for the tail
+    auto data = RandomBytes(100003, 1);
+    EXPECT_EQ(Crc32(0, data.data(), data.size()), crc32(0, data.data(), static_cast<uInt>(data.size())));
+    EXPECT_EQ(Adler32(1, data.data(), data.size()), adler32(1, data.data(), static_cast<uInt>(data.size())));
+    EXPECT_EQ(Crc32(0, nullptr, 0), 0u);
+    EXPECT_EQ(Adler32(1, nullptr, 0), 1u);
+}
+
+TEST(ChecksumsTests, ContinueAcrossCalls)
+{
+    auto data = RandomBytes(70000, 2);
+    EXPECT_EQ(Crc32(Crc32(0, data.data(), 12345), data.data() + 12345, data.size() - 12345), Crc32(0, data.data(), data.size()));
+    EXPECT_EQ(Adler32(Adler32(1, data.data(), 12345), data.data() + 12345, data.size() - 12345), Adler32(1, data.data(), data.size()));
+}
+
+TEST(ChecksumsTests, AdlerCombineMatchesOnePass)
+{
+    // All 0xFF bytes push both sums as high as they go before each modulo
+    auto data = RandomBytes(200000, 3);
+    std::vector<uint8_t> saturated(200000, 0xFF);
+    for (auto* buffer : { &data, &saturated })
+    {
+        for (size_t split : { size_t(0), size_t(1), size_t(65521), size_t(100000), buffer->size() })
+        {
+            auto first = Adler32(1, buffer->data(), split);
+            auto second = Adler32(1, buffer->data() + split, buffer->size() - split);
+            EXPECT_EQ(Adler32Combine(first, second, buffer->size() - split), Adler32(1, buffer->data(), buffer->size())) << "split at " << split;
+        }
+    }
+}
@@ -0,0 +1,612 @@
+#include "pch.h"
+#include "ColorConverter.h"
+#include "Checksums.h"
+#include "TestHarness.h"
+#include <random>
+
+static const TransferFunction Transfers[] = { TransferFunction::Linear, TransferFunction::Srgb, TransferFunction::Bt709, TransferFunction::Bt1886 };
+static const ColorPrimaries Primaries[] = { ColorPrimaries::Bt709, ColorPrimaries::DisplayP3, ColorPrimaries::Bt2020 };
+
+// The curves as their specifications write them
+static double ReferenceDecode(TransferFunction transfer, double signal)
+{
+    switch (transfer)
+    {
+    case TransferFunction::Srgb:
+        return signal <= 0.04045 ? signal / 12.92 : std::pow((signal + 0.055) / 1.055, 2.4);
+    case TransferFunction::Bt709:
+        return signal < 0.081 ? signal / 4.5 : std::pow((signal + 0.099) / 1.099, 1.0 / 0.45);
+    case TransferFunction::Bt1886:
+        return std::pow(signal, 2.4);
+    default:
+        return signal;
+    }
+}
+
+static double ReferenceEncode(TransferFunction transfer, double linear)
+{
+    switch (transfer)
+    {
+    case TransferFunction::Srgb:
+        return linear <= 0.0031308 ? linear * 12.92 : (1.055 * std::pow(linear, 1.0 / 2.4)) - 0.055;
+    case TransferFunction::Bt709:
+        return linear < 0.018 ? linear * 4.5 : (1.099 * std::pow(linear, 0.45)) - 0.099;
+    case TransferFunction::Bt1886:
+        return std::pow(linear, 1.0 / 2.4);
+    default:
+        return linear;
+    }
+}
+
+static uint32_t ReferenceUnpremultiply(uint32_t value, uint32_t alpha)
+{
+    return std::min(static_cast<uint32_t>(std::lround(value * 255.0 / alpha)), 255u);
+}
+
+static uint8_t ReferencePremultiply(uint32_t value, uint32_t alpha)
+{
+    return static_cast<uint8_t>(std::lround(value * alpha / 255.0));
+}
+
+// Decode, change primaries and encode in double precision, for an
+// unpremultiplied RGB color. The result is in levels, not yet rounded.
+static std::array<double, 3> ReferenceParametric(ColorSpace const& source, ColorSpace const& dest, std::array<uint32_t, 3> const& rgb)
+{
+    auto matrix = ConversionMatrix(source.Primaries, dest.Primaries);
+    double linear[3] = {};
+    for (size_t c = 0; c < 3; c++)
+    {
+        linear[c] = ReferenceDecode(source.Transfer, rgb[c] / 255.0);
+    }
+    std::array<double, 3> result = {};
+    for (size_t row = 0; row < 3; row++)
+    {
+        auto value = (matrix[row * 3] * linear[0]) + (matrix[(row * 3) + 1] * linear[1]) + (matrix[(row * 3) + 2] * linear[2]);
+        value = std::clamp(value, 0.0, 1.0);
+        result[row] = ReferenceEncode(dest.Transfer, value) * 255.0;
+    }
+    return result;
+}
+
+// Splits the cell into six tetrahedra by sorting the fractions, and
+// walks from the cell's first corner to its last one channel at a time
+static std::array<double, 3> ReferenceTetrahedral(CubeLut const& lut, std::array<uint32_t, 3> const& rgb)
+{
+    auto size = lut.Size;
+    std::array<uint32_t, 3> cell = {};
+    std::array<double, 3> fractions = {};
+    for (size_t c = 0; c < 3; c++)
+    {
+        auto position = std::clamp(((rgb[c] / 255.0) - lut.DomainMin[c]) / (lut.DomainMax[c] - lut.DomainMin[c]), 0.0, 1.0) * (size - 1);
+        cell[c] = std::min(static_cast<uint32_t>(position), size - 2);
+        fractions[c] = position - cell[c];
+    }
+    auto entry = [&](std::array<uint32_t, 3> const& corner, size_t channel)
+    {
+        auto index = corner[0] + (static_cast<size_t>(corner[1]) * size) + (static_cast<size_t>(corner[2]) * size * size);
+        return static_cast<double>(lut.Entries[(index * 3) + channel]);
+    };
+
+    std::array<size_t, 3> order = { 0, 1, 2 };
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fractions[a] > fractions[b]; });
+    std::array<double, 3> result = {};
+    for (size_t channel = 0; channel < 3; channel++)
+    {
+        auto corner = cell;
+        auto previous = 1.0;
+        for (size_t step = 0; step < 3; step++)
+        {
+            auto fraction = fractions[order[step]];
+            result[channel] += (previous - fraction) * entry(corner, channel);
+            previous = fraction;
+            corner[order[step]]++;
+        }
+        result[channel] += previous * entry(corner, channel);
+    }
+    return result;
+}
+
+// The lattice of a LUT that maps every color through a function
+static std::string CubeText(uint32_t size, std::function<std::array<double, 3>(double, double, double)> const& function)
+{
+    std::ostringstream text;
+    text << "# Generated\nTITLE \"Test\"\nLUT_3D_SIZE " << size << "\n";
+    for (uint32_t b = 0; b < size; b++)
+    {
+        for (uint32_t g = 0; g < size; g++)
+        {
+            for (uint32_t r = 0; r < size; r++)
+            {
+                auto color = function(r / (size - 1.0), g / (size - 1.0), b / (size - 1.0));
+                text << color[0] << " " << color[1] << " " << color[2] << "\n";
+            }
+        }
+    }
+    return text.str();
+}
+
+// Valid premultiplied BGRA, with some opaque and some transparent
+static std::vector<uint8_t> RandomPixels(size_t count, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::vector<uint8_t> pixels(count * 4);
+    for (size_t i = 0; i < count; i++)
+    {
+        auto pixel = pixels.data() + (i * 4);
+        auto choice = random() % 4;
+        uint32_t alpha = choice == 0 ? 255 : choice == 1 ? 0 : random() % 256;
+        for (size_t c = 0; c < 3; c++)
+        {
+            pixel[c] = static_cast<uint8_t>(random() % (alpha + 1));
+        }
+        pixel[3] = static_cast<uint8_t>(alpha);
+    }
+    return pixels;
+}
+
+static std::vector<uint8_t> Convert(ColorConverter const& converter, std::vector<uint8_t> const& pixels)
+{
+    std::vector<uint8_t> result(pixels.size(), 0xEE);
+    auto width = static_cast<uint32_t>(pixels.size() / 4);
+    converter.Apply(pixels.data(), width * 4, result.data(), width * 4, width, 1);
+    return result;
+}
+
+static std::string Describe(ColorSpace const& source, ColorSpace const& dest)
+{
+    return std::string(ToString(source.Primaries)) + "/" + ToString(source.Transfer) + " to " + ToString(dest.Primaries) + "/" + ToString(dest.Transfer);
+}
+
+TEST(ColorConverterTests, TransfersMatchTheirDefinitions)
+{
+    for (auto transfer : Transfers)
+    {
+        for (uint32_t i = 0; i <= 1000; i++)
+        {
+            auto value = i / 1000.0;
+            EXPECT_NEAR(DecodeTransfer(transfer, value), ReferenceDecode(transfer, value), 1e-12) << ToString(transfer) << " " << value;
+            EXPECT_NEAR(EncodeTransfer(transfer, value), ReferenceEncode(transfer, value), 1e-12) << ToString(transfer) << " " << value;
+            // The two pieces of the BT.709 curve don't quite meet at the
+            // break, so a round trip there is a little out
+            EXPECT_NEAR(EncodeTransfer(transfer, DecodeTransfer(transfer, value)), value, 1e-3) << ToString(transfer) << " " << value;
+        }
+        // Out of range values are clipped
+        EXPECT_EQ(DecodeTransfer(transfer, -0.5), 0.0);
+        EXPECT_NEAR(EncodeTransfer(transfer, 2.0), 1.0, 1e-12);
+    }
+    EXPECT_NEAR(EncodeTransfer(TransferFunction::Srgb, 0.18), 0.461356, 1e-5);
+    EXPECT_NEAR(DecodeTransfer(TransferFunction::Bt709, 0.5), 0.259589, 1e-5);
+}
+
+TEST(ColorConverterTests, PrimariesMatchPublishedMatrices)
+{
+    // BT.709 to BT.2020, from BT.2087
+    auto matrix = ConversionMatrix(ColorPrimaries::Bt709, ColorPrimaries::Bt2020);
+    const double bt2087[] = { 0.6274, 0.3293, 0.0433, 0.0691, 0.9195, 0.0114, 0.0164, 0.0880, 0.8956 };
+    for (size_t i = 0; i < 9; i++)
+    {
+        EXPECT_NEAR(matrix[i], bt2087[i], 1e-4) << "entry " << i;
+    }
+    // White stays white, and there and back again is the identity
+    for (auto from : Primaries)
+    {
+        for (auto to : Primaries)
+        {
+            auto there = ConversionMatrix(from, to);
+            auto back = ConversionMatrix(to, from);
+            for (size_t row = 0; row < 3; row++)
+            {
+                EXPECT_NEAR(there[row * 3] + there[(row * 3) + 1] + there[(row * 3) + 2], 1.0, 1e-12);
+                for (size_t column = 0; column < 3; column++)
+                {
+                    double product = 0.0;
+                    for (size_t k = 0; k < 3; k++)
+                    {
+                        product += back[(row * 3) + k] * there[(k * 3) + column];
+                    }
+                    EXPECT_NEAR(product, row == column ? 1.0 : 0.0, 1e-12);
+                }
+            }
+        }
+    }
+}
+
+TEST(ColorConverterTests, ParametricMatchesDoublePrecision)
+{
+    // Every level of each channel on its own, and random colors, between
+    // every pair of color spaces
+    std::vector<std::array<uint32_t, 3>> colors;
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        colors.push_back({ i, i, i });
+        colors.push_back({ i, 0, 0 });
+        colors.push_back({ 0, i, 0 });
+        colors.push_back({ 0, 0, i });
+    }
+    std::mt19937 random(1);
+    std::uniform_int_distribution<uint32_t> level(0, 255);
+    for (size_t i = 0; i < 1000; i++)
+    {
+        colors.push_back({ level(random), level(random), level(random) });
+    }
+    std::vector<uint8_t> pixels;
+    for (auto& color : colors)
+    {
+        pixels.insert(pixels.end(), { static_cast<uint8_t>(color[2]), static_cast<uint8_t>(color[1]), static_cast<uint8_t>(color[0]), 255 });
+    }
+
+    for (auto sourcePrimaries : Primaries)
+    {
+        for (auto sourceTransfer : Transfers)
+        {
+            for (auto destPrimaries : Primaries)
+            {
+                for (auto destTransfer : Transfers)
+                {
+                    ColorSpace source = { sourcePrimaries, sourceTransfer };
+                    ColorSpace dest = { destPrimaries, destTransfer };
+                    auto converter = ColorConverter::CreateParametric(source, dest);
+                    EXPECT_EQ(converter->IsIdentity(), source == dest);
+                    auto converted = Convert(*converter, pixels);
+                    for (size_t i = 0; i < colors.size(); i++)
+                    {
+                        auto expected = ReferenceParametric(source, dest, colors[i]);
+                        for (size_t c = 0; c < 3; c++)
+                        {
+                            // The nearest level, unless the exact value is
+                            // all but halfway and the float math lands on
+                            // the other side
+                            auto actual = converted[(i * 4) + 2 - c];
+                            EXPECT_LE(std::abs(actual - expected[c]), 0.5 + 1e-3) << Describe(source, dest) << ", color " << i << ", channel " << c;
+                        }
+                        EXPECT_EQ(converted[(i * 4) + 3], 255);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(ColorConverterTests, TetrahedralMatchesDoublePrecision)
+{
+    // Entries all over the place, some outside 0-1, and a domain that
+    // doesn't start at 0
+    CubeLut lut;
+    lut.Size = 5;
+    lut.DomainMin = { 0.1f, 0.0f, -0.2f };
+    lut.DomainMax = { 0.9f, 1.0f, 1.0f };
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> distribution(-0.2f, 1.2f);
+    std::uniform_int_distribution<uint32_t> level(0, 255);
+    for (size_t i = 0; i < 5 * 5 * 5 * 3; i++)
+    {
+        lut.Entries.push_back(distribution(random));
+    }
+    auto converter = ColorConverter::CreateFromCube(lut, "random");
+    EXPECT_FALSE(converter->IsIdentity());
+
+    std::vector<std::array<uint32_t, 3>> colors;
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        colors.push_back({ i, i, i });
+        colors.push_back({ i, 255 - i, (i * 7) % 256 });
+    }
+    for (size_t i = 0; i < 20000; i++)
+    {
+        colors.push_back({ level(random), level(random), level(random) });
+    }
+    std::vector<uint8_t> pixels;
+    for (auto& color : colors)
+    {
+        pixels.insert(pixels.end(), { static_cast<uint8_t>(color[2]), static_cast<uint8_t>(color[1]), static_cast<uint8_t>(color[0]), 255 });
+    }
+
+    auto converted = Convert(*converter, pixels);
+    for (size_t i = 0; i < colors.size(); i++)
+    {
+        auto expected = ReferenceTetrahedral(lut, colors[i]);
+        for (size_t c = 0; c < 3; c++)
+        {
+            auto exact = std::clamp(expected[c], 0.0, 1.0) * 255.0;
+            auto actual = converted[(i * 4) + 2 - c];
+            // Within a rounding of the exact value
+            EXPECT_LE(std::abs(actual - exact), 0.5 + 1e-3) << "color " << i << ", channel " << c;
+        }
+    }
+}
+
+TEST(ColorConverterTests, LinearLutsAreExact)
+{
+    // Tetrahedral interpolation reproduces anything linear in the input,
+    // here swapping the channels around and inverting one
+    auto text = CubeText(9, [](double r, double g, double b) { return std::array<double, 3> { g, b, 1.0 - r }; });
+    auto converter = ColorConverter::CreateFromCube(CubeLut::Parse(text), "rotate");
+    std::vector<uint8_t> pixels;
+    std::vector<std::array<uint8_t, 3>> expected;
+    std::mt19937 random(3);
+    for (size_t i = 0; i < 10000; i++)
+    {
+        auto r = static_cast<uint8_t>(random());
+        auto g = static_cast<uint8_t>(random());
+        auto b = static_cast<uint8_t>(random());
+        pixels.insert(pixels.end(), { b, g, r, 255 });
+        expected.push_back({ g, b, static_cast<uint8_t>(255 - r) });
+    }
+    auto converted = Convert(*converter, pixels);
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        for (size_t c = 0; c < 3; c++)
+        {
+            EXPECT_EQ(converted[(i * 4) + 2 - c], expected[i][c]) << "color " << i << ", channel " << c;
+        }
+    }
+}
+
+TEST(ColorConverterTests, IdentityCubesLeavePixelsAlone)
+{
+    auto identity = [](double r, double g, double b) { return std::array<double, 3> { r, g, b }; };
+    for (uint32_t size : { 2u, 17u, 33u })
+    {
+        auto converter = ColorConverter::CreateFromCube(CubeLut::Parse(CubeText(size, identity)), "identity");
+        // Goes through the LUT, it isn't recognized as doing nothing
+        EXPECT_FALSE(converter->IsIdentity());
+        auto pixels = RandomPixels(20000, size);
+        auto converted = Convert(*converter, pixels);
+        for (size_t i = 0; i < pixels.size(); i++)
+        {
+            EXPECT_EQ(converted[i], pixels[i]) << "size " << size << ", byte " << i;
+        }
+    }
+}
+
+TEST(ColorConverterTests, CubeFilesParse)
+{
+    auto lut = CubeLut::Parse(
+        "# A comment\r\n"
+        "TITLE \"Warm\"\r\n"
+        "\r\n"
+        "LUT_3D_SIZE 2\r\n"
+        "DOMAIN_MIN 0 0.1 0\r\n"
+        "DOMAIN_MAX 1 0.9 2\r\n"
+        "VENDOR_KEYWORD whatever\r\n"
+        "0 0 0\r\n 1 0 0\r\n0 1 0\r\n1 1 0\r\n"
+        "0 0 1\r\n1 0 1\r\n0 1 1\r\n1e0 1.0 0.5\r\n");
+    EXPECT_EQ(lut.Title, "Warm");
+    EXPECT_EQ(lut.Size, 2u);
+    EXPECT_EQ(lut.DomainMin[1], 0.1f);
+    EXPECT_EQ(lut.DomainMax[2], 2.0f);
+    ASSERT_EQ(lut.Entries.size(), 24u);
+    EXPECT_EQ(lut.Entries[3], 1.0f);
+    EXPECT_EQ(lut.Entries[23], 0.5f);
+
+    // Resolve's input range, and no newline at the end
+    auto resolve = CubeLut::Parse("LUT_3D_SIZE 2\nLUT_3D_INPUT_RANGE -0.5 1.5\n0 0 0\n1 0 0\n0 1 0\n1 1 0\n0 0 1\n1 0 1\n0 1 1\n1 1 1");
+    EXPECT_EQ(resolve.DomainMin[0], -0.5f);
+    EXPECT_EQ(resolve.DomainMax[2], 1.5f);
+}
+
+TEST(ColorConverterTests, MalformedCubeFilesThrow)
+{
+    const std::string entries8 = "0 0 0\n1 0 0\n0 1 0\n1 1 0\n0 0 1\n1 0 1\n0 1 1\n1 1 1\n";
+    const std::string malformed[] =
+    {
+        // Bad LUT_3D_SIZE
+        "LUT_3D_SIZE 1\n0 0 0\n",
+        "LUT_3D_SIZE 257\n" + entries8,
+        "LUT_3D_SIZE 2.5\n" + entries8,
+        "LUT_3D_SIZE two\n" + entries8,
+        "LUT_3D_SIZE\n" + entries8,
+        "LUT_3D_SIZE 2 2\n" + entries8,
+        // The wrong number of entries
+        "LUT_3D_SIZE 2\n" + entries8.substr(0, entries8.size() - 6),
+        "LUT_3D_SIZE 2\n" + entries8 + "1 1 1\n",
+        "LUT_3D_SIZE 3\n" + entries8,
+        "",
+        entries8,
+        // Bad entries
+        "LUT_3D_SIZE 2\n" + entries8.substr(0, entries8.size() - 6) + "1 1\n",
+        "LUT_3D_SIZE 2\n" + entries8.substr(0, entries8.size() - 6) + "1 1 1 1\n",
+        "LUT_3D_SIZE 2\n" + entries8.substr(0, entries8.size() - 6) + "1 1 x\n",
+        // Keywords after the data, 1D LUTs and backwards domains
+        "LUT_3D_SIZE 2\n0 0 0\nTITLE \"Late\"\n" + entries8.substr(6),
+        "LUT_1D_SIZE 2\n0 0 0\n1 1 1\n",
+        "LUT_3D_SIZE 2\nDOMAIN_MIN 0 1 0\nDOMAIN_MAX 1 1 1\n" + entries8,
+        "LUT_3D_SIZE 2\nDOMAIN_MIN 0 0\n" + entries8,
+    };
+    for (auto& text : malformed)
+    {
+        EXPECT_THROW(CubeLut::Parse(text), std::invalid_argument) << text;
+    }
+
+    // Errors on a line say which one
+    try
+    {
+        CubeLut::Parse("# Size\n\nLUT_3D_SIZE 300\n");
+        ADD_FAILURE() << "expected a parse error";
+    }
+    catch (std::invalid_argument const& error)
+    {
+        EXPECT_EQ(std::string(error.what()).rfind("Line 3 ", 0), 0u) << error.what();
+    }
+
+    // A LUT built by hand is checked too
+    CubeLut short3;
+    short3.Size = 3;
+    short3.Entries.resize(26 * 3);
+    EXPECT_THROW(ColorConverter::CreateFromCube(short3, "short"), std::invalid_argument);
+    CubeLut tiny;
+    tiny.Size = 1;
+    tiny.Entries.resize(3);
+    EXPECT_THROW(ColorConverter::CreateFromCube(tiny, "tiny"), std::invalid_argument);
+}
+
+TEST(ColorConverterTests, PremultipliedColorsAreConvertedUnpremultiplied)
+{
+    ColorSpace source = { ColorPrimaries::DisplayP3, TransferFunction::Srgb };
+    ColorSpace dest = { ColorPrimaries::Bt709, TransferFunction::Bt1886 };
+    auto converter = ColorConverter::CreateParametric(source, dest);
+    auto pixels = RandomPixels(20000, 4);
+    auto converted = Convert(*converter, pixels);
+    for (size_t i = 0; i < pixels.size(); i += 4)
+    {
+        uint32_t alpha = pixels[i + 3];
+        EXPECT_EQ(converted[i + 3], alpha);
+        if (alpha == 0)
+        {
+            // Transparent black stays transparent black
+            EXPECT_EQ(converted[i] | converted[i + 1] | converted[i + 2], 0) << "pixel " << i / 4;
+            continue;
+        }
+        std::array<uint32_t, 3> rgb = {};
+        for (size_t c = 0; c < 3; c++)
+        {
+            rgb[c] = ReferenceUnpremultiply(pixels[i + 2 - c], alpha);
+        }
+        auto expected = ReferenceParametric(source, dest, rgb);
+        for (size_t c = 0; c < 3; c++)
+        {
+            auto actual = converted[i + 2 - c];
+            // Never more than a level out, and still premultiplied
+            EXPECT_LE(std::abs(actual - ReferencePremultiply(static_cast<uint32_t>(std::lround(expected[c])), alpha)), 1) << "pixel " << i / 4 << ", channel " << c;
+            EXPECT_LE(actual, alpha) << "pixel " << i / 4 << ", channel " << c;
+        }
+    }
+
+    // In place, on a rectangle of a larger image, and the same as a copy
+    const uint32_t width = 300;
+    const uint32_t height = 250;
+    const uint32_t stride = (width + 20) * 4;
+    std::vector<uint8_t> image(static_cast<size_t>(stride) * height, 0xEE);
+    auto random = RandomPixels(static_cast<size_t>(width) * height, 5);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        std::copy_n(random.data() + (static_cast<size_t>(y) * width * 4), width * 4, image.data() + (static_cast<size_t>(y) * stride));
+    }
+    std::vector<uint8_t> copy(static_cast<size_t>(width) * height * 4);
+    converter->Apply(image.data(), stride, copy.data(), width * 4, width, height);
+    converter->Apply(image.data(), stride, image.data(), stride, width, height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < stride; x++)
+        {
+            auto actual = image[(static_cast<size_t>(y) * stride) + x];
+            auto expected = x < width * 4 ? copy[(static_cast<size_t>(y) * width * 4) + x] : 0xEE;
+            EXPECT_EQ(actual, expected) << x << ", " << y;
+        }
+    }
+}
+
+TEST(ColorConverterTests, IdentityConversionsCopy)
+{
+    ColorSpace space = { ColorPrimaries::Bt2020, TransferFunction::Bt709 };
+    auto converter = ColorConverter::CreateParametric(space, space);
+    EXPECT_TRUE(converter->IsIdentity());
+    // Even pixels that aren't validly premultiplied come through as they were
+    std::vector<uint8_t> pixels(4096);
+    std::mt19937 random(6);
+    for (auto& value : pixels)
+    {
+        value = static_cast<uint8_t>(random());
+    }
+    EXPECT_TRUE(Convert(*converter, pixels) == pixels);
+}
+
+TEST(ColorConverterTests, CachesKeyEachTransform)
+{
+    ColorConverterCache cache(3);
+    ColorSpace srgb;
+    ColorSpace p3 = { ColorPrimaries::DisplayP3, TransferFunction::Srgb };
+    ColorSpace linear2020 = { ColorPrimaries::Bt2020, TransferFunction::Linear };
+
+    auto srgbToP3 = cache.GetParametric(srgb, p3);
+    EXPECT_EQ(srgbToP3->Key(), "parametric:bt709/srgb>p3/srgb");
+    EXPECT_TRUE(cache.GetParametric(srgb, p3) == srgbToP3);
+    // Direction matters
+    auto p3ToSrgb = cache.GetParametric(p3, srgb);
+    EXPECT_EQ(p3ToSrgb->Key(), "parametric:p3/srgb>bt709/srgb");
+    EXPECT_TRUE(p3ToSrgb != srgbToP3);
+    EXPECT_EQ(cache.Count(), 2u);
+
+    // The same text is parsed once, and other text is another transform
+    auto identity = CubeText(2, [](double r, double g, double b) { return std::array<double, 3> { r, g, b }; });
+    auto cube = cache.GetCube(identity);
+    EXPECT_EQ(cube->Key().rfind("cube:", 0), 0u) << cube->Key();
+    EXPECT_TRUE(cache.GetCube(std::string(identity)) == cube);
+    EXPECT_EQ(cache.Count(), 3u);
+    EXPECT_THROW(cache.GetCube("LUT_3D_SIZE 2\n"), std::invalid_argument);
+    EXPECT_EQ(cache.Count(), 3u);
+
+    // Least recently used goes first, and a caller's reference outlives it
+    EXPECT_TRUE(cache.GetParametric(srgb, p3) == srgbToP3);
+    auto other = cache.GetParametric(srgb, linear2020);
+    EXPECT_EQ(cache.Count(), 3u);
+    EXPECT_TRUE(cache.GetParametric(srgb, p3) == srgbToP3);
+    EXPECT_TRUE(cache.GetCube(identity) == cube);
+    auto rebuilt = cache.GetParametric(p3, srgb);
+    EXPECT_TRUE(rebuilt != p3ToSrgb);
+    EXPECT_EQ(rebuilt->Key(), p3ToSrgb->Key());
+    EXPECT_EQ(p3ToSrgb->Key(), "parametric:p3/srgb>bt709/srgb");
+    EXPECT_EQ(cache.Count(), 3u);
+}
+
+TEST(ColorConverterTests, CacheTellsApartCubesWhoseKeysCollide)
+{
+    // Two transforms whose text is the same length, with comments picked
+    // so that the checksums match. The comments are random, counting
+    // through them only varies a few bits of each character.
+    auto identity = CubeText(2, [](double r, double g, double b) { return std::array<double, 3> { r, g, b }; });
+    auto swapped = CubeText(2, [](double r, double g, double b) { return std::array<double, 3> { b, g, r }; });
+    ASSERT_EQ(identity.size(), swapped.size());
+    auto checksum = [](std::string const& text)
+    {
+        return Crc32(0, reinterpret_cast<uint8_t const*>(text.data()), text.size());
+    };
+    std::mt19937 random(7);
+    std::vector<std::string> comments;
+    std::unordered_map<uint32_t, size_t> identityChecksums;
+    std::unordered_map<uint32_t, size_t> swappedChecksums;
+    std::string first;
+    std::string second;
+    for (size_t i = 0; first.empty() && i < (1 << 22); i++)
+    {
+        std::string comment = "# ";
+        for (size_t j = 0; j < 8; j++)
+        {
+            comment.push_back(static_cast<char>(' ' + (random() % 95)));
+        }
+        comment.push_back('\n');
+        comments.push_back(comment);
+
+        auto identityChecksum = checksum(comment + identity);
+        auto swappedChecksum = checksum(comment + swapped);
+        if (auto found = swappedChecksums.find(identityChecksum); found != swappedChecksums.end())
+        {
+            first = comments[found->second] + swapped;
+            second = comment + identity;
+        }
+        else if (auto found = identityChecksums.find(swappedChecksum); found != identityChecksums.end())
+        {
+            first = comments[found->second] + identity;
+            second = comment + swapped;
+        }
+        identityChecksums.emplace(identityChecksum, i);
+        swappedChecksums.emplace(swappedChecksum, i);
+    }
+    ASSERT_FALSE(first.empty());
+    ASSERT_EQ(checksum(first), checksum(second));
+    ASSERT_EQ(first.size(), second.size());
+
+    ColorConverterCache cache;
+    auto cached = cache.GetCube(first);
+    auto colliding = cache.GetCube(second);
+    EXPECT_TRUE(colliding != cached);
+    EXPECT_TRUE(cache.GetCube(first) == cached);
+    EXPECT_EQ(cache.Count(), 1u);
+
+    // Opaque red goes through each transform as its own
+    std::vector<uint8_t> red = { 0, 0, 255, 255 };
+    std::vector<uint8_t> blue = { 255, 0, 0, 255 };
+    auto firstIsIdentity = first.find(identity) != std::string::npos;
+    EXPECT_TRUE(Convert(*cached, red) == (firstIsIdentity ? red : blue));
+    EXPECT_TRUE(Convert(*colliding, red) == (firstIsIdentity ? blue : red));
+}
@@ -0,0 +1,149 @@
+#include "pch.h"
+#include "DeflateEncoder.h"
+#include "TestHarness.h"
+#include <random>
+#include <zlib.h>
+
+// Inflates a raw deflate stream with zlib. Returns nothing if it isn't
+// one complete, valid stream.
+static std::optional<std::vector<uint8_t>> Inflate(std::vector<uint8_t> const& compressed, size_t expectedSize)
+{
+    std::vector<uint8_t> output(expectedSize + 1);
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+    {
+        return std::nullopt;
+    }
+    stream.next_in = const_cast<Bytef*>(compressed.data());
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    stream.next_out = output.data();
+    stream.avail_out = static_cast<uInt>(output.size());
+    auto result = inflate(&stream, Z_FINISH);
+    auto consumedAll = stream.avail_in == 0;
+    output.resize(stream.total_out);
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END || !consumedAll)
+    {
+        return std::nullopt;
+    }
+    return output;
+}
+
+// Runs of random bytes, zeros and slow ramps, so every level finds both
+// matches and literals
+static std::vector<uint8_t> MixedData(size_t size, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        data[i] = (i / 1000) % 3 == 0 ? static_cast<uint8_t>(random()) : (i % 97) < 50 ? 0 : static_cast<uint8_t>(i / 7);
+    }
+    return data;
+}
+
+// Compresses data as pieces split at the given offsets, each allowed to
+// reference the window before it
+static std::vector<uint8_t> CompressPieces(std::vector<uint8_t> const& data, std::vector<size_t> const& splits, uint32_t level)
+{
+    DeflateEncoder encoder(level);
+    std::vector<uint8_t> output;
+    size_t begin = 0;
+    for (size_t piece = 0; piece <= splits.size(); piece++)
+    {
+        auto end = piece < splits.size() ? splits[piece] : data.size();
+        encoder.Compress(data.data() + begin, end - begin, std::min(begin, DeflateEncoder::WindowSize), piece == splits.size(), output);
+        begin = end;
+    }
+    return output;
+}
+
+TEST(DeflateEncoderTests, RoundTripsAtEveryLevel)
+{
+    auto data = MixedData(300000, 1);
+    for (uint32_t level = 0; level <= DeflateEncoder::MaxLevel; level++)
+    {
+        auto compressed = CompressPieces(data, {}, level);
+        auto inflated = Inflate(compressed, data.size());
+        ASSERT_TRUE(inflated.has_value()) << "level " << level;
+        EXPECT_TRUE(*inflated == data) << "level " << level;
+    }
+}
+
+TEST(DeflateEncoderTests, PiecesReferencingTheWindowJoinIntoOneStream)
+{
+    // Includes an empty piece, a one byte piece and pieces shorter and
+    // longer than the window
+    auto data = MixedData(300000, 2);
+    std::vector<size_t> splits = { 0, 1, 70000, 70003, 90000, 200000 };
+    for (uint32_t level = 0; level <= DeflateEncoder::MaxLevel; level++)
+    {
+        auto compressed = CompressPieces(data, splits, level);
+        auto inflated = Inflate(compressed, data.size());
+        ASSERT_TRUE(inflated.has_value()) << "level " << level;
+        EXPECT_TRUE(*inflated == data) << "level " << level;
+    }
+}
+
+TEST(DeflateEncoderTests, MatchesReachIntoTheDictionary)
+{
+    // The second piece repeats the first, so it should shrink to a few
+    // long matches
+    auto block = MixedData(20000, 3);
+    std::vector<uint8_t> data(block);
+    data.insert(data.end(), block.begin(), block.end());
+
+    DeflateEncoder encoder(DeflateEncoder::MaxLevel);
+    std::vector<uint8_t> first;
+    encoder.Compress(data.data(), block.size(), 0, false, first);
+    std::vector<uint8_t> second;
+    encoder.Compress(data.data() + block.size(), block.size(), block.size(), true, second);
+    EXPECT_LT(second.size(), first.size() / 20);
+
+    auto joined = first;
+    joined.insert(joined.end(), second.begin(), second.end());
+    auto inflated = Inflate(joined, data.size());
+    ASSERT_TRUE(inflated.has_value());
+    EXPECT_TRUE(*inflated == data);
+}
+
+TEST(DeflateEncoderTests, EmptyInputIsAValidStream)
+{
+    for (uint32_t level : { 0u, 1u, 6u, 9u })
+    {
+        DeflateEncoder encoder(level);
+        std::vector<uint8_t> output;
+        encoder.Compress(nullptr, 0, 0, true, output);
+        auto inflated = Inflate(output, 0);
+        ASSERT_TRUE(inflated.has_value()) << "level " << level;
+        EXPECT_TRUE(inflated->empty());
+    }
+}
+
+TEST(DeflateEncoderTests, CompressesAboutAsWellAsZlib)
+{
+    auto data = MixedData(1 << 20, 4);
+    for (uint32_t level : { 1u, 6u, 9u })
+    {
+        auto compressed = CompressPieces(data, {}, level);
+        uLongf zlibSize = compressBound(static_cast<uLong>(data.size()));
+        std::vector<uint8_t> zlibOutput(zlibSize);
+        ASSERT_EQ(compress2(zlibOutput.data(), &zlibSize, data.data(), static_cast<uLong>(data.size()), static_cast<int>(level)), Z_OK);
+        EXPECT_LT(compressed.size(), zlibSize + (zlibSize / 10)) << "level " << level;
+    }
+}
+
+TEST(DeflateEncoderTests, LevelZeroStoresTheData)
+{
+    auto data = MixedData(200000, 5);
+    auto compressed = CompressPieces(data, { 100000 }, 0);
+    // Five bytes of header per stored block of up to 64 KB, and an empty
+    // one ending the first piece
+    EXPECT_GE(compressed.size(), data.size());
+    EXPECT_LT(compressed.size(), data.size() + 64);
+}
+
+TEST(DeflateEncoderTests, RejectsLevelsAboveNine)
+{
+    EXPECT_THROW(DeflateEncoder(10), std::invalid_argument);
+}
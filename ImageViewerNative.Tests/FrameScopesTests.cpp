@@ -0,0 +1,271 @@
+#include "pch.h"
+#include "FrameScopes.h"
+#include "BackgroundScopeAnalyzer.h"
+#include "TestHarness.h"
+#include <random>
+
+// Random colors in padded rows, with flat runs like real frames have
+struct TestFrame
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Stride;
+    std::vector<uint8_t> Pixels;
+
+    TestFrame(uint32_t width, uint32_t height, uint32_t seed) : Width(width), Height(height), Stride((width * 4) + 36), Pixels(static_cast<size_t>(Stride) * height)
+    {
+        std::mt19937 random(seed);
+        uint32_t color = 0;
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                if (random() % 4 == 0)
+                {
+                    color = random();
+                }
+                memcpy(Pixel(x, y), &color, 4);
+            }
+        }
+    }
+
+    uint8_t* Pixel(uint32_t x, uint32_t y) { return Pixels.data() + (static_cast<size_t>(y) * Stride) + (x * 4); }
+};
+
+// BT.709 Y'CbCr of full range values, rounded to the nearest level
+static void ExactYCbCr(uint8_t const* bgra, double& luma, double& cb, double& cr)
+{
+    luma = (0.2126 * bgra[2]) + (0.7152 * bgra[1]) + (0.0722 * bgra[0]);
+    cb = ((bgra[0] - luma) / 1.8556) + 128.0;
+    cr = ((bgra[2] - luma) / 1.5748) + 128.0;
+}
+
+// Counts the frame one sample at a time, the way the header describes,
+// taking the levels of each sample from the scopes of that pixel alone
+static FrameScopes ReferenceScopes(TestFrame& frame, uint32_t sampleStep)
+{
+    FrameScopes reference;
+    reference.SampledWidth = (frame.Width + sampleStep - 1) / sampleStep;
+    reference.SampledHeight = (frame.Height + sampleStep - 1) / sampleStep;
+    reference.WaveformWidth = std::min(reference.SampledWidth, FrameScopes::MaxWaveformWidth);
+    reference.Waveform.resize(static_cast<size_t>(reference.WaveformWidth) * FrameScopes::Levels);
+    reference.Vectorscope.resize(static_cast<size_t>(FrameScopes::Levels) * FrameScopes::Levels);
+
+    // The level of every color in the frame, from 1x1 frames
+    std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> levels;
+    for (uint32_t y = 0; y < reference.SampledHeight; y++)
+    {
+        for (uint32_t x = 0; x < reference.SampledWidth; x++)
+        {
+            auto pixel = frame.Pixel(x * sampleStep, y * sampleStep);
+            uint32_t color = 0;
+            memcpy(&color, pixel, 4);
+            auto found = levels.find(color);
+            if (found == levels.end())
+            {
+                auto single = ComputeScopes(pixel, 1, 1, 4, 1);
+                auto luma = single.LowestLevel(ScopeChannel::Luma);
+                auto chroma = static_cast<uint32_t>(std::find(single.Vectorscope.begin(), single.Vectorscope.end(), 1u) - single.Vectorscope.begin());
+                found = levels.emplace(color, std::make_pair(luma, chroma)).first;
+            }
+
+            auto luma = found->second.first;
+            reference.Histograms[0][luma]++;
+            reference.Histograms[1][pixel[2]]++;
+            reference.Histograms[2][pixel[1]]++;
+            reference.Histograms[3][pixel[0]]++;
+            auto column = (static_cast<uint64_t>(x) * reference.WaveformWidth) / reference.SampledWidth;
+            reference.Waveform[(static_cast<size_t>(luma) * reference.WaveformWidth) + column]++;
+            reference.Vectorscope[found->second.second]++;
+        }
+    }
+    return reference;
+}
+
+static void ExpectSameScopes(FrameScopes const& actual, FrameScopes const& expected, std::string const& description)
+{
+    EXPECT_EQ(actual.SampledWidth, expected.SampledWidth) << description;
+    EXPECT_EQ(actual.SampledHeight, expected.SampledHeight) << description;
+    EXPECT_EQ(actual.WaveformWidth, expected.WaveformWidth) << description;
+    EXPECT_TRUE(actual.Histograms == expected.Histograms) << description;
+    EXPECT_TRUE(actual.Waveform == expected.Waveform) << description;
+    EXPECT_TRUE(actual.Vectorscope == expected.Vectorscope) << description;
+}
+
+TEST(FrameScopesTests, LevelsAreBt709)
+{
+    // Every 17th level of every channel
+    std::vector<uint8_t> pixel(4, 255);
+    int32_t maxError = 0;
+    for (uint32_t r = 0; r < 256; r += 17)
+    {
+        for (uint32_t g = 0; g < 256; g += 17)
+        {
+            for (uint32_t b = 0; b < 256; b += 17)
+            {
+                pixel[0] = static_cast<uint8_t>(b);
+                pixel[1] = static_cast<uint8_t>(g);
+                pixel[2] = static_cast<uint8_t>(r);
+                auto scopes = ComputeScopes(pixel.data(), 1, 1, 4, 1);
+                auto chroma = std::find(scopes.Vectorscope.begin(), scopes.Vectorscope.end(), 1u) - scopes.Vectorscope.begin();
+                double luma, cb, cr;
+                ExactYCbCr(pixel.data(), luma, cb, cr);
+                maxError = std::max<int32_t>(maxError, std::abs(static_cast<int32_t>(scopes.LowestLevel(ScopeChannel::Luma)) - static_cast<int32_t>(std::lround(luma))));
+                maxError = std::max<int32_t>(maxError, std::abs(static_cast<int32_t>(chroma % FrameScopes::Levels) - static_cast<int32_t>(std::min(std::lround(cb), 255l))));
+                maxError = std::max<int32_t>(maxError, std::abs(static_cast<int32_t>(chroma / FrameScopes::Levels) - static_cast<int32_t>(std::min(std::lround(cr), 255l))));
+            }
+        }
+    }
+    // The 8-bit weights are off by a level at most
+    EXPECT_LE(maxError, 1);
+}
+
+TEST(FrameScopesTests, MatchesCountingEachSample)
+{
+    // Narrower and wider than the waveform, with and without sampling
+    for (auto size : { std::make_pair(37u, 23u), std::make_pair(1283u, 41u) })
+    {
+        for (uint32_t sampleStep : { 1u, 2u, 3u })
+        {
+            TestFrame frame(size.first, size.second, sampleStep);
+            auto scopes = ComputeScopes(frame.Pixels.data(), frame.Width, frame.Height, frame.Stride, sampleStep);
+            ExpectSameScopes(scopes, ReferenceScopes(frame, sampleStep), std::to_string(frame.Width) + " wide, step " + std::to_string(sampleStep));
+            EXPECT_EQ(scopes.SampleCount(), static_cast<uint64_t>(scopes.SampledWidth) * scopes.SampledHeight);
+        }
+    }
+}
+
+TEST(FrameScopesTests, ThreadCountDoesntChangeTheResult)
+{
+    TestFrame frame(1920, 30, 7);
+    auto expected = ComputeScopes(frame.Pixels.data(), frame.Width, frame.Height, frame.Stride, 1);
+    for (uint32_t workerCount : { 0u, 1u, 5u })
+    {
+        TaskScheduler scheduler(workerCount);
+        TaskScheduler::OverrideDefault(&scheduler);
+        auto scopes = ComputeScopes(frame.Pixels.data(), frame.Width, frame.Height, frame.Stride, 1);
+        TaskScheduler::OverrideDefault(nullptr);
+        ExpectSameScopes(scopes, expected, std::to_string(workerCount) + " workers");
+    }
+}
+
+TEST(FrameScopesTests, RangesShowInTheExtremes)
+{
+    // A limited range gray ramp, which would pile up at 0 and 255 if it
+    // had been expanded
+    TestFrame frame(220, 4, 1);
+    for (uint32_t y = 0; y < frame.Height; y++)
+    {
+        for (uint32_t x = 0; x < frame.Width; x++)
+        {
+            auto level = static_cast<uint8_t>(16 + ((x * 219) / (frame.Width - 1)));
+            auto pixel = frame.Pixel(x, y);
+            pixel[0] = pixel[1] = pixel[2] = level;
+            pixel[3] = 255;
+        }
+    }
+    auto scopes = ComputeScopes(frame.Pixels.data(), frame.Width, frame.Height, frame.Stride, 1);
+    for (auto channel : { ScopeChannel::Luma, ScopeChannel::Red, ScopeChannel::Green, ScopeChannel::Blue })
+    {
+        EXPECT_EQ(scopes.LowestLevel(channel), 16u);
+        EXPECT_EQ(scopes.HighestLevel(channel), 235u);
+    }
+    // Grays have no chroma
+    EXPECT_EQ(scopes.Vectorscope[(128 * FrameScopes::Levels) + 128], 220u * 4);
+}
+
+TEST(FrameScopesTests, BadArgumentsAreRejected)
+{
+    uint8_t pixel[4] = {};
+    EXPECT_THROW(ComputeScopes(pixel, 0, 1, 4, 1), std::invalid_argument);
+    EXPECT_THROW(ComputeScopes(pixel, 1, 1, 4, 0), std::invalid_argument);
+    EXPECT_THROW(BackgroundScopeAnalyzer(1, 0, 1), std::invalid_argument);
+    EXPECT_THROW(BackgroundScopeAnalyzer(1, 1, 0), std::invalid_argument);
+
+    FrameScopes empty;
+    EXPECT_EQ(empty.LowestLevel(ScopeChannel::Luma), 0u);
+    EXPECT_EQ(empty.HighestLevel(ScopeChannel::Blue), 0u);
+}
+
+TEST(FrameScopesTests, RenderedScopes)
+{
+    // Pure black and pure red halves
+    TestFrame frame(64, 8, 1);
+    for (uint32_t y = 0; y < frame.Height; y++)
+    {
+        for (uint32_t x = 0; x < frame.Width; x++)
+        {
+            uint32_t color = x < 32 ? 0xFF000000 : 0xFFFF0000;
+            memcpy(frame.Pixel(x, y), &color, 4);
+        }
+    }
+    auto scopes = ComputeScopes(frame.Pixels.data(), frame.Width, frame.Height, frame.Stride, 1);
+    auto pixelAt = [](std::vector<uint8_t> const& bgra, uint32_t width, uint32_t x, uint32_t y)
+    {
+        uint32_t pixel = 0;
+        memcpy(&pixel, bgra.data() + (((static_cast<size_t>(y) * width) + x) * 4), 4);
+        return pixel;
+    };
+
+    // Every sample has no green or blue, so those bars are the tallest,
+    // and half have no red and no luma
+    std::vector<uint8_t> histogram(static_cast<size_t>(FrameScopes::Levels) * 100 * 4);
+    RenderHistogram(scopes, histogram.data(), 100);
+    EXPECT_EQ(pixelAt(histogram, 256, 0, 0), 0xFF00A0A0u);
+    EXPECT_EQ(pixelAt(histogram, 256, 0, 99), 0xFFFFFFFFu);
+    EXPECT_EQ(pixelAt(histogram, 256, 255, 0), 0xFF000000u);
+    EXPECT_EQ(pixelAt(histogram, 256, 255, 99), 0xFFA00000u);
+    EXPECT_EQ(pixelAt(histogram, 256, 128, 99), 0xFF000000u);
+
+    // Black on the left at the bottom, red's luma (54) on the right, and
+    // the limited range guides where nothing is
+    std::vector<uint8_t> waveform(static_cast<size_t>(scopes.WaveformWidth) * FrameScopes::Levels * 4);
+    RenderWaveform(scopes, waveform.data());
+    EXPECT_EQ(pixelAt(waveform, 64, 0, 255), 0xFF7FFF7Fu);
+    EXPECT_EQ(pixelAt(waveform, 64, 63, 255), 0xFF000000u);
+    EXPECT_EQ(pixelAt(waveform, 64, 63, 255 - 54), 0xFF7FFF7Fu);
+    EXPECT_EQ(pixelAt(waveform, 64, 10, 255 - 235), 0xFF600000u);
+    EXPECT_EQ(pixelAt(waveform, 64, 10, 255 - 16), 0xFF600000u);
+
+    // Gray at the center, red at the top, left of the center, and the
+    // axes where there's nothing else
+    std::vector<uint8_t> vectorscope(static_cast<size_t>(FrameScopes::Levels) * FrameScopes::Levels * 4);
+    RenderVectorscope(scopes, vectorscope.data());
+    EXPECT_EQ(pixelAt(vectorscope, 256, 128, 255 - 128), 0xFF808080u);
+    auto red = pixelAt(vectorscope, 256, 99, 0);
+    EXPECT_EQ(red & 0xFFFF0000u, 0xFFFF0000u);
+    EXPECT_LT(red & 0xFFFFu, 0x6060u);
+    EXPECT_EQ(pixelAt(vectorscope, 256, 128, 10), 0xFF303030u);
+    EXPECT_EQ(pixelAt(vectorscope, 256, 10, 10), 0xFF000000u);
+}
+
+TEST(FrameScopesTests, BackgroundAnalysisMatches)
+{
+    TestFrame frame(300, 200, 3);
+    auto expected = ComputeScopes(frame.Pixels.data(), frame.Width, frame.Height, frame.Stride, 2);
+    // Handed to workers, and analyzed in place when there are none
+    for (uint32_t workerCount : { 0u, 2u })
+    {
+        TaskScheduler scheduler(workerCount);
+        TaskScheduler::OverrideDefault(&scheduler);
+        {
+            BackgroundScopeAnalyzer analyzer(frame.Width, frame.Height, 2);
+            EXPECT_TRUE(analyzer.Latest() == nullptr);
+            uint32_t enqueued = 0;
+            for (uint32_t i = 0; i < 20; i++)
+            {
+                enqueued += analyzer.TryEnqueue(frame.Pixels.data(), frame.Stride) ? 1 : 0;
+            }
+            EXPECT_GE(enqueued, 1u);
+            // Waits for the last one
+            while (analyzer.AnalyzedFrameCount() < enqueued)
+            {
+                std::this_thread::yield();
+            }
+            EXPECT_EQ(analyzer.AnalyzedFrameCount() + analyzer.SkippedFrameCount(), 20u);
+            ASSERT_TRUE(analyzer.Latest() != nullptr);
+            ExpectSameScopes(*analyzer.Latest(), expected, std::to_string(workerCount) + " workers");
+        }
+        TaskScheduler::OverrideDefault(nullptr);
+    }
+}
@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "HalfFloat.h"
+#include "TestHarness.h"
+#include <random>
+
+static uint32_t FloatBits(float value)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float BitsToFloat(uint32_t bits)
+{
+    float value = 0.0f;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// What a half means, straight from the format
+static double ReferenceHalfValue(uint16_t half)
+{
+    auto sign = (half & 0x8000) != 0 ? -1.0 : 1.0;
+    auto exponent = (half >> 10) & 0x1F;
+    auto mantissa = half & 0x3FF;
+    if (exponent == 0x1F)
+    {
+        return mantissa == 0 ? sign * INFINITY : NAN;
+    }
+    if (exponent == 0)
+    {
+        return sign * std::ldexp(mantissa, -24);
+    }
+    return sign * std::ldexp(mantissa + 1024, exponent - 25);
+}
+
+static bool IsNanHalf(uint16_t half)
+{
+    return (half & 0x7C00) == 0x7C00 && (half & 0x3FF) != 0;
+}
+
+// The nearest half, ties to the even mantissa, by searching every finite
+// positive half
+static uint16_t ReferenceFloatToHalf(float value)
+{
+    static auto const positives = []()
+    {
+        std::vector<double> values;
+        for (uint32_t half = 0; half < 0x7C00; half++)
+        {
+            values.push_back(ReferenceHalfValue(static_cast<uint16_t>(half)));
+        }
+        return values;
+    }();
+
+    auto sign = static_cast<uint16_t>(std::signbit(value) ? 0x8000 : 0);
+    double magnitude = std::abs(value);
+    // Halfway between the largest half (65504) and the next step (65536)
+    if (magnitude >= 65520.0)
+    {
+        return sign | 0x7C00;
+    }
+    auto above = static_cast<uint16_t>(std::lower_bound(positives.begin(), positives.end(), magnitude) - positives.begin());
+    if (above == positives.size())
+    {
+        return sign | 0x7BFF;
+    }
+    if (above == 0 || positives[above] == magnitude)
+    {
+        return sign | above;
+    }
+    auto below = static_cast<uint16_t>(above - 1);
+    auto belowDistance = magnitude - positives[below];
+    auto aboveDistance = positives[above] - magnitude;
+    if (belowDistance != aboveDistance)
+    {
+        return sign | (belowDistance < aboveDistance ? below : above);
+    }
+    return sign | ((below & 1) == 0 ? below : above);
+}
+
+TEST(HalfFloatTests, EveryHalfConvertsExactly)
+{
+    std::vector<uint16_t> halves(65536);
+    for (uint32_t i = 0; i < halves.size(); i++)
+    {
+        halves[i] = static_cast<uint16_t>(i);
+    }
+    // One short of a multiple of four, so the vectorized version has a tail
+    std::vector<float> floats(halves.size() - 1);
+    HalfToFloat(halves.data(), floats.data(), floats.size());
+
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < floats.size(); i++)
+    {
+        auto half = static_cast<uint16_t>(i);
+        auto value = HalfToFloat(half);
+        auto expected = ReferenceHalfValue(half);
+        auto matches = IsNanHalf(half) ? std::isnan(value) : (value == expected && std::signbit(value) == std::signbit(expected));
+        // The whole array version gives the same bits
+        matches = matches && FloatBits(floats[i]) == FloatBits(value);
+        // And every half makes it back unchanged, NaN payloads included
+        matches = matches && FloatToHalf(value) == half;
+        if (!matches && mismatches++ < 10)
+        {
+            ADD_FAILURE() << "half 0x" << std::hex << i;
+        }
+    }
+    EXPECT_EQ(mismatches, 0u);
+}
+
+TEST(HalfFloatTests, FloatsRoundToNearestEven)
+{
+    // Exactly between 1 and the next half, and between the next two
+    EXPECT_EQ(FloatToHalf(1.0f + std::ldexp(1.0f, -11)), 0x3C00);
+    EXPECT_EQ(FloatToHalf(1.0f + std::ldexp(3.0f, -11)), 0x3C02);
+    EXPECT_EQ(FloatToHalf(-2.0f), 0xC000);
+    // Subnormals
+    EXPECT_EQ(FloatToHalf(std::ldexp(1.0f, -24)), 0x0001);
+    EXPECT_EQ(FloatToHalf(std::ldexp(1.0f, -25)), 0x0000);
+    EXPECT_EQ(FloatToHalf(std::ldexp(1.5f, -24)), 0x0002);
+    EXPECT_EQ(FloatToHalf(std::ldexp(1.0f, -14) - std::ldexp(1.0f, -25)), 0x0400);
+    // The largest half, and what rounds up past it
+    EXPECT_EQ(FloatToHalf(65504.0f), 0x7BFF);
+    EXPECT_EQ(FloatToHalf(65519.0f), 0x7BFF);
+    EXPECT_EQ(FloatToHalf(65520.0f), 0x7C00);
+    EXPECT_EQ(FloatToHalf(-1e10f), 0xFC00);
+    EXPECT_EQ(FloatToHalf(INFINITY), 0x7C00);
+    EXPECT_TRUE(IsNanHalf(FloatToHalf(NAN)));
+    // A payload that only fits in a float still leaves a NaN
+    EXPECT_EQ(FloatToHalf(BitsToFloat(0xFF800001)), 0xFE00);
+    EXPECT_EQ(FloatToHalf(-0.0f), 0x8000);
+}
+
+TEST(HalfFloatTests, RandomFloatsMatchTheReference)
+{
+    std::mt19937 random(5);
+    // Mostly within the range of halves, and some well outside of it
+    std::uniform_int_distribution<uint32_t> exponents(127 - 28, 127 + 18);
+    std::vector<float> floats(200001);
+    for (auto& value : floats)
+    {
+        auto bits = (random() & 0x807FFFFF) | (exponents(random) << 23);
+        value = BitsToFloat(bits);
+    }
+    std::vector<uint16_t> halves(floats.size());
+    FloatToHalf(floats.data(), halves.data(), floats.size());
+
+    uint32_t mismatches = 0;
+    for (size_t i = 0; i < floats.size(); i++)
+    {
+        auto expected = ReferenceFloatToHalf(floats[i]);
+        if ((halves[i] != expected || FloatToHalf(floats[i]) != expected) && mismatches++ < 10)
+        {
+            ADD_FAILURE() << "float " << floats[i] << " became 0x" << std::hex << halves[i] << " instead of 0x" << expected;
+        }
+    }
+    EXPECT_EQ(mismatches, 0u);
+}
@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "HdrTransfer.h"
+#include "HalfFloat.h"
+#include "TestHarness.h"
+
+// An HDR10 pixel, with 2-bit alpha
+static uint32_t Hdr10Pixel(uint32_t red, uint32_t green, uint32_t blue, uint32_t alpha)
+{
+    return red | (green << 10) | (blue << 20) | (alpha << 30);
+}
+
+TEST(HdrTransferTests, PqMatchesKnownLevels)
+{
+    EXPECT_EQ(PqToLinear(0.0f), 0.0f);
+    EXPECT_NEAR(PqToLinear(1.0f), 1.0f, 1e-6);
+    // 100 and 1000 nits, as published for ST 2084
+    EXPECT_NEAR(LinearToPq(100.0f / PqMaxNits), 0.5081, 1e-4);
+    EXPECT_NEAR(LinearToPq(1000.0f / PqMaxNits), 0.7518, 1e-4);
+    // Out of range values are clamped
+    EXPECT_EQ(LinearToPq(2.0f), LinearToPq(1.0f));
+    EXPECT_EQ(PqToLinear(-0.5f), 0.0f);
+}
+
+TEST(HdrTransferTests, PqRoundTrips)
+{
+    auto last = -1.0f;
+    for (uint32_t i = 0; i <= 1000; i++)
+    {
+        auto signal = static_cast<float>(i) / 1000.0f;
+        auto linear = PqToLinear(signal);
+        EXPECT_GT(linear, last) << "signal " << signal;
+        EXPECT_NEAR(LinearToPq(linear), signal, 1e-5) << "signal " << signal;
+        last = linear;
+    }
+}
+
+TEST(HdrTransferTests, Hdr10GraysStayGray)
+{
+    std::vector<uint32_t> pixels;
+    for (uint32_t code = 0; code < 1024; code += 31)
+    {
+        pixels.push_back(Hdr10Pixel(code, code, code, 3));
+    }
+    std::vector<uint16_t> halves(pixels.size() * 4);
+    ConvertHdr10ToScRgb(pixels.data(), halves.data(), pixels.size());
+
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        auto code = pixels[i] & 0x3FF;
+        auto expected = PqToLinear(static_cast<float>(code) / 1023.0f) * (PqMaxNits / ScRgbWhiteNits);
+        for (size_t c = 0; c < 3; c++)
+        {
+            // Within the precision of a half
+            EXPECT_NEAR(HalfToFloat(halves[(i * 4) + c]), expected, (expected * 1e-3) + 1e-6) << "code " << code;
+        }
+        EXPECT_EQ(halves[(i * 4) + 3], FloatToHalf(1.0f));
+    }
+}
+
+TEST(HdrTransferTests, Hdr10WhiteAndWideColors)
+{
+    // The code nearest 80 nits is scRGB 1.0
+    auto whiteCode = static_cast<uint32_t>(std::lround(LinearToPq(ScRgbWhiteNits / PqMaxNits) * 1023.0f));
+    uint32_t pixels[] =
+    {
+        Hdr10Pixel(whiteCode, whiteCode, whiteCode, 2),
+        // BT.2020 green is outside of BT.709, so red and blue go negative
+        Hdr10Pixel(0, whiteCode, 0, 1),
+        Hdr10Pixel(0, 0, 0, 0),
+    };
+    uint16_t halves[3 * 4];
+    ConvertHdr10ToScRgb(pixels, halves, 3);
+
+    for (size_t c = 0; c < 3; c++)
+    {
+        EXPECT_NEAR(HalfToFloat(halves[c]), 1.0f, 0.02f);
+    }
+    EXPECT_NEAR(HalfToFloat(halves[3]), 2.0f / 3.0f, 1e-3);
+    EXPECT_LT(HalfToFloat(halves[4]), 0.0f);
+    EXPECT_GT(HalfToFloat(halves[5]), 1.0f);
+    EXPECT_LT(HalfToFloat(halves[6]), 0.0f);
+    EXPECT_NEAR(HalfToFloat(halves[7]), 1.0f / 3.0f, 1e-3);
+    for (size_t i = 8; i < 12; i++)
+    {
+        EXPECT_EQ(HalfToFloat(halves[i]), 0.0f);
+    }
+}
+
+TEST(HdrTransferTests, FloatPixelsBecomeHalves)
+{
+    // More than one band for the scheduler, and not a whole number of them
+    std::vector<float> floats(70001 * 4);
+    for (size_t i = 0; i < floats.size(); i++)
+    {
+        floats[i] = (static_cast<float>(i % 5000) - 1000.0f) / 37.0f;
+    }
+    std::vector<uint16_t> halves(floats.size());
+    ConvertFloatToScRgb(floats.data(), halves.data(), floats.size() / 4);
+    uint32_t mismatches = 0;
+    for (size_t i = 0; i < floats.size(); i++)
+    {
+        if (halves[i] != FloatToHalf(floats[i]))
+        {
+            mismatches++;
+        }
+    }
+    EXPECT_EQ(mismatches, 0u);
+}
@@ -0,0 +1,248 @@
+#include "pch.h"
+#include "ImageResampler.h"
+#include "TestHarness.h"
+#include <random>
+
+// A straightforward resampler in floating point to check against. Like
+// ImageResampler it filters rows into a BGRA8 image first, so the only
+// differences left are from the fixed point weights.
+struct ReferenceResampler
+{
+    static double Kernel(ResampleFilter filter, double x)
+    {
+        x = std::abs(x);
+        if (filter == ResampleFilter::Bilinear)
+        {
+            return std::max(0.0, 1.0 - x);
+        }
+        if (x >= 3.0)
+        {
+            return 0.0;
+        }
+        auto sinc = [](double t) { return t == 0.0 ? 1.0 : std::sin(t * 3.14159265358979323846) / (t * 3.14159265358979323846); };
+        return sinc(x) * sinc(x / 3.0);
+    }
+
+    // For each destination pixel, every source pixel's weight, with
+    // samples past the edges landing on the edge pixels
+    static std::vector<std::vector<double>> Weights(uint32_t sourceSize, uint32_t destSize, ResampleFilter filter)
+    {
+        auto scale = static_cast<double>(sourceSize) / destSize;
+        auto filterScale = std::max(scale, 1.0);
+        auto reach = static_cast<int64_t>(std::ceil(3.0 * filterScale)) + 1;
+        std::vector<std::vector<double>> weights(destSize, std::vector<double>(sourceSize));
+        for (uint32_t i = 0; i < destSize; i++)
+        {
+            auto center = (i + 0.5) * scale;
+            auto total = 0.0;
+            for (auto j = static_cast<int64_t>(center) - reach; j <= static_cast<int64_t>(center) + reach; j++)
+            {
+                auto weight = Kernel(filter, (j + 0.5 - center) / filterScale);
+                weights[i][std::clamp<int64_t>(j, 0, sourceSize - 1)] += weight;
+                total += weight;
+            }
+            for (auto& weight : weights[i])
+            {
+                weight /= total;
+            }
+        }
+        return weights;
+    }
+
+    static uint8_t ToByte(double value)
+    {
+        return static_cast<uint8_t>(std::clamp(std::lround(value), 0l, 255l));
+    }
+
+    // Tightly packed output
+    static std::vector<uint8_t> Resample(uint8_t const* source, uint32_t sourceStride, PixelRect const& rect, uint32_t destWidth, uint32_t destHeight, ResampleFilter filter)
+    {
+        auto horizontal = Weights(rect.Width, destWidth, filter);
+        auto vertical = Weights(rect.Height, destHeight, filter);
+        std::vector<uint8_t> rows(static_cast<size_t>(destWidth) * rect.Height * 4);
+        for (uint32_t y = 0; y < rect.Height; y++)
+        {
+            auto sourceRow = source + (static_cast<size_t>(rect.Y + y) * sourceStride) + (static_cast<size_t>(rect.X) * 4);
+            for (uint32_t x = 0; x < destWidth; x++)
+            {
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    auto sum = 0.0;
+                    for (uint32_t j = 0; j < rect.Width; j++)
+                    {
+                        sum += horizontal[x][j] * sourceRow[(j * 4) + c];
+                    }
+                    rows[(((static_cast<size_t>(y) * destWidth) + x) * 4) + c] = ToByte(sum);
+                }
+            }
+        }
+
+        std::vector<uint8_t> dest(static_cast<size_t>(destWidth) * destHeight * 4);
+        for (uint32_t y = 0; y < destHeight; y++)
+        {
+            for (size_t i = 0; i < static_cast<size_t>(destWidth) * 4; i++)
+            {
+                auto sum = 0.0;
+                for (uint32_t j = 0; j < rect.Height; j++)
+                {
+                    sum += vertical[y][j] * rows[(static_cast<size_t>(j) * destWidth * 4) + i];
+                }
+                dest[(static_cast<size_t>(y) * destWidth * 4) + i] = ToByte(sum);
+            }
+        }
+        return dest;
+    }
+};
+
+// Gradients with noise and hard edges, premultiplied, in rows padded with
+// a color that must never show up in the output
+struct TestImage
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Stride;
+    std::vector<uint8_t> Pixels;
+
+    TestImage(uint32_t width, uint32_t height) : Width(width), Height(height), Stride((width * 4) + 20), Pixels(static_cast<size_t>(Stride) * height, 0xEE)
+    {
+        std::mt19937 random(width * height);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                auto pixel = Pixels.data() + (static_cast<size_t>(y) * Stride) + (x * 4);
+                auto alpha = ((x / 7) + (y / 5)) % 3 == 0 ? 255u : (random() % 256);
+                auto edge = (x / 9) % 2 == 0 ? 0u : 255u;
+                uint32_t colors[3] = { (x * 255) / width, (y * 255) / height, edge };
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    auto noisy = std::clamp<int32_t>(static_cast<int32_t>(colors[c]) + static_cast<int32_t>(random() % 41) - 20, 0, 255);
+                    pixel[c] = static_cast<uint8_t>((noisy * alpha) / 255);
+                }
+                pixel[3] = static_cast<uint8_t>(alpha);
+            }
+        }
+    }
+};
+
+static std::vector<uint8_t> Resample(TestImage const& image, PixelRect const& rect, uint32_t destWidth, uint32_t destHeight, ResampleFilter filter)
+{
+    // Padded destination rows, to check that the stride is kept
+    auto destStride = (destWidth * 4) + 12;
+    std::vector<uint8_t> padded(static_cast<size_t>(destStride) * destHeight, 0xEE);
+    ImageResampler::Resample(image.Pixels.data(), image.Stride, rect, padded.data(), destWidth, destHeight, destStride, filter);
+
+    std::vector<uint8_t> dest(static_cast<size_t>(destWidth) * destHeight * 4);
+    for (uint32_t y = 0; y < destHeight; y++)
+    {
+        auto row = padded.data() + (static_cast<size_t>(y) * destStride);
+        memcpy(dest.data() + (static_cast<size_t>(y) * destWidth * 4), row, static_cast<size_t>(destWidth) * 4);
+        for (uint32_t i = destWidth * 4; i < destStride; i++)
+        {
+            EXPECT_EQ(row[i], 0xEE) << "padding of row " << y;
+        }
+    }
+    return dest;
+}
+
+static void ExpectMatchesReference(ResampleFilter filter, PixelRect const& rect, uint32_t destWidth, uint32_t destHeight, int32_t tolerance)
+{
+    TestImage image(rect.X + rect.Width + 3, rect.Y + rect.Height + 2);
+    auto actual = Resample(image, rect, destWidth, destHeight, filter);
+    auto expected = ReferenceResampler::Resample(image.Pixels.data(), image.Stride, rect, destWidth, destHeight, filter);
+
+    int32_t maxError = 0;
+    int64_t totalError = 0;
+    for (size_t i = 0; i < actual.size(); i++)
+    {
+        auto error = std::abs(static_cast<int32_t>(actual[i]) - expected[i]);
+        maxError = std::max(maxError, error);
+        totalError += error;
+    }
+    auto description = std::to_string(rect.Width) + "x" + std::to_string(rect.Height) + " to " + std::to_string(destWidth) + "x" + std::to_string(destHeight);
+    EXPECT_LE(maxError, tolerance) << description;
+    // Off by one now and then, not everywhere
+    EXPECT_LT(static_cast<double>(totalError) / actual.size(), 0.1) << description;
+}
+
+TEST(ImageResamplerTests, BilinearMatchesTheReference)
+{
+    // Down by more than two, down by less, up by a fraction and up
+    ExpectMatchesReference(ResampleFilter::Bilinear, { 0, 0, 203, 117 }, 61, 40, 1);
+    ExpectMatchesReference(ResampleFilter::Bilinear, { 5, 3, 160, 90 }, 117, 71, 1);
+    ExpectMatchesReference(ResampleFilter::Bilinear, { 2, 7, 64, 48 }, 91, 53, 1);
+    ExpectMatchesReference(ResampleFilter::Bilinear, { 0, 0, 21, 13 }, 84, 52, 1);
+}
+
+TEST(ImageResamplerTests, LanczosMatchesTheReference)
+{
+    // The negative lobes amplify the rows' rounding a little
+    ExpectMatchesReference(ResampleFilter::Lanczos3, { 0, 0, 203, 117 }, 61, 40, 2);
+    ExpectMatchesReference(ResampleFilter::Lanczos3, { 5, 3, 160, 90 }, 117, 71, 2);
+    ExpectMatchesReference(ResampleFilter::Lanczos3, { 2, 7, 64, 48 }, 91, 53, 2);
+    ExpectMatchesReference(ResampleFilter::Lanczos3, { 0, 0, 21, 13 }, 84, 52, 2);
+    // Fewer source pixels than taps
+    ExpectMatchesReference(ResampleFilter::Lanczos3, { 1, 1, 3, 2 }, 17, 9, 2);
+}
+
+TEST(ImageResamplerTests, FlatImagesStayFlat)
+{
+    for (auto filter : { ResampleFilter::Bilinear, ResampleFilter::Lanczos3 })
+    {
+        std::vector<uint8_t> source(static_cast<size_t>(97) * 61 * 4);
+        for (size_t i = 0; i < source.size(); i += 4)
+        {
+            source[i] = 12;
+            source[i + 1] = 200;
+            source[i + 2] = 255;
+            source[i + 3] = 255;
+        }
+        std::vector<uint8_t> dest(static_cast<size_t>(40) * 150 * 4);
+        ImageResampler::Resample(source.data(), 97 * 4, { 0, 0, 97, 61 }, dest.data(), 40, 150, 40 * 4, filter);
+        for (size_t i = 0; i < dest.size(); i += 4)
+        {
+            ASSERT_TRUE(dest[i] == 12 && dest[i + 1] == 200 && dest[i + 2] == 255 && dest[i + 3] == 255) << "pixel " << (i / 4);
+        }
+    }
+}
+
+TEST(ImageResamplerTests, BilinearKeepsPixelsPremultiplied)
+{
+    TestImage image(150, 90);
+    auto dest = Resample(image, { 0, 0, 150, 90 }, 77, 31, ResampleFilter::Bilinear);
+    for (size_t i = 0; i < dest.size(); i += 4)
+    {
+        ASSERT_TRUE(dest[i] <= dest[i + 3] && dest[i + 1] <= dest[i + 3] && dest[i + 2] <= dest[i + 3]) << "pixel " << (i / 4);
+    }
+}
+
+TEST(ImageResamplerTests, SameSizeIsACopyOfTheRect)
+{
+    TestImage image(50, 40);
+    PixelRect rect = { 7, 9, 30, 20 };
+    auto dest = Resample(image, rect, rect.Width, rect.Height, ResampleFilter::Lanczos3);
+    for (uint32_t y = 0; y < rect.Height; y++)
+    {
+        auto row = image.Pixels.data() + (static_cast<size_t>(rect.Y + y) * image.Stride) + (rect.X * 4);
+        EXPECT_EQ(memcmp(dest.data() + (static_cast<size_t>(y) * rect.Width * 4), row, rect.Width * 4), 0) << "row " << y;
+    }
+}
+
+TEST(ImageResamplerTests, FitSizeKeepsTheAspectRatio)
+{
+    EXPECT_TRUE(ImageResampler::FitSize(3840, 2160, 400, 300) == std::make_pair(400u, 225u));
+    EXPECT_TRUE(ImageResampler::FitSize(1080, 1920, 400, 300) == std::make_pair(169u, 300u));
+    EXPECT_TRUE(ImageResampler::FitSize(1920, 1080, 3840, 2160) == std::make_pair(3840u, 2160u));
+    // Never smaller than a pixel
+    EXPECT_TRUE(ImageResampler::FitSize(1000, 10, 50, 50) == std::make_pair(50u, 1u));
+    EXPECT_TRUE(ImageResampler::FitSize(5000, 1, 50, 50) == std::make_pair(50u, 1u));
+    EXPECT_TRUE(ImageResampler::FitSize(0, 5, 50, 50) == std::make_pair(1u, 1u));
+    EXPECT_TRUE(ImageResampler::FitSize(100, 100, 0, 0) == std::make_pair(1u, 1u));
+}
+
+TEST(ImageResamplerTests, EmptyImagesAreRejected)
+{
+    std::vector<uint8_t> pixels(64);
+    EXPECT_THROW(ImageResampler::Resample(pixels.data(), 16, { 0, 0, 0, 4 }, pixels.data(), 2, 2, 8, ResampleFilter::Bilinear), std::invalid_argument);
+    EXPECT_THROW(ImageResampler::Resample(pixels.data(), 16, { 0, 0, 4, 4 }, pixels.data(), 2, 0, 8, ResampleFilter::Bilinear), std::invalid_argument);
+}
@@ -0,0 +1,151 @@
+#include "pch.h"
+#include "KeyedPool.h"
+#include "TestHarness.h"
+
+// Values cost their key
+using TestPool = KeyedPool<size_t, std::unique_ptr<int>>;
+
+static std::unique_ptr<TestPool> CreatePool(size_t maxIdleCost)
+{
+    return std::make_unique<TestPool>(maxIdleCost, [](size_t const& key) { return key; });
+}
+
+static std::unique_ptr<int> Create(int value)
+{
+    return std::make_unique<int>(value);
+}
+
+TEST(KeyedPoolTests, ReturnedValuesAreReusedByKey)
+{
+    auto pool = CreatePool(100);
+    auto first = pool->Take(1, [] { return Create(1); });
+    auto firstPointer = first.get();
+    pool->Return(1, std::move(first));
+
+    auto reused = pool->Take(1, []() -> std::unique_ptr<int> { throw std::logic_error("Should have been reused"); });
+    EXPECT_EQ(reused.get(), firstPointer);
+    auto other = pool->Take(2, [] { return Create(2); });
+    EXPECT_EQ(*other, 2);
+
+    auto statistics = pool->Statistics();
+    EXPECT_EQ(statistics.Allocations, 2u);
+    EXPECT_EQ(statistics.Reuses, 1u);
+    EXPECT_EQ(statistics.OutstandingCost, 3u);
+    EXPECT_EQ(statistics.IdleCost, 0u);
+
+    pool->Return(1, std::move(reused));
+    pool->Return(2, std::move(other));
+    statistics = pool->Statistics();
+    EXPECT_EQ(statistics.OutstandingCost, 0u);
+    EXPECT_EQ(statistics.IdleCost, 3u);
+}
+
+TEST(KeyedPoolTests, ReturnsOverBudgetAreDiscarded)
+{
+    auto pool = CreatePool(10);
+    auto first = pool->Take(6, [] { return Create(1); });
+    auto second = pool->Take(6, [] { return Create(2); });
+    pool->Return(6, std::move(first));
+    pool->Return(6, std::move(second));
+
+    auto statistics = pool->Statistics();
+    EXPECT_EQ(statistics.IdleCost, 6u);
+    EXPECT_EQ(statistics.Discards, 1u);
+    EXPECT_EQ(statistics.OutstandingCost, 0u);
+}
+
+TEST(KeyedPoolTests, TrimKeepsWhatWasOutAtOnce)
+{
+    auto pool = CreatePool(100);
+    std::vector<std::unique_ptr<int>> values;
+    for (int i = 0; i < 3; i++)
+    {
+        values.push_back(pool->Take(1, [i] { return Create(i); }));
+    }
+    for (auto& value : values)
+    {
+        pool->Return(1, std::move(value));
+    }
+    values.clear();
+
+    // Three were out at once since the last trim
+    pool->Trim();
+    EXPECT_EQ(pool->Statistics().IdleCost, 3u);
+
+    // Then only one
+    pool->Return(1, pool->Take(1, [] { return Create(0); }));
+    pool->Trim();
+    EXPECT_EQ(pool->Statistics().IdleCost, 1u);
+
+    // And then none
+    pool->Trim();
+    EXPECT_EQ(pool->Statistics().IdleCost, 0u);
+    EXPECT_EQ(pool->Statistics().Allocations, 3u);
+}
+
+TEST(KeyedPoolTests, TrimKeepsRoomForOutstandingValues)
+{
+    auto pool = CreatePool(100);
+    auto first = pool->Take(1, [] { return Create(1); });
+    auto second = pool->Take(1, [] { return Create(2); });
+    pool->Return(1, std::move(second));
+
+    // One is still out, and two were out at once, so one idle is kept
+    pool->Trim();
+    EXPECT_EQ(pool->Statistics().IdleCost, 1u);
+    pool->Return(1, std::move(first));
+    EXPECT_EQ(pool->Statistics().IdleCost, 2u);
+}
+
+TEST(KeyedPoolTests, FailedCreatesAreNotOutstanding)
+{
+    auto pool = CreatePool(100);
+    EXPECT_THROW(pool->Take(5, []() -> std::unique_ptr<int> { throw std::bad_alloc(); }), std::bad_alloc);
+    auto statistics = pool->Statistics();
+    EXPECT_EQ(statistics.OutstandingCost, 0u);
+    EXPECT_EQ(statistics.IdleCost, 0u);
+
+    // The failure doesn't count towards what Trim keeps
+    pool->Return(5, pool->Take(5, [] { return Create(5); }));
+    pool->Trim();
+    pool->Trim();
+    EXPECT_EQ(pool->Statistics().IdleCost, 0u);
+}
+
+TEST(KeyedPoolTests, ConcurrentTakesNeverShareAValue)
+{
+    auto pool = CreatePool(1000);
+    std::atomic<int> nextValue = 0;
+    std::atomic<bool> shared = false;
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 0; thread < 4; thread++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (uint32_t i = 0; i < 2000; i++)
+            {
+                auto value = pool->Take(1, [&] { return Create(0); });
+                // Whoever holds a value owns it, so nobody else sees this
+                auto mark = ++nextValue;
+                *value = mark;
+                std::this_thread::yield();
+                if (*value != mark)
+                {
+                    shared = true;
+                }
+                pool->Return(1, std::move(value));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_FALSE(shared.load());
+    auto statistics = pool->Statistics();
+    EXPECT_LE(statistics.Allocations, 4u);
+    EXPECT_EQ(statistics.Allocations + statistics.Reuses, 8000u);
+    EXPECT_EQ(statistics.OutstandingCost, 0u);
+    EXPECT_EQ(statistics.IdleCost, statistics.Allocations);
+}
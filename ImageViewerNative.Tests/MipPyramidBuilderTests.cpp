@@ -0,0 +1,88 @@
+#include "pch.h"
+#include "MipPyramidBuilder.h"
+#include "TestHarness.h"
+#include <random>
+
+// One 2x box-filtered level, with odd edges averaged with themselves
+static std::vector<uint8_t> ReferenceDownsample(std::vector<uint8_t> const& source, uint32_t width, uint32_t height)
+{
+    auto destWidth = (width + 1) / 2;
+    auto destHeight = (height + 1) / 2;
+    std::vector<uint8_t> dest(static_cast<size_t>(destWidth) * destHeight * 4);
+    auto at = [&](uint32_t x, uint32_t y, uint32_t channel)
+    {
+        x = std::min(x, width - 1);
+        y = std::min(y, height - 1);
+        return static_cast<uint32_t>(source[(((static_cast<size_t>(y) * width) + x) * 4) + channel]);
+    };
+    for (uint32_t y = 0; y < destHeight; y++)
+    {
+        for (uint32_t x = 0; x < destWidth; x++)
+        {
+            for (uint32_t channel = 0; channel < 4; channel++)
+            {
+                auto sum = at(2 * x, 2 * y, channel) + at((2 * x) + 1, 2 * y, channel) + at(2 * x, (2 * y) + 1, channel) + at((2 * x) + 1, (2 * y) + 1, channel);
+                dest[(((static_cast<size_t>(y) * destWidth) + x) * 4) + channel] = static_cast<uint8_t>((sum + 2) / 4);
+            }
+        }
+    }
+    return dest;
+}
+
+TEST(MipPyramidBuilderTests, LevelsMatchABoxFilterDownToOnePixel)
+{
+    std::mt19937 random(1);
+    // Odd and even sizes, wide enough for the vector path
+    for (auto size : { std::make_pair(1u, 1u), std::make_pair(2u, 1u), std::make_pair(37u, 5u), std::make_pair(64u, 64u), std::make_pair(77u, 130u) })
+    {
+        auto width = size.first;
+        auto height = size.second;
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+        for (auto& value : pixels)
+        {
+            value = static_cast<uint8_t>(random());
+        }
+
+        MipPyramidBuilder builder(pixels.data(), width, height, width * 4);
+        EXPECT_EQ(builder.LevelCount(), MipPyramidBuilder::LevelCountForSize(width, height));
+        auto expected = pixels;
+        for (uint32_t level = 1; level < builder.LevelCount(); level++)
+        {
+            expected = ReferenceDownsample(expected, width, height);
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+
+            auto& mipLevel = builder.Level(level);
+            ASSERT_EQ(mipLevel.Width, width);
+            ASSERT_EQ(mipLevel.Height, height);
+            EXPECT_TRUE(mipLevel.Pixels == expected) << size.first << "x" << size.second << " level " << level;
+            EXPECT_EQ(builder.LevelSize(level), std::make_pair(width, height));
+        }
+        EXPECT_EQ(width, 1u);
+        EXPECT_EQ(height, 1u);
+    }
+}
+
+TEST(MipPyramidBuilderTests, LevelForZoomFactorIsTheFinestAtOrBelowOneToOne)
+{
+    EXPECT_EQ(MipPyramidBuilder::LevelForZoomFactor(2.0f, 10), 0u);
+    EXPECT_EQ(MipPyramidBuilder::LevelForZoomFactor(1.0f, 10), 0u);
+    EXPECT_EQ(MipPyramidBuilder::LevelForZoomFactor(0.6f, 10), 0u);
+    EXPECT_EQ(MipPyramidBuilder::LevelForZoomFactor(0.5f, 10), 1u);
+    EXPECT_EQ(MipPyramidBuilder::LevelForZoomFactor(0.3f, 10), 1u);
+    EXPECT_EQ(MipPyramidBuilder::LevelForZoomFactor(0.1f, 10), 3u);
+    EXPECT_EQ(MipPyramidBuilder::LevelForZoomFactor(0.001f, 4), 3u);
+}
+
+TEST(MipPyramidBuilderTests, LevelForViewFitsInATexture)
+{
+    // Small enough for one texture, so only the zoom matters
+    EXPECT_EQ(MipPyramidBuilder::LevelForView(4000, 3000, 1.0f, 16384), 0u);
+    EXPECT_EQ(MipPyramidBuilder::LevelForView(4000, 3000, 0.25f, 16384), 2u);
+    // 40000 halves to 20000 and then 10000 before it fits
+    EXPECT_EQ(MipPyramidBuilder::LevelForView(40000, 1000, 1.0f, 16384), 2u);
+    EXPECT_EQ(MipPyramidBuilder::LevelForView(1000, 40000, 1.0f, 16384), 2u);
+    EXPECT_EQ(MipPyramidBuilder::LevelForView(40000, 1000, 0.1f, 16384), 3u);
+    // Never past the last level
+    EXPECT_EQ(MipPyramidBuilder::LevelForView(8, 8, 1.0f, 0), 3u);
+}
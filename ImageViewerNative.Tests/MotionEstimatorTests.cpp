@@ -0,0 +1,287 @@
+#include "pch.h"
+#include "MotionEstimator.h"
+#include "YuvConverter.h"
+#include "TestHarness.h"
+#include <fstream>
+#include <iterator>
+#include <random>
+
+// Smooth blobs with fine grain on top, on a canvas larger than any frame
+// cut from it, so a shifted frame has real content at every edge
+class TestCanvas
+{
+public:
+    static const uint32_t Size = 512;
+
+    explicit TestCanvas(uint32_t seed) : m_values(static_cast<size_t>(Size) * Size)
+    {
+        std::mt19937 random(seed);
+        const uint32_t cell = 8;
+        const uint32_t cells = (Size / cell) + 1;
+        std::vector<float> coarse(static_cast<size_t>(cells) * cells);
+        for (auto& value : coarse)
+        {
+            value = static_cast<float>(random() % 200);
+        }
+        for (uint32_t y = 0; y < Size; y++)
+        {
+            for (uint32_t x = 0; x < Size; x++)
+            {
+                auto cx = x / cell;
+                auto cy = y / cell;
+                auto fx = static_cast<float>(x % cell) / cell;
+                auto fy = static_cast<float>(y % cell) / cell;
+                auto at = [&](uint32_t i, uint32_t j) { return coarse[(static_cast<size_t>(j) * cells) + i]; };
+                auto top = at(cx, cy) + ((at(cx + 1, cy) - at(cx, cy)) * fx);
+                auto bottom = at(cx, cy + 1) + ((at(cx + 1, cy + 1) - at(cx, cy + 1)) * fx);
+                auto value = top + ((bottom - top) * fy) + static_cast<float>(random() % 48);
+                m_values[(static_cast<size_t>(y) * Size) + x] = static_cast<uint8_t>(value);
+            }
+        }
+    }
+
+    // A gray frame in padded rows, showing the canvas from (left, top)
+    std::vector<uint8_t> Frame(uint32_t width, uint32_t height, uint32_t stride, uint32_t left, uint32_t top) const
+    {
+        std::vector<uint8_t> bgra(static_cast<size_t>(stride) * height, 0xEE);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                auto value = m_values[(static_cast<size_t>(top + y) * Size) + left + x];
+                auto pixel = bgra.data() + (static_cast<size_t>(y) * stride) + (static_cast<size_t>(x) * 4);
+                pixel[0] = value;
+                pixel[1] = value;
+                pixel[2] = value;
+                pixel[3] = 255;
+            }
+        }
+        return bgra;
+    }
+
+private:
+    std::vector<uint8_t> m_values;
+};
+
+// The fraction of blocks whose vector is exactly the given one
+static double FractionMoving(MotionField const& field, MotionVector vector)
+{
+    size_t matching = 0;
+    for (auto found : field.Vectors)
+    {
+        matching += found == vector ? 1 : 0;
+    }
+    return static_cast<double>(matching) / field.BlockCount();
+}
+
+static std::string Describe(int32_t dx, int32_t dy)
+{
+    return "(" + std::to_string(dx) + ", " + std::to_string(dy) + ")";
+}
+
+TEST(MotionEstimatorTests, ShiftedFramesGiveTheShift)
+{
+    TestCanvas canvas(3);
+    const uint32_t width = 320;
+    const uint32_t height = 200;
+    const uint32_t stride = (width * 4) + 20;
+    const uint32_t searchRange = 32;
+    const uint32_t left = 96;
+    const uint32_t top = 96;
+    auto previous = canvas.Frame(width, height, stride, left, top);
+
+    // Small moves, odd ones that don't halve cleanly, and moves out at
+    // the search range
+    const int32_t shifts[][2] = { { 0, 0 }, { 1, 0 }, { 0, -1 }, { 5, -3 }, { -13, 9 }, { 17, 17 }, { -32, 2 }, { 30, -31 } };
+    for (auto shift : shifts)
+    {
+        auto dx = shift[0];
+        auto dy = shift[1];
+        auto description = Describe(dx, dy);
+        // The content moves by the shift, so the view moves the other way
+        auto current = canvas.Frame(width, height, stride, left - dx, top - dy);
+        auto field = EstimateMotion(previous.data(), current.data(), width, height, stride, searchRange);
+
+        EXPECT_EQ(field.Width, width);
+        EXPECT_EQ(field.Height, height);
+        EXPECT_EQ(field.BlocksWide, 20u);
+        EXPECT_EQ(field.BlocksHigh, 13u);
+        ASSERT_EQ(field.Vectors.size(), field.BlockCount());
+        EXPECT_EQ(field.TexturedBlockCount, static_cast<uint32_t>(field.BlockCount())) << description;
+        EXPECT_EQ(field.GlobalMotion.X, dx) << description;
+        EXPECT_EQ(field.GlobalMotion.Y, dy) << description;
+        size_t exactBlocks = 0;
+        for (uint32_t by = 0; by < field.BlocksHigh; by++)
+        {
+            for (uint32_t bx = 0; bx < field.BlocksWide; bx++)
+            {
+                auto index = (static_cast<size_t>(by) * field.BlocksWide) + bx;
+                // A block is all old content when it came from inside the
+                // previous frame
+                auto x = static_cast<int32_t>(std::min(bx * MotionField::BlockSize, width - MotionField::BlockSize)) - dx;
+                auto y = static_cast<int32_t>(std::min(by * MotionField::BlockSize, height - MotionField::BlockSize)) - dy;
+                if (x >= 0 && y >= 0 && x + MotionField::BlockSize <= width && y + MotionField::BlockSize <= height)
+                {
+                    EXPECT_TRUE(field.Vectors[index] == field.GlobalMotion) << description << ", block " << bx << ", " << by;
+                    EXPECT_EQ(field.Sads[index], 0u) << description << ", block " << bx << ", " << by;
+                    exactBlocks++;
+                }
+            }
+        }
+        // Only blocks that new content moved into can disagree
+        EXPECT_GT(exactBlocks, field.BlockCount() / 2) << description;
+        EXPECT_GE(field.GlobalConfidence, static_cast<float>(exactBlocks) / field.BlockCount()) << description;
+
+        if (dx == 0 && dy == 0)
+        {
+            EXPECT_EQ(field.MeanSad(), 0.0);
+            EXPECT_EQ(field.MeanStillSad(), 0.0);
+        }
+        else
+        {
+            EXPECT_LT(field.MeanSad(), field.MeanStillSad()) << description;
+        }
+    }
+}
+
+TEST(MotionEstimatorTests, OddSizesOverlapTheLastBlocks)
+{
+    TestCanvas canvas(11);
+    // Neither size is a whole number of blocks, and the second is only
+    // one block across, so it has no room to move sideways
+    const uint32_t cases[][4] = { { 203, 77, 3, 2 }, { 16, 40, 0, 2 } };
+    for (auto sizeAndShift : cases)
+    {
+        auto width = sizeAndShift[0];
+        auto height = sizeAndShift[1];
+        auto dx = static_cast<int32_t>(sizeAndShift[2]);
+        auto dy = static_cast<int32_t>(sizeAndShift[3]);
+        auto stride = width * 4;
+        auto previous = canvas.Frame(width, height, stride, 200, 200);
+        auto current = canvas.Frame(width, height, stride, 200 - dx, 200 - dy);
+        auto field = EstimateMotion(previous.data(), current.data(), width, height, stride, 8);
+
+        auto description = std::to_string(width) + "x" + std::to_string(height);
+        EXPECT_EQ(field.BlocksWide, (width + 15) / 16);
+        EXPECT_EQ(field.BlocksHigh, (height + 15) / 16);
+        EXPECT_EQ(field.GlobalMotion.X, dx) << description;
+        EXPECT_EQ(field.GlobalMotion.Y, dy) << description;
+        // The bottom right block is moved in to end at the corner, and its
+        // content came from inside the frame
+        EXPECT_TRUE(field.Vectors.back() == field.GlobalMotion) << description;
+        EXPECT_EQ(field.Sads.back(), 0u) << description;
+    }
+}
+
+TEST(MotionEstimatorTests, FlatFramesStayStill)
+{
+    const uint32_t width = 64;
+    const uint32_t height = 48;
+    std::vector<uint8_t> gray(static_cast<size_t>(width) * height * 4, 0x80);
+    std::vector<uint8_t> lighter(gray.size(), 0x90);
+    auto field = EstimateMotion(gray.data(), lighter.data(), width, height, width * 4, 16);
+
+    // Nothing can be matched, so every tie goes to no motion at all
+    EXPECT_EQ(field.TexturedBlockCount, 0u);
+    EXPECT_EQ(field.GlobalConfidence, 0.0f);
+    EXPECT_EQ(FractionMoving(field, MotionVector()), 1.0);
+    EXPECT_NEAR(field.MeanSad(), 16.0, 1.0);
+    EXPECT_EQ(field.MeanSad(), field.MeanStillSad());
+}
+
+TEST(MotionEstimatorTests, ThreadCountDoesntChangeTheResult)
+{
+    TestCanvas canvas(5);
+    const uint32_t width = 256;
+    const uint32_t height = 160;
+    auto previous = canvas.Frame(width, height, width * 4, 100, 100);
+    auto current = canvas.Frame(width, height, width * 4, 107, 95);
+    auto expected = EstimateMotion(previous.data(), current.data(), width, height, width * 4, 24);
+    for (uint32_t workerCount : { 0u, 1u, 5u })
+    {
+        TaskScheduler scheduler(workerCount);
+        TaskScheduler::OverrideDefault(&scheduler);
+        auto field = EstimateMotion(previous.data(), current.data(), width, height, width * 4, 24);
+        TaskScheduler::OverrideDefault(nullptr);
+        EXPECT_TRUE(field.Vectors == expected.Vectors) << workerCount << " workers";
+        EXPECT_TRUE(field.Sads == expected.Sads) << workerCount << " workers";
+        EXPECT_TRUE(field.StillSads == expected.StillSads) << workerCount << " workers";
+        EXPECT_TRUE(field.Textured == expected.Textured) << workerCount << " workers";
+        EXPECT_TRUE(field.GlobalMotion == expected.GlobalMotion) << workerCount << " workers";
+    }
+}
+
+TEST(MotionEstimatorTests, FixtureClipPans)
+{
+    const uint32_t width = 256;
+    const uint32_t height = 144;
+    const size_t frameSize = static_cast<size_t>(width) * height * 3 / 2;
+    std::ifstream file(IMAGEVIEWER_FIXTURES_DIR "/clip-256x144.nv12", std::ios::binary);
+    ASSERT_TRUE(file.good());
+    std::vector<uint8_t> clip((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ASSERT_EQ(clip.size(), frameSize * 6);
+
+    std::vector<std::vector<uint8_t>> frames;
+    for (size_t offset = 0; offset < clip.size(); offset += frameSize)
+    {
+        std::vector<uint8_t> bgra(static_cast<size_t>(width) * height * 4);
+        auto luma = clip.data() + offset;
+        ConvertNv12ToBgra(luma, width, luma + (static_cast<size_t>(width) * height), width, bgra.data(), width * 4, width, height, YuvMatrix::Bt709);
+        frames.push_back(std::move(bgra));
+    }
+
+    // The camera pans right and down, so the scene moves left and up, with
+    // a ball crossing it the other way
+    for (size_t i = 1; i + 1 < frames.size(); i++)
+    {
+        auto field = EstimateMotion(frames[i - 1].data(), frames[i].data(), width, height, width * 4, 16);
+        EXPECT_EQ(field.GlobalMotion.X, -4) << "frame " << i;
+        EXPECT_EQ(field.GlobalMotion.Y, -2) << "frame " << i;
+        EXPECT_GT(field.GlobalConfidence, 0.5f) << "frame " << i;
+        EXPECT_LT(field.MeanSad(), field.MeanStillSad()) << "frame " << i;
+    }
+
+    // The last frame repeats the one before it
+    auto repeated = EstimateMotion(frames[4].data(), frames[5].data(), width, height, width * 4, 16);
+    EXPECT_EQ(repeated.MeanStillSad(), 0.0);
+    EXPECT_EQ(FractionMoving(repeated, MotionVector()), 1.0);
+}
+
+TEST(MotionEstimatorTests, OverlayShowsTheVectors)
+{
+    TestCanvas canvas(7);
+    const uint32_t width = 128;
+    const uint32_t height = 64;
+    auto previous = canvas.Frame(width, height, width * 4, 50, 50);
+    auto current = canvas.Frame(width, height, width * 4, 44, 50);
+    auto field = EstimateMotion(previous.data(), current.data(), width, height, width * 4, 8);
+    ASSERT_EQ(field.GlobalMotion.X, 6);
+
+    // Drawn at half the size, starting from garbage
+    std::vector<uint8_t> overlay(static_cast<size_t>(width / 2) * (height / 2) * 4, 0xEE);
+    RenderMotionOverlay(field, overlay.data(), width / 2, height / 2);
+    size_t agreeing = 0;
+    for (size_t i = 0; i < overlay.size(); i += 4)
+    {
+        uint32_t pixel = 0;
+        memcpy(&pixel, overlay.data() + i, sizeof(pixel));
+        agreeing += pixel == 0xFF00FF00 ? 1 : 0;
+        // Premultiplied throughout
+        EXPECT_LE(overlay[i + 2], overlay[i + 3]);
+        EXPECT_LE(overlay[i + 1], overlay[i + 3]);
+    }
+    EXPECT_GT(agreeing, 0u);
+
+    // An empty field clears the overlay
+    RenderMotionOverlay(MotionField(), overlay.data(), width / 2, height / 2);
+    EXPECT_TRUE(std::all_of(overlay.begin(), overlay.end(), [](uint8_t value) { return value == 0; }));
+}
+
+TEST(MotionEstimatorTests, SmallFramesAreRejected)
+{
+    std::vector<uint8_t> pixels(16 * 16 * 4);
+    EXPECT_THROW(EstimateMotion(pixels.data(), pixels.data(), 15, 16, 16 * 4, 8), std::invalid_argument);
+    EXPECT_THROW(EstimateMotion(pixels.data(), pixels.data(), 16, 15, 16 * 4, 8), std::invalid_argument);
+    auto field = EstimateMotion(pixels.data(), pixels.data(), 16, 16, 16 * 4, 8);
+    EXPECT_EQ(field.BlockCount(), 1u);
+}
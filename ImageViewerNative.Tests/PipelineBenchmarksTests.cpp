@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "PipelineBenchmarks.h"
+#include "TaskScheduler.h"
+#include "TestHarness.h"
+
+static BenchmarkRun SampleRun()
+{
+    BenchmarkRun run;
+    run.ThreadCount = 8;
+    run.Results.push_back({ "DiffPixels/1080p", 1920, 1080, 40, 250.0, 2073.6 });
+    run.Results.push_back({ "PngEncode/4K", 3840, 2160, 12, 20.0, 663.552 });
+    run.Skipped.push_back("8K");
+    return run;
+}
+
+TEST(PipelineBenchmarksTests, JsonRoundTrips)
+{
+    auto run = SampleRun();
+    auto json = PipelineBenchmarks::ToJson(run);
+    auto readBack = PipelineBenchmarks::FromJson(json);
+
+    EXPECT_EQ(readBack.ThreadCount, 8u);
+    ASSERT_EQ(readBack.Results.size(), 2u);
+    EXPECT_EQ(readBack.Results[1].Name, "PngEncode/4K");
+    EXPECT_EQ(readBack.Results[1].Width, 3840u);
+    EXPECT_EQ(readBack.Results[1].Iterations, 12u);
+    EXPECT_DOUBLE_EQ(readBack.Results[1].FramesPerSecond, 20.0);
+    ASSERT_EQ(readBack.Skipped.size(), 1u);
+    EXPECT_EQ(readBack.Skipped[0], "8K");
+    EXPECT_EQ(PipelineBenchmarks::ToJson(readBack), json);
+}
+
+TEST(PipelineBenchmarksTests, ReadingSkipsUnknownKeys)
+{
+    auto run = PipelineBenchmarks::FromJson(
+        "{ \"future\": { \"a\": [1, true, null, \"x\"] }, \"results\": [ { \"name\": \"A/1080p\", \"extra\": false, \"framesPerSecond\": 5 } ], \"skipped\": [] }");
+    ASSERT_EQ(run.Results.size(), 1u);
+    EXPECT_EQ(run.Results[0].Name, "A/1080p");
+    EXPECT_DOUBLE_EQ(run.Results[0].FramesPerSecond, 5.0);
+}
+
+TEST(PipelineBenchmarksTests, ReadingRejectsMalformedFiles)
+{
+    EXPECT_THROW(PipelineBenchmarks::FromJson(""), std::invalid_argument);
+    EXPECT_THROW(PipelineBenchmarks::FromJson("{ \"results\": [ { \"name\": 3"), std::invalid_argument);
+    EXPECT_THROW(PipelineBenchmarks::FromJson("{} trailing"), std::invalid_argument);
+}
+
+TEST(PipelineBenchmarksTests, RegressionsAreDropsPastTheThreshold)
+{
+    auto baseline = SampleRun();
+    auto run = SampleRun();
+    // 5% slower is within a 10% threshold, 15% slower isn't
+    run.Results[0].FramesPerSecond = 237.5;
+    run.Results[1].FramesPerSecond = 17.0;
+    run.Results.push_back({ "New/1080p", 1920, 1080, 1, 1.0, 1.0 });
+
+    auto regressions = PipelineBenchmarks::FindRegressions(run, baseline, 0.1);
+    ASSERT_EQ(regressions.size(), 1u);
+    EXPECT_EQ(regressions[0].Name, "PngEncode/4K");
+    EXPECT_DOUBLE_EQ(regressions[0].BaselineFramesPerSecond, 20.0);
+    EXPECT_DOUBLE_EQ(regressions[0].FramesPerSecond, 17.0);
+
+    EXPECT_EQ(PipelineBenchmarks::FindRegressions(run, baseline, 0.2).size(), 0u);
+    EXPECT_EQ(PipelineBenchmarks::FindRegressions(run, baseline, 0.0).size(), 2u);
+}
+
+TEST(PipelineBenchmarksTests, RunsOnlyTheSelectedBenchmarks)
+{
+    PipelineBenchmarks::Options options;
+    options.MinimumSeconds = 0;
+    options.ResolutionNames = { "1080p" };
+    options.BenchmarkNames = { "DiffPixels", "Nv12ToBgra" };
+    // A tiny clip tiled to 1080p
+    options.Fixtures.ClipWidth = 16;
+    options.Fixtures.ClipHeight = 8;
+    options.Fixtures.ClipFrames.assign(2, std::vector<uint8_t>(16 * 8 * 3 / 2, 128));
+
+    auto run = PipelineBenchmarks::Run(options);
+    ASSERT_EQ(run.Results.size(), 2u);
+    EXPECT_EQ(run.Results[0].Name, "DiffPixels/1080p");
+    EXPECT_EQ(run.Results[1].Name, "Nv12ToBgra/1080p");
+    for (auto& result : run.Results)
+    {
+        EXPECT_GT(result.Iterations, 0u);
+        EXPECT_GT(result.FramesPerSecond, 0.0);
+        EXPECT_NEAR(result.MegabytesPerSecond, result.FramesPerSecond * 1920 * 1080 * 4 / 1000000.0, result.MegabytesPerSecond * 1e-9);
+    }
+}
+
+TEST(PipelineBenchmarksTests, ClipBenchmarksNeedAClip)
+{
+    PipelineBenchmarks::Options options;
+    options.MinimumSeconds = 0;
+    options.ResolutionNames = { "1080p" };
+    options.BenchmarkNames = { "Nv12ToBgra", "FramePipeline" };
+
+    EXPECT_TRUE(PipelineBenchmarks::Run(options).Results.empty());
+}
+
+TEST(PipelineBenchmarksTests, RunsOnTheGivenThreadCount)
+{
+    PipelineBenchmarks::Options options;
+    options.MinimumSeconds = 0;
+    options.ResolutionNames = { "1080p" };
+    options.BenchmarkNames = { "BlockDiffer" };
+    options.ThreadCount = 3;
+
+    auto run = PipelineBenchmarks::Run(options);
+    EXPECT_EQ(run.ThreadCount, 3u);
+    EXPECT_EQ(run.Results.size(), 1u);
+    // The shared scheduler is back afterwards
+    EXPECT_EQ(TaskScheduler::Default().WorkerCount(), std::max(1u, std::thread::hardware_concurrency()) - 1);
+}
+
+TEST(PipelineBenchmarksTests, ScalingIsRelativeToTheFirstRun)
+{
+    auto oneThread = SampleRun();
+    oneThread.ThreadCount = 1;
+    auto twoThreads = SampleRun();
+    twoThreads.ThreadCount = 2;
+    twoThreads.Results[0].FramesPerSecond = 475.0;
+    twoThreads.Results.pop_back();
+
+    auto summary = PipelineBenchmarks::ScalingSummary({ oneThread, twoThreads });
+    EXPECT_EQ(summary,
+        "Threads 1 2\n"
+        "DiffPixels/1080p: 1.00x 1.90x of 250.00 frames/s\n"
+        "PngEncode/4K: 1.00x - of 20.00 frames/s\n");
+    EXPECT_EQ(PipelineBenchmarks::ScalingSummary({}), "");
+}
@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "PixelDiffer.h"
+#include "HalfFloat.h"
+#include "TestHarness.h"
+
+static uint32_t PixelAt(PooledBuffer const& pixels, size_t index)
+{
+    uint32_t pixel = 0;
+    memcpy(&pixel, pixels.Data() + (index * 4), sizeof(pixel));
+    return pixel;
+}
+
+TEST(PixelDifferTests, HalfDiffsSeeTheSmallestDifference)
+{
+    // 3x2 RGBA half pixels, all 1.0 to start with
+    std::vector<uint16_t> first(3 * 2 * 4, FloatToHalf(1.0f));
+    auto second = first;
+    // The next half up in green, far too small to show in 8 bits
+    second[(1 * 4) + 1] = static_cast<uint16_t>(first[(1 * 4) + 1] + 1);
+    // +0 and -0 are the same
+    first[(2 * 4) + 2] = FloatToHalf(0.0f);
+    second[(2 * 4) + 2] = FloatToHalf(-0.0f);
+    // Half of the alpha range
+    second[(4 * 4) + 3] = FloatToHalf(0.5f);
+    // A NaN differs from everything
+    second[(5 * 4) + 0] = FloatToHalf(NAN);
+
+    auto diff = DiffHalfPixels(first.data(), second.data(), 3, 2);
+    EXPECT_FALSE(diff.ColorChannelsMatch);
+    EXPECT_FALSE(diff.AlphaChannelsMatch);
+    // BGRA out, and opaque
+    EXPECT_EQ(PixelAt(diff.ColorPixels, 0), 0xFF000000u);
+    EXPECT_EQ(PixelAt(diff.ColorPixels, 1), 0xFF000100u);
+    EXPECT_EQ(PixelAt(diff.ColorPixels, 2), 0xFF000000u);
+    EXPECT_EQ(PixelAt(diff.ColorPixels, 4), 0xFF000000u);
+    EXPECT_EQ(PixelAt(diff.AlphaPixels, 4), 0xFF808080u);
+    EXPECT_EQ(PixelAt(diff.ColorPixels, 5), 0xFFFF0000u);
+    EXPECT_EQ(PixelAt(diff.AlphaPixels, 5), 0xFF000000u);
+}
+
+TEST(PixelDifferTests, IdenticalHalvesMatch)
+{
+    std::vector<uint16_t> pixels(17 * 5 * 4);
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        pixels[i] = FloatToHalf(static_cast<float>(i) / 7.0f - 20.0f);
+    }
+    auto diff = DiffHalfPixels(pixels.data(), pixels.data(), 17, 5);
+    EXPECT_TRUE(diff.ColorChannelsMatch);
+    EXPECT_TRUE(diff.AlphaChannelsMatch);
+    for (size_t i = 0; i < 17 * 5; i++)
+    {
+        EXPECT_EQ(PixelAt(diff.ColorPixels, i), 0xFF000000u);
+    }
+}
@@ -0,0 +1,144 @@
+#include "pch.h"
+#include "PixelProbeCache.h"
+#include "TestHarness.h"
+
+// Every pixel different, so a pixel read from the wrong place shows
+static uint32_t SourcePixel(uint32_t x, uint32_t y)
+{
+    return 0xFF000000 | ((y & 0xFFF) << 12) | (x & 0xFFF);
+}
+
+// What the probe does once the GPU copy of a tile lands: fills the
+// tile's buffer row by row, TileSize() pixels apart
+static void ReadBack(PixelProbeCache& cache, TileCoordinate const& tile)
+{
+    auto bounds = cache.TileBounds(tile);
+    auto dest = cache.Insert(tile);
+    for (uint32_t row = 0; row < bounds.Height; row++)
+    {
+        for (uint32_t column = 0; column < bounds.Width; column++)
+        {
+            auto pixel = SourcePixel(bounds.X + column, bounds.Y + row);
+            memcpy(dest + (((static_cast<size_t>(row) * cache.TileSize()) + column) * 4), &pixel, 4);
+        }
+    }
+}
+
+// Reads the pixel the way the probe does, reading its tile back first
+// if it isn't resident
+static uint32_t Probe(PixelProbeCache& cache, uint32_t x, uint32_t y)
+{
+    auto tile = cache.TileFor(x, y);
+    auto pixels = cache.Find(tile);
+    if (pixels == nullptr)
+    {
+        ReadBack(cache, tile);
+        pixels = cache.Find(tile);
+    }
+    uint32_t pixel = 0;
+    memcpy(&pixel, pixels + cache.PixelOffset(x, y), 4);
+    return pixel;
+}
+
+TEST(PixelProbeCacheTests, ProbesMatchTheSourceAtTileEdges)
+{
+    // The last column and row of tiles are partial
+    PixelProbeCache cache(200, 130, 64, 64);
+    auto tile = cache.TileFor(199, 129);
+    EXPECT_EQ(tile.X, 3u);
+    EXPECT_EQ(tile.Y, 2u);
+    auto bounds = cache.TileBounds(tile);
+    EXPECT_EQ(bounds.X, 192u);
+    EXPECT_EQ(bounds.Y, 128u);
+    EXPECT_EQ(bounds.Width, 8u);
+    EXPECT_EQ(bounds.Height, 2u);
+
+    const uint32_t edges[] = { 0, 1, 62, 63, 64, 65, 127, 128, 129, 191, 192, 199 };
+    for (auto y : edges)
+    {
+        for (auto x : edges)
+        {
+            if (y < cache.Height())
+            {
+                EXPECT_EQ(Probe(cache, x, y), SourcePixel(x, y)) << x << ", " << y;
+            }
+        }
+    }
+}
+
+TEST(PixelProbeCacheTests, LeastRecentlyUsedTilesAreEvicted)
+{
+    PixelProbeCache cache(256, 256, 64, 3);
+    EXPECT_EQ(Probe(cache, 10, 10), SourcePixel(10, 10));
+    EXPECT_EQ(Probe(cache, 70, 10), SourcePixel(70, 10));
+    EXPECT_EQ(Probe(cache, 130, 10), SourcePixel(130, 10));
+    // Touching the first tile makes the second the oldest
+    EXPECT_TRUE(cache.Find({ 0, 0 }) != nullptr);
+    EXPECT_EQ(Probe(cache, 200, 200), SourcePixel(200, 200));
+
+    EXPECT_TRUE(cache.Contains({ 0, 0 }));
+    EXPECT_FALSE(cache.Contains({ 1, 0 }));
+    EXPECT_TRUE(cache.Contains({ 2, 0 }));
+    EXPECT_TRUE(cache.Contains({ 3, 3 }));
+    EXPECT_TRUE(cache.Find({ 1, 0 }) == nullptr);
+
+    // The evicted tile's buffer went to another tile, and reading it back
+    // again gives its own pixels, not what the buffer held before
+    for (uint32_t y : { 0u, 63u })
+    {
+        for (uint32_t x : { 64u, 127u })
+        {
+            EXPECT_EQ(Probe(cache, x, y), SourcePixel(x, y)) << x << ", " << y;
+        }
+    }
+    EXPECT_FALSE(cache.Contains({ 2, 0 }));
+    EXPECT_EQ(Probe(cache, 255, 255), SourcePixel(255, 255));
+
+    // Inserting a resident tile keeps its buffer
+    auto pixels = cache.Find({ 3, 3 });
+    EXPECT_TRUE(cache.Insert({ 3, 3 }) == pixels);
+
+    cache.Clear();
+    EXPECT_FALSE(cache.Contains({ 3, 3 }));
+    EXPECT_EQ(Probe(cache, 3, 4), SourcePixel(3, 4));
+}
+
+TEST(PixelProbeCacheTests, PrefetchFollowsThePointer)
+{
+    PixelProbeCache cache(512, 512, 64, 8);
+    // Nothing to go on from a single probe
+    EXPECT_FALSE(cache.RecordProbe(40, 100).has_value());
+
+    // Moving right towards the next tile
+    std::optional<TileCoordinate> next;
+    for (uint32_t x = 44; x < 64 && !next.has_value(); x += 4)
+    {
+        Probe(cache, x, 100);
+        next = cache.RecordProbe(x, 100);
+    }
+    ASSERT_TRUE(next.has_value());
+    EXPECT_EQ(next->X, 1u);
+    EXPECT_EQ(next->Y, 1u);
+
+    // Once it's read, there's nothing left to fetch
+    ReadBack(cache, *next);
+    EXPECT_FALSE(cache.RecordProbe(62, 100).has_value());
+
+    // Standing still settles on the current tile
+    std::optional<TileCoordinate> still;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        still = cache.RecordProbe(30, 30);
+    }
+    EXPECT_FALSE(still.has_value());
+
+    // Heading up and left, and not off the edge of the image
+    PixelProbeCache edge(512, 512, 64, 8);
+    edge.RecordProbe(100, 100);
+    auto upLeft = edge.RecordProbe(80, 80);
+    ASSERT_TRUE(upLeft.has_value());
+    EXPECT_EQ(upLeft->X, 0u);
+    EXPECT_EQ(upLeft->Y, 0u);
+    edge.RecordProbe(20, 5);
+    EXPECT_FALSE(edge.RecordProbe(2, 0).has_value());
+}
@@ -0,0 +1,302 @@
+#include "pch.h"
+#include "PngEncoder.h"
+#include "TestHarness.h"
+#include <random>
+#include <zlib.h>
+
+static uint32_t LoadBigEndian(uint8_t const* data)
+{
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+struct DecodedPng
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint8_t ColorType = 0;
+    uint32_t IdatCount = 0;
+    // RGB or RGBA rows, tightly packed
+    std::vector<uint8_t> Pixels;
+
+    uint32_t Channels() const { return ColorType == 2 ? 3 : 4; }
+};
+
+// Decodes the 8-bit RGB and RGBA PNGs PngEncoder writes, with zlib
+// checking the Adler-32. Fails the test and returns nothing on a bad
+// chunk CRC or anything else out of place.
+static std::optional<DecodedPng> Decode(std::vector<uint8_t> const& png)
+{
+    static const uint8_t Signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (png.size() < sizeof(Signature) || memcmp(png.data(), Signature, sizeof(Signature)) != 0)
+    {
+        ADD_FAILURE() << "Missing the PNG signature";
+        return std::nullopt;
+    }
+
+    DecodedPng decoded;
+    std::vector<uint8_t> idat;
+    auto sawEnd = false;
+    size_t position = sizeof(Signature);
+    while (position + 12 <= png.size() && !sawEnd)
+    {
+        auto size = LoadBigEndian(png.data() + position);
+        if (position + 12 + size > png.size())
+        {
+            break;
+        }
+        auto type = std::string(reinterpret_cast<char const*>(png.data() + position + 4), 4);
+        auto data = png.data() + position + 8;
+        auto crc = crc32(0, png.data() + position + 4, size + 4);
+        if (crc != LoadBigEndian(data + size))
+        {
+            ADD_FAILURE() << "Bad CRC on " << type;
+            return std::nullopt;
+        }
+
+        if (type == "IHDR")
+        {
+            decoded.Width = LoadBigEndian(data);
+            decoded.Height = LoadBigEndian(data + 4);
+            if (size != 13 || data[8] != 8 || (data[9] != 2 && data[9] != 6) || data[10] != 0 || data[11] != 0 || data[12] != 0)
+            {
+                ADD_FAILURE() << "Unexpected IHDR";
+                return std::nullopt;
+            }
+            decoded.ColorType = data[9];
+        }
+        else if (type == "IDAT")
+        {
+            idat.insert(idat.end(), data, data + size);
+            decoded.IdatCount++;
+        }
+        else if (type == "IEND")
+        {
+            sawEnd = true;
+        }
+        position += 12 + size;
+    }
+    if (!sawEnd || position != png.size() || decoded.ColorType == 0)
+    {
+        ADD_FAILURE() << "Truncated, or chunks out of place";
+        return std::nullopt;
+    }
+
+    auto channels = decoded.Channels();
+    auto rowBytes = static_cast<size_t>(decoded.Width) * channels;
+    std::vector<uint8_t> filtered((rowBytes + 1) * decoded.Height);
+    auto filteredSize = static_cast<uLongf>(filtered.size());
+    auto result = uncompress(filtered.data(), &filteredSize, idat.data(), static_cast<uLong>(idat.size()));
+    if (result != Z_OK || filteredSize != filtered.size())
+    {
+        ADD_FAILURE() << "zlib couldn't inflate the image data (" << result << ")";
+        return std::nullopt;
+    }
+
+    decoded.Pixels.resize(rowBytes * decoded.Height);
+    std::vector<uint8_t> zeroRow(rowBytes);
+    for (uint32_t y = 0; y < decoded.Height; y++)
+    {
+        auto filter = filtered[y * (rowBytes + 1)];
+        auto input = filtered.data() + (y * (rowBytes + 1)) + 1;
+        auto output = decoded.Pixels.data() + (y * rowBytes);
+        auto previous = y > 0 ? output - rowBytes : zeroRow.data();
+        for (size_t i = 0; i < rowBytes; i++)
+        {
+            int32_t left = i >= channels ? output[i - channels] : 0;
+            int32_t up = previous[i];
+            int32_t upLeft = i >= channels ? previous[i - channels] : 0;
+            int32_t predictor = 0;
+            switch (filter)
+            {
+            case 0:
+                break;
+            case 1:
+                predictor = left;
+                break;
+            case 2:
+                predictor = up;
+                break;
+            case 3:
+                predictor = (left + up) / 2;
+                break;
+            case 4:
+            {
+                auto pa = std::abs(up - upLeft);
+                auto pb = std::abs(left - upLeft);
+                auto pc = std::abs(left + up - (2 * upLeft));
+                predictor = (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+                break;
+            }
+            default:
+                ADD_FAILURE() << "Unknown filter " << static_cast<uint32_t>(filter) << " on row " << y;
+                return std::nullopt;
+            }
+            output[i] = static_cast<uint8_t>(input[i] + predictor);
+        }
+    }
+    return decoded;
+}
+
+static std::vector<uint8_t> Encode(std::vector<uint8_t> const& bgra, uint32_t width, uint32_t height, uint32_t stride, bool premultiplied, uint32_t level)
+{
+    std::vector<uint8_t> png;
+    PngEncoder::Encode(bgra.data(), width, height, stride, premultiplied, level, [&](uint8_t const* data, size_t size)
+    {
+        png.insert(png.end(), data, data + size);
+    });
+    return png;
+}
+
+// Gradients, a checkerboard and noise, with a stride wider than the rows
+struct TestImage
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Stride;
+    std::vector<uint8_t> Bgra;
+
+    TestImage(uint32_t width, uint32_t height, bool opaque, bool premultiplied, uint32_t seed) :
+        Width(width), Height(height), Stride((width * 4) + 12), Bgra(static_cast<size_t>(Stride) * height)
+    {
+        std::mt19937 random(seed);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                auto pixel = Bgra.data() + (static_cast<size_t>(y) * Stride) + (x * 4);
+                auto alpha = opaque ? 255u : ((x * 7) + y) % 256;
+                uint32_t red = (x * 3) % 256;
+                uint32_t green = (y * 5) % 256;
+                uint32_t blue = ((x ^ y) & 8) != 0 ? 200 : random() % 256;
+                if (premultiplied)
+                {
+                    red = red * alpha / 255;
+                    green = green * alpha / 255;
+                    blue = blue * alpha / 255;
+                }
+                pixel[0] = static_cast<uint8_t>(blue);
+                pixel[1] = static_cast<uint8_t>(green);
+                pixel[2] = static_cast<uint8_t>(red);
+                pixel[3] = static_cast<uint8_t>(alpha);
+            }
+        }
+    }
+
+    // What the PNG should hold for the pixel: RGB, unpremultiplied
+    // when needed, and alpha
+    std::array<uint8_t, 4> Expected(uint32_t x, uint32_t y, bool premultiplied) const
+    {
+        auto pixel = Bgra.data() + (static_cast<size_t>(y) * Stride) + (x * 4);
+        uint32_t alpha = pixel[3];
+        auto unpremultiply = [&](uint32_t value)
+        {
+            if (!premultiplied || alpha == 255)
+            {
+                return static_cast<uint8_t>(value);
+            }
+            if (alpha == 0)
+            {
+                return static_cast<uint8_t>(0);
+            }
+            return static_cast<uint8_t>(std::min(255u, ((value * 255) + (alpha / 2)) / alpha));
+        };
+        return { unpremultiply(pixel[2]), unpremultiply(pixel[1]), unpremultiply(pixel[0]), static_cast<uint8_t>(alpha) };
+    }
+};
+
+static void ExpectDecodesTo(TestImage const& image, bool premultiplied, uint32_t level, bool opaque)
+{
+    auto png = Encode(image.Bgra, image.Width, image.Height, image.Stride, premultiplied, level);
+    auto decoded = Decode(png);
+    ASSERT_TRUE(decoded.has_value()) << image.Width << "x" << image.Height << " level " << level;
+    ASSERT_EQ(decoded->Width, image.Width);
+    ASSERT_EQ(decoded->Height, image.Height);
+    ASSERT_EQ(decoded->ColorType, opaque ? 2 : 6);
+
+    auto channels = decoded->Channels();
+    size_t mismatches = 0;
+    for (uint32_t y = 0; y < image.Height; y++)
+    {
+        for (uint32_t x = 0; x < image.Width; x++)
+        {
+            auto expected = image.Expected(x, y, premultiplied);
+            auto actual = decoded->Pixels.data() + (((static_cast<size_t>(y) * image.Width) + x) * channels);
+            if (memcmp(actual, expected.data(), channels) != 0)
+            {
+                mismatches++;
+            }
+        }
+    }
+    EXPECT_EQ(mismatches, 0u) << image.Width << "x" << image.Height << " level " << level << (premultiplied ? " premultiplied" : "");
+}
+
+TEST(PngEncoderTests, OpaqueImagesAreRgbAtEveryLevel)
+{
+    TestImage image(37, 23, true, false, 1);
+    for (uint32_t level = 0; level <= 9; level++)
+    {
+        ExpectDecodesTo(image, false, level, true);
+    }
+}
+
+TEST(PngEncoderTests, TranslucentImagesAreRgbaAtEveryLevel)
+{
+    TestImage image(37, 23, false, false, 2);
+    for (uint32_t level = 0; level <= 9; level++)
+    {
+        ExpectDecodesTo(image, false, level, false);
+    }
+}
+
+TEST(PngEncoderTests, PremultipliedPixelsAreUnpremultiplied)
+{
+    // Wide enough for the vector paths, with alpha running through 0
+    TestImage image(257, 19, false, true, 3);
+    for (uint32_t level : { 0u, 1u, 6u, 9u })
+    {
+        ExpectDecodesTo(image, true, level, false);
+    }
+}
+
+TEST(PngEncoderTests, OddSizes)
+{
+    for (auto size : { std::make_pair(1u, 1u), std::make_pair(1u, 17u), std::make_pair(17u, 1u), std::make_pair(3u, 2u), std::make_pair(129u, 65u) })
+    {
+        ExpectDecodesTo(TestImage(size.first, size.second, true, false, 4), false, 6, true);
+        ExpectDecodesTo(TestImage(size.first, size.second, false, true, 5), true, 6, false);
+    }
+}
+
+TEST(PngEncoderTests, LargeImagesSplitIntoIndependentPieces)
+{
+    // Enough filtered bytes for several pieces, ending in a partial one
+    TestImage image(641, 480, false, true, 6);
+    auto filteredSize = (static_cast<size_t>(image.Width) * 4 + 1) * image.Height;
+    ASSERT_GT(filteredSize, PngEncoder::PieceSize * 4);
+    for (uint32_t level : { 0u, 1u, 6u, 9u })
+    {
+        ExpectDecodesTo(image, true, level, false);
+        auto decoded = Decode(Encode(image.Bgra, image.Width, image.Height, image.Stride, true, level));
+        ASSERT_TRUE(decoded.has_value());
+        EXPECT_EQ(decoded->IdatCount, static_cast<uint32_t>((filteredSize + PngEncoder::PieceSize - 1) / PngEncoder::PieceSize));
+    }
+}
+
+TEST(PngEncoderTests, HigherLevelsAreSmaller)
+{
+    TestImage image(640, 480, true, false, 7);
+    auto stored = Encode(image.Bgra, image.Width, image.Height, image.Stride, false, 0).size();
+    auto fast = Encode(image.Bgra, image.Width, image.Height, image.Stride, false, 1).size();
+    auto best = Encode(image.Bgra, image.Width, image.Height, image.Stride, false, 9).size();
+    EXPECT_LT(fast, stored);
+    EXPECT_LE(best, fast);
+}
+
+TEST(PngEncoderTests, RejectsBadArguments)
+{
+    TestImage image(4, 4, true, false, 8);
+    auto write = [](uint8_t const*, size_t) {};
+    EXPECT_THROW(PngEncoder::Encode(image.Bgra.data(), 0, 4, image.Stride, false, 6, write), std::invalid_argument);
+    EXPECT_THROW(PngEncoder::Encode(image.Bgra.data(), 4, 4, 15, false, 6, write), std::invalid_argument);
+    EXPECT_THROW(PngEncoder::Encode(image.Bgra.data(), 4, 4, image.Stride, false, 10, write), std::invalid_argument);
+}
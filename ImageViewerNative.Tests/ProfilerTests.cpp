@@ -0,0 +1,263 @@
+#include "pch.h"
+#include "Profiler.h"
+#include "TestHarness.h"
+
+static ProfileStage TestStage("ProfilerTests.Stage");
+static ProfileStage QuotedStage("ProfilerTests.\"Quoted\\Stage\"");
+static ProfileStage StallStage("ProfilerTests.StallStage");
+static ProfileCounter TestCounter("ProfilerTests.Counter");
+static ProfileCounter LappedCounter("ProfilerTests.Lapped");
+static ProfileCounter StallCounter("ProfilerTests.StallNanoseconds");
+
+static size_t CountOccurrences(std::string const& text, std::string const& pattern)
+{
+    size_t count = 0;
+    for (auto position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + pattern.size()))
+    {
+        count++;
+    }
+    return count;
+}
+
+// The value a counter ends the summary with, or -1 if it isn't listed
+static int64_t SummaryValue(std::string const& name)
+{
+    auto summary = Profiler::Summary();
+    auto prefix = "\n" + name + ": ";
+    auto position = ("\n" + summary).find(prefix);
+    if (position == std::string::npos)
+    {
+        return -1;
+    }
+    return std::stoll(summary.substr(position + prefix.size() - 1));
+}
+
+// Brackets balance outside of strings, and strings end
+static bool IsBalancedJson(std::string const& json)
+{
+    std::vector<char> open;
+    auto inString = false;
+    for (size_t i = 0; i < json.size(); i++)
+    {
+        auto c = json[i];
+        if (inString)
+        {
+            if (c == '\\')
+            {
+                i++;
+            }
+            else if (c == '"')
+            {
+                inString = false;
+            }
+            continue;
+        }
+        if (c == '"')
+        {
+            inString = true;
+        }
+        else if (c == '{' || c == '[')
+        {
+            open.push_back(c == '{' ? '}' : ']');
+        }
+        else if (c == '}' || c == ']')
+        {
+            if (open.empty() || open.back() != c)
+            {
+                return false;
+            }
+            open.pop_back();
+        }
+    }
+    return !inString && open.empty();
+}
+
+// Starts every test from an empty, enabled profiler and disables it after
+struct EnabledProfiler
+{
+    EnabledProfiler()
+    {
+        Profiler::SetEnabled(true);
+        Profiler::Reset();
+    }
+    ~EnabledProfiler()
+    {
+        Profiler::SetEnabled(false);
+        Profiler::Reset();
+    }
+};
+
+TEST(ProfilerTests, SpansAndCountersExportAsTraceEvents)
+{
+    EnabledProfiler profiler;
+    {
+        ProfileScope scope(TestStage);
+        TestCounter.Add(3);
+    }
+    TestCounter.Add(4);
+
+    auto trace = Profiler::ExportChromeTrace();
+    EXPECT_TRUE(IsBalancedJson(trace)) << trace;
+    EXPECT_EQ(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0u);
+    EXPECT_EQ(CountOccurrences(trace, "{\"name\":\"ProfilerTests.Stage\",\"pid\":1,"), 1u);
+    EXPECT_EQ(CountOccurrences(trace, "\"ph\":\"X\",\"dur\":"), 1u);
+    EXPECT_EQ(CountOccurrences(trace, "{\"name\":\"ProfilerTests.Counter\",\"pid\":1,"), 2u);
+    EXPECT_NE(trace.find("\"ph\":\"C\",\"args\":{\"value\":3}}"), std::string::npos);
+    EXPECT_NE(trace.find("\"ph\":\"C\",\"args\":{\"value\":7}}"), std::string::npos);
+    // The span started first, so it's the origin
+    auto span = trace.find("{\"name\":\"ProfilerTests.Stage\"");
+    EXPECT_NE(trace.find(",\"ts\":0.000,", span), std::string::npos);
+    EXPECT_LT(trace.find(",\"ts\":0.000,", span), trace.find("\n", span));
+    EXPECT_EQ(SummaryValue("ProfilerTests.Counter"), 7);
+}
+
+TEST(ProfilerTests, NamesAreEscaped)
+{
+    EnabledProfiler profiler;
+    {
+        ProfileScope scope(QuotedStage);
+    }
+    auto trace = Profiler::ExportChromeTrace();
+    EXPECT_TRUE(IsBalancedJson(trace)) << trace;
+    EXPECT_NE(trace.find("\"name\":\"ProfilerTests.\\\"Quoted\\\\Stage\\\"\""), std::string::npos) << trace;
+}
+
+TEST(ProfilerTests, NothingIsRecordedWhileDisabled)
+{
+    EnabledProfiler profiler;
+    Profiler::SetEnabled(false);
+    {
+        ProfileScope scope(TestStage);
+        TestCounter.Add(1);
+    }
+    EXPECT_EQ(Profiler::ExportChromeTrace().find("ProfilerTests."), std::string::npos);
+    EXPECT_EQ(Profiler::Summary().find("ProfilerTests."), std::string::npos);
+}
+
+TEST(ProfilerTests, NamedCountersAreCreatedOnce)
+{
+    EnabledProfiler profiler;
+    std::string name = "ProfilerTests.Named";
+    auto& counter = Profiler::Counter(name);
+    counter.Add(2);
+    // The counter keeps its own copy of the name
+    name.assign("ProfilerTests.Other");
+    Profiler::Counter(std::string("ProfilerTests.Named")).Add(3);
+    EXPECT_EQ(&Profiler::Counter("ProfilerTests.Named"), &counter);
+    EXPECT_EQ(std::string(counter.Name()), "ProfilerTests.Named");
+    EXPECT_EQ(SummaryValue("ProfilerTests.Named"), 5);
+    EXPECT_EQ(CountOccurrences(Profiler::ExportChromeTrace(), "\"name\":\"ProfilerTests.Named\""), 2u);
+}
+
+TEST(ProfilerTests, ResetDropsEvents)
+{
+    EnabledProfiler profiler;
+    {
+        ProfileScope scope(TestStage);
+        TestCounter.Add(1);
+    }
+    Profiler::Reset();
+    EXPECT_EQ(Profiler::ExportChromeTrace().find("ProfilerTests."), std::string::npos);
+    EXPECT_EQ(SummaryValue("ProfilerTests.Counter"), -1);
+
+    // Rings keep recording after a reset
+    TestCounter.Add(2);
+    EXPECT_EQ(CountOccurrences(Profiler::ExportChromeTrace(), "\"name\":\"ProfilerTests.Counter\""), 1u);
+}
+
+TEST(ProfilerTests, FullRingsKeepTheNewestEvents)
+{
+    EnabledProfiler profiler;
+    auto eventCount = static_cast<int64_t>(Profiler::RingCapacity) + 100;
+    // A thread of its own, so that nothing else shares the ring
+    std::thread([eventCount]()
+    {
+        for (int64_t i = 0; i < eventCount; i++)
+        {
+            LappedCounter.Set(i);
+        }
+    }).join();
+
+    // The thread is gone, but its events are kept
+    auto trace = Profiler::ExportChromeTrace();
+    EXPECT_TRUE(IsBalancedJson(trace));
+    EXPECT_EQ(CountOccurrences(trace, "\"name\":\"ProfilerTests.Lapped\""), static_cast<size_t>(Profiler::RingCapacity));
+    EXPECT_EQ(trace.find("{\"value\":99}"), std::string::npos);
+    EXPECT_NE(trace.find("{\"value\":100}"), std::string::npos);
+    EXPECT_NE(trace.find("{\"value\":" + std::to_string(eventCount - 1) + "}"), std::string::npos);
+}
+
+// The trace thread id of the first event with the given name
+static std::string TraceThreadId(std::string const& trace, std::string const& name)
+{
+    auto position = trace.find("{\"name\":\"" + name + "\"");
+    if (position == std::string::npos)
+    {
+        return "";
+    }
+    auto begin = trace.find("\"tid\":", position) + 6;
+    return trace.substr(begin, trace.find(',', begin) - begin);
+}
+
+TEST(ProfilerTests, ExitedThreadsHandTheirRingsOn)
+{
+    EnabledProfiler profiler;
+    std::thread([]() { TestCounter.Set(1); }).join();
+    auto exitedThread = TraceThreadId(Profiler::ExportChromeTrace(), "ProfilerTests.Counter");
+    EXPECT_FALSE(exitedThread.empty());
+
+    // The next thread records into the same ring, after what's there
+    std::thread([]() { LappedCounter.Set(2); }).join();
+    auto trace = Profiler::ExportChromeTrace();
+    EXPECT_EQ(CountOccurrences(trace, "\"name\":\"ProfilerTests.Counter\""), 1u);
+    EXPECT_EQ(TraceThreadId(trace, "ProfilerTests.Lapped"), exitedThread);
+
+    // Reset frees it, so the next thread gets a new one
+    Profiler::Reset();
+    std::thread([]() { TestCounter.Set(3); }).join();
+    auto nextThread = TraceThreadId(Profiler::ExportChromeTrace(), "ProfilerTests.Counter");
+    EXPECT_FALSE(nextThread.empty());
+    EXPECT_NE(nextThread, exitedThread);
+}
+
+TEST(ProfilerTests, EventsAreExportedInTimeOrder)
+{
+    EnabledProfiler profiler;
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        threads.emplace_back([]()
+        {
+            for (uint32_t j = 0; j < 100; j++)
+            {
+                ProfileScope scope(TestStage);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    auto trace = Profiler::ExportChromeTrace();
+    EXPECT_EQ(CountOccurrences(trace, "\"name\":\"ProfilerTests.Stage\""), 400u);
+    double last = 0;
+    for (auto position = trace.find("\"ts\":"); position != std::string::npos; position = trace.find("\"ts\":", position + 1))
+    {
+        auto timestamp = std::stod(trace.substr(position + 5));
+        EXPECT_GE(timestamp, last);
+        last = timestamp;
+    }
+}
+
+TEST(ProfilerTests, StallsAddUpInTheirCounter)
+{
+    EnabledProfiler profiler;
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        ProfileScope scope(StallStage, &StallCounter);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    EXPECT_GE(SummaryValue("ProfilerTests.StallNanoseconds"), 4000000);
+    EXPECT_NE(Profiler::Summary().find("ProfilerTests.StallStage: 2 runs"), std::string::npos);
+}
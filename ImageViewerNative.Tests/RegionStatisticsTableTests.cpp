@@ -0,0 +1,213 @@
+#include "pch.h"
+#include "RegionStatisticsTable.h"
+#include "TestHarness.h"
+#include <random>
+
+static const uint32_t BlockSize = RegionStatisticsTable::BlockSize;
+
+// Random BGRA in padded rows, with runs of zeros so the non-zero counts
+// have something to count
+struct TestImage
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Stride;
+    std::vector<uint8_t> Pixels;
+
+    TestImage(uint32_t width, uint32_t height, uint32_t seed) : Width(width), Height(height), Stride((width * 4) + 12), Pixels(static_cast<size_t>(Stride) * height, 0xEE)
+    {
+        std::mt19937 random(seed);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                auto pixel = Pixel(x, y);
+                for (size_t c = 0; c < 4; c++)
+                {
+                    pixel[c] = random() % 3 == 0 ? 0 : static_cast<uint8_t>(random());
+                }
+            }
+        }
+    }
+
+    uint8_t* Pixel(uint32_t x, uint32_t y) { return Pixels.data() + (static_cast<size_t>(y) * Stride) + (static_cast<size_t>(x) * 4); }
+};
+
+// Every pixel of the rect, clipped to the image, one at a time
+static RegionAccumulator ReferenceQuery(TestImage& image, PixelRect const& rect)
+{
+    RegionAccumulator result;
+    auto x1 = std::min<uint64_t>(static_cast<uint64_t>(rect.X) + rect.Width, image.Width);
+    auto y1 = std::min<uint64_t>(static_cast<uint64_t>(rect.Y) + rect.Height, image.Height);
+    for (uint64_t y = rect.Y; y < y1; y++)
+    {
+        for (uint64_t x = rect.X; x < x1; x++)
+        {
+            auto pixel = image.Pixel(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+            for (size_t c = 0; c < 4; c++)
+            {
+                auto& channel = result.Channels[c];
+                channel.Sum += pixel[c];
+                channel.SquaredSum += static_cast<uint64_t>(pixel[c]) * pixel[c];
+                channel.NonZeroCount += pixel[c] != 0 ? 1 : 0;
+                channel.Minimum = std::min(channel.Minimum, pixel[c]);
+                channel.Maximum = std::max(channel.Maximum, pixel[c]);
+            }
+            result.PixelCount++;
+        }
+    }
+    return result;
+}
+
+static std::string Describe(PixelRect const& rect)
+{
+    return std::to_string(rect.Width) + "x" + std::to_string(rect.Height) + " at " + std::to_string(rect.X) + ", " + std::to_string(rect.Y);
+}
+
+static void ExpectSameStatistics(RegionAccumulator const& actual, RegionAccumulator const& expected, std::string const& description)
+{
+    EXPECT_EQ(actual.PixelCount, expected.PixelCount) << description;
+    for (size_t c = 0; c < 4; c++)
+    {
+        auto& channel = actual.Channels[c];
+        auto& expectedChannel = expected.Channels[c];
+        EXPECT_EQ(channel.Sum, expectedChannel.Sum) << description << ", channel " << c;
+        EXPECT_EQ(channel.SquaredSum, expectedChannel.SquaredSum) << description << ", channel " << c;
+        EXPECT_EQ(channel.NonZeroCount, expectedChannel.NonZeroCount) << description << ", channel " << c;
+        EXPECT_EQ(channel.Minimum, expectedChannel.Minimum) << description << ", channel " << c;
+        EXPECT_EQ(channel.Maximum, expectedChannel.Maximum) << description << ", channel " << c;
+    }
+}
+
+static void ExpectQueryMatches(RegionStatisticsTable const& table, TestImage& image, PixelRect const& rect)
+{
+    ExpectSameStatistics(table.Query(rect), ReferenceQuery(image, rect), Describe(rect));
+}
+
+TEST(RegionStatisticsTableTests, ChosenRectsMatchCountingEachPixel)
+{
+    // Neither side is a whole number of blocks
+    TestImage image(203, 77, 1);
+    RegionStatisticsTable table(image.Pixels.data(), image.Width, image.Height, image.Stride);
+    EXPECT_EQ(table.Width(), image.Width);
+    EXPECT_EQ(table.Height(), image.Height);
+
+    const PixelRect rects[] =
+    {
+        // Single pixels, including the last one
+        { 0, 0, 1, 1 },
+        { 17, 33, 1, 1 },
+        { 202, 76, 1, 1 },
+        // Inside one block, and exactly one block
+        { 18, 19, 9, 7 },
+        { BlockSize, BlockSize, BlockSize, BlockSize },
+        // Across block edges without a whole block inside
+        { 12, 12, 8, 8 },
+        { 30, 5, 5, 40 },
+        // Whole blocks with partial ones around them
+        { 3, 5, 90, 60 },
+        { BlockSize, 0, BlockSize * 4, BlockSize * 3 },
+        // The partial blocks at the right and bottom edges
+        { 190, 60, 13, 17 },
+        { 0, 64, 203, 13 },
+        // Everything, and past the edges
+        { 0, 0, 203, 77 },
+        { 5, 7, 1000, 1000 },
+        { 0, 0, UINT32_MAX, UINT32_MAX },
+    };
+    for (auto& rect : rects)
+    {
+        ExpectQueryMatches(table, image, rect);
+    }
+}
+
+TEST(RegionStatisticsTableTests, RandomRectsMatchCountingEachPixel)
+{
+    const std::pair<uint32_t, uint32_t> sizes[] = { { 256, 160 }, { 250, 131 }, { 15, 40 }, { 37, 9 } };
+    std::mt19937 random(2);
+    for (auto size : sizes)
+    {
+        TestImage image(size.first, size.second, size.first);
+        RegionStatisticsTable table(image.Pixels.data(), image.Width, image.Height, image.Stride);
+        for (uint32_t i = 0; i < 200; i++)
+        {
+            PixelRect rect;
+            rect.X = random() % image.Width;
+            rect.Y = random() % image.Height;
+            rect.Width = 1 + (random() % (image.Width - rect.X));
+            rect.Height = 1 + (random() % (image.Height - rect.Y));
+            ExpectQueryMatches(table, image, rect);
+        }
+    }
+}
+
+TEST(RegionStatisticsTableTests, WhiteImagesDontOverflow)
+{
+    // Long edge strips accumulate far more than the vectorized lanes can
+    // hold before they are flushed, and so do the whole blocks
+    TestImage image(1031, 70, 3);
+    std::fill(image.Pixels.begin(), image.Pixels.end(), 255);
+    RegionStatisticsTable table(image.Pixels.data(), image.Width, image.Height, image.Stride);
+
+    const PixelRect rects[] = { { 0, 0, 1031, 70 }, { 1, 1, 1029, 14 }, { 3, 0, 1025, 3 }, { 0, 2, 15, 68 } };
+    for (auto& rect : rects)
+    {
+        auto result = table.Query(rect);
+        ExpectSameStatistics(result, ReferenceQuery(image, rect), Describe(rect));
+        auto pixelCount = static_cast<uint64_t>(rect.Width) * rect.Height;
+        for (auto& channel : result.Channels)
+        {
+            EXPECT_EQ(channel.Sum, pixelCount * 255) << Describe(rect);
+            EXPECT_EQ(channel.SquaredSum, pixelCount * 255 * 255) << Describe(rect);
+            EXPECT_EQ(channel.NonZeroCount, pixelCount) << Describe(rect);
+            EXPECT_EQ(channel.Minimum, 255);
+        }
+        // The mean is exact
+        EXPECT_EQ(static_cast<double>(result.Channels[0].Sum) / result.PixelCount, 255.0);
+    }
+}
+
+TEST(RegionStatisticsTableTests, ExtremesComeFromTheRightBlocks)
+{
+    // A gray image with one dark and one bright pixel, so min and max
+    // only change when the rect reaches them
+    TestImage image(96, 80, 4);
+    std::fill(image.Pixels.begin(), image.Pixels.end(), 128);
+    image.Pixel(40, 37)[1] = 3;
+    image.Pixel(70, 64)[2] = 250;
+    RegionStatisticsTable table(image.Pixels.data(), image.Width, image.Height, image.Stride);
+
+    auto all = table.Query({ 0, 0, 96, 80 });
+    EXPECT_EQ(all.Channels[1].Minimum, 3);
+    EXPECT_EQ(all.Channels[2].Maximum, 250);
+    // Whole blocks around the dark one, but not the block it's in
+    auto beside = table.Query({ 48, 0, 48, 64 });
+    EXPECT_EQ(beside.Channels[1].Minimum, 128);
+    EXPECT_EQ(beside.Channels[2].Maximum, 128);
+    // The bright one in the edge strip of a larger rect
+    auto strip = table.Query({ 16, 16, 55, 49 });
+    EXPECT_EQ(strip.Channels[2].Maximum, 250);
+    EXPECT_EQ(strip.Channels[1].Minimum, 3);
+    ExpectSameStatistics(strip, ReferenceQuery(image, { 16, 16, 55, 49 }), "strip");
+}
+
+TEST(RegionStatisticsTableTests, EmptyRectsAreEmpty)
+{
+    TestImage image(40, 40, 5);
+    RegionStatisticsTable table(image.Pixels.data(), image.Width, image.Height, image.Stride);
+    const PixelRect rects[] = { { 0, 0, 0, 10 }, { 5, 5, 10, 0 }, { 40, 0, 5, 5 }, { 0, 40, 5, 5 }, { 100, 100, 5, 5 } };
+    for (auto& rect : rects)
+    {
+        auto result = table.Query(rect);
+        EXPECT_EQ(result.PixelCount, 0u) << Describe(rect);
+        EXPECT_EQ(result.Channels[0].Sum, 0u) << Describe(rect);
+        EXPECT_EQ(result.Channels[0].Minimum, 255);
+        EXPECT_EQ(result.Channels[0].Maximum, 0);
+    }
+
+    // Images smaller than a block have no block tables at all
+    TestImage tiny(5, 3, 6);
+    RegionStatisticsTable tinyTable(tiny.Pixels.data(), tiny.Width, tiny.Height, tiny.Stride);
+    ExpectQueryMatches(tinyTable, tiny, { 0, 0, 5, 3 });
+    ExpectQueryMatches(tinyTable, tiny, { 1, 1, 2, 2 });
+}
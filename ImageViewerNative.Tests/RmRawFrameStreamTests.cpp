@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "RmRawFrameStream.h"
+#include "TestHarness.h"
+#include <fstream>
+#include <iterator>
+#include <random>
+
+// Random frames with padded rows, changing a few pixels at a time and
+// now and then all at once
+struct FrameSequence
+{
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Stride;
+    std::vector<uint8_t> Pixels;
+    std::mt19937 Random;
+
+    FrameSequence(uint32_t width, uint32_t height, uint32_t seed) :
+        Width(width), Height(height), Stride((width * 4) + 28), Pixels(static_cast<size_t>(Stride) * height), Random(seed)
+    {
+        Scramble();
+    }
+
+    void Scramble()
+    {
+        for (auto& value : Pixels)
+        {
+            value = static_cast<uint8_t>(Random());
+        }
+    }
+
+    void Advance(uint32_t index)
+    {
+        if (index % 37 == 36)
+        {
+            Scramble();
+            return;
+        }
+        auto changeCount = Random() % 20;
+        for (uint32_t i = 0; i < changeCount; i++)
+        {
+            auto x = Random() % Width;
+            auto y = Random() % Height;
+            Pixels[(static_cast<size_t>(y) * Stride) + (x * 4) + (Random() % 4)] = static_cast<uint8_t>(Random());
+        }
+    }
+
+    std::vector<uint8_t> Packed() const
+    {
+        std::vector<uint8_t> packed(static_cast<size_t>(Width) * Height * 4);
+        for (uint32_t y = 0; y < Height; y++)
+        {
+            memcpy(packed.data() + (static_cast<size_t>(y) * Width * 4), Pixels.data() + (static_cast<size_t>(y) * Stride), Width * 4);
+        }
+        return packed;
+    }
+};
+
+static RmRawFrameStreamReader::ReadFunction ReadFrom(std::vector<uint8_t> const& stream)
+{
+    return [&stream](uint64_t offset, uint8_t* data, size_t size)
+    {
+        if (offset + size > stream.size())
+        {
+            throw std::out_of_range("Read past the end of the stream");
+        }
+        memcpy(data, stream.data() + offset, size);
+    };
+}
+
+// Writes 150 frames, which spans a few key frames
+static std::vector<uint8_t> WriteStream(std::vector<std::vector<uint8_t>>& frames)
+{
+    std::vector<uint8_t> stream;
+    FrameSequence sequence(333, 211, 3);
+    RmRawFrameStreamWriter writer([&](uint8_t const* data, size_t size) { stream.insert(stream.end(), data, data + size); }, sequence.Width, sequence.Height);
+    for (uint32_t i = 0; i < 150; i++)
+    {
+        sequence.Advance(i);
+        writer.WriteFrame(sequence.Pixels.data(), sequence.Stride, static_cast<int64_t>(i) * 166666);
+        frames.push_back(sequence.Packed());
+    }
+    writer.Finish();
+    return stream;
+}
+
+TEST(RmRawFrameStreamTests, FramesReadBackInOrder)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    auto stream = WriteStream(frames);
+    EXPECT_TRUE(RmRawFrameStreamReader::IsFrameStream(stream.data(), stream.size()));
+    // Most frames only change a few pixels
+    EXPECT_LT(stream.size(), frames.size() * frames[0].size() / 4);
+
+    RmRawFrameStreamReader reader(ReadFrom(stream), stream.size());
+    ASSERT_EQ(reader.FrameCount(), static_cast<uint32_t>(frames.size()));
+    EXPECT_EQ(reader.Width(), 333u);
+    EXPECT_EQ(reader.Height(), 211u);
+    for (uint32_t i = 0; i < reader.FrameCount(); i++)
+    {
+        EXPECT_TRUE(reader.DecodeFrame(i) == frames[i]) << "frame " << i;
+        EXPECT_EQ(reader.Entry(i).Timestamp, static_cast<int64_t>(i) * 166666);
+    }
+}
+
+TEST(RmRawFrameStreamTests, FramesReadBackInAnyOrder)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    auto stream = WriteStream(frames);
+    RmRawFrameStreamReader reader(ReadFrom(stream), stream.size());
+
+    // Key frames are where decoding restarts
+    EXPECT_NE(reader.Entry(0).Flags, 0u);
+    EXPECT_EQ(reader.Entry(RmRawFrameStreamWriter::KeyFrameInterval).Flags, reader.Entry(0).Flags);
+    EXPECT_EQ(reader.Entry(1).Flags, 0u);
+
+    std::mt19937 random(4);
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        auto index = random() % reader.FrameCount();
+        EXPECT_TRUE(reader.DecodeFrame(index) == frames[index]) << "frame " << index;
+    }
+    EXPECT_THROW(reader.DecodeFrame(reader.FrameCount()), std::out_of_range);
+}
+
+TEST(RmRawFrameStreamTests, UnfinishedStreamsAreRejected)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    auto stream = WriteStream(frames);
+
+    std::vector<uint8_t> truncated(stream.begin(), stream.end() - 3);
+    EXPECT_THROW(RmRawFrameStreamReader(ReadFrom(truncated), truncated.size()), std::runtime_error);
+
+    auto corrupt = stream;
+    corrupt[0] ^= 0xFF;
+    EXPECT_FALSE(RmRawFrameStreamReader::IsFrameStream(corrupt.data(), corrupt.size()));
+    EXPECT_THROW(RmRawFrameStreamReader(ReadFrom(corrupt), corrupt.size()), std::runtime_error);
+}
+
+TEST(RmRawFrameStreamTests, WriterRejectsFramesAfterFinish)
+{
+    std::vector<uint8_t> stream;
+    std::vector<uint8_t> pixels(16 * 16 * 4);
+    RmRawFrameStreamWriter writer([&](uint8_t const* data, size_t size) { stream.insert(stream.end(), data, data + size); }, 16, 16);
+    writer.Finish();
+    EXPECT_THROW(writer.WriteFrame(pixels.data(), 16 * 4, 0), std::logic_error);
+
+    // An empty stream is still a valid one
+    RmRawFrameStreamReader reader(ReadFrom(stream), stream.size());
+    EXPECT_EQ(reader.FrameCount(), 0u);
+}
+
+TEST(RmRawFrameStreamTests, FixtureDecodes)
+{
+    std::ifstream file(IMAGEVIEWER_FIXTURES_DIR "/desktop.rmraw", std::ios::binary);
+    ASSERT_TRUE(file.good());
+    std::vector<uint8_t> stream((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    ASSERT_TRUE(RmRawFrameStreamReader::IsFrameStream(stream.data(), stream.size()));
+
+    RmRawFrameStreamReader reader(ReadFrom(stream), stream.size());
+    EXPECT_EQ(reader.Width(), 256u);
+    EXPECT_EQ(reader.Height(), 144u);
+    ASSERT_EQ(reader.FrameCount(), 1u);
+    auto& pixels = reader.DecodeFrame(0);
+    ASSERT_EQ(pixels.size(), static_cast<size_t>(256) * 144 * 4);
+    // A screenshot is opaque
+    bool opaque = true;
+    for (size_t i = 3; i < pixels.size(); i += 4)
+    {
+        opaque = opaque && pixels[i] == 255;
+    }
+    EXPECT_TRUE(opaque);
+}
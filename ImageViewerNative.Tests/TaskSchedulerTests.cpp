@@ -0,0 +1,229 @@
+#include "pch.h"
+#include "TaskScheduler.h"
+#include "ParallelFor.h"
+#include "TestHarness.h"
+#include <set>
+
+// Makes ParallelFor run on a scheduler with the given number of workers
+struct OverriddenScheduler
+{
+    TaskScheduler Scheduler;
+
+    explicit OverriddenScheduler(uint32_t workerCount) : Scheduler(workerCount)
+    {
+        TaskScheduler::OverrideDefault(&Scheduler);
+    }
+    ~OverriddenScheduler()
+    {
+        TaskScheduler::OverrideDefault(nullptr);
+    }
+};
+
+TEST(TaskSchedulerTests, EveryTaskRunsOnce)
+{
+    for (uint32_t workerCount = 0; workerCount <= 3; workerCount++)
+    {
+        TaskScheduler scheduler(workerCount);
+        EXPECT_EQ(scheduler.WorkerCount(), workerCount);
+        std::vector<std::atomic<uint32_t>> runCounts(1000);
+        TaskGroup group(scheduler, TaskPriority::Visible);
+        for (auto& runCount : runCounts)
+        {
+            group.Run([&runCount]() { runCount++; });
+        }
+        group.Wait();
+
+        for (auto& runCount : runCounts)
+        {
+            EXPECT_EQ(runCount.load(), 1u) << workerCount << " workers";
+        }
+    }
+}
+
+TEST(TaskSchedulerTests, HigherPrioritiesRunFirst)
+{
+    // Without workers nothing runs until this thread asks for it
+    TaskScheduler scheduler(0);
+    std::vector<std::string> order;
+    auto submit = [&](std::string name, TaskPriority priority)
+    {
+        scheduler.Submit([&order, name]() { order.push_back(name); }, priority);
+    };
+    submit("Background1", TaskPriority::Background);
+    submit("Visible1", TaskPriority::Visible);
+    submit("Interactive1", TaskPriority::Interactive);
+    submit("Background2", TaskPriority::Background);
+    submit("Visible2", TaskPriority::Visible);
+    submit("Interactive2", TaskPriority::Interactive);
+    while (scheduler.TryRunPendingTask())
+    {
+    }
+
+    // Oldest first within a priority, since nothing was stolen
+    std::vector<std::string> expected = { "Interactive1", "Interactive2", "Visible1", "Visible2", "Background1", "Background2" };
+    EXPECT_TRUE(order == expected);
+    EXPECT_FALSE(scheduler.TryRunPendingTask());
+}
+
+TEST(TaskSchedulerTests, WaitRethrowsTheFirstErrorAndSkipsTheRest)
+{
+    TaskScheduler scheduler(0);
+    uint32_t runCount = 0;
+    TaskGroup group(scheduler, TaskPriority::Visible);
+    group.Run([]() { throw std::out_of_range("First"); });
+    group.Run([]() { throw std::logic_error("Second"); });
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        group.Run([&runCount]() { runCount++; });
+    }
+    EXPECT_THROW(group.Wait(), std::out_of_range);
+    EXPECT_EQ(runCount, 0u);
+}
+
+TEST(TaskSchedulerTests, CanceledGroupsSkipTheirTasks)
+{
+    TaskScheduler scheduler(2);
+    CancellationToken cancellation;
+    std::atomic<uint32_t> runCount = 0;
+    {
+        TaskGroup group(scheduler, TaskPriority::Background, &cancellation);
+        for (uint32_t i = 0; i < 1000; i++)
+        {
+            group.Run([&runCount, cancellation]() mutable
+            {
+                if (++runCount == 10)
+                {
+                    cancellation.Cancel();
+                }
+            });
+        }
+        EXPECT_THROW(group.Wait(), TaskCanceledError);
+    }
+    // Tasks that had already started finish, the others don't start
+    EXPECT_GE(runCount.load(), 10u);
+    EXPECT_LT(runCount.load(), 1000u);
+
+    // Canceling before anything runs skips everything
+    CancellationToken canceled;
+    canceled.Cancel();
+    EXPECT_THROW(ParallelFor(0, 100, [](uint32_t, uint32_t) { ADD_FAILURE(); }, TaskPriority::Visible, &canceled), TaskCanceledError);
+}
+
+TEST(TaskSchedulerTests, WaitsOnlyRunTasksAtTheirPriorityOrHigher)
+{
+    TaskScheduler scheduler(0);
+    std::vector<std::string> order;
+    scheduler.Submit([&order]() { order.push_back("Background"); }, TaskPriority::Background);
+    scheduler.Submit([&order]() { order.push_back("Interactive"); }, TaskPriority::Interactive);
+    {
+        // The interactive wait runs its own task and the other interactive
+        // one, and leaves the background task queued
+        TaskGroup group(scheduler, TaskPriority::Interactive);
+        group.Run([&order]() { order.push_back("Group"); });
+        group.Wait();
+    }
+    EXPECT_TRUE(order == std::vector<std::string>({ "Interactive", "Group" }));
+
+    // A background wait runs anything
+    {
+        TaskGroup group(scheduler, TaskPriority::Background);
+        group.Run([&order]() { order.push_back("Group"); });
+        group.Wait();
+    }
+    EXPECT_TRUE(order == std::vector<std::string>({ "Interactive", "Group", "Background", "Group" }));
+
+    // As can the scheduler's caller, if it asks for less
+    scheduler.Submit([&order]() { order.push_back("Visible"); }, TaskPriority::Visible);
+    EXPECT_FALSE(scheduler.TryRunPendingTask(TaskPriority::Interactive));
+    EXPECT_TRUE(scheduler.TryRunPendingTask(TaskPriority::Visible));
+    EXPECT_EQ(order.back(), "Visible");
+}
+
+TEST(TaskSchedulerTests, NestedGroupsDontDeadlock)
+{
+    // Every thread ends up waiting on a nested group, so the waits have
+    // to run the nested tasks themselves
+    TaskScheduler scheduler(1);
+    std::atomic<uint32_t> runCount = 0;
+    TaskGroup outer(scheduler, TaskPriority::Visible);
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        outer.Run([&]()
+        {
+            TaskGroup inner(scheduler, TaskPriority::Interactive);
+            for (uint32_t j = 0; j < 8; j++)
+            {
+                inner.Run([&runCount]() { runCount++; });
+            }
+            inner.Wait();
+        });
+    }
+    outer.Wait();
+    EXPECT_EQ(runCount.load(), 64u);
+}
+
+TEST(TaskSchedulerTests, ParallelForCoversTheRangeOnce)
+{
+    for (uint32_t workerCount = 0; workerCount <= 3; workerCount++)
+    {
+        OverriddenScheduler overridden(workerCount);
+        EXPECT_EQ(&TaskScheduler::Default(), &overridden.Scheduler);
+        // Fewer items than bands, and a count that doesn't divide evenly
+        for (uint32_t count : { 1u, 3u, 1001u })
+        {
+            std::vector<std::atomic<uint32_t>> runCounts(count + 10);
+            ParallelFor(5, 5 + count, [&runCounts](uint32_t begin, uint32_t end)
+            {
+                for (auto i = begin; i < end; i++)
+                {
+                    runCounts[i]++;
+                }
+            });
+            for (uint32_t i = 0; i < runCounts.size(); i++)
+            {
+                EXPECT_EQ(runCounts[i].load(), (i >= 5 && i < 5 + count) ? 1u : 0u) << workerCount << " workers, " << count << " items, index " << i;
+            }
+        }
+        ParallelFor(7, 7, [](uint32_t, uint32_t) { ADD_FAILURE(); });
+    }
+    EXPECT_EQ(TaskScheduler::Default().WorkerCount(), std::max(1u, std::thread::hardware_concurrency()) - 1);
+}
+
+TEST(TaskSchedulerTests, ParallelForGivesTheSameResultOnAnyThreadCount)
+{
+    // The same sum on 1 to N threads, where N is at least 4 so that there
+    // is stealing even on a single core. How it scales is measured by the
+    // ParallelFor benchmark.
+    static const uint32_t ItemCount = 1 << 20;
+    auto maxThreadCount = std::max(4u, std::thread::hardware_concurrency());
+    uint64_t expected = 0;
+    for (uint32_t threadCount = 1; threadCount <= maxThreadCount; threadCount++)
+    {
+        OverriddenScheduler overridden(threadCount - 1);
+        std::atomic<uint64_t> sum = 0;
+        std::mutex threadsLock;
+        std::set<std::thread::id> threads;
+        ParallelFor(0, ItemCount, [&](uint32_t begin, uint32_t end)
+        {
+            uint64_t bandSum = 0;
+            for (auto i = begin; i < end; i++)
+            {
+                // A little arithmetic per item, so bands aren't only overhead
+                uint64_t value = i;
+                value ^= value >> 13;
+                value *= 0x9E3779B97F4A7C15ull;
+                bandSum += value >> 40;
+            }
+            sum += bandSum;
+            std::lock_guard lock(threadsLock);
+            threads.insert(std::this_thread::get_id());
+        });
+        if (threadCount == 1)
+        {
+            expected = sum.load();
+            EXPECT_EQ(threads.size(), 1u);
+        }
+        EXPECT_EQ(sum.load(), expected) << threadCount << " threads";
+        EXPECT_LE(threads.size(), static_cast<size_t>(threadCount));
+    }
+}
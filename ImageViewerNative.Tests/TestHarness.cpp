@@ -0,0 +1,82 @@
+#include "pch.h"
+#include "TestHarness.h"
+
+// Runs every registered test, or those whose "Suite.Name" starts with
+// the --filter argument. Exits with 1 if any failed.
+
+static bool CurrentTestFailed = false;
+
+std::vector<TestHarness::TestCase>& TestHarness::Registry()
+{
+    static std::vector<TestCase> registry;
+    return registry;
+}
+
+void TestHarness::ReportFailure(char const* file, int line, std::string const& message)
+{
+    CurrentTestFailed = true;
+    std::cout << file << ":" << line << ": " << message << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--filter Suite.Name]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::vector<std::string> failed;
+    size_t runCount = 0;
+    for (auto& test : TestHarness::Registry())
+    {
+        auto name = std::string(test.Suite) + "." + test.Name;
+        if (name.compare(0, filter.size(), filter) != 0)
+        {
+            continue;
+        }
+
+        std::cout << "[ RUN      ] " << name << std::endl;
+        CurrentTestFailed = false;
+        auto begin = std::chrono::steady_clock::now();
+        try
+        {
+            test.Function();
+        }
+        catch (std::exception const& error)
+        {
+            TestHarness::ReportFailure(test.Suite, 0, std::string("Unexpected exception: ") + error.what());
+        }
+        catch (...)
+        {
+            TestHarness::ReportFailure(test.Suite, 0, "Unexpected exception");
+        }
+        auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << (CurrentTestFailed ? "[  FAILED  ] " : "[       OK ] ") << name << " (" << milliseconds << " ms)" << std::endl;
+        if (CurrentTestFailed)
+        {
+            failed.push_back(name);
+        }
+        runCount++;
+    }
+
+    std::cout << runCount << " tests ran, " << failed.size() << " failed" << std::endl;
+    for (auto& name : failed)
+    {
+        std::cout << "[  FAILED  ] " << name << std::endl;
+    }
+    if (runCount == 0)
+    {
+        std::cout << "No tests match " << filter << std::endl;
+        return 1;
+    }
+    return failed.empty() ? 0 : 1;
+}
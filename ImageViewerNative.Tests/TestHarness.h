@@ -0,0 +1,200 @@
+#pragma once
+#include <iostream>
+
+// A small test harness with the macros of Google Test, so that the tests
+// build anywhere the cores do with nothing else installed. TEST(Suite,
+// Name) registers a test, TestHarness.cpp runs them. EXPECT_ checks carry
+// on after a failure, ASSERT_ checks return from the test.
+namespace TestHarness
+{
+    struct TestCase
+    {
+        char const* Suite;
+        char const* Name;
+        void (*Function)();
+    };
+
+    std::vector<TestCase>& Registry();
+    void ReportFailure(char const* file, int line, std::string const& message);
+
+    struct Registrar
+    {
+        Registrar(char const* suite, char const* name, void (*function)())
+        {
+            Registry().push_back({ suite, name, function });
+        }
+    };
+
+    // Reports when destroyed, after any message streamed into it
+    class Failure
+    {
+    public:
+        Failure(char const* file, int line, std::string const& message) : m_file(file), m_line(line)
+        {
+            m_stream << message;
+        }
+        ~Failure()
+        {
+            ReportFailure(m_file, m_line, m_stream.str());
+        }
+
+        template <typename T>
+        Failure& operator<<(T const& value)
+        {
+            if (!m_hasDetails)
+            {
+                m_stream << "\n  ";
+                m_hasDetails = true;
+            }
+            m_stream << value;
+            return *this;
+        }
+
+    private:
+        char const* m_file;
+        int m_line;
+        bool m_hasDetails = false;
+        std::ostringstream m_stream;
+    };
+
+    // Lets ASSERT_ checks report and return in one statement
+    struct FatalFailure
+    {
+        void operator=(Failure const&) {}
+    };
+
+    struct CheckResult
+    {
+        bool Passed = true;
+        std::string Message;
+
+        explicit operator bool() const { return Passed; }
+    };
+
+    template <typename T>
+    auto PrintValue(std::ostream& stream, T const& value, int) -> decltype(stream << value, void())
+    {
+        stream << value;
+    }
+
+    template <typename T>
+    void PrintValue(std::ostream& stream, T const&, long)
+    {
+        stream << "(" << sizeof(T) << "-byte value)";
+    }
+
+    inline void PrintValue(std::ostream& stream, uint8_t value, int)
+    {
+        stream << static_cast<uint32_t>(value);
+    }
+
+    template <typename T>
+    std::string Describe(T const& value)
+    {
+        std::ostringstream stream;
+        PrintValue(stream, value, 0);
+        return stream.str();
+    }
+
+    template <typename A, typename B, typename CompareT>
+    CheckResult CheckBinary(A const& a, B const& b, CompareT const& compare, char const* aText, char const* bText, char const* op)
+    {
+        if (compare(a, b))
+        {
+            return {};
+        }
+        return { false, std::string("Expected ") + aText + " " + op + " " + bText + ", got " + Describe(a) + " and " + Describe(b) };
+    }
+
+    inline CheckResult CheckNear(double a, double b, double tolerance, char const* aText, char const* bText)
+    {
+        if (std::abs(a - b) <= tolerance)
+        {
+            return {};
+        }
+        return { false, std::string("Expected ") + aText + " within " + Describe(tolerance) + " of " + bText + ", got " + Describe(a) + " and " + Describe(b) };
+    }
+
+    inline bool AlmostEqual(double a, double b)
+    {
+        return a == b || std::abs(a - b) <= 1e-12 * std::max(std::abs(a), std::abs(b));
+    }
+
+    template <typename ExceptionT, typename FunctionT>
+    bool Throws(FunctionT const& function)
+    {
+        try
+        {
+            function();
+        }
+        catch (ExceptionT const&)
+        {
+            return true;
+        }
+        catch (...)
+        {
+            return false;
+        }
+        return false;
+    }
+
+    template <typename FunctionT>
+    bool DoesNotThrow(FunctionT const& function)
+    {
+        try
+        {
+            function();
+        }
+        catch (...)
+        {
+            return false;
+        }
+        return true;
+    }
+}
+
+#define TEST(suite, name) \
+    static void suite##_##name(); \
+    static ::TestHarness::Registrar suite##_##name##_registrar(#suite, #name, &suite##_##name); \
+    static void suite##_##name()
+
+// The switch keeps the trailing else from pairing with an outer if
+#define TEST_CHECK(result, onFailure) \
+    switch (0) case 0: default: \
+    if (auto const testResult = (result)) ; \
+    else onFailure ::TestHarness::Failure(__FILE__, __LINE__, testResult.Message)
+
+#define TEST_NONFATAL
+#define TEST_FATAL return ::TestHarness::FatalFailure() =
+
+#define TEST_BINARY(a, b, op, onFailure) \
+    TEST_CHECK(::TestHarness::CheckBinary((a), (b), [](auto const& x, auto const& y) { return x op y; }, #a, #b, #op), onFailure)
+
+#define TEST_BOOLEAN(condition, expected, message, onFailure) \
+    TEST_CHECK((::TestHarness::CheckResult{ static_cast<bool>(condition) == (expected), message }), onFailure)
+
+#define EXPECT_EQ(a, b) TEST_BINARY(a, b, ==, TEST_NONFATAL)
+#define EXPECT_NE(a, b) TEST_BINARY(a, b, !=, TEST_NONFATAL)
+#define EXPECT_LT(a, b) TEST_BINARY(a, b, <, TEST_NONFATAL)
+#define EXPECT_LE(a, b) TEST_BINARY(a, b, <=, TEST_NONFATAL)
+#define EXPECT_GT(a, b) TEST_BINARY(a, b, >, TEST_NONFATAL)
+#define EXPECT_GE(a, b) TEST_BINARY(a, b, >=, TEST_NONFATAL)
+#define EXPECT_TRUE(condition) TEST_BOOLEAN(condition, true, "Expected " #condition " to be true", TEST_NONFATAL)
+#define EXPECT_FALSE(condition) TEST_BOOLEAN(condition, false, "Expected " #condition " to be false", TEST_NONFATAL)
+#define EXPECT_NEAR(a, b, tolerance) TEST_CHECK(::TestHarness::CheckNear((a), (b), (tolerance), #a, #b), TEST_NONFATAL)
+#define EXPECT_DOUBLE_EQ(a, b) \
+    TEST_CHECK(::TestHarness::CheckBinary(static_cast<double>(a), static_cast<double>(b), &::TestHarness::AlmostEqual, #a, #b, "=="), TEST_NONFATAL)
+#define EXPECT_THROW(statement, exception) \
+    TEST_BOOLEAN(::TestHarness::Throws<exception>([&]() { statement; }), true, "Expected " #statement " to throw " #exception, TEST_NONFATAL)
+#define EXPECT_NO_THROW(statement) \
+    TEST_BOOLEAN(::TestHarness::DoesNotThrow([&]() { statement; }), true, "Expected " #statement " not to throw", TEST_NONFATAL)
+#define ADD_FAILURE() ::TestHarness::Failure(__FILE__, __LINE__, "Failed")
+
+#define ASSERT_EQ(a, b) TEST_BINARY(a, b, ==, TEST_FATAL)
+#define ASSERT_NE(a, b) TEST_BINARY(a, b, !=, TEST_FATAL)
+#define ASSERT_LT(a, b) TEST_BINARY(a, b, <, TEST_FATAL)
+#define ASSERT_LE(a, b) TEST_BINARY(a, b, <=, TEST_FATAL)
+#define ASSERT_GT(a, b) TEST_BINARY(a, b, >, TEST_FATAL)
+#define ASSERT_GE(a, b) TEST_BINARY(a, b, >=, TEST_FATAL)
+#define ASSERT_TRUE(condition) TEST_BOOLEAN(condition, true, "Expected " #condition " to be true", TEST_FATAL)
+#define ASSERT_FALSE(condition) TEST_BOOLEAN(condition, false, "Expected " #condition " to be false", TEST_FATAL)
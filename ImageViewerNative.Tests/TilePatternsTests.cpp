@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "TilePatterns.h"
+#include "TestHarness.h"
+
+static const uint32_t Light = 0xFFCCCCCC;
+static const uint32_t Dark = 0xFF999999;
+static const uint32_t Line = 0x80404040;
+// Written into the padding, which must be left alone
+static const uint32_t Guard = 0xEEEEEEEE;
+
+// A tile in padded rows, filled with the guard
+struct TestTile
+{
+    PixelRect Bounds;
+    uint32_t Stride;
+    std::vector<uint32_t> Pixels;
+
+    explicit TestTile(PixelRect const& bounds) : Bounds(bounds), Stride((bounds.Width + 3) * 4), Pixels(static_cast<size_t>(Stride / 4) * bounds.Height, Guard) {}
+
+    uint8_t* Data() { return reinterpret_cast<uint8_t*>(Pixels.data()); }
+    uint32_t At(uint32_t x, uint32_t y) const { return Pixels[(static_cast<size_t>(y) * (Stride / 4)) + x]; }
+
+    void ExpectPaddingUntouched() const
+    {
+        for (uint32_t y = 0; y < Bounds.Height; y++)
+        {
+            for (auto x = Bounds.Width; x < Stride / 4; x++)
+            {
+                EXPECT_EQ(At(x, y), Guard) << x << ", " << y;
+            }
+        }
+    }
+};
+
+TEST(TilePatternsTests, CheckerboardCellsAreInSurfaceCoordinates)
+{
+    // Starts partway through a cell, on a dark one
+    TestTile tile({ 6, 2, 7, 5 });
+    RasterizeCheckerboard(tile.Bounds, 4, Light, Dark, tile.Data(), tile.Stride);
+    for (uint32_t y = 0; y < tile.Bounds.Height; y++)
+    {
+        for (uint32_t x = 0; x < tile.Bounds.Width; x++)
+        {
+            auto cell = ((tile.Bounds.X + x) / 4) + ((tile.Bounds.Y + y) / 4);
+            EXPECT_EQ(tile.At(x, y), cell % 2 == 0 ? Light : Dark) << x << ", " << y;
+        }
+    }
+    EXPECT_EQ(tile.At(0, 0), Dark);
+    EXPECT_EQ(tile.At(2, 0), Light);
+    EXPECT_EQ(tile.At(2, 2), Dark);
+    tile.ExpectPaddingUntouched();
+}
+
+TEST(TilePatternsTests, AdjacentTilesLineUp)
+{
+    // The same 24x20 area in one piece and in four uneven tiles
+    TestTile whole({ 0, 0, 24, 20 });
+    RasterizeCheckerboard(whole.Bounds, 5, Light, Dark, whole.Data(), whole.Stride);
+    TestTile wholeGrid({ 0, 0, 24, 20 });
+    RasterizeGridLines(wholeGrid.Bounds, 6, Line, wholeGrid.Data(), wholeGrid.Stride);
+
+    const PixelRect pieces[] = { { 0, 0, 11, 7 }, { 11, 0, 13, 7 }, { 0, 7, 11, 13 }, { 11, 7, 13, 13 } };
+    for (auto& bounds : pieces)
+    {
+        TestTile piece(bounds);
+        RasterizeCheckerboard(bounds, 5, Light, Dark, piece.Data(), piece.Stride);
+        TestTile grid(bounds);
+        RasterizeGridLines(bounds, 6, Line, grid.Data(), grid.Stride);
+        for (uint32_t y = 0; y < bounds.Height; y++)
+        {
+            for (uint32_t x = 0; x < bounds.Width; x++)
+            {
+                EXPECT_EQ(piece.At(x, y), whole.At(bounds.X + x, bounds.Y + y)) << bounds.X + x << ", " << bounds.Y + y;
+                EXPECT_EQ(grid.At(x, y), wholeGrid.At(bounds.X + x, bounds.Y + y)) << bounds.X + x << ", " << bounds.Y + y;
+            }
+        }
+        piece.ExpectPaddingUntouched();
+        grid.ExpectPaddingUntouched();
+    }
+}
+
+TEST(TilePatternsTests, GridLinesEndEachCell)
+{
+    TestTile tile({ 2, 1, 9, 6 });
+    RasterizeGridLines(tile.Bounds, 4, Line, tile.Data(), tile.Stride);
+    for (uint32_t y = 0; y < tile.Bounds.Height; y++)
+    {
+        for (uint32_t x = 0; x < tile.Bounds.Width; x++)
+        {
+            // The last pixel of each cell, across and down, and clear
+            // everywhere else
+            auto onLine = (tile.Bounds.X + x) % 4 == 3 || (tile.Bounds.Y + y) % 4 == 3;
+            EXPECT_EQ(tile.At(x, y), onLine ? Line : 0u) << x << ", " << y;
+        }
+    }
+    tile.ExpectPaddingUntouched();
+
+    // A zero spacing or cell size is treated as one
+    TestTile ones({ 0, 0, 3, 2 });
+    RasterizeGridLines(ones.Bounds, 0, Line, ones.Data(), ones.Stride);
+    EXPECT_EQ(ones.At(1, 1), Line);
+    RasterizeCheckerboard(ones.Bounds, 0, Light, Dark, ones.Data(), ones.Stride);
+    EXPECT_EQ(ones.At(0, 0), Light);
+    EXPECT_EQ(ones.At(1, 0), Dark);
+    EXPECT_EQ(ones.At(1, 1), Light);
+}
@@ -0,0 +1,140 @@
+#include "pch.h"
+#include "ToneMapper.h"
+#include "HalfFloat.h"
+#include "TestHarness.h"
+#include <random>
+
+// The documented steps in double precision, with an exact sRGB curve
+// instead of a table
+static std::array<uint8_t, 4> ReferenceToneMap(uint16_t const* halfRgba, float exposureStops, ToneMapOperator op)
+{
+    double alpha = HalfToFloat(halfRgba[3]);
+    alpha = std::isnan(alpha) ? 0.0 : std::clamp(alpha, 0.0, 1.0);
+    auto alphaByte = static_cast<int32_t>(std::lround(alpha * 255.0));
+
+    std::array<uint8_t, 4> bgra = {};
+    for (size_t c = 0; c < 3; c++)
+    {
+        auto value = HalfToFloat(halfRgba[c]) * std::exp2(exposureStops) / alpha;
+        value = std::isnan(value) || value < 0.0 ? 0.0 : value;
+        if (op == ToneMapOperator::Filmic)
+        {
+            value = std::isinf(value) ? 2.51 / 2.43 : (value * ((2.51 * value) + 0.03)) / ((value * ((2.43 * value) + 0.59)) + 0.14);
+        }
+        value = std::min(value, 1.0);
+        auto encoded = value <= 0.0031308 ? value * 12.92 : (1.055 * std::pow(value, 1.0 / 2.4)) - 0.055;
+        auto encodedByte = static_cast<int32_t>(std::lround(encoded * 255.0));
+        bgra[2 - c] = static_cast<uint8_t>(((encodedByte * alphaByte) + 127) / 255);
+    }
+    bgra[3] = static_cast<uint8_t>(alphaByte);
+    return bgra;
+}
+
+static std::vector<uint8_t> ToneMapPixels(std::vector<uint16_t> const& halves, float exposureStops, ToneMapOperator op)
+{
+    // A guard past the end, which must not be written
+    std::vector<uint8_t> bgra(halves.size() + 4, 0xEE);
+    ToneMap(halves.data(), halves.size() / 4, bgra.data(), exposureStops, op);
+    for (size_t i = halves.size(); i < bgra.size(); i++)
+    {
+        EXPECT_EQ(bgra[i], 0xEE) << "byte " << i << " is past the end";
+    }
+    bgra.resize(halves.size());
+    return bgra;
+}
+
+static std::vector<uint16_t> Pixel(float red, float green, float blue, float alpha)
+{
+    return { FloatToHalf(red), FloatToHalf(green), FloatToHalf(blue), FloatToHalf(alpha) };
+}
+
+TEST(ToneMapperTests, MatchesTheReference)
+{
+    // Premultiplied values from black to well past white, with some
+    // negative, infinite and NaN channels, in more pixels than a band and
+    // not a multiple of four
+    std::mt19937 random(8);
+    std::uniform_real_distribution<float> values(-0.5f, 20.0f);
+    std::vector<uint16_t> halves(70003 * 4);
+    for (size_t i = 0; i < halves.size(); i += 4)
+    {
+        auto alpha = (i / 4) % 5 == 0 ? std::uniform_real_distribution<float>(0.0f, 1.0f)(random) : 1.0f;
+        for (size_t c = 0; c < 3; c++)
+        {
+            auto value = values(random);
+            value = value < 3.0f ? value * value / 9.0f : value;
+            halves[i + c] = FloatToHalf(value * alpha);
+        }
+        halves[i + 3] = FloatToHalf(alpha);
+    }
+    halves[0] = FloatToHalf(NAN);
+    halves[5] = FloatToHalf(INFINITY);
+    halves[10] = FloatToHalf(-INFINITY);
+    halves[15] = FloatToHalf(0.0f);
+
+    for (auto op : { ToneMapOperator::Clip, ToneMapOperator::Filmic })
+    {
+        for (auto exposureStops : { -2.5f, 0.0f, 1.0f })
+        {
+            auto bgra = ToneMapPixels(halves, exposureStops, op);
+            int32_t maxError = 0;
+            for (size_t i = 0; i < halves.size(); i += 4)
+            {
+                auto expected = ReferenceToneMap(halves.data() + i, exposureStops, op);
+                for (size_t c = 0; c < 4; c++)
+                {
+                    maxError = std::max(maxError, std::abs(bgra[i + c] - static_cast<int32_t>(expected[c])));
+                }
+            }
+            // The table is fine enough to be off by at most a level
+            EXPECT_LE(maxError, 1) << "operator " << static_cast<uint32_t>(op) << ", " << exposureStops << " stops";
+        }
+    }
+}
+
+TEST(ToneMapperTests, ClipAndFilmicHighlights)
+{
+    auto white = Pixel(1.0f, 1.0f, 1.0f, 1.0f);
+    auto bright = Pixel(4.0f, 2.0f, 1.5f, 1.0f);
+    auto clipped = ToneMapPixels(bright, 0.0f, ToneMapOperator::Clip);
+    EXPECT_TRUE(clipped == std::vector<uint8_t>({ 255, 255, 255, 255 }));
+    EXPECT_TRUE(ToneMapPixels(white, 0.0f, ToneMapOperator::Clip) == clipped);
+
+    // Filmic rolls off instead, so brighter stays brighter
+    auto filmic = ToneMapPixels(bright, 0.0f, ToneMapOperator::Filmic);
+    EXPECT_LT(filmic[0], filmic[1]);
+    EXPECT_LT(filmic[1], filmic[2]);
+    EXPECT_LT(filmic[0], 255);
+    EXPECT_EQ(filmic[3], 255);
+}
+
+TEST(ToneMapperTests, ExposureScalesByPowersOfTwo)
+{
+    auto quarter = Pixel(0.25f, 0.125f, 0.5f, 1.0f);
+    auto half = Pixel(0.5f, 0.25f, 1.0f, 1.0f);
+    for (auto op : { ToneMapOperator::Clip, ToneMapOperator::Filmic })
+    {
+        EXPECT_TRUE(ToneMapPixels(quarter, 1.0f, op) == ToneMapPixels(half, 0.0f, op));
+        EXPECT_TRUE(ToneMapPixels(half, -1.0f, op) == ToneMapPixels(quarter, 0.0f, op));
+    }
+}
+
+TEST(ToneMapperTests, InvalidValuesBecomeBlack)
+{
+    std::vector<uint16_t> halves = Pixel(NAN, -3.0f, -INFINITY, 1.0f);
+    auto transparent = Pixel(0.0f, 0.0f, 0.0f, 0.0f);
+    halves.insert(halves.end(), transparent.begin(), transparent.end());
+    auto bgra = ToneMapPixels(halves, 0.0f, ToneMapOperator::Filmic);
+    EXPECT_TRUE(bgra == std::vector<uint8_t>({ 0, 0, 0, 255, 0, 0, 0, 0 }));
+}
+
+TEST(ToneMapperTests, ColorsStayPremultiplied)
+{
+    // Half transparent white unpremultiplies to white
+    auto bgra = ToneMapPixels(Pixel(0.5f, 0.5f, 0.25f, 0.5f), 0.0f, ToneMapOperator::Clip);
+    EXPECT_EQ(bgra[3], 128);
+    EXPECT_EQ(bgra[1], 128);
+    EXPECT_EQ(bgra[2], 128);
+    // A quarter of the alpha is linear 0.5
+    EXPECT_EQ(bgra[0], (188 * 128 + 127) / 255);
+}
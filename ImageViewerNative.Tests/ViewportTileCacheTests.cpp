@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "ViewportTileCache.h"
+#include "TestHarness.h"
+#include <set>
+
+static std::set<std::pair<uint32_t, uint32_t>> AsSet(std::vector<TileCoordinate> const& tiles)
+{
+    std::set<std::pair<uint32_t, uint32_t>> set;
+    for (auto& tile : tiles)
+    {
+        set.insert({ tile.X, tile.Y });
+    }
+    return set;
+}
+
+static std::vector<TileCoordinate> Render(ViewportTileCache& cache, PixelRect const& viewport)
+{
+    std::vector<TileCoordinate> toRender;
+    std::vector<TileCoordinate> toEvict;
+    cache.UpdateViewport(viewport, toRender, toEvict);
+    EXPECT_TRUE(toEvict.empty());
+    return toRender;
+}
+
+TEST(ViewportTileCacheTests, VisibleTilesAtTheEdges)
+{
+    using Tiles = std::set<std::pair<uint32_t, uint32_t>>;
+    // 4x3 tiles, with the last column and row partial
+    const uint32_t width = 1000;
+    const uint32_t height = 600;
+    ViewportTileCache cache(width, height, 256, 100);
+
+    auto bounds = cache.TileBounds({ 3, 2 });
+    EXPECT_EQ(bounds.X, 768u);
+    EXPECT_EQ(bounds.Y, 512u);
+    EXPECT_EQ(bounds.Width, 232u);
+    EXPECT_EQ(bounds.Height, 88u);
+
+    // Exactly one tile, and a pixel either side of a corner
+    EXPECT_TRUE(AsSet(Render(cache, { 0, 0, 256, 256 })) == Tiles({ { 0, 0 } }));
+    cache.Clear();
+    EXPECT_TRUE(AsSet(Render(cache, { 255, 255, 2, 2 })) == Tiles({ { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } }));
+    cache.Clear();
+    // Hanging off the bottom right only gets the tiles that exist
+    EXPECT_TRUE(AsSet(Render(cache, { 900, 500, 500, 500 })) == Tiles({ { 3, 1 }, { 3, 2 } }));
+    cache.Clear();
+    // The whole surface, and more, is every tile once
+    auto all = Render(cache, { 0, 0, UINT32_MAX, UINT32_MAX });
+    EXPECT_EQ(all.size(), 12u);
+    EXPECT_EQ(AsSet(all).size(), 12u);
+    EXPECT_EQ(cache.ResidentCount(), 12u);
+
+    // Nothing visible changes nothing
+    cache.Clear();
+    EXPECT_TRUE(Render(cache, { width, 0, 100, 100 }).empty());
+    EXPECT_TRUE(Render(cache, { 0, height, 100, 100 }).empty());
+    EXPECT_TRUE(Render(cache, { 10, 10, 0, 100 }).empty());
+    EXPECT_TRUE(Render(cache, { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX }).empty());
+    EXPECT_EQ(cache.ResidentCount(), 0u);
+}
+
+TEST(ViewportTileCacheTests, TilesRenderFromTheCenterOnce)
+{
+    ViewportTileCache cache(1024, 1024, 64, 100);
+    // 5x5 tiles, centered on (4, 4)
+    auto tiles = Render(cache, { 130, 130, 300, 300 });
+    ASSERT_EQ(tiles.size(), 25u);
+    EXPECT_EQ(tiles[0].X, 4u);
+    EXPECT_EQ(tiles[0].Y, 4u);
+    // Then the four beside it, before any corner
+    for (size_t i = 1; i < 5; i++)
+    {
+        auto dx = std::abs(static_cast<int32_t>(tiles[i].X) - 4);
+        auto dy = std::abs(static_cast<int32_t>(tiles[i].Y) - 4);
+        EXPECT_EQ(dx + dy, 1) << "tile " << i;
+    }
+
+    // Resident tiles aren't rendered again, only the new column is
+    EXPECT_TRUE(Render(cache, { 130, 130, 300, 300 }).empty());
+    auto moved = Render(cache, { 194, 130, 300, 300 });
+    EXPECT_EQ(moved.size(), 5u);
+    for (auto& tile : moved)
+    {
+        EXPECT_EQ(tile.X, 7u);
+    }
+}
+
+TEST(ViewportTileCacheTests, LeastRecentlyVisibleTilesAreEvicted)
+{
+    // One row of ten tiles, room for four
+    ViewportTileCache cache(1000, 100, 100, 4);
+    for (uint32_t x : { 0u, 1u, 2u, 3u })
+    {
+        EXPECT_EQ(Render(cache, { x * 100, 0, 100, 100 }).size(), 1u);
+    }
+    // Seeing the first again makes the second the oldest
+    EXPECT_TRUE(Render(cache, { 0, 0, 100, 100 }).empty());
+
+    std::vector<TileCoordinate> toRender;
+    std::vector<TileCoordinate> toEvict;
+    cache.UpdateViewport({ 400, 0, 100, 100 }, toRender, toEvict);
+    ASSERT_EQ(toEvict.size(), 1u);
+    EXPECT_EQ(toEvict[0].X, 1u);
+    cache.UpdateViewport({ 500, 0, 100, 100 }, toRender, toEvict);
+    ASSERT_EQ(toEvict.size(), 1u);
+    EXPECT_EQ(toEvict[0].X, 2u);
+    EXPECT_EQ(cache.ResidentCount(), 4u);
+
+    // A viewport larger than the capacity keeps all of itself and evicts
+    // everything else, oldest first
+    cache.UpdateViewport({ 600, 0, 400, 100 }, toRender, toEvict);
+    EXPECT_EQ(toRender.size(), 4u);
+    ASSERT_EQ(toEvict.size(), 4u);
+    EXPECT_EQ(toEvict[0].X, 3u);
+    EXPECT_EQ(toEvict[1].X, 0u);
+    EXPECT_EQ(toEvict[2].X, 4u);
+    EXPECT_EQ(toEvict[3].X, 5u);
+    cache.UpdateViewport({ 0, 0, 1000, 100 }, toRender, toEvict);
+    EXPECT_EQ(toRender.size(), 6u);
+    EXPECT_TRUE(toEvict.empty());
+    EXPECT_EQ(cache.ResidentCount(), 10u);
+    // And trims back down once the viewport shrinks again
+    cache.UpdateViewport({ 0, 0, 100, 100 }, toRender, toEvict);
+    EXPECT_EQ(toEvict.size(), 6u);
+    EXPECT_EQ(cache.ResidentCount(), 4u);
+}
+
+TEST(ViewportTileCacheTests, ClearingRendersEverythingAgain)
+{
+    // Once the tiles are stale, every visible one is handed out again
+    ViewportTileCache cache(512, 512, 128, 16);
+    PixelRect viewport = { 100, 100, 300, 200 };
+    auto first = Render(cache, viewport);
+    EXPECT_EQ(first.size(), 12u);
+    EXPECT_TRUE(Render(cache, viewport).empty());
+
+    cache.Clear();
+    EXPECT_EQ(cache.ResidentCount(), 0u);
+    auto again = Render(cache, viewport);
+    EXPECT_TRUE(AsSet(again) == AsSet(first));
+    // Cleared tiles aren't reported as evicted later on
+    std::vector<TileCoordinate> toRender;
+    std::vector<TileCoordinate> toEvict;
+    cache.UpdateViewport({ 0, 0, 512, 512 }, toRender, toEvict);
+    EXPECT_EQ(toRender.size(), 4u);
+    EXPECT_TRUE(toEvict.empty());
+}
+
+TEST(ViewportTileCacheTests, ZoomingStartsOverAtTheNewScale)
+{
+    // The viewer gives a surface drawn at a new scale a cache of its own,
+    // sized to match, and the same part of the image is other tiles there
+    ViewportTileCache unscaled(500, 300, 128, 16);
+    ViewportTileCache doubled(1000, 600, 128, 16);
+    auto before = Render(unscaled, { 100, 50, 200, 100 });
+    auto after = Render(doubled, { 200, 100, 400, 200 });
+    EXPECT_EQ(before.size(), 6u);
+    EXPECT_EQ(after.size(), 12u);
+    EXPECT_EQ(doubled.TileBounds({ 7, 4 }).Width, 104u);
+    EXPECT_EQ(doubled.TileBounds({ 7, 4 }).Height, 88u);
+}
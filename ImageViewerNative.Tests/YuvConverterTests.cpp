@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "YuvConverter.h"
+#include "TestHarness.h"
+
+struct Nv12Frame
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    std::vector<uint8_t> Luma;
+    std::vector<uint8_t> Chroma;
+
+    Nv12Frame(uint32_t width, uint32_t height) :
+        Width(width), Height(height),
+        Luma(static_cast<size_t>(width) * height),
+        Chroma(static_cast<size_t>((width + 1) / 2) * 2 * ((height + 1) / 2)) {}
+
+    uint32_t ChromaStride() const { return ((Width + 1) / 2) * 2; }
+
+    std::vector<uint8_t> Convert(YuvMatrix matrix) const
+    {
+        std::vector<uint8_t> bgra(static_cast<size_t>(Width) * Height * 4);
+        ConvertNv12ToBgra(Luma.data(), Width, Chroma.data(), ChromaStride(), bgra.data(), Width * 4, Width, Height, matrix);
+        return bgra;
+    }
+};
+
+// The conversion in floating point
+static std::array<double, 3> ReferenceBgr(int y, int u, int v, YuvMatrix matrix)
+{
+    auto kr = matrix == YuvMatrix::Bt709 ? 0.2126 : 0.299;
+    auto kb = matrix == YuvMatrix::Bt709 ? 0.0722 : 0.114;
+    auto kg = 1.0 - kr - kb;
+    auto luma = (y - 16) * 255.0 / 219.0;
+    auto cb = (u - 128) * 255.0 / 224.0;
+    auto cr = (v - 128) * 255.0 / 224.0;
+    auto r = luma + (2.0 * (1.0 - kr) * cr);
+    auto b = luma + (2.0 * (1.0 - kb) * cb);
+    auto g = (luma - (kr * r) - (kb * b)) / kg;
+    auto clamp = [](double value) { return std::clamp(value, 0.0, 255.0); };
+    return { clamp(b), clamp(g), clamp(r) };
+}
+
+TEST(YuvConverterTests, BlackAndWhiteAreTheEndsOfTheRange)
+{
+    Nv12Frame frame(16, 2);
+    std::fill(frame.Chroma.begin(), frame.Chroma.end(), 128);
+    std::fill(frame.Luma.begin(), frame.Luma.begin() + 16, 16);
+    std::fill(frame.Luma.begin() + 16, frame.Luma.end(), 235);
+
+    auto bgra = frame.Convert(YuvMatrix::Bt709);
+    for (uint32_t x = 0; x < 16; x++)
+    {
+        EXPECT_EQ(bgra[(x * 4) + 0], 0);
+        EXPECT_EQ(bgra[(x * 4) + 2], 0);
+        EXPECT_EQ(bgra[(x * 4) + 3], 255);
+        EXPECT_EQ(bgra[((16 + x) * 4) + 1], 255);
+        EXPECT_EQ(bgra[((16 + x) * 4) + 3], 255);
+    }
+}
+
+TEST(YuvConverterTests, MatchesTheReferenceWithinALevel)
+{
+    // Odd sizes cover the scalar tail and the last, unpaired column
+    for (auto matrix : { YuvMatrix::Bt601, YuvMatrix::Bt709 })
+    {
+        Nv12Frame frame(37, 9);
+        uint32_t state = 12345;
+        auto next = [&]()
+        {
+            state = (state * 1103515245) + 12345;
+            return static_cast<uint8_t>(state >> 16);
+        };
+        std::generate(frame.Luma.begin(), frame.Luma.end(), next);
+        std::generate(frame.Chroma.begin(), frame.Chroma.end(), next);
+
+        auto bgra = frame.Convert(matrix);
+        for (uint32_t y = 0; y < frame.Height; y++)
+        {
+            for (uint32_t x = 0; x < frame.Width; x++)
+            {
+                auto pair = frame.Chroma.data() + ((y / 2) * frame.ChromaStride()) + (x & ~1u);
+                auto expected = ReferenceBgr(frame.Luma[(y * frame.Width) + x], pair[0], pair[1], matrix);
+                auto pixel = bgra.data() + (((y * frame.Width) + x) * 4);
+                for (size_t c = 0; c < 3; c++)
+                {
+                    EXPECT_NEAR(pixel[c], expected[c], 1.0) << "at " << x << ", " << y;
+                }
+                EXPECT_EQ(pixel[3], 255);
+            }
+        }
+    }
+}
+
+TEST(YuvConverterTests, RowsDontDependOnTheirNeighbours)
+{
+    // A frame converted whole is the same as each row pair converted alone,
+    // so bands on different threads can't bleed into each other
+    Nv12Frame frame(64, 64);
+    for (size_t i = 0; i < frame.Luma.size(); i++)
+    {
+        frame.Luma[i] = static_cast<uint8_t>(i * 7);
+    }
+    for (size_t i = 0; i < frame.Chroma.size(); i++)
+    {
+        frame.Chroma[i] = static_cast<uint8_t>(i * 13);
+    }
+    auto whole = frame.Convert(YuvMatrix::Bt709);
+
+    std::vector<uint8_t> rows(whole.size());
+    for (uint32_t y = 0; y < frame.Height; y += 2)
+    {
+        ConvertNv12ToBgra(
+            frame.Luma.data() + (y * frame.Width), frame.Width,
+            frame.Chroma.data() + ((y / 2) * frame.ChromaStride()), frame.ChromaStride(),
+            rows.data() + (y * frame.Width * 4), frame.Width * 4, frame.Width, 2, YuvMatrix::Bt709);
+    }
+    EXPECT_EQ(rows, whole);
+}
@@ -0,0 +1,139 @@
+#include "pch.h"
+#include "BackgroundFrameWriter.h"
+#include "Profiler.h"
+
+static ProfileStage CopyStage("BackgroundFrameWriter.Copy");
+static ProfileStage WriteStage("BackgroundFrameWriter.Write");
+static ProfileStage FinishStage("BackgroundFrameWriter.Finish");
+static ProfileCounter QueueDepthCounter("BackgroundFrameWriter.QueueDepth");
+static ProfileCounter DroppedFrameCounter("BackgroundFrameWriter.DroppedFrames");
+// Nanoseconds the writer spent behind, with frames being dropped
+static ProfileCounter QueueFullCounter("BackgroundFrameWriter.QueueFullNanoseconds");
+// Nanoseconds callers of Finish waited for the queue to be written out
+static ProfileCounter FinishWaitCounter("BackgroundFrameWriter.FinishWaitNanoseconds");
+
+BackgroundFrameWriter::BackgroundFrameWriter(std::unique_ptr<RmRawFrameStreamWriter> writer, size_t capacity)
+{
+    m_writer = std::move(writer);
+    m_capacity = std::max<size_t>(capacity, 1);
+    m_frameSize = static_cast<size_t>(m_writer->Width()) * m_writer->Height() * 4;
+    m_thread = std::thread([this]() { Run(); });
+}
+
+BackgroundFrameWriter::~BackgroundFrameWriter()
+{
+    try
+    {
+        Finish();
+    }
+    catch (...)
+    {
+        // Errors are only reported to callers of Finish
+    }
+}
+
+bool BackgroundFrameWriter::TryEnqueue(uint8_t const* bgraPixels, uint32_t stride, int64_t timestamp)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_finishing || m_error || m_queue.size() >= m_capacity)
+        {
+            if (!m_finishing && !m_error && m_queueFullSince < 0 && Profiler::IsEnabled())
+            {
+                m_queueFullSince = Profiler::Now();
+            }
+            m_droppedFrameCount++;
+            DroppedFrameCounter.Add(1);
+            return false;
+        }
+    }
+
+    // Buffers come back to the pool once written, so at most the queue
+    // plus the one being written are out at a time. Copy outside of the
+    // lock so the writer isn't held up.
+    auto buffer = BufferPool::Shared().Acquire(m_frameSize);
+    {
+        ProfileScope scope(CopyStage);
+        auto rowSize = static_cast<size_t>(m_writer->Width()) * 4;
+        for (uint32_t y = 0; y < m_writer->Height(); y++)
+        {
+            memcpy(buffer.Data() + (y * rowSize), bgraPixels + (static_cast<size_t>(y) * stride), rowSize);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        // Finish may have been called from another thread during the copy
+        if (m_finishing || m_error)
+        {
+            m_droppedFrameCount++;
+            DroppedFrameCounter.Add(1);
+            return false;
+        }
+        m_queue.push_back({ std::move(buffer), timestamp });
+        QueueDepthCounter.Set(static_cast<int64_t>(m_queue.size()));
+    }
+    m_condition.notify_one();
+    return true;
+}
+
+void BackgroundFrameWriter::Finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_finishing = true;
+    }
+    m_condition.notify_one();
+    if (m_thread.joinable())
+    {
+        ProfileScope scope(FinishStage, &FinishWaitCounter);
+        m_thread.join();
+    }
+
+    if (m_error)
+    {
+        auto error = m_error;
+        m_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void BackgroundFrameWriter::Run()
+{
+    try
+    {
+        while (true)
+        {
+            QueuedFrame frame;
+            {
+                std::unique_lock<std::mutex> lock(m_lock);
+                m_condition.wait(lock, [this]() { return m_finishing || !m_queue.empty(); });
+                if (m_queue.empty())
+                {
+                    break;
+                }
+                frame = std::move(m_queue.front());
+                m_queue.pop_front();
+                QueueDepthCounter.Set(static_cast<int64_t>(m_queue.size()));
+                if (m_queueFullSince >= 0)
+                {
+                    QueueFullCounter.Add(Profiler::Now() - m_queueFullSince);
+                    m_queueFullSince = -1;
+                }
+            }
+
+            {
+                ProfileScope scope(WriteStage);
+                m_writer->WriteFrame(frame.Pixels.Data(), m_writer->Width() * 4, frame.Timestamp);
+            }
+            m_writtenFrameCount++;
+        }
+        m_writer->Finish();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_error = std::current_exception();
+        m_queue.clear();
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "RmRawFrameStream.h"
+#include "BufferPool.h"
+
+// Hands frames from a producer (the capture thread) to a writer thread
+// through a bounded queue. The producer only ever copies pixels; when
+// the queue is full the frame is dropped instead of waiting on I/O.
+class BackgroundFrameWriter
+{
+public:
+    BackgroundFrameWriter(std::unique_ptr<RmRawFrameStreamWriter> writer, size_t capacity);
+    ~BackgroundFrameWriter();
+
+    // Returns false if the frame was dropped.
+    bool TryEnqueue(uint8_t const* bgraPixels, uint32_t stride, int64_t timestamp);
+    // Writes out the queued frames and the index, then stops the writer
+    // thread. Rethrows the first error the writer ran into.
+    void Finish();
+
+    uint64_t WrittenFrameCount() const { return m_writtenFrameCount; }
+    uint64_t DroppedFrameCount() const { return m_droppedFrameCount; }
+
+private:
+    struct QueuedFrame
+    {
+        PooledBuffer Pixels;
+        int64_t Timestamp = 0;
+    };
+
+    void Run();
+
+private:
+    std::unique_ptr<RmRawFrameStreamWriter> m_writer;
+    size_t m_capacity = 0;
+    size_t m_frameSize = 0;
+
+    std::mutex m_lock;
+    std::condition_variable m_condition;
+    std::deque<QueuedFrame> m_queue;
+    bool m_finishing = false;
+    std::exception_ptr m_error;
+    // When the queue filled up, while the profiler is enabled. Frames are
+    // dropped until the writer catches up.
+    int64_t m_queueFullSince = -1;
+
+    std::atomic<uint64_t> m_writtenFrameCount = 0;
+    std::atomic<uint64_t> m_droppedFrameCount = 0;
+    std::thread m_thread;
+};
@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "BackgroundScopeAnalyzer.h"
+#include "Profiler.h"
+
+static ProfileStage CopyStage("BackgroundScopeAnalyzer.Copy");
+static ProfileCounter SkippedFrameCounter("BackgroundScopeAnalyzer.SkippedFrames");
+
+BackgroundScopeAnalyzer::BackgroundScopeAnalyzer(uint32_t width, uint32_t height, uint32_t sampleStep)
+{
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument("The frame size must not be empty.");
+    }
+    if (sampleStep == 0)
+    {
+        throw std::invalid_argument("The sample step must be at least 1.");
+    }
+    m_width = width;
+    m_height = height;
+    m_sampleStep = sampleStep;
+    m_sampledWidth = (width + sampleStep - 1) / sampleStep;
+    m_sampledHeight = (height + sampleStep - 1) / sampleStep;
+    m_samples = BufferPool::Shared().Acquire(static_cast<size_t>(m_sampledWidth) * m_sampledHeight * 4);
+}
+
+BackgroundScopeAnalyzer::~BackgroundScopeAnalyzer()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_idle.wait(lock, [this]() { return !m_busy; });
+}
+
+bool BackgroundScopeAnalyzer::TryEnqueue(uint8_t const* bgraPixels, uint32_t stride)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_busy)
+        {
+            m_skippedFrameCount++;
+            SkippedFrameCounter.Add(1);
+            return false;
+        }
+        m_busy = true;
+    }
+
+    {
+        ProfileScope scope(CopyStage);
+        auto rowSize = static_cast<size_t>(m_sampledWidth) * 4;
+        auto dest = m_samples.Data();
+        for (uint32_t y = 0; y < m_sampledHeight; y++)
+        {
+            auto row = bgraPixels + (static_cast<size_t>(y) * m_sampleStep * stride);
+            auto destRow = dest + (y * rowSize);
+            if (m_sampleStep == 1)
+            {
+                memcpy(destRow, row, rowSize);
+                continue;
+            }
+            for (uint32_t x = 0; x < m_sampledWidth; x++)
+            {
+                memcpy(destRow + (static_cast<size_t>(x) * 4), row + (static_cast<size_t>(x) * m_sampleStep * 4), 4);
+            }
+        }
+    }
+
+    // Without workers nothing would ever run the task, so the frame is
+    // analyzed here instead
+    auto& scheduler = TaskScheduler::Default();
+    if (scheduler.WorkerCount() == 0)
+    {
+        Analyze();
+        return true;
+    }
+    scheduler.Submit([this]() { Analyze(); }, TaskPriority::Visible);
+    return true;
+}
+
+std::shared_ptr<FrameScopes const> BackgroundScopeAnalyzer::Latest() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_latest;
+}
+
+void BackgroundScopeAnalyzer::Analyze()
+{
+    std::shared_ptr<FrameScopes const> scopes;
+    try
+    {
+        // The copy is already sampled
+        scopes = std::make_shared<FrameScopes const>(ComputeScopes(
+            m_samples.Data(), m_sampledWidth, m_sampledHeight, m_sampledWidth * 4, 1, TaskPriority::Visible));
+    }
+    catch (...)
+    {
+        // A frame that fails to analyze is as good as skipped
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (scopes != nullptr)
+        {
+            m_latest = std::move(scopes);
+            m_analyzedFrameCount++;
+        }
+        m_busy = false;
+        // Notified under the lock, since the destructor may be waiting
+        // to free the condition variable
+        m_idle.notify_all();
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "FrameScopes.h"
+#include "BufferPool.h"
+
+// Computes the scopes of a live stream of frames on the shared
+// TaskScheduler. The producer (the capture thread) copies the sampled
+// pixels of a frame only when the previous one is done; frames that
+// arrive while one is being analyzed are skipped, so the analysis never
+// holds up frame delivery, except on a single core, where there's no
+// other thread to analyze them on.
+class BackgroundScopeAnalyzer
+{
+public:
+    BackgroundScopeAnalyzer(uint32_t width, uint32_t height, uint32_t sampleStep);
+    // Waits for the frame being analyzed
+    ~BackgroundScopeAnalyzer();
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t SampleStep() const { return m_sampleStep; }
+
+    // Returns false if the frame was skipped.
+    bool TryEnqueue(uint8_t const* bgraPixels, uint32_t stride);
+    // The scopes of the last analyzed frame, null before the first
+    std::shared_ptr<FrameScopes const> Latest() const;
+
+    uint64_t AnalyzedFrameCount() const { return m_analyzedFrameCount; }
+    uint64_t SkippedFrameCount() const { return m_skippedFrameCount; }
+
+private:
+    void Analyze();
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_sampleStep = 1;
+    uint32_t m_sampledWidth = 0;
+    uint32_t m_sampledHeight = 0;
+    // Only the sampled pixels are copied, tightly packed. Owned by the
+    // analysis while it runs.
+    PooledBuffer m_samples;
+
+    mutable std::mutex m_lock;
+    std::condition_variable m_idle;
+    bool m_busy = false;
+    std::shared_ptr<FrameScopes const> m_latest;
+
+    std::atomic<uint64_t> m_analyzedFrameCount = 0;
+    std::atomic<uint64_t> m_skippedFrameCount = 0;
+};
@@ -0,0 +1,180 @@
+#include "pch.h"
+#include "BlockDiffer.h"
+#include "ParallelFor.h"
+#include "SimdHelpers.h"
+
+BlockDiffer::BlockDiffer(uint32_t width, uint32_t height)
+{
+    m_width = width;
+    m_height = height;
+    m_blocksWide = (width + BlockSize - 1) / BlockSize;
+    m_blocksHigh = (height + BlockSize - 1) / BlockSize;
+    m_reference.resize(static_cast<size_t>(width) * height * 4);
+    m_dirtyBlocks.resize(static_cast<size_t>(m_blocksWide) * m_blocksHigh);
+}
+
+std::vector<PixelRect> const& BlockDiffer::Compare(uint8_t const* bgraPixels, uint32_t stride)
+{
+    if (m_hasReference)
+    {
+        std::fill(m_dirtyBlocks.begin(), m_dirtyBlocks.end(), static_cast<uint8_t>(0));
+    }
+    else
+    {
+        std::fill(m_dirtyBlocks.begin(), m_dirtyBlocks.end(), static_cast<uint8_t>(1));
+    }
+
+    // Block rows are independent of each other
+    auto hasReference = m_hasReference;
+    ParallelFor(0, m_blocksHigh, [&](uint32_t blockRowBegin, uint32_t blockRowEnd)
+    {
+        if (hasReference)
+        {
+            FindDirtyBlocks(bgraPixels, stride, blockRowBegin, blockRowEnd);
+        }
+        UpdateReference(bgraPixels, stride, blockRowBegin, blockRowEnd);
+    });
+    m_hasReference = true;
+
+    MergeDirtyBlocks();
+    return m_dirtyRects;
+}
+
+bool BlockDiffer::RowSegmentDiffers(uint8_t const* first, uint8_t const* second, uint32_t size)
+{
+    uint32_t i = 0;
+#ifdef IMAGEVIEWER_SSE2
+    // OR together the differences and test once at the end, the rows
+    // are short enough that an early out per load isn't worth it
+    auto differences = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16)
+    {
+        auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first + i));
+        auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(second + i));
+        differences = _mm_or_si128(differences, _mm_xor_si128(a, b));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(differences, _mm_setzero_si128())) != 0xFFFF)
+    {
+        return true;
+    }
+#endif
+    return memcmp(first + i, second + i, size - i) != 0;
+}
+
+void BlockDiffer::FindDirtyBlocks(uint8_t const* pixels, uint32_t stride, uint32_t blockRowBegin, uint32_t blockRowEnd)
+{
+    auto referenceStride = static_cast<size_t>(m_width) * 4;
+    for (uint32_t blockY = blockRowBegin; blockY < blockRowEnd; blockY++)
+    {
+        auto dirtyRow = m_dirtyBlocks.data() + (static_cast<size_t>(blockY) * m_blocksWide);
+        auto rowBegin = blockY * BlockSize;
+        auto rowEnd = std::min(rowBegin + BlockSize, m_height);
+        // Walk the band a row at a time so both images are read
+        // sequentially, skipping blocks that are already known to be dirty
+        for (auto y = rowBegin; y < rowEnd; y++)
+        {
+            auto sourceRow = pixels + (static_cast<size_t>(y) * stride);
+            auto referenceRow = m_reference.data() + (y * referenceStride);
+            for (uint32_t blockX = 0; blockX < m_blocksWide; blockX++)
+            {
+                if (dirtyRow[blockX])
+                {
+                    continue;
+                }
+                auto x = blockX * BlockSize;
+                auto size = (std::min(x + BlockSize, m_width) - x) * 4;
+                if (RowSegmentDiffers(sourceRow + (x * 4), referenceRow + (x * 4), size))
+                {
+                    dirtyRow[blockX] = 1;
+                }
+            }
+        }
+    }
+}
+
+void BlockDiffer::UpdateReference(uint8_t const* pixels, uint32_t stride, uint32_t blockRowBegin, uint32_t blockRowEnd)
+{
+    auto referenceStride = static_cast<size_t>(m_width) * 4;
+    for (uint32_t blockY = blockRowBegin; blockY < blockRowEnd; blockY++)
+    {
+        auto dirtyRow = m_dirtyBlocks.data() + (static_cast<size_t>(blockY) * m_blocksWide);
+        auto rowBegin = blockY * BlockSize;
+        auto rowEnd = std::min(rowBegin + BlockSize, m_height);
+        uint32_t blockX = 0;
+        while (blockX < m_blocksWide)
+        {
+            if (!dirtyRow[blockX])
+            {
+                blockX++;
+                continue;
+            }
+
+            // Copy runs of dirty blocks with one memcpy per row
+            auto runBegin = blockX;
+            while (blockX < m_blocksWide && dirtyRow[blockX])
+            {
+                blockX++;
+            }
+            auto x = runBegin * BlockSize;
+            auto size = (std::min(blockX * BlockSize, m_width) - x) * 4;
+            for (auto y = rowBegin; y < rowEnd; y++)
+            {
+                memcpy(m_reference.data() + (y * referenceStride) + (x * 4), pixels + (static_cast<size_t>(y) * stride) + (x * 4), size);
+            }
+        }
+    }
+}
+
+void BlockDiffer::MergeDirtyBlocks()
+{
+    m_dirtyRects.clear();
+    m_dirtyPixelCount = 0;
+
+    // Runs of dirty blocks in a block row become rectangles, which are
+    // extended downwards while the row below has the same run
+    std::vector<PixelRect> open;
+    std::vector<PixelRect> nextOpen;
+    for (uint32_t blockY = 0; blockY < m_blocksHigh; blockY++)
+    {
+        auto dirtyRow = m_dirtyBlocks.data() + (static_cast<size_t>(blockY) * m_blocksWide);
+        auto y = blockY * BlockSize;
+        auto height = std::min(y + BlockSize, m_height) - y;
+        nextOpen.clear();
+
+        uint32_t blockX = 0;
+        while (blockX < m_blocksWide)
+        {
+            if (!dirtyRow[blockX])
+            {
+                blockX++;
+                continue;
+            }
+            auto runBegin = blockX;
+            while (blockX < m_blocksWide && dirtyRow[blockX])
+            {
+                blockX++;
+            }
+            auto x = runBegin * BlockSize;
+            auto width = std::min(blockX * BlockSize, m_width) - x;
+            m_dirtyPixelCount += static_cast<uint64_t>(width) * height;
+
+            auto above = std::find_if(open.begin(), open.end(), [=](PixelRect const& rect) { return rect.X == x && rect.Width == width; });
+            if (above != open.end())
+            {
+                auto rect = *above;
+                rect.Height += height;
+                nextOpen.push_back(rect);
+                open.erase(above);
+            }
+            else
+            {
+                nextOpen.push_back({ x, y, width, height });
+            }
+        }
+
+        // Whatever wasn't continued is finished
+        m_dirtyRects.insert(m_dirtyRects.end(), open.begin(), open.end());
+        std::swap(open, nextOpen);
+    }
+    m_dirtyRects.insert(m_dirtyRects.end(), open.begin(), open.end());
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "PixelRect.h"
+
+// Compares consecutive BGRA8 frames in fixed-size blocks and reports
+// the rectangles that changed. The previous frame is kept as a
+// reference, and only its dirty blocks are refreshed after a compare.
+class BlockDiffer
+{
+public:
+    static constexpr uint32_t BlockSize = 32;
+
+    BlockDiffer(uint32_t width, uint32_t height);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+
+    // The first frame after construction or Reset() is entirely dirty.
+    // Adjacent dirty blocks are merged into larger rectangles.
+    std::vector<PixelRect> const& Compare(uint8_t const* bgraPixels, uint32_t stride);
+    uint64_t DirtyPixelCount() const { return m_dirtyPixelCount; }
+    void Reset() { m_hasReference = false; }
+
+private:
+    void FindDirtyBlocks(uint8_t const* pixels, uint32_t stride, uint32_t blockRowBegin, uint32_t blockRowEnd);
+    void UpdateReference(uint8_t const* pixels, uint32_t stride, uint32_t blockRowBegin, uint32_t blockRowEnd);
+    void MergeDirtyBlocks();
+
+    static bool RowSegmentDiffers(uint8_t const* first, uint8_t const* second, uint32_t size);
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_blocksWide = 0;
+    uint32_t m_blocksHigh = 0;
+    bool m_hasReference = false;
+    std::vector<uint8_t> m_reference;
+    std::vector<uint8_t> m_dirtyBlocks;
+    std::vector<PixelRect> m_dirtyRects;
+    uint64_t m_dirtyPixelCount = 0;
+};
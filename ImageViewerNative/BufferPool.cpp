@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "BufferPool.h"
+#include "Profiler.h"
+
+static ProfileCounter AllocationCounter("BufferPool.Allocations");
+static ProfileCounter ReuseCounter("BufferPool.Reuses");
+static ProfileCounter IdleBytesCounter("BufferPool.IdleBytes");
+
+PooledBuffer::PooledBuffer(std::shared_ptr<Pool> pool, Storage data, size_t size, size_t capacity)
+{
+    m_pool = std::move(pool);
+    m_data = std::move(data);
+    m_size = size;
+    m_capacity = capacity;
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        m_pool = std::move(other.m_pool);
+        m_data = std::move(other.m_data);
+        m_size = std::exchange(other.m_size, 0);
+        m_capacity = std::exchange(other.m_capacity, 0);
+    }
+    return *this;
+}
+
+void PooledBuffer::Release()
+{
+    if (m_data != nullptr)
+    {
+        m_pool->Return(m_capacity, std::move(m_data));
+        if (Profiler::IsEnabled())
+        {
+            IdleBytesCounter.Set(static_cast<int64_t>(m_pool->Statistics().IdleCost));
+        }
+    }
+    m_pool = nullptr;
+    m_size = 0;
+    m_capacity = 0;
+}
+
+BufferPool& BufferPool::Shared()
+{
+    static BufferPool pool;
+    return pool;
+}
+
+size_t BufferPool::ClassSize(size_t size)
+{
+    if (size <= MinimumClassSize)
+    {
+        return MinimumClassSize;
+    }
+    size_t power = MinimumClassSize;
+    while (power * 2 <= size)
+    {
+        power *= 2;
+    }
+    auto step = power / 4;
+    return (size + step - 1) / step * step;
+}
+
+BufferPool::BufferPool(size_t maxIdleBytes)
+{
+    m_pool = std::make_shared<PooledBuffer::Pool>(maxIdleBytes, [](size_t const& capacity) { return capacity; });
+}
+
+PooledBuffer BufferPool::Acquire(size_t size)
+{
+    auto capacity = ClassSize(size);
+    auto created = false;
+    auto data = m_pool->Take(capacity, [&]()
+    {
+        created = true;
+        // Not value-initialized, new leases don't pay for zeroing
+        return PooledBuffer::Storage(new uint8_t[capacity]);
+    });
+    if (created)
+    {
+        AllocationCounter.Add(1);
+    }
+    else
+    {
+        ReuseCounter.Add(1);
+    }
+    return PooledBuffer(m_pool, std::move(data), size, capacity);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "KeyedPool.h"
+
+class BufferPool;
+
+// A buffer leased from a BufferPool, handed back when the lease is
+// released or destroyed. The contents of a new lease are undefined.
+class PooledBuffer
+{
+public:
+    PooledBuffer() = default;
+    ~PooledBuffer() { Release(); }
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(PooledBuffer const&) = delete;
+    PooledBuffer& operator=(PooledBuffer const&) = delete;
+
+    uint8_t* Data() { return m_data.get(); }
+    uint8_t const* Data() const { return m_data.get(); }
+    size_t Size() const { return m_size; }
+    size_t Capacity() const { return m_capacity; }
+    bool Empty() const { return m_data == nullptr; }
+
+    void Release();
+
+private:
+    friend class BufferPool;
+
+    using Storage = std::unique_ptr<uint8_t[]>;
+    using Pool = KeyedPool<size_t, Storage>;
+
+    PooledBuffer(std::shared_ptr<Pool> pool, Storage data, size_t size, size_t capacity);
+
+private:
+    std::shared_ptr<Pool> m_pool;
+    Storage m_data;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+};
+
+// Recycles CPU buffers (frames, staging copies, encoder scratch) in size
+// classes, so that a steady stream of same-sized work stops allocating
+// after the first few buffers. Classes are a quarter of a power of two
+// apart, so a buffer is at most 25% larger than asked for.
+class BufferPool
+{
+public:
+    static constexpr size_t MinimumClassSize = 4096;
+    static constexpr size_t DefaultMaxIdleBytes = 512 * 1024 * 1024;
+
+    // Shared by the native kernels
+    static BufferPool& Shared();
+    static size_t ClassSize(size_t size);
+
+    explicit BufferPool(size_t maxIdleBytes = DefaultMaxIdleBytes);
+
+    PooledBuffer Acquire(size_t size);
+    // Frees idle buffers beyond what was leased at once since the last
+    // call.
+    void Trim() { m_pool->Trim(); }
+    PoolStatistics Statistics() const { return m_pool->Statistics(); }
+
+private:
+    std::shared_ptr<PooledBuffer::Pool> m_pool;
+};
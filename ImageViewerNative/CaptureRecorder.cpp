@@ -0,0 +1,46 @@
+#include "pch.h"
+#include "CaptureRecorder.h"
+#include "CaptureRecorder.g.cpp"
+#include "StreamInterop.h"
+
+namespace winrt
+{
+    using namespace Windows::Graphics;
+    using namespace Windows::Storage::Streams;
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    CaptureRecorder::CaptureRecorder(winrt::IRandomAccessStream const& stream, winrt::SizeInt32 const& size, uint32_t queueCapacity)
+    {
+        if (size.Width <= 0 || size.Height <= 0)
+        {
+            throw winrt::hresult_invalid_argument(L"The frame size must not be empty.");
+        }
+
+        m_size = size;
+        m_stream = CreateStreamOverRandomAccessStream(stream);
+        auto rawStream = m_stream.get();
+        auto writer = std::make_unique<RmRawFrameStreamWriter>([rawStream](uint8_t const* data, size_t dataSize)
+        {
+            WriteToStream(rawStream, data, dataSize);
+        }, static_cast<uint32_t>(size.Width), static_cast<uint32_t>(size.Height));
+        m_writer = std::make_unique<BackgroundFrameWriter>(std::move(writer), queueCapacity);
+    }
+
+    void CaptureRecorder::Finish()
+    {
+        m_writer->Finish();
+        winrt::check_hresult(m_stream->Commit(STGC_DEFAULT));
+    }
+
+    bool CaptureRecorder::TryEnqueue(uint8_t const* bgraPixels, uint32_t stride, int64_t timestamp)
+    {
+        // Timestamps are stored relative to the first recorded frame
+        if (!m_firstTimestamp.has_value())
+        {
+            m_firstTimestamp = timestamp;
+        }
+        return m_writer->TryEnqueue(bgraPixels, stride, timestamp - *m_firstTimestamp);
+    }
+}
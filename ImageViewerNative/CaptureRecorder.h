@@ -0,0 +1,32 @@
+#pragma once
+#include "CaptureRecorder.g.h"
+#include "BackgroundFrameWriter.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct CaptureRecorder : CaptureRecorderT<CaptureRecorder>
+    {
+        CaptureRecorder(winrt::Windows::Storage::Streams::IRandomAccessStream const& stream, winrt::Windows::Graphics::SizeInt32 const& size, uint32_t queueCapacity);
+
+        winrt::Windows::Graphics::SizeInt32 Size() { return m_size; }
+        uint64_t WrittenFrameCount() { return m_writer->WrittenFrameCount(); }
+        uint64_t DroppedFrameCount() { return m_writer->DroppedFrameCount(); }
+        void Finish();
+
+        // Called on the capture thread with the frame mapped, but not the
+        // device locked. Only copies.
+        bool TryEnqueue(uint8_t const* bgraPixels, uint32_t stride, int64_t timestamp);
+
+    private:
+        winrt::com_ptr<IStream> m_stream;
+        winrt::Windows::Graphics::SizeInt32 m_size = {};
+        std::unique_ptr<BackgroundFrameWriter> m_writer;
+        std::optional<int64_t> m_firstTimestamp;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct CaptureRecorder : CaptureRecorderT<CaptureRecorder, implementation::CaptureRecorder>
+    {
+    };
+}
@@ -0,0 +1,86 @@
+#include "pch.h"
+#include "Checksums.h"
+
+static const uint32_t AdlerModulus = 65521;
+// The most bytes that can be summed before the 32-bit sums could overflow
+static const size_t AdlerMaxRun = 5552;
+
+// Slicing-by-4 tables for the reflected polynomial 0xEDB88320
+static std::array<std::array<uint32_t, 256>, 4> BuildCrcTables()
+{
+    std::array<std::array<uint32_t, 256>, 4> tables = {};
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        auto value = i;
+        for (auto bit = 0; bit < 8; bit++)
+        {
+            value = (value & 1) ? (0xEDB88320 ^ (value >> 1)) : (value >> 1);
+        }
+        tables[0][i] = value;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        for (size_t slice = 1; slice < tables.size(); slice++)
+        {
+            auto previous = tables[slice - 1][i];
+            tables[slice][i] = (previous >> 8) ^ tables[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+uint32_t Crc32(uint32_t crc, uint8_t const* data, size_t size)
+{
+    static const auto tables = BuildCrcTables();
+
+    crc = ~crc;
+    while (size >= 4)
+    {
+        uint32_t word = 0;
+        memcpy(&word, data, sizeof(word));
+        // Little-endian, like every platform we build for
+        crc ^= word;
+        crc = tables[3][crc & 0xFF] ^ tables[2][(crc >> 8) & 0xFF] ^ tables[1][(crc >> 16) & 0xFF] ^ tables[0][crc >> 24];
+        data += 4;
+        size -= 4;
+    }
+    while (size > 0)
+    {
+        crc = tables[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+        data++;
+        size--;
+    }
+    return ~crc;
+}
+
+uint32_t Adler32(uint32_t adler, uint8_t const* data, size_t size)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0)
+    {
+        auto run = std::min(size, AdlerMaxRun);
+        size -= run;
+        for (size_t i = 0; i < run; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        data += run;
+        a %= AdlerModulus;
+        b %= AdlerModulus;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t Adler32Combine(uint32_t adlerA, uint32_t adlerB, uint64_t sizeB)
+{
+    // B's sums start from 1 and 0, so shift them by A's. Every byte of B
+    // also adds A's first sum to the second sum once.
+    auto remainder = static_cast<uint32_t>(sizeB % AdlerModulus);
+    uint64_t a = (adlerA & 0xFFFF) + (adlerB & 0xFFFF) + AdlerModulus - 1;
+    uint64_t b = (static_cast<uint64_t>(remainder) * (adlerA & 0xFFFF)) + (adlerA >> 16) + (adlerB >> 16) + AdlerModulus - remainder;
+    a %= AdlerModulus;
+    b %= AdlerModulus;
+    return static_cast<uint32_t>((b << 16) | a);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// CRC-32 (as used by PNG) and Adler-32 (as used by zlib). Start both
+// from their initial values (0 and 1) and pass the result back in to
+// continue over more data.
+uint32_t Crc32(uint32_t crc, uint8_t const* data, size_t size);
+uint32_t Adler32(uint32_t adler, uint8_t const* data, size_t size);
+// The Adler-32 of A followed by B, from the checksums of A and B and the
+// size of B. Lets pieces of a buffer be checksummed in parallel.
+uint32_t Adler32Combine(uint32_t adlerA, uint32_t adlerB, uint64_t sizeB);
@@ -0,0 +1,441 @@
+#include "pch.h"
+#include "ColorConverter.h"
+#include "Checksums.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "SimdHelpers.h"
+
+static ProfileStage ApplyStage("ColorConverter.Apply");
+
+// Fewer rows than this aren't worth handing to the scheduler
+static const uint32_t SerialRowPixels = 64 * 1024;
+
+// Unpremultiplies an 8-bit color, rounded
+static uint32_t Unpremultiply(uint32_t value, uint32_t alpha)
+{
+    return std::min(((value * 255) + (alpha / 2)) / alpha, 255u);
+}
+
+static uint8_t Premultiply(uint32_t value, uint32_t alpha)
+{
+    return static_cast<uint8_t>(((value * alpha) + 127) / 255);
+}
+
+static std::string ParametricKey(ColorSpace const& source, ColorSpace const& dest)
+{
+    return std::string("parametric:") +
+        ToString(source.Primaries) + "/" + ToString(source.Transfer) + ">" +
+        ToString(dest.Primaries) + "/" + ToString(dest.Transfer);
+}
+
+#ifndef IMAGEVIEWER_SSE2
+// The SSE2 path rounds four channels at once the same way
+static uint8_t ToLevel(float value)
+{
+    return static_cast<uint8_t>((std::clamp(value, 0.0f, 1.0f) * 255.0f) + 0.5f);
+}
+#endif
+
+std::shared_ptr<ColorConverter const> ColorConverter::CreateParametric(ColorSpace const& source, ColorSpace const& dest)
+{
+    std::shared_ptr<ColorConverter> transform(new ColorConverter());
+    transform->m_kind = Kind::Parametric;
+    transform->m_key = ParametricKey(source, dest);
+    transform->m_isIdentity = source == dest;
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        transform->m_decode[i] = static_cast<float>(DecodeTransfer(source.Transfer, i / 255.0));
+    }
+    auto matrix = ConversionMatrix(source.Primaries, dest.Primaries);
+    for (size_t column = 0; column < 3; column++)
+    {
+        for (size_t row = 0; row < 3; row++)
+        {
+            transform->m_matrixColumns[column][row] = static_cast<float>(matrix[(row * 3) + column]);
+        }
+    }
+
+    // Level k covers the signals from (k - 0.5) / 255 to (k + 0.5) / 255
+    for (uint32_t level = 0; level < 255; level++)
+    {
+        transform->m_thresholds[level] = static_cast<float>(DecodeTransfer(dest.Transfer, (level + 0.5) / 255.0));
+    }
+    // Linear values are clipped to 1, so nothing rounds up past 255
+    transform->m_thresholds[255] = 2.0f;
+    // Indexed by the square root of the linear value, which spreads the
+    // buckets out near black, where gamma curves are steepest
+    transform->m_encodeLevels.resize(EncodeTableSize);
+    uint32_t level = 0;
+    for (uint32_t i = 0; i < EncodeTableSize; i++)
+    {
+        auto root = static_cast<float>(i) / (EncodeTableSize - 1);
+        auto linear = root * root;
+        while (linear >= transform->m_thresholds[level])
+        {
+            level++;
+        }
+        transform->m_encodeLevels[i] = static_cast<uint8_t>(level);
+    }
+    return transform;
+}
+
+std::shared_ptr<ColorConverter const> ColorConverter::CreateFromCube(CubeLut const& lut, std::string key)
+{
+    if (lut.Size < CubeLut::MinSize || lut.Entries.size() != static_cast<size_t>(lut.Size) * lut.Size * lut.Size * 3)
+    {
+        throw std::invalid_argument("The LUT doesn't have Size^3 entries.");
+    }
+
+    std::shared_ptr<ColorConverter> transform(new ColorConverter());
+    transform->m_kind = Kind::Lut;
+    transform->m_key = std::move(key);
+    transform->m_lutSize = lut.Size;
+
+    auto entryCount = lut.Entries.size() / 3;
+    transform->m_lutEntries.resize(entryCount * 4);
+    for (size_t i = 0; i < entryCount; i++)
+    {
+        std::copy_n(lut.Entries.data() + (i * 3), 3, transform->m_lutEntries.data() + (i * 4));
+    }
+
+    // The lattice strides of red, green and blue, in entries
+    uint32_t strides[3] = { 1, lut.Size, lut.Size * lut.Size };
+    auto lastCell = static_cast<float>(lut.Size - 2);
+    for (size_t channel = 0; channel < 3; channel++)
+    {
+        auto domainMin = lut.DomainMin[channel];
+        auto domainSize = lut.DomainMax[channel] - domainMin;
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            auto position = std::clamp(((i / 255.0f) - domainMin) / domainSize, 0.0f, 1.0f) * (lut.Size - 1);
+            auto cell = std::min(std::floor(position), lastCell);
+            transform->m_lutOffsets[channel][i] = static_cast<uint32_t>(cell) * strides[channel];
+            transform->m_lutFractions[channel][i] = position - cell;
+        }
+    }
+    return transform;
+}
+
+void ColorConverter::TransformParametric(uint32_t r, uint32_t g, uint32_t b, uint8_t* out) const
+{
+    // The linear color in the destination primaries, clipped to its gamut,
+    // and where it falls in the encode table
+    alignas(16) float linear[4];
+    alignas(16) int32_t buckets[4];
+#ifdef IMAGEVIEWER_SSE2
+    auto color = _mm_add_ps(
+        _mm_add_ps(
+            _mm_mul_ps(_mm_set1_ps(m_decode[r]), _mm_loadu_ps(m_matrixColumns[0].data())),
+            _mm_mul_ps(_mm_set1_ps(m_decode[g]), _mm_loadu_ps(m_matrixColumns[1].data()))),
+        _mm_mul_ps(_mm_set1_ps(m_decode[b]), _mm_loadu_ps(m_matrixColumns[2].data())));
+    color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    _mm_store_ps(linear, color);
+    _mm_store_si128(reinterpret_cast<__m128i*>(buckets), _mm_cvttps_epi32(_mm_mul_ps(_mm_sqrt_ps(color), _mm_set1_ps(EncodeTableSize - 1))));
+#else
+    for (size_t row = 0; row < 3; row++)
+    {
+        auto value = ((m_decode[r] * m_matrixColumns[0][row]) + (m_decode[g] * m_matrixColumns[1][row])) + (m_decode[b] * m_matrixColumns[2][row]);
+        linear[row] = std::clamp(value, 0.0f, 1.0f);
+        buckets[row] = static_cast<int32_t>(std::sqrt(linear[row]) * (EncodeTableSize - 1));
+    }
+#endif
+
+    for (size_t channel = 0; channel < 3; channel++)
+    {
+        auto value = linear[channel];
+        uint32_t level = m_encodeLevels[buckets[channel]];
+        // The table is exact at the start of each bucket, and the buckets
+        // are narrower than a level, so this takes at most a step
+        while (value >= m_thresholds[level])
+        {
+            level++;
+        }
+        while (level > 0 && value < m_thresholds[level - 1])
+        {
+            level--;
+        }
+        out[channel] = static_cast<uint8_t>(level);
+    }
+}
+
+void ColorConverter::TransformLut(uint32_t r, uint32_t g, uint32_t b, uint8_t* out) const
+{
+    auto size = m_lutSize;
+    auto fr = m_lutFractions[0][r];
+    auto fg = m_lutFractions[1][g];
+    auto fb = m_lutFractions[2][b];
+    auto base = m_lutEntries.data() + (static_cast<size_t>(m_lutOffsets[0][r] + m_lutOffsets[1][g] + m_lutOffsets[2][b]) * 4);
+
+    // The cell is split into six tetrahedra along its diagonal. The one
+    // holding the color is picked by the order of the fractions, and its
+    // four corners are weighted by the differences between them.
+    size_t strideR = 4;
+    size_t strideG = static_cast<size_t>(size) * 4;
+    size_t strideB = static_cast<size_t>(size) * size * 4;
+    size_t second = 0;
+    size_t third = 0;
+    float w0 = 0.0f;
+    float w1 = 0.0f;
+    float w2 = 0.0f;
+    float w3 = 0.0f;
+    if (fr > fg)
+    {
+        if (fg > fb)
+        {
+            second = strideR;
+            third = strideR + strideG;
+            w0 = 1.0f - fr; w1 = fr - fg; w2 = fg - fb; w3 = fb;
+        }
+        else if (fr > fb)
+        {
+            second = strideR;
+            third = strideR + strideB;
+            w0 = 1.0f - fr; w1 = fr - fb; w2 = fb - fg; w3 = fg;
+        }
+        else
+        {
+            second = strideB;
+            third = strideR + strideB;
+            w0 = 1.0f - fb; w1 = fb - fr; w2 = fr - fg; w3 = fg;
+        }
+    }
+    else
+    {
+        if (fb > fg)
+        {
+            second = strideB;
+            third = strideG + strideB;
+            w0 = 1.0f - fb; w1 = fb - fg; w2 = fg - fr; w3 = fr;
+        }
+        else if (fb > fr)
+        {
+            second = strideG;
+            third = strideG + strideB;
+            w0 = 1.0f - fg; w1 = fg - fb; w2 = fb - fr; w3 = fr;
+        }
+        else
+        {
+            second = strideG;
+            third = strideR + strideG;
+            w0 = 1.0f - fg; w1 = fg - fr; w2 = fr - fb; w3 = fb;
+        }
+    }
+    auto last = strideR + strideG + strideB;
+
+#ifdef IMAGEVIEWER_SSE2
+    auto color = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(base), _mm_set1_ps(w0)), _mm_mul_ps(_mm_loadu_ps(base + second), _mm_set1_ps(w1))),
+        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(base + third), _mm_set1_ps(w2)), _mm_mul_ps(_mm_loadu_ps(base + last), _mm_set1_ps(w3))));
+    color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    auto levels = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(color, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+    alignas(16) int32_t values[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(values), levels);
+    for (size_t channel = 0; channel < 3; channel++)
+    {
+        out[channel] = static_cast<uint8_t>(values[channel]);
+    }
+#else
+    for (size_t channel = 0; channel < 3; channel++)
+    {
+        auto value = ((base[channel] * w0) + (base[second + channel] * w1)) + ((base[third + channel] * w2) + (base[last + channel] * w3));
+        out[channel] = ToLevel(value);
+    }
+#endif
+}
+
+void ColorConverter::ApplyToRow(uint8_t const* source, uint8_t* dest, uint32_t width) const
+{
+    // Runs of the same color are common in screenshots and flat areas, so
+    // the last result is kept. Transparent black maps to itself.
+    uint32_t lastSource = 0;
+    uint32_t lastDest = 0;
+    for (uint32_t x = 0; x < width; x++)
+    {
+        auto pixel = source + (static_cast<size_t>(x) * 4);
+        auto destPixel = dest + (static_cast<size_t>(x) * 4);
+        uint32_t value = 0;
+        memcpy(&value, pixel, 4);
+        if (value == lastSource)
+        {
+            memcpy(destPixel, &lastDest, 4);
+            continue;
+        }
+
+        uint8_t result[4] = {};
+        uint32_t alpha = pixel[3];
+        if (alpha != 0)
+        {
+            uint32_t r = pixel[2];
+            uint32_t g = pixel[1];
+            uint32_t b = pixel[0];
+            if (alpha < 255)
+            {
+                r = Unpremultiply(r, alpha);
+                g = Unpremultiply(g, alpha);
+                b = Unpremultiply(b, alpha);
+            }
+
+            uint8_t rgb[3];
+            if (m_kind == Kind::Parametric)
+            {
+                TransformParametric(r, g, b, rgb);
+            }
+            else
+            {
+                TransformLut(r, g, b, rgb);
+            }
+
+            if (alpha < 255)
+            {
+                for (auto& channel : rgb)
+                {
+                    channel = Premultiply(channel, alpha);
+                }
+            }
+            result[0] = rgb[2];
+            result[1] = rgb[1];
+            result[2] = rgb[0];
+            result[3] = static_cast<uint8_t>(alpha);
+        }
+
+        lastSource = value;
+        memcpy(&lastDest, result, 4);
+        memcpy(destPixel, result, 4);
+    }
+}
+
+void ColorConverter::Apply(
+    uint8_t const* source, uint32_t sourceStride,
+    uint8_t* dest, uint32_t destStride,
+    uint32_t width, uint32_t height, TaskPriority priority) const
+{
+    ProfileScope scope(ApplyStage);
+    auto rowSize = static_cast<size_t>(width) * 4;
+    auto transformRows = [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end; y++)
+        {
+            auto sourceRow = source + (static_cast<size_t>(y) * sourceStride);
+            auto destRow = dest + (static_cast<size_t>(y) * destStride);
+            if (!m_isIdentity)
+            {
+                ApplyToRow(sourceRow, destRow, width);
+            }
+            else if (sourceRow != destRow)
+            {
+                memcpy(destRow, sourceRow, rowSize);
+            }
+        }
+    };
+
+    if (static_cast<uint64_t>(width) * height <= SerialRowPixels)
+    {
+        transformRows(0, height);
+    }
+    else
+    {
+        ParallelFor(0, height, transformRows, priority);
+    }
+}
+
+ColorConverterCache& ColorConverterCache::Shared()
+{
+    static ColorConverterCache cache;
+    return cache;
+}
+
+ColorConverterCache::ColorConverterCache(size_t capacity)
+{
+    m_capacity = std::max<size_t>(capacity, 1);
+}
+
+std::shared_ptr<ColorConverter const> ColorConverterCache::GetParametric(ColorSpace const& source, ColorSpace const& dest)
+{
+    return GetOrCreate(ParametricKey(source, dest), {}, [&]()
+    {
+        return ColorConverter::CreateParametric(source, dest);
+    });
+}
+
+std::shared_ptr<ColorConverter const> ColorConverterCache::GetCube(std::string_view text)
+{
+    auto checksum = Crc32(0, reinterpret_cast<uint8_t const*>(text.data()), text.size());
+    std::ostringstream key;
+    key << "cube:" << std::hex << checksum << ":" << std::dec << text.size();
+    return GetOrCreate(key.str(), text, [&]()
+    {
+        return ColorConverter::CreateFromCube(CubeLut::Parse(text), key.str());
+    });
+}
+
+size_t ColorConverterCache::Count() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_lru.size();
+}
+
+std::shared_ptr<ColorConverter const> ColorConverterCache::GetOrCreate(std::string const& key, std::string_view source, Builder const& create)
+{
+    std::promise<std::shared_ptr<ColorConverter const>> promise;
+    std::shared_future<std::shared_ptr<ColorConverter const>> converter;
+    uint64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto found = m_entries.find(key);
+        if (found != m_entries.end() && found->second.Source == source)
+        {
+            m_lru.splice(m_lru.begin(), m_lru, found->second.Position);
+            converter = found->second.Converter;
+        }
+        else if (found == m_entries.end())
+        {
+            // Anyone else asking for it waits on the future instead of
+            // building it again
+            converter = promise.get_future().share();
+            id = ++m_nextId;
+            m_lru.push_front(key);
+            m_entries.emplace(key, Entry{ std::string(source), converter, m_lru.begin(), id });
+        }
+    }
+
+    // Another source with the same key. The entry it collides with stays.
+    if (!converter.valid())
+    {
+        return create();
+    }
+    if (id == 0)
+    {
+        return converter.get();
+    }
+
+    try
+    {
+        promise.set_value(create());
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto found = m_entries.find(key);
+        if (found != m_entries.end() && found->second.Id == id)
+        {
+            m_lru.erase(found->second.Position);
+            m_entries.erase(found);
+        }
+        throw;
+    }
+
+    // Only dropped once this one is built, so a build that fails doesn't
+    // push out a transform that's still good. Entries still being built
+    // can go too, their callers hold the future.
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        while (m_lru.size() > m_capacity)
+        {
+            m_entries.erase(m_lru.back());
+            m_lru.pop_back();
+        }
+    }
+    return converter.get();
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "ColorSpaces.h"
+#include "CubeLut.h"
+#include "TaskScheduler.h"
+
+// Converts premultiplied BGRA8 pixels from one encoding to another, either
+// parametrically (decode, change primaries, encode) or through a 3D LUT
+// with tetrahedral interpolation. Colors are unpremultiplied around the
+// transform and alpha is kept. Everything that can be worked out ahead of
+// time for 8-bit input is, so build each transform once and reuse it
+// through the ColorConverterCache.
+class ColorConverter
+{
+public:
+    // Size of the table that finds the 8-bit level of a linear value
+    static constexpr uint32_t EncodeTableSize = 16384;
+
+    // Out of gamut colors are clipped
+    static std::shared_ptr<ColorConverter const> CreateParametric(ColorSpace const& source, ColorSpace const& dest);
+    // Input values are 8-bit values / 255 in the LUT's domain. Outputs
+    // are clipped to 0-1.
+    static std::shared_ptr<ColorConverter const> CreateFromCube(CubeLut const& lut, std::string key);
+
+    // Identifies the transform in the cache
+    std::string const& Key() const { return m_key; }
+    bool IsIdentity() const { return m_isIdentity; }
+
+    // Source and dest may be the same pixels. Works on any rectangle of a
+    // larger image, like a single display tile.
+    void Apply(
+        uint8_t const* source, uint32_t sourceStride,
+        uint8_t* dest, uint32_t destStride,
+        uint32_t width, uint32_t height, TaskPriority priority = TaskPriority::Visible) const;
+
+private:
+    enum class Kind
+    {
+        Parametric,
+        Lut,
+    };
+
+    ColorConverter() = default;
+    void ApplyToRow(uint8_t const* source, uint8_t* dest, uint32_t width) const;
+    void TransformParametric(uint32_t r, uint32_t g, uint32_t b, uint8_t* out) const;
+    void TransformLut(uint32_t r, uint32_t g, uint32_t b, uint8_t* out) const;
+
+private:
+    Kind m_kind = Kind::Parametric;
+    std::string m_key;
+    bool m_isIdentity = false;
+
+    // Parametric: 8-bit signal to linear, the primaries as the columns of
+    // the conversion matrix (padded to 4), and back to 8-bit. The encode
+    // table gives the level at the start of each bucket of linear values,
+    // which the thresholds then correct to the exactly rounded level.
+    std::array<float, 256> m_decode = {};
+    std::array<std::array<float, 4>, 3> m_matrixColumns = {};
+    std::vector<uint8_t> m_encodeLevels;
+    // The linear value from which each level rounds up to the next
+    std::array<float, 256> m_thresholds = {};
+
+    // LUT: RGB entries padded to 4 floats. For each 8-bit input of each
+    // channel, the offset of the lattice cell below it and how far into
+    // the cell it is.
+    uint32_t m_lutSize = 0;
+    std::vector<float> m_lutEntries;
+    std::array<std::array<uint32_t, 256>, 3> m_lutOffsets = {};
+    std::array<std::array<float, 256>, 3> m_lutFractions = {};
+};
+
+// Transforms are built once per key and shared. The least recently used
+// are dropped once over capacity; callers holding one keep it alive.
+// Building happens outside the lock, so a large LUT doesn't hold up
+// lookups of other transforms. Callers asking for one that's being
+// built wait for it.
+class ColorConverterCache
+{
+public:
+    static constexpr size_t DefaultCapacity = 16;
+
+    static ColorConverterCache& Shared();
+
+    explicit ColorConverterCache(size_t capacity = DefaultCapacity);
+
+    std::shared_ptr<ColorConverter const> GetParametric(ColorSpace const& source, ColorSpace const& dest);
+    // Keyed by the checksum and length of the text, so the same file is
+    // only parsed once. The text is kept to tell apart files whose keys
+    // collide; those are built again each time instead of cached.
+    std::shared_ptr<ColorConverter const> GetCube(std::string_view text);
+
+    size_t Count() const;
+
+private:
+    using Builder = std::function<std::shared_ptr<ColorConverter const>()>;
+
+    struct Entry
+    {
+        // What the key was made from, when the key alone could collide
+        std::string Source;
+        std::shared_future<std::shared_ptr<ColorConverter const>> Converter;
+        std::list<std::string>::iterator Position;
+        uint64_t Id = 0;
+    };
+
+    std::shared_ptr<ColorConverter const> GetOrCreate(std::string const& key, std::string_view source, Builder const& create);
+
+private:
+    size_t m_capacity = 0;
+    mutable std::mutex m_lock;
+    // Keys, most recently used at the front
+    std::list<std::string> m_lru;
+    std::unordered_map<std::string, Entry> m_entries;
+    // Tells a failed build's entry apart from one added for the same key
+    // after it was dropped
+    uint64_t m_nextId = 0;
+};
@@ -0,0 +1,169 @@
+#include "pch.h"
+#include "ColorSpaces.h"
+
+struct Chromaticity
+{
+    double X;
+    double Y;
+};
+
+static const Chromaticity D65 = { 0.3127, 0.3290 };
+
+// BT.709 / BT.2020 camera curve constants
+static const double Bt709Alpha = 1.099;
+static const double Bt709Beta = 0.018;
+
+static std::array<Chromaticity, 3> PrimaryChromaticities(ColorPrimaries primaries)
+{
+    switch (primaries)
+    {
+    case ColorPrimaries::Bt709:
+        return { { { 0.640, 0.330 }, { 0.300, 0.600 }, { 0.150, 0.060 } } };
+    case ColorPrimaries::DisplayP3:
+        return { { { 0.680, 0.320 }, { 0.265, 0.690 }, { 0.150, 0.060 } } };
+    case ColorPrimaries::Bt2020:
+        return { { { 0.708, 0.292 }, { 0.170, 0.797 }, { 0.131, 0.046 } } };
+    default:
+        throw std::invalid_argument("Unknown color primaries.");
+    }
+}
+
+// XYZ with Y = 1
+static std::array<double, 3> ToXyz(Chromaticity const& chromaticity)
+{
+    return { chromaticity.X / chromaticity.Y, 1.0, (1.0 - chromaticity.X - chromaticity.Y) / chromaticity.Y };
+}
+
+static ColorMatrix Multiply(ColorMatrix const& first, ColorMatrix const& second)
+{
+    ColorMatrix result = {};
+    for (size_t row = 0; row < 3; row++)
+    {
+        for (size_t column = 0; column < 3; column++)
+        {
+            for (size_t k = 0; k < 3; k++)
+            {
+                result[(row * 3) + column] += first[(row * 3) + k] * second[(k * 3) + column];
+            }
+        }
+    }
+    return result;
+}
+
+static ColorMatrix Invert(ColorMatrix const& m)
+{
+    auto c00 = (m[4] * m[8]) - (m[5] * m[7]);
+    auto c01 = (m[5] * m[6]) - (m[3] * m[8]);
+    auto c02 = (m[3] * m[7]) - (m[4] * m[6]);
+    auto determinant = (m[0] * c00) + (m[1] * c01) + (m[2] * c02);
+    return
+    {
+        c00 / determinant, ((m[2] * m[7]) - (m[1] * m[8])) / determinant, ((m[1] * m[5]) - (m[2] * m[4])) / determinant,
+        c01 / determinant, ((m[0] * m[8]) - (m[2] * m[6])) / determinant, ((m[2] * m[3]) - (m[0] * m[5])) / determinant,
+        c02 / determinant, ((m[1] * m[6]) - (m[0] * m[7])) / determinant, ((m[0] * m[4]) - (m[1] * m[3])) / determinant,
+    };
+}
+
+ColorMatrix RgbToXyzMatrix(ColorPrimaries primaries)
+{
+    // The primaries are scaled so that RGB 1, 1, 1 lands on the white point
+    auto chromaticities = PrimaryChromaticities(primaries);
+    ColorMatrix unscaled = {};
+    for (size_t column = 0; column < 3; column++)
+    {
+        auto xyz = ToXyz(chromaticities[column]);
+        for (size_t row = 0; row < 3; row++)
+        {
+            unscaled[(row * 3) + column] = xyz[row];
+        }
+    }
+    auto white = ToXyz(D65);
+    auto inverse = Invert(unscaled);
+    ColorMatrix result = {};
+    for (size_t column = 0; column < 3; column++)
+    {
+        auto scale = (inverse[(column * 3) + 0] * white[0]) + (inverse[(column * 3) + 1] * white[1]) + (inverse[(column * 3) + 2] * white[2]);
+        for (size_t row = 0; row < 3; row++)
+        {
+            result[(row * 3) + column] = unscaled[(row * 3) + column] * scale;
+        }
+    }
+    return result;
+}
+
+ColorMatrix ConversionMatrix(ColorPrimaries from, ColorPrimaries to)
+{
+    if (from == to)
+    {
+        return { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 };
+    }
+    return Multiply(Invert(RgbToXyzMatrix(to)), RgbToXyzMatrix(from));
+}
+
+double DecodeTransfer(TransferFunction transfer, double signal)
+{
+    signal = std::clamp(signal, 0.0, 1.0);
+    switch (transfer)
+    {
+    case TransferFunction::Linear:
+        return signal;
+    case TransferFunction::Srgb:
+        return signal <= 0.04045 ? signal / 12.92 : std::pow((signal + 0.055) / 1.055, 2.4);
+    case TransferFunction::Bt709:
+        return signal < Bt709Beta * 4.5 ? signal / 4.5 : std::pow((signal + (Bt709Alpha - 1.0)) / Bt709Alpha, 1.0 / 0.45);
+    case TransferFunction::Bt1886:
+        return std::pow(signal, 2.4);
+    default:
+        throw std::invalid_argument("Unknown transfer function.");
+    }
+}
+
+double EncodeTransfer(TransferFunction transfer, double linear)
+{
+    linear = std::clamp(linear, 0.0, 1.0);
+    switch (transfer)
+    {
+    case TransferFunction::Linear:
+        return linear;
+    case TransferFunction::Srgb:
+        return linear <= 0.0031308 ? linear * 12.92 : (1.055 * std::pow(linear, 1.0 / 2.4)) - 0.055;
+    case TransferFunction::Bt709:
+        return linear < Bt709Beta ? linear * 4.5 : (Bt709Alpha * std::pow(linear, 0.45)) - (Bt709Alpha - 1.0);
+    case TransferFunction::Bt1886:
+        return std::pow(linear, 1.0 / 2.4);
+    default:
+        throw std::invalid_argument("Unknown transfer function.");
+    }
+}
+
+char const* ToString(ColorPrimaries primaries)
+{
+    switch (primaries)
+    {
+    case ColorPrimaries::Bt709:
+        return "bt709";
+    case ColorPrimaries::DisplayP3:
+        return "p3";
+    case ColorPrimaries::Bt2020:
+        return "bt2020";
+    default:
+        throw std::invalid_argument("Unknown color primaries.");
+    }
+}
+
+char const* ToString(TransferFunction transfer)
+{
+    switch (transfer)
+    {
+    case TransferFunction::Linear:
+        return "linear";
+    case TransferFunction::Srgb:
+        return "srgb";
+    case TransferFunction::Bt709:
+        return "bt709";
+    case TransferFunction::Bt1886:
+        return "bt1886";
+    default:
+        throw std::invalid_argument("Unknown transfer function.");
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// All of these share the D65 white point
+enum class ColorPrimaries : uint32_t
+{
+    // Also sRGB
+    Bt709 = 0,
+    DisplayP3 = 1,
+    Bt2020 = 2,
+};
+
+enum class TransferFunction : uint32_t
+{
+    Linear = 0,
+    // IEC 61966-2-1, also used by Display P3
+    Srgb = 1,
+    // The BT.709 (and BT.2020) camera curve
+    Bt709 = 2,
+    // The BT.1886 display curve, a pure 2.4 gamma for a zero black level
+    Bt1886 = 3,
+};
+
+struct ColorSpace
+{
+    ColorPrimaries Primaries = ColorPrimaries::Bt709;
+    TransferFunction Transfer = TransferFunction::Srgb;
+
+    bool operator==(ColorSpace const& other) const { return Primaries == other.Primaries && Transfer == other.Transfer; }
+    bool operator!=(ColorSpace const& other) const { return !(*this == other); }
+};
+
+// Row major, applied to column vectors
+using ColorMatrix = std::array<double, 9>;
+
+ColorMatrix RgbToXyzMatrix(ColorPrimaries primaries);
+// Linear RGB in one set of primaries to linear RGB in another. Colors
+// outside of the destination gamut come out below 0 or above 1.
+ColorMatrix ConversionMatrix(ColorPrimaries from, ColorPrimaries to);
+
+// Signal (0-1) to linear light (0-1), and back
+double DecodeTransfer(TransferFunction transfer, double signal);
+double EncodeTransfer(TransferFunction transfer, double linear);
+
+char const* ToString(ColorPrimaries primaries);
+char const* ToString(TransferFunction transfer);
@@ -0,0 +1,77 @@
+#include "pch.h"
+#include "ColorTransform.h"
+#include "ColorTransform.g.cpp"
+
+static ColorPrimaries ToColorPrimaries(winrt::ImageViewerNative::ColorPrimaries const& primaries)
+{
+    switch (primaries)
+    {
+    case winrt::ImageViewerNative::ColorPrimaries::Bt709:
+        return ColorPrimaries::Bt709;
+    case winrt::ImageViewerNative::ColorPrimaries::DisplayP3:
+        return ColorPrimaries::DisplayP3;
+    case winrt::ImageViewerNative::ColorPrimaries::Bt2020:
+        return ColorPrimaries::Bt2020;
+    default:
+        throw winrt::hresult_invalid_argument(L"Unknown color primaries.");
+    }
+}
+
+static TransferFunction ToTransferFunction(winrt::ImageViewerNative::TransferFunction const& transfer)
+{
+    switch (transfer)
+    {
+    case winrt::ImageViewerNative::TransferFunction::Linear:
+        return TransferFunction::Linear;
+    case winrt::ImageViewerNative::TransferFunction::Srgb:
+        return TransferFunction::Srgb;
+    case winrt::ImageViewerNative::TransferFunction::Bt709:
+        return TransferFunction::Bt709;
+    case winrt::ImageViewerNative::TransferFunction::Bt1886:
+        return TransferFunction::Bt1886;
+    default:
+        throw winrt::hresult_invalid_argument(L"Unknown transfer function.");
+    }
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    ColorTransform::ColorTransform(std::shared_ptr<ColorConverter const> converter)
+    {
+        m_converter = std::move(converter);
+    }
+
+    winrt::ImageViewerNative::ColorTransform ColorTransform::CreateParametric(
+        winrt::ImageViewerNative::ColorPrimaries const& sourcePrimaries,
+        winrt::ImageViewerNative::TransferFunction const& sourceTransfer,
+        winrt::ImageViewerNative::ColorPrimaries const& destPrimaries,
+        winrt::ImageViewerNative::TransferFunction const& destTransfer)
+    {
+        ColorSpace source;
+        source.Primaries = ToColorPrimaries(sourcePrimaries);
+        source.Transfer = ToTransferFunction(sourceTransfer);
+        ColorSpace dest;
+        dest.Primaries = ToColorPrimaries(destPrimaries);
+        dest.Transfer = ToTransferFunction(destTransfer);
+        return winrt::make<ColorTransform>(ColorConverterCache::Shared().GetParametric(source, dest));
+    }
+
+    winrt::ImageViewerNative::ColorTransform ColorTransform::CreateFromCube(winrt::hstring const& cubeText)
+    {
+        // Parse errors come back as E_INVALIDARG with their message
+        auto text = winrt::to_string(cubeText);
+        return winrt::make<ColorTransform>(ColorConverterCache::Shared().GetCube(text));
+    }
+
+    winrt::com_array<uint8_t> ColorTransform::Apply(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height)
+    {
+        if (bgraPixels.size() < static_cast<uint64_t>(width) * height * 4)
+        {
+            throw winrt::hresult_invalid_argument(L"The pixel buffer is smaller than the given size.");
+        }
+
+        winrt::com_array<uint8_t> pixels(width * height * 4);
+        m_converter->Apply(bgraPixels.data(), width * 4, pixels.data(), width * 4, width, height);
+        return pixels;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "ColorTransform.g.h"
+#include "ColorConverter.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct ColorTransform : ColorTransformT<ColorTransform>
+    {
+        ColorTransform(std::shared_ptr<ColorConverter const> converter);
+
+        static winrt::ImageViewerNative::ColorTransform CreateParametric(
+            winrt::ImageViewerNative::ColorPrimaries const& sourcePrimaries,
+            winrt::ImageViewerNative::TransferFunction const& sourceTransfer,
+            winrt::ImageViewerNative::ColorPrimaries const& destPrimaries,
+            winrt::ImageViewerNative::TransferFunction const& destTransfer);
+        static winrt::ImageViewerNative::ColorTransform CreateFromCube(winrt::hstring const& cubeText);
+
+        winrt::hstring Key() { return winrt::to_hstring(m_converter->Key()); }
+        winrt::com_array<uint8_t> Apply(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height);
+
+    private:
+        std::shared_ptr<ColorConverter const> m_converter;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct ColorTransform : ColorTransformT<ColorTransform, implementation::ColorTransform>
+    {
+    };
+}
@@ -0,0 +1,164 @@
+#include "pch.h"
+#include "CubeLut.h"
+
+static std::invalid_argument ParseError(size_t lineNumber, char const* message)
+{
+    return std::invalid_argument("Line " + std::to_string(lineNumber) + " of the .cube file: " + message);
+}
+
+static bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static std::string_view Trim(std::string_view text)
+{
+    while (!text.empty() && IsSpace(text.front()))
+    {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && IsSpace(text.back()))
+    {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// Splits off the next whitespace separated token
+static std::string_view NextToken(std::string_view& text)
+{
+    text = Trim(text);
+    size_t length = 0;
+    while (length < text.size() && !IsSpace(text[length]))
+    {
+        length++;
+    }
+    auto token = text.substr(0, length);
+    text.remove_prefix(length);
+    return token;
+}
+
+static bool TryParseFloat(std::string_view token, float& value)
+{
+    auto end = token.data() + token.size();
+    auto result = std::from_chars(token.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+static void ParseFloats(std::string_view text, float* values, size_t count, size_t lineNumber)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!TryParseFloat(NextToken(text), values[i]))
+        {
+            throw ParseError(lineNumber, "expected a number.");
+        }
+    }
+    if (!Trim(text).empty())
+    {
+        throw ParseError(lineNumber, "unexpected text after the numbers.");
+    }
+}
+
+CubeLut CubeLut::Parse(std::string_view text)
+{
+    CubeLut lut;
+    size_t lineNumber = 0;
+    size_t expectedCount = 0;
+    while (!text.empty())
+    {
+        auto lineEnd = text.find('\n');
+        auto line = Trim(text.substr(0, lineEnd));
+        text.remove_prefix(lineEnd == std::string_view::npos ? text.size() : lineEnd + 1);
+        lineNumber++;
+        if (line.empty() || line.front() == '#')
+        {
+            continue;
+        }
+
+        // Keywords start with a letter, data lines with a number
+        auto first = line.front();
+        if ((first >= 'A' && first <= 'Z') || (first >= 'a' && first <= 'z'))
+        {
+            if (!lut.Entries.empty())
+            {
+                throw ParseError(lineNumber, "keywords must come before the data.");
+            }
+            auto rest = line;
+            auto keyword = NextToken(rest);
+            if (keyword == "TITLE")
+            {
+                auto title = Trim(rest);
+                if (title.size() >= 2 && title.front() == '"' && title.back() == '"')
+                {
+                    title = title.substr(1, title.size() - 2);
+                }
+                lut.Title = std::string(title);
+            }
+            else if (keyword == "LUT_3D_SIZE")
+            {
+                float size = 0.0f;
+                ParseFloats(rest, &size, 1, lineNumber);
+                if (size < MinSize || size > MaxSize || size != std::floor(size))
+                {
+                    throw ParseError(lineNumber, "the LUT size must be a whole number from 2 to 256.");
+                }
+                lut.Size = static_cast<uint32_t>(size);
+                expectedCount = static_cast<size_t>(lut.Size) * lut.Size * lut.Size;
+                lut.Entries.reserve(expectedCount * 3);
+            }
+            else if (keyword == "LUT_1D_SIZE")
+            {
+                throw ParseError(lineNumber, "1D LUTs aren't supported.");
+            }
+            else if (keyword == "DOMAIN_MIN")
+            {
+                ParseFloats(rest, lut.DomainMin.data(), 3, lineNumber);
+            }
+            else if (keyword == "DOMAIN_MAX")
+            {
+                ParseFloats(rest, lut.DomainMax.data(), 3, lineNumber);
+            }
+            else if (keyword == "LUT_3D_INPUT_RANGE")
+            {
+                // Resolve's spelling of the domain, the same for every channel
+                float range[2] = {};
+                ParseFloats(rest, range, 2, lineNumber);
+                lut.DomainMin.fill(range[0]);
+                lut.DomainMax.fill(range[1]);
+            }
+            // Anything else (LUT_1D_INPUT_RANGE and vendor keywords) doesn't
+            // change the 3D table
+            continue;
+        }
+
+        if (lut.Size == 0)
+        {
+            throw ParseError(lineNumber, "data before LUT_3D_SIZE.");
+        }
+        if (lut.Entries.size() >= expectedCount * 3)
+        {
+            throw ParseError(lineNumber, "more entries than LUT_3D_SIZE allows.");
+        }
+        float values[3] = {};
+        ParseFloats(line, values, 3, lineNumber);
+        lut.Entries.insert(lut.Entries.end(), values, values + 3);
+    }
+
+    if (lut.Size == 0)
+    {
+        throw std::invalid_argument("The .cube file has no LUT_3D_SIZE.");
+    }
+    if (lut.Entries.size() != expectedCount * 3)
+    {
+        throw std::invalid_argument("The .cube file has fewer entries than LUT_3D_SIZE needs.");
+    }
+    for (size_t channel = 0; channel < 3; channel++)
+    {
+        if (!(lut.DomainMin[channel] < lut.DomainMax[channel]))
+        {
+            throw std::invalid_argument("The .cube file's DOMAIN_MIN must be below its DOMAIN_MAX.");
+        }
+    }
+    return lut;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// A 3D LUT in the Adobe / Resolve .cube text format.
+struct CubeLut
+{
+    static constexpr uint32_t MinSize = 2;
+    static constexpr uint32_t MaxSize = 256;
+
+    std::string Title;
+    uint32_t Size = 0;
+    // The input values that map to the first and last entries
+    std::array<float, 3> DomainMin = { 0.0f, 0.0f, 0.0f };
+    std::array<float, 3> DomainMax = { 1.0f, 1.0f, 1.0f };
+    // RGB triples, red changing fastest, then green, then blue
+    std::vector<float> Entries;
+
+    // Throws std::invalid_argument with the line number on malformed
+    // input. 1D LUTs aren't supported.
+    static CubeLut Parse(std::string_view text);
+};
@@ -0,0 +1,711 @@
+#include "pch.h"
+#include "DeflateEncoder.h"
+
+static const uint32_t MinMatch = 3;
+static const uint32_t MaxMatch = 258;
+static const uint32_t HashBits = 15;
+static const uint32_t HashMask = (1u << HashBits) - 1;
+static const size_t WindowMask = DeflateEncoder::WindowSize - 1;
+static const size_t MaxStoredBlockSize = 65535;
+static const size_t MaxBlockSymbols = 32768;
+static const uint32_t MaxCodeLength = 15;
+static const uint32_t MaxCodeLengthCodeLength = 7;
+static const uint32_t EndOfBlock = 256;
+// Once the match to beat is this long, search a quarter of the chain
+static const uint32_t GoodLength = 32;
+
+static const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t LengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t DistanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// The order code length code lengths are written in
+static const uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static uint32_t LengthCode(uint32_t length)
+{
+    static const auto table = []()
+    {
+        std::array<uint8_t, MaxMatch + 1> result = {};
+        uint32_t code = 0;
+        for (uint32_t length = MinMatch; length <= MaxMatch; length++)
+        {
+            while (code + 1 < 29 && LengthBase[code + 1] <= length)
+            {
+                code++;
+            }
+            result[length] = static_cast<uint8_t>(code);
+        }
+        return result;
+    }();
+    return table[length];
+}
+
+static uint32_t DistanceCode(uint32_t distance)
+{
+    // Distances up to 256 are looked up directly, the rest by their
+    // upper bits since codes past 16 cover multiples of 128
+    static const auto table = []()
+    {
+        std::array<uint8_t, 512> result = {};
+        uint32_t code = 0;
+        for (uint32_t distance = 1; distance <= 256; distance++)
+        {
+            while (code + 1 < 30 && DistanceBase[code + 1] <= distance)
+            {
+                code++;
+            }
+            result[distance - 1] = static_cast<uint8_t>(code);
+        }
+        for (uint32_t distance = 257; distance <= DeflateEncoder::WindowSize; distance += 128)
+        {
+            while (code + 1 < 30 && DistanceBase[code + 1] <= distance)
+            {
+                code++;
+            }
+            result[256 + ((distance - 1) >> 7)] = static_cast<uint8_t>(code);
+        }
+        return result;
+    }();
+    return distance <= 256 ? table[distance - 1] : table[256 + ((distance - 1) >> 7)];
+}
+
+static uint32_t Hash(uint8_t const* data)
+{
+    return ((static_cast<uint32_t>(data[0]) << 10) ^ (static_cast<uint32_t>(data[1]) << 5) ^ data[2]) & HashMask;
+}
+
+static uint32_t MatchLength(uint8_t const* scan, uint8_t const* match, uint32_t maxLength)
+{
+    uint32_t length = 0;
+    while (length + 8 <= maxLength)
+    {
+        uint64_t a = 0;
+        uint64_t b = 0;
+        memcpy(&a, scan + length, sizeof(a));
+        memcpy(&b, match + length, sizeof(b));
+        if (a != b)
+        {
+            break;
+        }
+        length += 8;
+    }
+    while (length < maxLength && scan[length] == match[length])
+    {
+        length++;
+    }
+    return length;
+}
+
+static uint32_t ReverseBits(uint32_t code, uint32_t length)
+{
+    uint32_t result = 0;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        result = (result << 1) | (code & 1);
+        code >>= 1;
+    }
+    return result;
+}
+
+// Huffman trees with a single symbol aren't complete, which some
+// decoders reject. Give every alphabet at least two codes.
+static void EnsureTwoSymbols(uint32_t* frequencies, size_t count)
+{
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        used += frequencies[i] > 0 ? 1 : 0;
+    }
+    for (size_t i = 0; i < count && used < 2; i++)
+    {
+        if (frequencies[i] == 0)
+        {
+            frequencies[i] = 1;
+            used++;
+        }
+    }
+}
+
+DeflateEncoder::LevelParameters DeflateEncoder::ParametersForLevel(uint32_t level)
+{
+    static const LevelParameters table[] =
+    {
+        { 0, 0, false },
+        { 4, 8, false },
+        { 8, 16, false },
+        { 16, 32, false },
+        { 16, 16, true },
+        { 32, 32, true },
+        { 128, 128, true },
+        { 256, 128, true },
+        { 1024, MaxMatch, true },
+        { 4096, MaxMatch, true },
+    };
+    return table[level];
+}
+
+DeflateEncoder::DeflateEncoder(uint32_t level)
+{
+    if (level > MaxLevel)
+    {
+        throw std::invalid_argument("The compression level must be between 0 and 9.");
+    }
+
+    m_level = level;
+    m_parameters = ParametersForLevel(level);
+    if (level > 0)
+    {
+        m_head.resize(HashMask + 1);
+        m_previous.resize(WindowSize);
+        m_symbols.reserve(MaxBlockSymbols);
+    }
+}
+
+void DeflateEncoder::Compress(uint8_t const* data, size_t size, size_t dictionarySize, bool last, std::vector<uint8_t>& output)
+{
+    m_output = &output;
+    m_bitBuffer = 0;
+    m_bitCount = 0;
+
+    if (m_level == 0)
+    {
+        WriteStoredBlocks(data, size, last);
+    }
+    else
+    {
+        dictionarySize = std::min(dictionarySize, WindowSize);
+        auto window = data - dictionarySize;
+        auto end = dictionarySize + size;
+        std::fill(m_head.begin(), m_head.end(), -1);
+        for (size_t position = 0; position < dictionarySize; position++)
+        {
+            InsertHash(window, position, end);
+        }
+        FindSymbols(window, dictionarySize, end, last);
+    }
+
+    if (!last)
+    {
+        // Sync flush: an empty stored block leaves the stream byte-aligned
+        PutBits(0, 3);
+        AlignToByte();
+        output.insert(output.end(), { 0x00, 0x00, 0xFF, 0xFF });
+    }
+    else
+    {
+        AlignToByte();
+    }
+    m_output = nullptr;
+}
+
+void DeflateEncoder::InsertHash(uint8_t const* window, size_t position, size_t end)
+{
+    if (position + MinMatch <= end)
+    {
+        auto hash = Hash(window + position);
+        m_previous[position & WindowMask] = m_head[hash];
+        m_head[hash] = static_cast<int32_t>(position);
+    }
+}
+
+uint32_t DeflateEncoder::FindLongestMatch(uint8_t const* window, size_t position, size_t end, uint32_t previousLength, uint32_t& distance) const
+{
+    auto maxLength = static_cast<uint32_t>(std::min<size_t>(MaxMatch, end - position));
+    if (previousLength >= maxLength)
+    {
+        return 0;
+    }
+
+    auto limit = position > WindowSize ? static_cast<int64_t>(position - WindowSize) : 0;
+    auto scan = window + position;
+    auto bestLength = previousLength;
+    auto chainLength = m_parameters.MaxChainLength;
+    if (previousLength >= GoodLength)
+    {
+        chainLength >>= 2;
+    }
+    int64_t candidate = m_head[Hash(scan)];
+    while (candidate >= limit && chainLength-- > 0)
+    {
+        auto match = window + candidate;
+        // Cheap rejection before comparing the whole match
+        if (match[bestLength] == scan[bestLength] && match[0] == scan[0] && match[1] == scan[1])
+        {
+            auto length = MatchLength(scan, match, maxLength);
+            if (length > bestLength)
+            {
+                bestLength = length;
+                distance = static_cast<uint32_t>(position - candidate);
+                if (length >= m_parameters.NiceLength || length == maxLength)
+                {
+                    break;
+                }
+            }
+        }
+        candidate = m_previous[candidate & WindowMask];
+    }
+    return bestLength > previousLength && bestLength >= MinMatch ? bestLength : 0;
+}
+
+void DeflateEncoder::FindSymbols(uint8_t const* window, size_t begin, size_t end, bool last)
+{
+    m_symbols.clear();
+    m_blockStart = begin;
+
+    // With lazy matching, a match found at position - 1 is held back
+    // until we know the match at position isn't longer.
+    bool hasPending = false;
+    uint32_t pendingLength = 0;
+    uint32_t pendingDistance = 0;
+
+    auto position = begin;
+    while (position < end)
+    {
+        if (!hasPending && m_symbols.size() >= MaxBlockSymbols)
+        {
+            FlushBlock(window, position, false);
+        }
+
+        uint32_t distance = 0;
+        uint32_t length = 0;
+        if (end - position >= MinMatch)
+        {
+            length = FindLongestMatch(window, position, end, hasPending ? pendingLength : MinMatch - 1, distance);
+            InsertHash(window, position, end);
+        }
+
+        if (hasPending)
+        {
+            if (length > 0)
+            {
+                m_symbols.push_back({ window[position - 1], 0 });
+                pendingLength = length;
+                pendingDistance = distance;
+                position++;
+                continue;
+            }
+
+            m_symbols.push_back({ static_cast<uint16_t>(pendingLength), static_cast<uint16_t>(pendingDistance) });
+            auto matchEnd = position - 1 + pendingLength;
+            for (position++; position < matchEnd; position++)
+            {
+                InsertHash(window, position, end);
+            }
+            hasPending = false;
+            continue;
+        }
+
+        if (length > 0)
+        {
+            if (m_parameters.Lazy && length < m_parameters.NiceLength)
+            {
+                hasPending = true;
+                pendingLength = length;
+                pendingDistance = distance;
+                position++;
+                continue;
+            }
+
+            m_symbols.push_back({ static_cast<uint16_t>(length), static_cast<uint16_t>(distance) });
+            auto matchEnd = position + length;
+            for (position++; position < matchEnd; position++)
+            {
+                InsertHash(window, position, end);
+            }
+            continue;
+        }
+
+        m_symbols.push_back({ window[position], 0 });
+        position++;
+    }
+
+    FlushBlock(window, end, last);
+}
+
+void DeflateEncoder::FlushBlock(uint8_t const* window, size_t blockEnd, bool last)
+{
+    std::array<uint32_t, 288> literalFrequencies = {};
+    std::array<uint32_t, 30> distanceFrequencies = {};
+    uint64_t extraBits = 0;
+    for (auto const& symbol : m_symbols)
+    {
+        if (symbol.Distance == 0)
+        {
+            literalFrequencies[symbol.LengthOrLiteral]++;
+        }
+        else
+        {
+            auto lengthCode = LengthCode(symbol.LengthOrLiteral);
+            auto distanceCode = DistanceCode(symbol.Distance);
+            literalFrequencies[257 + lengthCode]++;
+            distanceFrequencies[distanceCode]++;
+            extraBits += LengthExtraBits[lengthCode] + DistanceExtraBits[distanceCode];
+        }
+    }
+    literalFrequencies[EndOfBlock] = 1;
+    EnsureTwoSymbols(literalFrequencies.data(), 286);
+
+    // Only 286 literal/length codes are valid in a dynamic block
+    std::array<uint8_t, 288> literalLengths = {};
+    std::array<uint8_t, 30> distanceLengths = {};
+    EnsureTwoSymbols(distanceFrequencies.data(), distanceFrequencies.size());
+    BuildCodeLengths(literalFrequencies.data(), 286, MaxCodeLength, literalLengths.data());
+    BuildCodeLengths(distanceFrequencies.data(), distanceFrequencies.size(), MaxCodeLength, distanceLengths.data());
+    auto header = BuildDynamicHeader(literalLengths, distanceLengths);
+
+    std::array<uint8_t, 288> fixedLiteralLengths = {};
+    std::array<uint8_t, 30> fixedDistanceLengths = {};
+    std::fill(fixedLiteralLengths.begin(), fixedLiteralLengths.begin() + 144, 8);
+    std::fill(fixedLiteralLengths.begin() + 144, fixedLiteralLengths.begin() + 256, 9);
+    std::fill(fixedLiteralLengths.begin() + 256, fixedLiteralLengths.begin() + 280, 7);
+    std::fill(fixedLiteralLengths.begin() + 280, fixedLiteralLengths.end(), 8);
+    fixedDistanceLengths.fill(5);
+
+    uint64_t dynamicBits = header.BitCount + extraBits;
+    uint64_t fixedBits = extraBits;
+    for (size_t i = 0; i < literalFrequencies.size(); i++)
+    {
+        dynamicBits += static_cast<uint64_t>(literalFrequencies[i]) * literalLengths[i];
+        fixedBits += static_cast<uint64_t>(literalFrequencies[i]) * fixedLiteralLengths[i];
+    }
+    for (size_t i = 0; i < distanceFrequencies.size(); i++)
+    {
+        dynamicBits += static_cast<uint64_t>(distanceFrequencies[i]) * distanceLengths[i];
+        fixedBits += static_cast<uint64_t>(distanceFrequencies[i]) * fixedDistanceLengths[i];
+    }
+    auto blockSize = blockEnd - m_blockStart;
+    auto storedBlockCount = std::max<size_t>(1, (blockSize + MaxStoredBlockSize - 1) / MaxStoredBlockSize);
+    uint64_t storedBits = (storedBlockCount * (3 + 7 + 32)) + (static_cast<uint64_t>(blockSize) * 8);
+
+    if (storedBits < dynamicBits && storedBits < fixedBits)
+    {
+        WriteStoredBlocks(window + m_blockStart, blockSize, last);
+    }
+    else if (fixedBits <= dynamicBits)
+    {
+        WriteHuffmanBlock(fixedLiteralLengths, fixedDistanceLengths, nullptr, last);
+    }
+    else
+    {
+        WriteHuffmanBlock(literalLengths, distanceLengths, &header, last);
+    }
+
+    m_symbols.clear();
+    m_blockStart = blockEnd;
+}
+
+void DeflateEncoder::WriteStoredBlocks(uint8_t const* data, size_t size, bool last)
+{
+    if (size == 0 && !last)
+    {
+        return;
+    }
+
+    do
+    {
+        auto blockSize = std::min(size, MaxStoredBlockSize);
+        auto isLast = last && blockSize == size;
+        PutBits(isLast ? 1 : 0, 3);
+        AlignToByte();
+        auto length = static_cast<uint16_t>(blockSize);
+        auto complement = static_cast<uint16_t>(~length);
+        m_output->insert(m_output->end(),
+        {
+            static_cast<uint8_t>(length & 0xFF),
+            static_cast<uint8_t>(length >> 8),
+            static_cast<uint8_t>(complement & 0xFF),
+            static_cast<uint8_t>(complement >> 8),
+        });
+        m_output->insert(m_output->end(), data, data + blockSize);
+        data += blockSize;
+        size -= blockSize;
+    } while (size > 0);
+}
+
+void DeflateEncoder::WriteHuffmanBlock(std::array<uint8_t, 288> const& literalLengths, std::array<uint8_t, 30> const& distanceLengths, DynamicHeader const* header, bool last)
+{
+    std::array<uint16_t, 288> literalCodes = {};
+    std::array<uint16_t, 30> distanceCodes = {};
+    BuildCodes(literalLengths.data(), literalLengths.size(), literalCodes.data());
+    BuildCodes(distanceLengths.data(), distanceLengths.size(), distanceCodes.data());
+
+    PutBits(last ? 1 : 0, 1);
+    PutBits(header != nullptr ? 2 : 1, 2);
+    if (header != nullptr)
+    {
+        PutBits(header->LiteralCount - 257, 5);
+        PutBits(header->DistanceCount - 1, 5);
+        PutBits(header->CodeLengthCount - 4, 4);
+        for (uint32_t i = 0; i < header->CodeLengthCount; i++)
+        {
+            PutBits(header->CodeLengthLengths[CodeLengthOrder[i]], 3);
+        }
+        for (auto token : header->Tokens)
+        {
+            auto symbol = token & 0xFF;
+            auto extra = token >> 8;
+            PutBits(header->CodeLengthCodes[symbol], header->CodeLengthLengths[symbol]);
+            if (symbol == 16)
+            {
+                PutBits(extra, 2);
+            }
+            else if (symbol == 17)
+            {
+                PutBits(extra, 3);
+            }
+            else if (symbol == 18)
+            {
+                PutBits(extra, 7);
+            }
+        }
+    }
+
+    for (auto const& symbol : m_symbols)
+    {
+        if (symbol.Distance == 0)
+        {
+            PutBits(literalCodes[symbol.LengthOrLiteral], literalLengths[symbol.LengthOrLiteral]);
+        }
+        else
+        {
+            auto lengthCode = LengthCode(symbol.LengthOrLiteral);
+            PutBits(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+            PutBits(symbol.LengthOrLiteral - LengthBase[lengthCode], LengthExtraBits[lengthCode]);
+            auto distanceCode = DistanceCode(symbol.Distance);
+            PutBits(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+            PutBits(symbol.Distance - DistanceBase[distanceCode], DistanceExtraBits[distanceCode]);
+        }
+    }
+    PutBits(literalCodes[EndOfBlock], literalLengths[EndOfBlock]);
+}
+
+DeflateEncoder::DynamicHeader DeflateEncoder::BuildDynamicHeader(std::array<uint8_t, 288> const& literalLengths, std::array<uint8_t, 30> const& distanceLengths)
+{
+    DynamicHeader header;
+    header.LiteralCount = 286;
+    while (header.LiteralCount > 257 && literalLengths[header.LiteralCount - 1] == 0)
+    {
+        header.LiteralCount--;
+    }
+    header.DistanceCount = 30;
+    while (header.DistanceCount > 1 && distanceLengths[header.DistanceCount - 1] == 0)
+    {
+        header.DistanceCount--;
+    }
+
+    // Literal and distance lengths are run-length encoded as one sequence
+    std::vector<uint8_t> lengths;
+    lengths.reserve(header.LiteralCount + header.DistanceCount);
+    lengths.insert(lengths.end(), literalLengths.begin(), literalLengths.begin() + header.LiteralCount);
+    lengths.insert(lengths.end(), distanceLengths.begin(), distanceLengths.begin() + header.DistanceCount);
+
+    auto addToken = [&header](uint32_t symbol, uint32_t extra)
+    {
+        header.Tokens.push_back(static_cast<uint16_t>(symbol | (extra << 8)));
+    };
+    size_t i = 0;
+    while (i < lengths.size())
+    {
+        auto length = lengths[i];
+        size_t run = 1;
+        while (i + run < lengths.size() && lengths[i + run] == length)
+        {
+            run++;
+        }
+        i += run;
+
+        if (length == 0)
+        {
+            while (run >= 11)
+            {
+                auto count = std::min<size_t>(run, 138);
+                addToken(18, static_cast<uint32_t>(count - 11));
+                run -= count;
+            }
+            if (run >= 3)
+            {
+                addToken(17, static_cast<uint32_t>(run - 3));
+                run = 0;
+            }
+        }
+        else
+        {
+            addToken(length, 0);
+            run--;
+            while (run >= 3)
+            {
+                auto count = std::min<size_t>(run, 6);
+                addToken(16, static_cast<uint32_t>(count - 3));
+                run -= count;
+            }
+        }
+        for (; run > 0; run--)
+        {
+            addToken(length, 0);
+        }
+    }
+
+    std::array<uint32_t, 19> frequencies = {};
+    for (auto token : header.Tokens)
+    {
+        frequencies[token & 0xFF]++;
+    }
+    EnsureTwoSymbols(frequencies.data(), frequencies.size());
+    BuildCodeLengths(frequencies.data(), frequencies.size(), MaxCodeLengthCodeLength, header.CodeLengthLengths.data());
+    BuildCodes(header.CodeLengthLengths.data(), header.CodeLengthLengths.size(), header.CodeLengthCodes.data());
+
+    header.CodeLengthCount = 19;
+    while (header.CodeLengthCount > 4 && header.CodeLengthLengths[CodeLengthOrder[header.CodeLengthCount - 1]] == 0)
+    {
+        header.CodeLengthCount--;
+    }
+
+    header.BitCount = 5 + 5 + 4 + (3 * header.CodeLengthCount);
+    for (auto token : header.Tokens)
+    {
+        auto symbol = token & 0xFF;
+        header.BitCount += header.CodeLengthLengths[symbol];
+        header.BitCount += symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0;
+    }
+    return header;
+}
+
+void DeflateEncoder::BuildCodeLengths(uint32_t const* frequencies, size_t count, uint32_t maxLength, uint8_t* lengths)
+{
+    std::fill(lengths, lengths + count, static_cast<uint8_t>(0));
+
+    // Build an ordinary Huffman tree, and if it's too deep, flatten the
+    // frequencies and try again. Converges quickly, since frequencies
+    // that are all 1 give a balanced tree.
+    std::vector<uint32_t> weights(frequencies, frequencies + count);
+    std::vector<uint64_t> nodeWeights;
+    std::vector<int32_t> parents;
+    std::vector<int32_t> leaves;
+    while (true)
+    {
+        nodeWeights.clear();
+        parents.clear();
+        leaves.clear();
+        using QueueEntry = std::pair<uint64_t, int32_t>;
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (weights[i] > 0)
+            {
+                auto node = static_cast<int32_t>(nodeWeights.size());
+                nodeWeights.push_back(weights[i]);
+                parents.push_back(-1);
+                leaves.push_back(static_cast<int32_t>(i));
+                queue.push({ weights[i], node });
+            }
+        }
+        if (leaves.empty())
+        {
+            return;
+        }
+        if (leaves.size() == 1)
+        {
+            lengths[leaves[0]] = 1;
+            return;
+        }
+
+        while (queue.size() > 1)
+        {
+            auto first = queue.top();
+            queue.pop();
+            auto second = queue.top();
+            queue.pop();
+            auto node = static_cast<int32_t>(nodeWeights.size());
+            nodeWeights.push_back(first.first + second.first);
+            parents.push_back(-1);
+            parents[first.second] = node;
+            parents[second.second] = node;
+            queue.push({ first.first + second.first, node });
+        }
+
+        // Parents always come after their children, so depths can be
+        // filled in from the root down
+        std::vector<uint32_t> depths(nodeWeights.size(), 0);
+        for (auto node = static_cast<int32_t>(nodeWeights.size()) - 2; node >= 0; node--)
+        {
+            depths[node] = depths[parents[node]] + 1;
+        }
+
+        uint32_t deepest = 0;
+        for (size_t leaf = 0; leaf < leaves.size(); leaf++)
+        {
+            deepest = std::max(deepest, depths[leaf]);
+        }
+        if (deepest <= maxLength)
+        {
+            for (size_t leaf = 0; leaf < leaves.size(); leaf++)
+            {
+                lengths[leaves[leaf]] = static_cast<uint8_t>(depths[leaf]);
+            }
+            return;
+        }
+
+        for (auto& weight : weights)
+        {
+            if (weight > 0)
+            {
+                weight = std::max(1u, weight >> 1);
+            }
+        }
+    }
+}
+
+void DeflateEncoder::BuildCodes(uint8_t const* lengths, size_t count, uint16_t* codes)
+{
+    std::array<uint32_t, MaxCodeLength + 1> lengthCounts = {};
+    for (size_t i = 0; i < count; i++)
+    {
+        lengthCounts[lengths[i]]++;
+    }
+    lengthCounts[0] = 0;
+
+    std::array<uint32_t, MaxCodeLength + 1> nextCodes = {};
+    uint32_t code = 0;
+    for (uint32_t length = 1; length <= MaxCodeLength; length++)
+    {
+        code = (code + lengthCounts[length - 1]) << 1;
+        nextCodes[length] = code;
+    }
+
+    // Huffman codes are packed starting from their most significant bit
+    for (size_t i = 0; i < count; i++)
+    {
+        auto length = lengths[i];
+        codes[i] = length > 0 ? static_cast<uint16_t>(ReverseBits(nextCodes[length]++, length)) : 0;
+    }
+}
+
+void DeflateEncoder::PutBits(uint32_t bits, uint32_t count)
+{
+    m_bitBuffer |= static_cast<uint64_t>(bits) << m_bitCount;
+    m_bitCount += count;
+    if (m_bitCount >= 32)
+    {
+        auto word = static_cast<uint32_t>(m_bitBuffer);
+        m_output->insert(m_output->end(),
+        {
+            static_cast<uint8_t>(word),
+            static_cast<uint8_t>(word >> 8),
+            static_cast<uint8_t>(word >> 16),
+            static_cast<uint8_t>(word >> 24),
+        });
+        m_bitBuffer >>= 32;
+        m_bitCount -= 32;
+    }
+}
+
+void DeflateEncoder::AlignToByte()
+{
+    while (m_bitCount > 0)
+    {
+        m_output->push_back(static_cast<uint8_t>(m_bitBuffer));
+        m_bitBuffer >>= 8;
+        m_bitCount = m_bitCount > 8 ? m_bitCount - 8 : 0;
+    }
+    m_bitBuffer = 0;
+}
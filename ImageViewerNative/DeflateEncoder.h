@@ -0,0 +1,79 @@
+#pragma once
+
+// A raw deflate (RFC 1951) encoder that compresses a large buffer as
+// independent pieces, like pigz. Each piece may reference the 32 KB
+// before it, and every piece except the last ends byte-aligned with an
+// empty stored block. Pieces can then be compressed on different threads
+// and concatenated into one valid stream.
+class DeflateEncoder
+{
+public:
+    // 0 stores the data uncompressed. 1-9 trade speed for size, as in zlib.
+    static constexpr uint32_t MaxLevel = 9;
+    static constexpr size_t WindowSize = 32768;
+
+    DeflateEncoder(uint32_t level);
+
+    // Compresses [data, data + size) and appends it to output. The
+    // dictionarySize bytes before data may be referenced, up to
+    // WindowSize. Set last for the final piece of the stream.
+    void Compress(uint8_t const* data, size_t size, size_t dictionarySize, bool last, std::vector<uint8_t>& output);
+
+private:
+    // A literal when Distance is 0, otherwise a match.
+    struct Symbol
+    {
+        uint16_t LengthOrLiteral;
+        uint16_t Distance;
+    };
+
+    struct LevelParameters
+    {
+        uint32_t MaxChainLength;
+        // Matches at least this long are taken without looking further
+        uint32_t NiceLength;
+        bool Lazy;
+    };
+
+    // The code lengths of a dynamic block, run-length encoded with the
+    // code length alphabet (RFC 1951 3.2.7).
+    struct DynamicHeader
+    {
+        uint32_t LiteralCount = 0;
+        uint32_t DistanceCount = 0;
+        uint32_t CodeLengthCount = 0;
+        std::array<uint8_t, 19> CodeLengthLengths = {};
+        std::array<uint16_t, 19> CodeLengthCodes = {};
+        // Symbol in the low byte, extra bits in the high byte
+        std::vector<uint16_t> Tokens;
+        uint64_t BitCount = 0;
+    };
+
+    static LevelParameters ParametersForLevel(uint32_t level);
+
+    void FindSymbols(uint8_t const* window, size_t begin, size_t end, bool last);
+    void InsertHash(uint8_t const* window, size_t position, size_t end);
+    uint32_t FindLongestMatch(uint8_t const* window, size_t position, size_t end, uint32_t previousLength, uint32_t& distance) const;
+    void FlushBlock(uint8_t const* window, size_t blockEnd, bool last);
+
+    void WriteStoredBlocks(uint8_t const* data, size_t size, bool last);
+    void WriteHuffmanBlock(std::array<uint8_t, 288> const& literalLengths, std::array<uint8_t, 30> const& distanceLengths, DynamicHeader const* header, bool last);
+
+    static DynamicHeader BuildDynamicHeader(std::array<uint8_t, 288> const& literalLengths, std::array<uint8_t, 30> const& distanceLengths);
+    static void BuildCodeLengths(uint32_t const* frequencies, size_t count, uint32_t maxLength, uint8_t* lengths);
+    static void BuildCodes(uint8_t const* lengths, size_t count, uint16_t* codes);
+
+    void PutBits(uint32_t bits, uint32_t count);
+    void AlignToByte();
+
+private:
+    LevelParameters m_parameters = {};
+    uint32_t m_level = 0;
+    std::vector<int32_t> m_head;
+    std::vector<int32_t> m_previous;
+    std::vector<Symbol> m_symbols;
+    size_t m_blockStart = 0;
+    std::vector<uint8_t>* m_output = nullptr;
+    uint64_t m_bitBuffer = 0;
+    uint32_t m_bitCount = 0;
+};
@@ -0,0 +1,232 @@
+#include "pch.h"
+#include "FrameDiffer.h"
+#include "FrameDiffer.g.cpp"
+#include "PixelRectInterop.h"
+#include "CaptureRecorder.h"
+#include "ScopeAnalyzer.h"
+#include "Profiler.h"
+
+namespace winrt
+{
+    using namespace Windows::Foundation;
+    using namespace Windows::Graphics;
+    using namespace Windows::Graphics::DirectX::Direct3D11;
+}
+
+namespace util
+{
+    using namespace robmikh::common::uwp;
+}
+
+static ProfileStage UpdateStage("FrameDiffer.Update");
+static ProfileStage FlushStage("FrameDiffer.Flush");
+
+namespace winrt::ImageViewerNative::implementation
+{
+    FrameDiffer::FrameDiffer(winrt::IDirect3DDevice const& device, winrt::SizeInt32 const& size)
+    {
+        if (size.Width <= 0 || size.Height <= 0)
+        {
+            throw winrt::hresult_invalid_argument(L"The frame size must not be empty.");
+        }
+
+        m_d3dDevice = GetDXGIInterfaceFromObject<ID3D11Device>(device);
+        m_d3dDevice->GetImmediateContext(m_d3dContext.put());
+        m_multithread = m_d3dDevice.as<ID3D11Multithread>();
+
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = static_cast<uint32_t>(size.Width);
+        desc.Height = static_cast<uint32_t>(size.Height);
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_STAGING;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        for (auto& stagedFrame : m_stagedFrames)
+        {
+            winrt::check_hresult(m_d3dDevice->CreateTexture2D(&desc, nullptr, stagedFrame.Texture.put()));
+        }
+
+        m_differ = std::make_unique<BlockDiffer>(desc.Width, desc.Height);
+    }
+
+    void FrameDiffer::Recorder(winrt::ImageViewerNative::CaptureRecorder const& recorder)
+    {
+        if (recorder != nullptr)
+        {
+            auto size = recorder.Size();
+            if (static_cast<uint32_t>(size.Width) != m_differ->Width() || static_cast<uint32_t>(size.Height) != m_differ->Height())
+            {
+                throw winrt::hresult_invalid_argument(L"The recorder must be the same size as the frames.");
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_sinkLock);
+        m_recorder = recorder;
+    }
+
+    winrt::ImageViewerNative::CaptureRecorder FrameDiffer::Recorder()
+    {
+        std::lock_guard<std::mutex> lock(m_sinkLock);
+        return m_recorder;
+    }
+
+    winrt::ImageViewerNative::ScopeAnalyzer FrameDiffer::Scopes()
+    {
+        std::lock_guard<std::mutex> lock(m_sinkLock);
+        return m_scopes;
+    }
+
+    void FrameDiffer::Scopes(winrt::ImageViewerNative::ScopeAnalyzer const& scopes)
+    {
+        if (scopes != nullptr)
+        {
+            auto size = scopes.Size();
+            if (static_cast<uint32_t>(size.Width) != m_differ->Width() || static_cast<uint32_t>(size.Height) != m_differ->Height())
+            {
+                throw winrt::hresult_invalid_argument(L"The scope analyzer must be the same size as the frames.");
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_sinkLock);
+        m_scopes = scopes;
+        m_scopesNeedFrame = true;
+    }
+
+    winrt::com_array<winrt::RectInt32> FrameDiffer::Update(winrt::IDirect3DSurface const& frame, winrt::TimeSpan const& timestamp)
+    {
+        ProfileScope scope(UpdateStage);
+        auto texture = GetDXGIInterfaceFromObject<ID3D11Texture2D>(frame);
+        D3D11_TEXTURE2D_DESC desc = {};
+        texture->GetDesc(&desc);
+        if (desc.Format != DXGI_FORMAT_B8G8R8A8_UNORM)
+        {
+            throw winrt::hresult_invalid_argument(L"Only B8G8R8A8UIntNormalized frames can be compared.");
+        }
+
+        std::lock_guard<std::mutex> updateLock(m_updateLock);
+        std::vector<winrt::RectInt32> result;
+
+        // Every texture is waiting to be read, so the oldest has to be
+        // read now to make room
+        if (m_stagedFrameCount == StagingTextureCount)
+        {
+            CompareStagedFrames(true, result);
+        }
+
+        {
+            auto deviceLock = util::D3D11DeviceLock(m_multithread.get());
+            auto index = (m_oldestStagedFrame + m_stagedFrameCount) % StagingTextureCount;
+            auto& stagedFrame = m_stagedFrames[index];
+            D3D11_BOX box = {};
+            box.right = std::min(desc.Width, m_differ->Width());
+            box.bottom = std::min(desc.Height, m_differ->Height());
+            box.back = 1;
+            m_d3dContext->CopySubresourceRegion(stagedFrame.Texture.get(), 0, 0, 0, 0, texture.get(), 0, &box);
+
+            // Frames smaller than us keep the rest of the frame before
+            // them, which then reads as unchanged
+            auto previous = m_stagedFrames[(index + StagingTextureCount - 1) % StagingTextureCount].Texture.get();
+            if (box.right < m_differ->Width())
+            {
+                D3D11_BOX right = { box.right, 0, 0, m_differ->Width(), box.bottom, 1 };
+                m_d3dContext->CopySubresourceRegion(stagedFrame.Texture.get(), 0, right.left, 0, 0, previous, 0, &right);
+            }
+            if (box.bottom < m_differ->Height())
+            {
+                D3D11_BOX bottom = { 0, box.bottom, 0, m_differ->Width(), m_differ->Height(), 1 };
+                m_d3dContext->CopySubresourceRegion(stagedFrame.Texture.get(), 0, 0, bottom.top, 0, previous, 0, &bottom);
+            }
+            stagedFrame.Timestamp = timestamp.count();
+            m_stagedFrameCount++;
+        }
+
+        // Read whichever copies have finished. This is usually the frame
+        // before this one.
+        CompareStagedFrames(false, result);
+        return winrt::com_array<winrt::RectInt32>(result);
+    }
+
+    winrt::com_array<winrt::RectInt32> FrameDiffer::Flush()
+    {
+        ProfileScope scope(FlushStage);
+        std::lock_guard<std::mutex> updateLock(m_updateLock);
+        std::vector<winrt::RectInt32> result;
+        while (m_stagedFrameCount > 0)
+        {
+            CompareStagedFrames(true, result);
+        }
+        return winrt::com_array<winrt::RectInt32>(result);
+    }
+
+    // Maps the finished copies, oldest first, then compares them and
+    // hands them on with the device unlocked. Only the oldest is waited
+    // for, and only when asked to.
+    void FrameDiffer::CompareStagedFrames(bool waitForOldest, std::vector<winrt::RectInt32>& dirtyRects)
+    {
+        std::vector<std::pair<StagedFrame*, D3D11_MAPPED_SUBRESOURCE>> mappedFrames;
+        mappedFrames.reserve(StagingTextureCount);
+        auto unmap = wil::scope_exit([&]()
+        {
+            if (!mappedFrames.empty())
+            {
+                auto deviceLock = util::D3D11DeviceLock(m_multithread.get());
+                for (auto& mappedFrame : mappedFrames)
+                {
+                    m_d3dContext->Unmap(mappedFrame.first->Texture.get(), 0);
+                }
+            }
+        });
+
+        {
+            auto deviceLock = util::D3D11DeviceLock(m_multithread.get());
+            while (mappedFrames.size() < m_stagedFrameCount)
+            {
+                auto& stagedFrame = m_stagedFrames[(m_oldestStagedFrame + mappedFrames.size()) % StagingTextureCount];
+                auto wait = waitForOldest && mappedFrames.empty();
+                D3D11_MAPPED_SUBRESOURCE mapped = {};
+                auto hr = m_d3dContext->Map(stagedFrame.Texture.get(), 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+                if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+                {
+                    break;
+                }
+                winrt::check_hresult(hr);
+                mappedFrames.push_back({ &stagedFrame, mapped });
+                if (wait)
+                {
+                    break;
+                }
+            }
+        }
+        auto mappedCount = static_cast<uint32_t>(mappedFrames.size());
+        m_oldestStagedFrame = (m_oldestStagedFrame + mappedCount) % StagingTextureCount;
+        m_stagedFrameCount -= mappedCount;
+
+        winrt::ImageViewerNative::CaptureRecorder recorder{ nullptr };
+        winrt::ImageViewerNative::ScopeAnalyzer scopes{ nullptr };
+        {
+            std::lock_guard<std::mutex> lock(m_sinkLock);
+            recorder = m_recorder;
+            scopes = m_scopes;
+        }
+
+        for (auto& [stagedFrame, mapped] : mappedFrames)
+        {
+            auto pixels = reinterpret_cast<uint8_t const*>(mapped.pData);
+            auto& rects = m_differ->Compare(pixels, mapped.RowPitch);
+
+            // The frame is already mapped, so recording it is only a copy
+            if (recorder != nullptr)
+            {
+                winrt::get_self<CaptureRecorder>(recorder)->TryEnqueue(pixels, mapped.RowPitch, stagedFrame->Timestamp);
+            }
+            if (scopes != nullptr && (m_scopesNeedFrame || !rects.empty()))
+            {
+                m_scopesNeedFrame = !winrt::get_self<ScopeAnalyzer>(scopes)->TryEnqueue(pixels, mapped.RowPitch);
+            }
+            for (auto& rect : rects)
+            {
+                dirtyRects.push_back(ToRectInt32(rect));
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "FrameDiffer.g.h"
+#include "BlockDiffer.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    // Finds the regions of captured frames that changed, so only those
+    // are copied to the swap chain and recorded.
+    //
+    // The GPU can't say what changed, so every frame is copied to a
+    // staging texture and read back whole. What this saves is the work
+    // after the readback, not the readback itself, so SimpleCapture only
+    // uses it while the recorder, the scopes or the change overlay need
+    // the frames anyway, and otherwise copies whole frames on the GPU.
+    //
+    // To keep Update from stalling on the copy, frames are read back once
+    // the GPU has finished with them, which is usually a frame later. The
+    // rects Update returns are therefore for an earlier frame than the
+    // one passed in. Capture only raises frames when something changes,
+    // so callers must Flush once frames stop arriving, or the last change
+    // is never shown or recorded. SimpleCapture flushes after 50ms
+    // without a frame.
+    struct FrameDiffer : FrameDifferT<FrameDiffer>
+    {
+        FrameDiffer(winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device, winrt::Windows::Graphics::SizeInt32 const& size);
+
+        winrt::com_array<winrt::Windows::Graphics::RectInt32> Update(winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DSurface const& frame, winrt::Windows::Foundation::TimeSpan const& timestamp);
+        winrt::com_array<winrt::Windows::Graphics::RectInt32> Flush();
+        uint64_t DirtyPixelCount() { return m_differ->DirtyPixelCount(); }
+        void Reset() { m_differ->Reset(); }
+
+        winrt::ImageViewerNative::CaptureRecorder Recorder();
+        void Recorder(winrt::ImageViewerNative::CaptureRecorder const& recorder);
+        winrt::ImageViewerNative::ScopeAnalyzer Scopes();
+        void Scopes(winrt::ImageViewerNative::ScopeAnalyzer const& scopes);
+
+    private:
+        // Copies in flight on the GPU. Each one is read a frame or more
+        // later, when the copy has finished, instead of stalling on it.
+        static constexpr uint32_t StagingTextureCount = 3;
+
+        struct StagedFrame
+        {
+            winrt::com_ptr<ID3D11Texture2D> Texture;
+            int64_t Timestamp = 0;
+        };
+
+        void CompareStagedFrames(bool waitForOldest, std::vector<winrt::Windows::Graphics::RectInt32>& dirtyRects);
+
+    private:
+        winrt::com_ptr<ID3D11Device> m_d3dDevice;
+        winrt::com_ptr<ID3D11DeviceContext> m_d3dContext;
+        winrt::com_ptr<ID3D11Multithread> m_multithread;
+        // Held for all of Update. The device is only locked around the
+        // GPU copies and the maps, so that comparing and copying frames
+        // out doesn't hold up rendering.
+        std::mutex m_updateLock;
+        std::array<StagedFrame, StagingTextureCount> m_stagedFrames;
+        // The oldest copy not yet compared, and how many there are
+        uint32_t m_oldestStagedFrame = 0;
+        uint32_t m_stagedFrameCount = 0;
+        std::unique_ptr<BlockDiffer> m_differ;
+        // Guards the recorder and analyzer, which can be swapped while
+        // frames are being handed to them
+        std::mutex m_sinkLock;
+        winrt::ImageViewerNative::CaptureRecorder m_recorder{ nullptr };
+        winrt::ImageViewerNative::ScopeAnalyzer m_scopes{ nullptr };
+        // Unchanged frames have the scopes of the last analyzed one, so
+        // only changed frames are analyzed, unless the last one was skipped
+        std::atomic<bool> m_scopesNeedFrame = false;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct FrameDiffer : FrameDifferT<FrameDiffer, implementation::FrameDiffer>
+    {
+    };
+}
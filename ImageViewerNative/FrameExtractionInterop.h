@@ -0,0 +1,24 @@
+#pragma once
+#include "FrameExtractionRegion.h"
+#include "ImageResampler.h"
+#include "PixelRectInterop.h"
+
+inline FrameExtractionRegion ResolveFrameExtractionOptions(winrt::ImageViewerNative::FrameExtractionOptions const& options, uint32_t frameWidth, uint32_t frameHeight)
+{
+    auto& rect = options.SourceRect;
+    std::optional<FrameExtractionRegion> region;
+    if (rect.X >= 0 && rect.Y >= 0 && rect.Width >= 0 && rect.Height >= 0)
+    {
+        region = FrameExtractionRegion::Resolve(ToPixelRect(rect), options.Scale, frameWidth, frameHeight);
+    }
+    if (!region.has_value())
+    {
+        throw winrt::hresult_invalid_argument(L"The source rect must be inside the frame, and the scale between 0 and 1.");
+    }
+    return region.value();
+}
+
+inline ResampleFilter ToResampleFilter(winrt::ImageViewerNative::ResampleFilter const filter)
+{
+    return filter == winrt::ImageViewerNative::ResampleFilter::Lanczos3 ? ResampleFilter::Lanczos3 : ResampleFilter::Bilinear;
+}
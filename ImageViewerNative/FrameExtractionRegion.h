@@ -0,0 +1,48 @@
+#pragma once
+#include "PixelRect.h"
+
+// The part of each frame to extract and the size to scale it to.
+struct FrameExtractionRegion
+{
+    PixelRect SourceRect;
+    uint32_t OutputWidth = 0;
+    uint32_t OutputHeight = 0;
+
+    bool IsFullFrame(uint32_t frameWidth, uint32_t frameHeight) const
+    {
+        return SourceRect.X == 0 && SourceRect.Y == 0 &&
+            SourceRect.Width == frameWidth && SourceRect.Height == frameHeight &&
+            OutputWidth == frameWidth && OutputHeight == frameHeight;
+    }
+
+    // An empty source rect is the whole frame, and a scale of 0 is 1. Both
+    // dimensions are scaled by the same factor, so the aspect ratio is
+    // kept. Frames are only ever shrunk: returns nothing if the rect
+    // isn't inside the frame or the scale isn't in (0, 1].
+    static std::optional<FrameExtractionRegion> Resolve(PixelRect const& sourceRect, double scale, uint32_t frameWidth, uint32_t frameHeight)
+    {
+        FrameExtractionRegion region;
+        region.SourceRect = sourceRect;
+        if (sourceRect.Width == 0 || sourceRect.Height == 0)
+        {
+            region.SourceRect = { 0, 0, frameWidth, frameHeight };
+        }
+        else if (static_cast<uint64_t>(sourceRect.X) + sourceRect.Width > frameWidth ||
+            static_cast<uint64_t>(sourceRect.Y) + sourceRect.Height > frameHeight)
+        {
+            return std::nullopt;
+        }
+
+        if (scale == 0.0)
+        {
+            scale = 1.0;
+        }
+        if (!(scale > 0.0 && scale <= 1.0))
+        {
+            return std::nullopt;
+        }
+        region.OutputWidth = static_cast<uint32_t>(std::max(1.0, std::round(region.SourceRect.Width * scale)));
+        region.OutputHeight = static_cast<uint32_t>(std::max(1.0, std::round(region.SourceRect.Height * scale)));
+        return region;
+    }
+};
@@ -0,0 +1,388 @@
+#include "pch.h"
+#include "FrameScopes.h"
+#include "BufferPool.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "SimdHelpers.h"
+
+static ProfileStage ComputeStage("FrameScopes.Compute");
+
+static const uint32_t Levels = FrameScopes::Levels;
+static const uint32_t MaxWaveformWidth = FrameScopes::MaxWaveformWidth;
+static const size_t HistogramEntries = static_cast<size_t>(FrameScopes::ChannelCount) * Levels;
+static const size_t VectorscopeEntries = static_cast<size_t>(Levels) * Levels;
+// Neighbouring pixels of flat areas land in the same bins. Alternating
+// between two sets of histograms keeps each increment from waiting on
+// the one before it.
+static const size_t HistogramSets = 2;
+// What each strip counts into: the histogram sets, then the vectorscope
+static const size_t PartialEntries = (HistogramSets * HistogramEntries) + VectorscopeEntries;
+static const size_t ReduceChunkEntries = 4096;
+static const uint32_t BatchSize = 8;
+// The limited range black and white levels
+static const uint32_t VideoBlack = 16;
+static const uint32_t VideoWhite = 235;
+
+struct SampleBatch
+{
+    uint8_t Luma[BatchSize];
+    uint8_t Cb[BatchSize];
+    uint8_t Cr[BatchSize];
+};
+
+// BT.709 in 8-bit fixed point. The negative chroma terms are written as
+// weights of 255 - x so that every product is positive:
+//   Y  = (54 R + 183 G + 19 B + 128) >> 8
+//   Cb = (128 B - 29 R - 99 G + 32896) >> 8 = (128 B + 29 (255 - R) + 99 (255 - G) + 256) >> 8
+//   Cr = (128 R - 116 G - 12 B + 32896) >> 8 = (128 R + 116 (255 - G) + 12 (255 - B) + 256) >> 8
+// Chroma can reach 256, which is clamped to 255.
+#ifdef IMAGEVIEWER_SSE2
+static void ConvertQuad(__m128i pixels, __m128i& luma, __m128i& cb, __m128i& cr)
+{
+    // Every lane stays below 2^16, so 16-bit multiplies are enough
+    auto mask = _mm_set1_epi32(0xFF);
+    auto b = _mm_and_si128(pixels, mask);
+    auto g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+    auto r = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+    auto invB = _mm_xor_si128(b, mask);
+    auto invG = _mm_xor_si128(g, mask);
+    auto invR = _mm_xor_si128(r, mask);
+
+    luma = _mm_add_epi32(
+        _mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(54)), _mm_mullo_epi16(g, _mm_set1_epi32(183))),
+        _mm_add_epi32(_mm_mullo_epi16(b, _mm_set1_epi32(19)), _mm_set1_epi32(128)));
+    cb = _mm_add_epi32(
+        _mm_add_epi32(_mm_slli_epi32(b, 7), _mm_mullo_epi16(invR, _mm_set1_epi32(29))),
+        _mm_add_epi32(_mm_mullo_epi16(invG, _mm_set1_epi32(99)), _mm_set1_epi32(256)));
+    cr = _mm_add_epi32(
+        _mm_add_epi32(_mm_slli_epi32(r, 7), _mm_mullo_epi16(invG, _mm_set1_epi32(116))),
+        _mm_add_epi32(_mm_mullo_epi16(invB, _mm_set1_epi32(12)), _mm_set1_epi32(256)));
+    luma = _mm_srli_epi32(luma, 8);
+    cb = _mm_srli_epi32(cb, 8);
+    cr = _mm_srli_epi32(cr, 8);
+}
+
+static void StoreLevels(__m128i first, __m128i second, uint8_t* dest)
+{
+    auto words = _mm_min_epi16(_mm_packs_epi32(first, second), _mm_set1_epi16(255));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dest), _mm_packus_epi16(words, words));
+}
+#endif
+
+static void ConvertBatch(uint32_t const* pixels, SampleBatch& batch)
+{
+#ifdef IMAGEVIEWER_SSE2
+    __m128i luma0, cb0, cr0, luma1, cb1, cr1;
+    ConvertQuad(_mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels)), luma0, cb0, cr0);
+    ConvertQuad(_mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + 4)), luma1, cb1, cr1);
+    StoreLevels(luma0, luma1, batch.Luma);
+    StoreLevels(cb0, cb1, batch.Cb);
+    StoreLevels(cr0, cr1, batch.Cr);
+#else
+    for (uint32_t i = 0; i < BatchSize; i++)
+    {
+        auto b = pixels[i] & 0xFF;
+        auto g = (pixels[i] >> 8) & 0xFF;
+        auto r = (pixels[i] >> 16) & 0xFF;
+        batch.Luma[i] = static_cast<uint8_t>(((54 * r) + (183 * g) + (19 * b) + 128) >> 8);
+        batch.Cb[i] = static_cast<uint8_t>(std::min<uint32_t>(((128 * b) + (29 * (255 - r)) + (99 * (255 - g)) + 256) >> 8, 255));
+        batch.Cr[i] = static_cast<uint8_t>(std::min<uint32_t>(((128 * r) + (116 * (255 - g)) + (12 * (255 - b)) + 256) >> 8, 255));
+    }
+#endif
+}
+
+// Counts the sampled columns [begin, end) of every sampled row. The
+// waveform columns of a strip belong to it alone, so they're counted in
+// place; everything else goes into the strip's partial counts.
+static void CountStrip(
+    uint8_t const* bgraPixels, uint32_t stride, uint32_t sampleStep, uint32_t sampledHeight,
+    uint32_t begin, uint32_t end, uint16_t const* columns, uint32_t waveformWidth,
+    uint32_t* waveform, uint32_t* partial)
+{
+    memset(partial, 0, PartialEntries * sizeof(uint32_t));
+    auto vectorscope = partial + (HistogramSets * HistogramEntries);
+
+    uint32_t gathered[BatchSize] = {};
+    SampleBatch batch;
+    for (uint32_t y = 0; y < sampledHeight; y++)
+    {
+        auto row = bgraPixels + (static_cast<size_t>(y) * sampleStep * stride);
+        for (auto x = begin; x < end; x += BatchSize)
+        {
+            auto count = std::min(BatchSize, end - x);
+            if (sampleStep == 1)
+            {
+                memcpy(gathered, row + (static_cast<size_t>(x) * 4), count * 4);
+            }
+            else
+            {
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    memcpy(&gathered[i], row + (static_cast<size_t>(x + i) * sampleStep * 4), 4);
+                }
+            }
+            ConvertBatch(gathered, batch);
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                auto histograms = partial + ((i & 1) * HistogramEntries);
+                auto luma = batch.Luma[i];
+                histograms[luma]++;
+                histograms[(1 * Levels) + ((gathered[i] >> 16) & 0xFF)]++;
+                histograms[(2 * Levels) + ((gathered[i] >> 8) & 0xFF)]++;
+                histograms[(3 * Levels) + (gathered[i] & 0xFF)]++;
+                waveform[(static_cast<size_t>(luma) * waveformWidth) + columns[x + i]]++;
+                vectorscope[(static_cast<size_t>(batch.Cr[i]) * Levels) + batch.Cb[i]]++;
+            }
+        }
+    }
+}
+
+// Sums [first, first + count) of every strip's partial counts into dest
+static void SumPartials(uint32_t const* partials, uint32_t stripCount, size_t first, size_t count, uint32_t* dest)
+{
+    if (first > PartialEntries || count > PartialEntries - first)
+    {
+        throw std::out_of_range("The entries to sum are past the end of the partial counts.");
+    }
+    memcpy(dest, partials + first, count * sizeof(uint32_t));
+    for (uint32_t strip = 1; strip < stripCount; strip++)
+    {
+        auto source = partials + (static_cast<size_t>(strip) * PartialEntries) + first;
+        auto target = dest;
+        auto remaining = count;
+#ifdef IMAGEVIEWER_SSE2
+        for (; remaining >= 4; remaining -= 4, source += 4, target += 4)
+        {
+            auto sum = _mm_add_epi32(
+                _mm_loadu_si128(reinterpret_cast<__m128i const*>(target)),
+                _mm_loadu_si128(reinterpret_cast<__m128i const*>(source)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(target), sum);
+        }
+#endif
+        // Counted from what's left, so the tail is never longer than count
+        for (size_t i = 0; i < remaining; i++)
+        {
+            target[i] += source[i];
+        }
+    }
+}
+
+uint32_t FrameScopes::LowestLevel(ScopeChannel channel) const
+{
+    auto& histogram = Histogram(channel);
+    for (uint32_t level = 0; level < Levels; level++)
+    {
+        if (histogram[level] != 0)
+        {
+            return level;
+        }
+    }
+    return 0;
+}
+
+uint32_t FrameScopes::HighestLevel(ScopeChannel channel) const
+{
+    auto& histogram = Histogram(channel);
+    for (auto level = Levels; level > 0; level--)
+    {
+        if (histogram[level - 1] != 0)
+        {
+            return level - 1;
+        }
+    }
+    return 0;
+}
+
+FrameScopes ComputeScopes(
+    uint8_t const* bgraPixels, uint32_t width, uint32_t height, uint32_t stride,
+    uint32_t sampleStep, TaskPriority priority)
+{
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument("The frame can't be empty.");
+    }
+    if (sampleStep == 0)
+    {
+        throw std::invalid_argument("The sample step must be at least 1.");
+    }
+    ProfileScope scope(ComputeStage);
+
+    FrameScopes scopes;
+    scopes.SampledWidth = (width + sampleStep - 1) / sampleStep;
+    scopes.SampledHeight = (height + sampleStep - 1) / sampleStep;
+    scopes.WaveformWidth = std::min(scopes.SampledWidth, MaxWaveformWidth);
+    scopes.Waveform.resize(static_cast<size_t>(scopes.WaveformWidth) * Levels);
+    scopes.Vectorscope.resize(VectorscopeEntries);
+
+    auto sampledWidth = scopes.SampledWidth;
+    auto waveformWidth = scopes.WaveformWidth;
+    std::vector<uint16_t> columns(sampledWidth);
+    for (uint32_t x = 0; x < sampledWidth; x++)
+    {
+        columns[x] = static_cast<uint16_t>((static_cast<uint64_t>(x) * waveformWidth) / sampledWidth);
+    }
+    // The first sampled column of each waveform column
+    auto firstColumn = [&](uint32_t column)
+    {
+        return static_cast<uint32_t>(((static_cast<uint64_t>(column) * sampledWidth) + waveformWidth - 1) / waveformWidth);
+    };
+
+    // One strip per thread, split on waveform columns
+    auto stripCount = std::min(TaskScheduler::Default().WorkerCount() + 1, waveformWidth);
+    auto partialBuffer = BufferPool::Shared().Acquire(static_cast<size_t>(stripCount) * PartialEntries * sizeof(uint32_t));
+    auto partials = reinterpret_cast<uint32_t*>(partialBuffer.Data());
+    ParallelFor(0, stripCount, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto strip = begin; strip < end; strip++)
+        {
+            auto stripBegin = firstColumn(static_cast<uint32_t>((static_cast<uint64_t>(strip) * waveformWidth) / stripCount));
+            auto stripEnd = firstColumn(static_cast<uint32_t>((static_cast<uint64_t>(strip + 1) * waveformWidth) / stripCount));
+            CountStrip(
+                bgraPixels, stride, sampleStep, scopes.SampledHeight,
+                stripBegin, stripEnd, columns.data(), waveformWidth,
+                scopes.Waveform.data(), partials + (static_cast<size_t>(strip) * PartialEntries));
+        }
+    }, priority);
+
+    auto vectorscopeOffset = HistogramSets * HistogramEntries;
+    auto chunkCount = static_cast<uint32_t>((VectorscopeEntries + ReduceChunkEntries - 1) / ReduceChunkEntries);
+    ParallelFor(0, chunkCount, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto chunk = begin; chunk < end; chunk++)
+        {
+            auto first = static_cast<size_t>(chunk) * ReduceChunkEntries;
+            auto count = std::min(ReduceChunkEntries, VectorscopeEntries - first);
+            SumPartials(partials, stripCount, vectorscopeOffset + first, count, scopes.Vectorscope.data() + first);
+        }
+    }, priority);
+
+    std::vector<uint32_t> histogramSets(HistogramSets * HistogramEntries);
+    SumPartials(partials, stripCount, 0, histogramSets.size(), histogramSets.data());
+    for (size_t i = 0; i < HistogramEntries; i++)
+    {
+        uint32_t sum = 0;
+        for (size_t set = 0; set < HistogramSets; set++)
+        {
+            sum += histogramSets[(set * HistogramEntries) + i];
+        }
+        scopes.Histograms[i / Levels][i % Levels] = sum;
+    }
+    return scopes;
+}
+
+static void StorePixel(uint8_t* dest, uint32_t r, uint32_t g, uint32_t b)
+{
+    dest[0] = static_cast<uint8_t>(std::min(b, 255u));
+    dest[1] = static_cast<uint8_t>(std::min(g, 255u));
+    dest[2] = static_cast<uint8_t>(std::min(r, 255u));
+    dest[3] = 255;
+}
+
+// Maps counts to brightness so that the largest count is 255
+static float LogScale(std::vector<uint32_t> const& counts)
+{
+    auto largest = counts.empty() ? 0 : *std::max_element(counts.begin(), counts.end());
+    return largest == 0 ? 0.0f : 255.0f / std::log2(1.0f + largest);
+}
+
+static uint32_t Brightness(uint32_t count, float scale)
+{
+    // Anything counted is at least dimly lit
+    return count == 0 ? 0 : std::max(static_cast<uint32_t>(std::lround(std::log2(1.0f + count) * scale)), 32u);
+}
+
+void RenderHistogram(FrameScopes const& scopes, uint8_t* bgra, uint32_t height)
+{
+    uint32_t largest = 0;
+    for (auto& histogram : scopes.Histograms)
+    {
+        largest = std::max(largest, *std::max_element(histogram.begin(), histogram.end()));
+    }
+
+    // The height of each bar, in rows
+    std::array<std::array<uint32_t, Levels>, FrameScopes::ChannelCount> bars = {};
+    for (uint32_t channel = 0; channel < FrameScopes::ChannelCount; channel++)
+    {
+        for (uint32_t level = 0; level < Levels; level++)
+        {
+            auto count = scopes.Histograms[channel][level];
+            bars[channel][level] = largest == 0 ? 0 : static_cast<uint32_t>(((static_cast<uint64_t>(count) * height) + largest - 1) / largest);
+        }
+    }
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto rowHeight = height - y;
+        auto row = bgra + (static_cast<size_t>(y) * Levels * 4);
+        for (uint32_t level = 0; level < Levels; level++)
+        {
+            auto gray = bars[0][level] >= rowHeight ? 96u : 0u;
+            auto r = gray + (bars[1][level] >= rowHeight ? 160u : 0u);
+            auto g = gray + (bars[2][level] >= rowHeight ? 160u : 0u);
+            auto b = gray + (bars[3][level] >= rowHeight ? 160u : 0u);
+            StorePixel(row + (level * 4), r, g, b);
+        }
+    }
+}
+
+void RenderWaveform(FrameScopes const& scopes, uint8_t* bgra)
+{
+    auto scale = LogScale(scopes.Waveform);
+    auto width = scopes.WaveformWidth;
+    for (uint32_t y = 0; y < Levels; y++)
+    {
+        auto level = Levels - 1 - y;
+        auto counts = scopes.Waveform.data() + (static_cast<size_t>(level) * width);
+        auto row = bgra + (static_cast<size_t>(y) * width * 4);
+        auto isGuide = level == VideoBlack || level == VideoWhite;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            auto brightness = Brightness(counts[x], scale);
+            if (brightness == 0 && isGuide)
+            {
+                StorePixel(row + (x * 4), 96, 0, 0);
+            }
+            else
+            {
+                StorePixel(row + (x * 4), brightness / 2, brightness, brightness / 2);
+            }
+        }
+    }
+}
+
+void RenderVectorscope(FrameScopes const& scopes, uint8_t* bgra)
+{
+    auto scale = LogScale(scopes.Vectorscope);
+    auto center = static_cast<int32_t>(Levels / 2);
+    for (uint32_t y = 0; y < Levels; y++)
+    {
+        auto cr = Levels - 1 - y;
+        auto counts = scopes.Vectorscope.data() + (static_cast<size_t>(cr) * Levels);
+        auto row = bgra + (static_cast<size_t>(y) * Levels * 4);
+        auto crOffset = static_cast<int32_t>(cr) - center;
+        for (uint32_t cb = 0; cb < Levels; cb++)
+        {
+            auto brightness = Brightness(counts[cb], scale);
+            auto pixel = row + (cb * 4);
+            if (brightness == 0)
+            {
+                // The axes, where the color has no chroma
+                auto isAxis = cb == static_cast<uint32_t>(center) || cr == static_cast<uint32_t>(center);
+                StorePixel(pixel, isAxis ? 48 : 0, isAxis ? 48 : 0, isAxis ? 48 : 0);
+                continue;
+            }
+
+            // The color of this chroma at mid gray, dimmed by the count
+            auto cbOffset = static_cast<int32_t>(cb) - center;
+            auto r = 128.0f + (1.5748f * crOffset);
+            auto g = 128.0f - (0.1873f * cbOffset) - (0.4681f * crOffset);
+            auto b = 128.0f + (1.8556f * cbOffset);
+            auto dim = brightness / 255.0f;
+            StorePixel(pixel,
+                static_cast<uint32_t>(std::clamp(r, 0.0f, 255.0f) * dim),
+                static_cast<uint32_t>(std::clamp(g, 0.0f, 255.0f) * dim),
+                static_cast<uint32_t>(std::clamp(b, 0.0f, 255.0f) * dim));
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "TaskScheduler.h"
+
+enum class ScopeChannel : uint32_t
+{
+    Luma = 0,
+    Red = 1,
+    Green = 2,
+    Blue = 3,
+};
+
+// Histograms, a waveform and a vectorscope of one BGRA8 frame. Luma and
+// chroma are the BT.709 Y'CbCr of the full range 8-bit values, so limited
+// range video that wasn't expanded sits between 16 and 235, and expanded
+// full range video piles up at 0 and 255.
+struct FrameScopes
+{
+    static constexpr uint32_t Levels = 256;
+    static constexpr uint32_t ChannelCount = 4;
+    // Wider frames are binned into this many waveform columns
+    static constexpr uint32_t MaxWaveformWidth = 512;
+
+    // The sampled pixels, every pixel for a sample step of 1
+    uint32_t SampledWidth = 0;
+    uint32_t SampledHeight = 0;
+    std::array<std::array<uint32_t, Levels>, ChannelCount> Histograms = {};
+    // The luma of each column, WaveformWidth counts per level starting
+    // at level 0
+    uint32_t WaveformWidth = 0;
+    std::vector<uint32_t> Waveform;
+    // Counts per Cr row, each a row of Cb
+    std::vector<uint32_t> Vectorscope;
+
+    uint64_t SampleCount() const { return static_cast<uint64_t>(SampledWidth) * SampledHeight; }
+    std::array<uint32_t, Levels> const& Histogram(ScopeChannel channel) const { return Histograms[static_cast<uint32_t>(channel)]; }
+    // The lowest and highest levels with any samples, 0 when empty
+    uint32_t LowestLevel(ScopeChannel channel) const;
+    uint32_t HighestLevel(ScopeChannel channel) const;
+};
+
+// Looks at every sampleStep'th pixel of every sampleStep'th row, starting
+// with the first. Columns of the frame are split between threads, which
+// each count into their own histograms; those are summed at the end.
+FrameScopes ComputeScopes(
+    uint8_t const* bgraPixels, uint32_t width, uint32_t height, uint32_t stride,
+    uint32_t sampleStep, TaskPriority priority = TaskPriority::Visible);
+
+// Opaque BGRA8 images of the scopes. The waveform and vectorscope are
+// lit by the log of the counts, so that sparse traces stay visible.
+// The histogram is Levels wide; red, green and blue add up over the gray
+// luma.
+void RenderHistogram(FrameScopes const& scopes, uint8_t* bgra, uint32_t height);
+// WaveformWidth by Levels, level 255 at the top, with lines at the
+// limited range black and white levels.
+void RenderWaveform(FrameScopes const& scopes, uint8_t* bgra);
+// Levels by Levels, Cb to the right and Cr up, each count drawn in the
+// hue it stands for.
+void RenderVectorscope(FrameScopes const& scopes, uint8_t* bgra);
@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "HalfFloat.h"
+#include "SimdHelpers.h"
+
+static uint32_t FloatBits(float value)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float BitsToFloat(uint32_t bits)
+{
+    float value = 0.0f;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// The exponent field of a half, moved to where a float's is
+static const uint32_t ShiftedExponent = 0x7C00 << 13;
+// The difference between the float and half exponent biases (127 - 15)
+static const uint32_t ExponentAdjust = 112 << 23;
+// 2^-14, the smallest normal half
+static const uint32_t SmallestNormalBits = 113 << 23;
+
+float HalfToFloat(uint16_t half)
+{
+    auto bits = static_cast<uint32_t>(half & 0x7FFF) << 13;
+    auto exponent = bits & ShiftedExponent;
+    bits += ExponentAdjust;
+    if (exponent == ShiftedExponent)
+    {
+        // Infinity or NaN, the exponent goes all the way up
+        bits += ExponentAdjust;
+    }
+    else if (exponent == 0)
+    {
+        // Zero or subnormal: as a normal number 2^-14 too large, which is
+        // then subtracted exactly
+        bits += 1 << 23;
+        bits = FloatBits(BitsToFloat(bits) - BitsToFloat(SmallestNormalBits));
+    }
+    return BitsToFloat(bits | (static_cast<uint32_t>(half & 0x8000) << 16));
+}
+
+uint16_t FloatToHalf(float value)
+{
+    auto bits = FloatBits(value);
+    auto sign = bits & 0x80000000;
+    bits ^= sign;
+
+    uint32_t result = 0;
+    if (bits > 0x7F800000)
+    {
+        // NaNs keep the top of their payload, so that halves make it back
+        // unchanged, and stay NaNs when that part is empty
+        result = 0x7C00 | ((bits >> 13) & 0x3FF);
+        result = result == 0x7C00 ? 0x7E00 : result;
+    }
+    else if (bits >= 0x47800000)
+    {
+        // 65536 and up are too large
+        result = 0x7C00;
+    }
+    else if (bits < 0x38800000)
+    {
+        // Below the smallest normal half. Adding 0.5 lines the half's
+        // subnormal bits up with the bottom of the float's mantissa and
+        // lets the FPU do the rounding.
+        result = FloatBits(BitsToFloat(bits) + 0.5f) - FloatBits(0.5f);
+    }
+    else
+    {
+        // Round to nearest even, an overflow into the exponent is correct
+        auto odd = (bits >> 13) & 1;
+        bits += 0xC8000FFF; // Rebias the exponent and add just under half
+        bits += odd;
+        result = bits >> 13;
+    }
+    return static_cast<uint16_t>(result | (sign >> 16));
+}
+
+void HalfToFloat(uint16_t const* halves, float* floats, size_t count)
+{
+    size_t i = 0;
+#ifdef IMAGEVIEWER_SSE2
+    // The same steps as the scalar version, with compares in place of the
+    // branches
+    auto zero = _mm_setzero_si128();
+    auto magnitudeMask = _mm_set1_epi32(0x7FFF);
+    auto exponentMask = _mm_set1_epi32(static_cast<int32_t>(ShiftedExponent));
+    auto exponentAdjust = _mm_set1_epi32(static_cast<int32_t>(ExponentAdjust));
+    auto subnormalAdjust = _mm_set1_epi32(1 << 23);
+    auto smallestNormal = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int32_t>(SmallestNormalBits)));
+    for (; i + 4 <= count; i += 4)
+    {
+        auto values = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(halves + i)), zero);
+        auto sign = _mm_slli_epi32(_mm_andnot_si128(magnitudeMask, values), 16);
+        auto bits = _mm_slli_epi32(_mm_and_si128(values, magnitudeMask), 13);
+        auto exponent = _mm_and_si128(bits, exponentMask);
+        bits = _mm_add_epi32(bits, exponentAdjust);
+
+        auto infinite = _mm_cmpeq_epi32(exponent, exponentMask);
+        bits = _mm_add_epi32(bits, _mm_and_si128(infinite, exponentAdjust));
+        auto subnormal = _mm_cmpeq_epi32(exponent, zero);
+        bits = _mm_add_epi32(bits, _mm_and_si128(subnormal, subnormalAdjust));
+        // Only subnormals go through the subtraction, which would quiet
+        // signaling NaNs
+        auto normalized = _mm_sub_ps(_mm_castsi128_ps(bits), smallestNormal);
+        auto result = _mm_or_ps(_mm_and_ps(_mm_castsi128_ps(subnormal), normalized), _mm_andnot_ps(_mm_castsi128_ps(subnormal), _mm_castsi128_ps(bits)));
+
+        _mm_storeu_ps(floats + i, _mm_or_ps(result, _mm_castsi128_ps(sign)));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        floats[i] = HalfToFloat(halves[i]);
+    }
+}
+
+void FloatToHalf(float const* floats, uint16_t* halves, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        halves[i] = FloatToHalf(floats[i]);
+    }
+}
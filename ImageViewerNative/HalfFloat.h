@@ -0,0 +1,12 @@
+#pragma once
+
+// IEEE 754 binary16 conversions. Rounding is to nearest even, values too
+// large for a half become infinity and NaNs keep as much of their payload
+// as fits. Every half has an exact float, so a round trip through float
+// gives back the same bits, NaNs included.
+float HalfToFloat(uint16_t half);
+uint16_t FloatToHalf(float value);
+
+// Whole arrays, vectorized for half to float
+void HalfToFloat(uint16_t const* halves, float* floats, size_t count);
+void FloatToHalf(float const* floats, uint16_t* halves, size_t count);
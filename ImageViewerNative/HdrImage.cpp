@@ -0,0 +1,88 @@
+#include "pch.h"
+#include "HdrImage.h"
+#include "HdrImage.g.cpp"
+#include "HalfFloat.h"
+#include "HdrTransfer.h"
+#include "ToneMapper.h"
+
+namespace winrt
+{
+    using namespace Windows::Foundation;
+    using namespace Windows::Foundation::Numerics;
+}
+
+static size_t CheckPixelBytes(size_t byteCount, uint32_t width, uint32_t height, size_t bytesPerPixel)
+{
+    auto pixelCount = static_cast<uint64_t>(width) * height;
+    if (byteCount < pixelCount * bytesPerPixel)
+    {
+        throw winrt::hresult_invalid_argument(L"The pixel buffer is smaller than the given size.");
+    }
+    return static_cast<size_t>(pixelCount);
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    HdrImage::HdrImage(winrt::array_view<uint8_t const> const& halfPixelBytes, uint32_t width, uint32_t height)
+    {
+        auto pixelCount = CheckPixelBytes(halfPixelBytes.size(), width, height, 8);
+        m_pixels.resize(pixelCount * 4);
+        memcpy(m_pixels.data(), halfPixelBytes.data(), m_pixels.size() * sizeof(uint16_t));
+        m_width = width;
+        m_height = height;
+    }
+
+    HdrImage::HdrImage(std::vector<uint16_t>&& halfPixels, uint32_t width, uint32_t height)
+    {
+        m_pixels = std::move(halfPixels);
+        m_width = width;
+        m_height = height;
+    }
+
+    winrt::ImageViewerNative::HdrImage HdrImage::CreateFromFloatPixels(winrt::array_view<uint8_t const> const& floatPixelBytes, uint32_t width, uint32_t height)
+    {
+        auto pixelCount = CheckPixelBytes(floatPixelBytes.size(), width, height, 16);
+        std::vector<float> floats(pixelCount * 4);
+        memcpy(floats.data(), floatPixelBytes.data(), floats.size() * sizeof(float));
+        std::vector<uint16_t> halves(floats.size());
+        ConvertFloatToScRgb(floats.data(), halves.data(), pixelCount);
+        return winrt::make<HdrImage>(std::move(halves), width, height);
+    }
+
+    winrt::ImageViewerNative::HdrImage HdrImage::CreateFromHdr10Pixels(winrt::array_view<uint8_t const> const& pixelBytes, uint32_t width, uint32_t height)
+    {
+        auto pixelCount = CheckPixelBytes(pixelBytes.size(), width, height, 4);
+        std::vector<uint32_t> pixels(pixelCount);
+        memcpy(pixels.data(), pixelBytes.data(), pixels.size() * sizeof(uint32_t));
+        std::vector<uint16_t> halves(pixelCount * 4);
+        ConvertHdr10ToScRgb(pixels.data(), halves.data(), pixelCount);
+        return winrt::make<HdrImage>(std::move(halves), width, height);
+    }
+
+    winrt::com_array<uint8_t> HdrImage::GetHalfPixelBytes()
+    {
+        auto bytes = reinterpret_cast<uint8_t const*>(m_pixels.data());
+        return winrt::com_array<uint8_t>(bytes, bytes + (m_pixels.size() * sizeof(uint16_t)));
+    }
+
+    winrt::IReference<winrt::float4> HdrImage::GetPixel(int32_t x, int32_t y)
+    {
+        if (x < 0 || y < 0 || static_cast<uint32_t>(x) >= m_width || static_cast<uint32_t>(y) >= m_height)
+        {
+            return nullptr;
+        }
+
+        auto pixel = m_pixels.data() + (((static_cast<size_t>(y) * m_width) + x) * 4);
+        winrt::float4 value;
+        HalfToFloat(pixel, &value.x, 4);
+        return winrt::IReference<winrt::float4>(value);
+    }
+
+    winrt::com_array<uint8_t> HdrImage::ToneMap(float exposureStops, winrt::ImageViewerNative::ToneMapOperator const& op)
+    {
+        winrt::com_array<uint8_t> bgraPixels(static_cast<uint32_t>(m_pixels.size()));
+        auto toneMapOperator = op == winrt::ImageViewerNative::ToneMapOperator::Filmic ? ::ToneMapOperator::Filmic : ::ToneMapOperator::Clip;
+        ::ToneMap(m_pixels.data(), m_pixels.size() / 4, bgraPixels.data(), exposureStops, toneMapOperator);
+        return bgraPixels;
+    }
+}
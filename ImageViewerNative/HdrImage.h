@@ -0,0 +1,31 @@
+#pragma once
+#include "HdrImage.g.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct HdrImage : HdrImageT<HdrImage>
+    {
+        HdrImage(winrt::array_view<uint8_t const> const& halfPixelBytes, uint32_t width, uint32_t height);
+        HdrImage(std::vector<uint16_t>&& halfPixels, uint32_t width, uint32_t height);
+
+        static winrt::ImageViewerNative::HdrImage CreateFromFloatPixels(winrt::array_view<uint8_t const> const& floatPixelBytes, uint32_t width, uint32_t height);
+        static winrt::ImageViewerNative::HdrImage CreateFromHdr10Pixels(winrt::array_view<uint8_t const> const& pixelBytes, uint32_t width, uint32_t height);
+
+        uint32_t Width() { return m_width; }
+        uint32_t Height() { return m_height; }
+        winrt::com_array<uint8_t> GetHalfPixelBytes();
+        winrt::Windows::Foundation::IReference<winrt::Windows::Foundation::Numerics::float4> GetPixel(int32_t x, int32_t y);
+        winrt::com_array<uint8_t> ToneMap(float exposureStops, winrt::ImageViewerNative::ToneMapOperator const& op);
+
+    private:
+        std::vector<uint16_t> m_pixels;
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct HdrImage : HdrImageT<HdrImage, implementation::HdrImage>
+    {
+    };
+}
@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "HdrTransfer.h"
+#include "HalfFloat.h"
+#include "ParallelFor.h"
+
+// ST 2084 constants
+static const double PqM1 = 2610.0 / 16384.0;
+static const double PqM2 = 2523.0 / 4096.0 * 128.0;
+static const double PqC1 = 3424.0 / 4096.0;
+static const double PqC2 = 2413.0 / 4096.0 * 32.0;
+static const double PqC3 = 2392.0 / 4096.0 * 32.0;
+
+// Rows are the BT.709 red, green and blue of a BT.2020 color
+static const float Bt2020ToBt709[3][3] =
+{
+    { 1.660491f, -0.587641f, -0.072850f },
+    { -0.124550f, 1.132900f, -0.008349f },
+    { -0.018151f, -0.100579f, 1.118730f },
+};
+
+static const size_t ParallelPixelsPerRow = 64 * 1024;
+
+float PqToLinear(float signal)
+{
+    auto power = std::pow(std::clamp<double>(signal, 0.0, 1.0), 1.0 / PqM2);
+    auto linear = std::pow(std::max(power - PqC1, 0.0) / (PqC2 - (PqC3 * power)), 1.0 / PqM1);
+    return static_cast<float>(linear);
+}
+
+float LinearToPq(float linear)
+{
+    auto power = std::pow(std::clamp<double>(linear, 0.0, 1.0), PqM1);
+    auto signal = std::pow((PqC1 + (PqC2 * power)) / (1.0 + (PqC3 * power)), PqM2);
+    return static_cast<float>(signal);
+}
+
+// Splits a run of pixels into pieces for the scheduler
+template <typename FunctionT>
+static void ForEachPixelRange(size_t pixelCount, FunctionT const& function)
+{
+    auto pieceCount = static_cast<uint32_t>((pixelCount + ParallelPixelsPerRow - 1) / ParallelPixelsPerRow);
+    ParallelFor(0, pieceCount, [&](uint32_t begin, uint32_t end)
+    {
+        auto first = static_cast<size_t>(begin) * ParallelPixelsPerRow;
+        auto last = std::min(static_cast<size_t>(end) * ParallelPixelsPerRow, pixelCount);
+        function(first, last);
+    });
+}
+
+void ConvertHdr10ToScRgb(uint32_t const* pixels, uint16_t* halfRgba, size_t pixelCount)
+{
+    // Every 10-bit code decoded once, in scRGB units
+    static auto const decoded = []()
+    {
+        std::array<float, 1024> values = {};
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            values[i] = PqToLinear(static_cast<float>(i) / 1023.0f) * (PqMaxNits / ScRgbWhiteNits);
+        }
+        return values;
+    }();
+
+    ForEachPixelRange(pixelCount, [&](size_t first, size_t last)
+    {
+        for (auto i = first; i < last; i++)
+        {
+            auto pixel = pixels[i];
+            float bt2020[3] =
+            {
+                decoded[pixel & 0x3FF],
+                decoded[(pixel >> 10) & 0x3FF],
+                decoded[(pixel >> 20) & 0x3FF],
+            };
+            auto dest = halfRgba + (i * 4);
+            for (size_t c = 0; c < 3; c++)
+            {
+                auto& row = Bt2020ToBt709[c];
+                dest[c] = FloatToHalf((row[0] * bt2020[0]) + (row[1] * bt2020[1]) + (row[2] * bt2020[2]));
+            }
+            dest[3] = FloatToHalf(static_cast<float>(pixel >> 30) / 3.0f);
+        }
+    });
+}
+
+void ConvertFloatToScRgb(float const* rgba, uint16_t* halfRgba, size_t pixelCount)
+{
+    ForEachPixelRange(pixelCount, [&](size_t first, size_t last)
+    {
+        FloatToHalf(rgba + (first * 4), halfRgba + (first * 4), (last - first) * 4);
+    });
+}
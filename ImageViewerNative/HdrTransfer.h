@@ -0,0 +1,18 @@
+#pragma once
+
+// scRGB is linear with BT.709 primaries, and 1.0 is 80 nits. HDR10 is
+// BT.2020 primaries encoded with the SMPTE ST 2084 (PQ) curve, which
+// covers 0 to 10000 nits.
+static const float ScRgbWhiteNits = 80.0f;
+static const float PqMaxNits = 10000.0f;
+
+// PQ signal (0-1) to linear nits / 10000, and back
+float PqToLinear(float signal);
+float LinearToPq(float linear);
+
+// R10G10B10A2 HDR10 pixels to RGBA half float scRGB pixels. Colors
+// outside of BT.709 come out negative, as scRGB allows.
+void ConvertHdr10ToScRgb(uint32_t const* pixels, uint16_t* halfRgba, size_t pixelCount);
+// RGBA float scRGB pixels to RGBA half float, for images that were saved
+// as 32-bit floats
+void ConvertFloatToScRgb(float const* rgba, uint16_t* halfRgba, size_t pixelCount);
@@ -0,0 +1,42 @@
+#include "pch.h"
+#include "ImageDiff.h"
+#include "ImageDiff.g.cpp"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    ImageDiff::ImageDiff(winrt::array_view<uint8_t const> const& firstPixels, winrt::array_view<uint8_t const> const& secondPixels, uint32_t width, uint32_t height)
+    {
+        auto size = static_cast<uint64_t>(width) * height * 4;
+        if (firstPixels.size() < size || secondPixels.size() < size)
+        {
+            throw winrt::hresult_invalid_argument(L"The pixel buffers are smaller than the given size.");
+        }
+
+        m_diff = DiffPixels(firstPixels.data(), secondPixels.data(), width, height);
+    }
+
+    winrt::ImageViewerNative::ImageDiff ImageDiff::FromHalfPixels(winrt::array_view<uint8_t const> const& firstHalfPixelBytes, winrt::array_view<uint8_t const> const& secondHalfPixelBytes, uint32_t width, uint32_t height)
+    {
+        auto size = static_cast<uint64_t>(width) * height * 8;
+        if (firstHalfPixelBytes.size() < size || secondHalfPixelBytes.size() < size)
+        {
+            throw winrt::hresult_invalid_argument(L"The pixel buffers are smaller than the given size.");
+        }
+
+        auto diff = DiffHalfPixels(
+            reinterpret_cast<uint16_t const*>(firstHalfPixelBytes.data()),
+            reinterpret_cast<uint16_t const*>(secondHalfPixelBytes.data()),
+            width, height);
+        return winrt::make<ImageDiff>(std::move(diff));
+    }
+
+    winrt::com_array<uint8_t> ImageDiff::GetColorDiffPixels()
+    {
+        return winrt::com_array<uint8_t>(m_diff.ColorPixels.Data(), m_diff.ColorPixels.Data() + m_diff.ColorPixels.Size());
+    }
+
+    winrt::com_array<uint8_t> ImageDiff::GetAlphaDiffPixels()
+    {
+        return winrt::com_array<uint8_t>(m_diff.AlphaPixels.Data(), m_diff.AlphaPixels.Data() + m_diff.AlphaPixels.Size());
+    }
+}
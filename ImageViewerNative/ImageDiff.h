@@ -0,0 +1,28 @@
+#pragma once
+#include "ImageDiff.g.h"
+#include "PixelDiffer.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct ImageDiff : ImageDiffT<ImageDiff>
+    {
+        ImageDiff(winrt::array_view<uint8_t const> const& firstPixels, winrt::array_view<uint8_t const> const& secondPixels, uint32_t width, uint32_t height);
+        ImageDiff(PixelDiff&& diff) : m_diff(std::move(diff)) {}
+
+        static winrt::ImageViewerNative::ImageDiff FromHalfPixels(winrt::array_view<uint8_t const> const& firstHalfPixelBytes, winrt::array_view<uint8_t const> const& secondHalfPixelBytes, uint32_t width, uint32_t height);
+
+        winrt::com_array<uint8_t> GetColorDiffPixels();
+        winrt::com_array<uint8_t> GetAlphaDiffPixels();
+        bool ColorChannelsMatch() { return m_diff.ColorChannelsMatch; }
+        bool AlphaChannelsMatch() { return m_diff.AlphaChannelsMatch; }
+
+    private:
+        PixelDiff m_diff;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct ImageDiff : ImageDiffT<ImageDiff, implementation::ImageDiff>
+    {
+    };
+}
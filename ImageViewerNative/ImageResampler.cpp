@@ -0,0 +1,268 @@
+#include "pch.h"
+#include "ImageResampler.h"
+#include "BufferPool.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "SimdHelpers.h"
+
+static ProfileStage ResampleStage("ImageResampler.Resample");
+
+static const double Pi = 3.14159265358979323846;
+static const int32_t WeightRounding = 1 << (ImageResampler::WeightBits - 1);
+
+// The weights of every destination pixel along one axis. Each pixel reads
+// TapCount source pixels starting at its Start, so the inner loops don't
+// need to check the edges.
+struct FilterTaps
+{
+    uint32_t TapCount = 0;
+    std::vector<uint32_t> Starts;
+    std::vector<int16_t> Weights;
+
+    int16_t const* WeightsFor(uint32_t index) const { return Weights.data() + (static_cast<size_t>(index) * TapCount); }
+};
+
+static double FilterRadius(ResampleFilter filter)
+{
+    return filter == ResampleFilter::Lanczos3 ? 3.0 : 1.0;
+}
+
+static double Sinc(double x)
+{
+    if (x == 0.0)
+    {
+        return 1.0;
+    }
+    x *= Pi;
+    return std::sin(x) / x;
+}
+
+static double FilterWeight(ResampleFilter filter, double x)
+{
+    x = std::abs(x);
+    if (filter == ResampleFilter::Lanczos3)
+    {
+        return x < 3.0 ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+    }
+    return std::max(0.0, 1.0 - x);
+}
+
+static FilterTaps ComputeTaps(uint32_t sourceSize, uint32_t destSize, ResampleFilter filter)
+{
+    auto scale = static_cast<double>(sourceSize) / destSize;
+    auto filterScale = std::max(scale, 1.0);
+    auto support = FilterRadius(filter) * filterScale;
+
+    FilterTaps taps;
+    taps.TapCount = std::min(static_cast<uint32_t>(std::ceil(support)) * 2 + 2, sourceSize);
+    taps.Starts.resize(destSize);
+    taps.Weights.resize(static_cast<size_t>(destSize) * taps.TapCount);
+
+    std::vector<double> weights(taps.TapCount);
+    for (uint32_t i = 0; i < destSize; i++)
+    {
+        auto center = (i + 0.5) * scale;
+        auto first = static_cast<int64_t>(std::floor(center - support));
+        auto last = static_cast<int64_t>(std::ceil(center + support));
+        auto lastSource = static_cast<int64_t>(sourceSize) - 1;
+        auto start = static_cast<uint32_t>(std::clamp<int64_t>(first, 0, sourceSize - taps.TapCount));
+
+        std::fill(weights.begin(), weights.end(), 0.0);
+        auto total = 0.0;
+        for (auto j = first; j <= last; j++)
+        {
+            auto weight = FilterWeight(filter, (j + 0.5 - center) / filterScale);
+            if (weight == 0.0)
+            {
+                continue;
+            }
+            // Taps past the edges land on the edge pixels
+            auto clamped = static_cast<uint32_t>(std::clamp<int64_t>(j, 0, lastSource));
+            weights[clamped - start] += weight;
+            total += weight;
+        }
+
+        // The rounding error goes to the largest weight, so that flat
+        // areas come out exactly as they went in
+        auto destWeights = taps.Weights.data() + (static_cast<size_t>(i) * taps.TapCount);
+        int32_t sum = 0;
+        uint32_t largest = 0;
+        for (uint32_t k = 0; k < taps.TapCount; k++)
+        {
+            destWeights[k] = static_cast<int16_t>(std::lround(weights[k] / total * (1 << ImageResampler::WeightBits)));
+            sum += destWeights[k];
+            if (destWeights[k] > destWeights[largest])
+            {
+                largest = k;
+            }
+        }
+        destWeights[largest] = static_cast<int16_t>(destWeights[largest] + (1 << ImageResampler::WeightBits) - sum);
+        taps.Starts[i] = start;
+    }
+    return taps;
+}
+
+static uint8_t ToByte(int32_t sum)
+{
+    return static_cast<uint8_t>(std::clamp((sum + WeightRounding) >> ImageResampler::WeightBits, 0, 255));
+}
+
+#ifdef IMAGEVIEWER_SSE2
+static __m128i WeightPair(int16_t first, int16_t second)
+{
+    return _mm_set1_epi32(static_cast<int32_t>(static_cast<uint16_t>(first) | (static_cast<uint32_t>(static_cast<uint16_t>(second)) << 16)));
+}
+
+static __m128i ToBytes(__m128i sums0, __m128i sums1, __m128i sums2, __m128i sums3)
+{
+    auto rounding = _mm_set1_epi32(WeightRounding);
+    sums0 = _mm_srai_epi32(_mm_add_epi32(sums0, rounding), ImageResampler::WeightBits);
+    sums1 = _mm_srai_epi32(_mm_add_epi32(sums1, rounding), ImageResampler::WeightBits);
+    sums2 = _mm_srai_epi32(_mm_add_epi32(sums2, rounding), ImageResampler::WeightBits);
+    sums3 = _mm_srai_epi32(_mm_add_epi32(sums3, rounding), ImageResampler::WeightBits);
+    return _mm_packus_epi16(_mm_packs_epi32(sums0, sums1), _mm_packs_epi32(sums2, sums3));
+}
+#endif
+
+static void FilterRow(uint8_t const* source, uint8_t* dest, uint32_t destWidth, FilterTaps const& taps)
+{
+    for (uint32_t x = 0; x < destWidth; x++)
+    {
+        auto pixels = source + (static_cast<size_t>(taps.Starts[x]) * 4);
+        auto weights = taps.WeightsFor(x);
+        auto destPixel = dest + (static_cast<size_t>(x) * 4);
+        uint32_t k = 0;
+#ifdef IMAGEVIEWER_SSE2
+        auto zero = _mm_setzero_si128();
+        auto sums = _mm_setzero_si128();
+        for (; k + 2 <= taps.TapCount; k += 2)
+        {
+            // b0 g0 r0 a0 b1 g1 r1 a1 -> b0 b1 g0 g1 r0 r1 a0 a1, so that
+            // each multiply-add sums both taps of one channel
+            auto pair = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(pixels + (k * 4))), zero);
+            pair = _mm_unpacklo_epi16(pair, _mm_srli_si128(pair, 8));
+            sums = _mm_add_epi32(sums, _mm_madd_epi16(pair, WeightPair(weights[k], weights[k + 1])));
+        }
+        if (k < taps.TapCount)
+        {
+            int32_t last = 0;
+            memcpy(&last, pixels + (k * 4), 4);
+            auto single = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero), zero);
+            sums = _mm_add_epi32(sums, _mm_madd_epi16(single, WeightPair(weights[k], 0)));
+        }
+        auto bytes = ToBytes(sums, zero, zero, zero);
+        auto value = _mm_cvtsi128_si32(bytes);
+        memcpy(destPixel, &value, 4);
+#else
+        int32_t sums[4] = {};
+        for (; k < taps.TapCount; k++)
+        {
+            for (size_t c = 0; c < 4; c++)
+            {
+                sums[c] += weights[k] * pixels[(k * 4) + c];
+            }
+        }
+        for (size_t c = 0; c < 4; c++)
+        {
+            destPixel[c] = ToByte(sums[c]);
+        }
+#endif
+    }
+}
+
+static void FilterColumns(uint8_t const* source, size_t sourceStride, uint8_t* dest, size_t rowBytes, uint32_t start, uint32_t tapCount, int16_t const* weights)
+{
+    auto rows = source + (start * sourceStride);
+    size_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+    auto zero = _mm_setzero_si128();
+    for (; x + 16 <= rowBytes; x += 16)
+    {
+        auto sums0 = _mm_setzero_si128();
+        auto sums1 = _mm_setzero_si128();
+        auto sums2 = _mm_setzero_si128();
+        auto sums3 = _mm_setzero_si128();
+        for (uint32_t k = 0; k < tapCount; k += 2)
+        {
+            // Interleaving two rows pairs up the same byte of each, with
+            // a zero row standing in for the second of an odd tap count
+            auto row0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows + (k * sourceStride) + x));
+            auto row1 = k + 1 < tapCount ? _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows + ((k + 1) * sourceStride) + x)) : zero;
+            auto weight = WeightPair(weights[k], k + 1 < tapCount ? weights[k + 1] : 0);
+            auto low = _mm_unpacklo_epi8(row0, row1);
+            auto high = _mm_unpackhi_epi8(row0, row1);
+            sums0 = _mm_add_epi32(sums0, _mm_madd_epi16(_mm_unpacklo_epi8(low, zero), weight));
+            sums1 = _mm_add_epi32(sums1, _mm_madd_epi16(_mm_unpackhi_epi8(low, zero), weight));
+            sums2 = _mm_add_epi32(sums2, _mm_madd_epi16(_mm_unpacklo_epi8(high, zero), weight));
+            sums3 = _mm_add_epi32(sums3, _mm_madd_epi16(_mm_unpackhi_epi8(high, zero), weight));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), ToBytes(sums0, sums1, sums2, sums3));
+    }
+#endif
+    for (; x < rowBytes; x++)
+    {
+        int32_t sum = 0;
+        for (uint32_t k = 0; k < tapCount; k++)
+        {
+            sum += weights[k] * rows[(k * sourceStride) + x];
+        }
+        dest[x] = ToByte(sum);
+    }
+}
+
+std::pair<uint32_t, uint32_t> ImageResampler::FitSize(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t maxWidth, uint32_t maxHeight)
+{
+    if (sourceWidth == 0 || sourceHeight == 0)
+    {
+        return { 1, 1 };
+    }
+    auto scale = std::min(static_cast<double>(maxWidth) / sourceWidth, static_cast<double>(maxHeight) / sourceHeight);
+    auto width = static_cast<uint32_t>(std::lround(sourceWidth * scale));
+    auto height = static_cast<uint32_t>(std::lround(sourceHeight * scale));
+    return { std::clamp(width, 1u, std::max(maxWidth, 1u)), std::clamp(height, 1u, std::max(maxHeight, 1u)) };
+}
+
+void ImageResampler::Resample(
+    uint8_t const* source, uint32_t sourceStride, PixelRect const& sourceRect,
+    uint8_t* dest, uint32_t destWidth, uint32_t destHeight, uint32_t destStride,
+    ResampleFilter filter, TaskPriority priority)
+{
+    if (sourceRect.Width == 0 || sourceRect.Height == 0 || destWidth == 0 || destHeight == 0)
+    {
+        throw std::invalid_argument("The source and destination can't be empty.");
+    }
+    ProfileScope scope(ResampleStage);
+
+    auto origin = source + (static_cast<size_t>(sourceRect.Y) * sourceStride) + (static_cast<size_t>(sourceRect.X) * 4);
+    auto rowBytes = static_cast<size_t>(destWidth) * 4;
+    if (sourceRect.Width == destWidth && sourceRect.Height == destHeight)
+    {
+        for (uint32_t y = 0; y < destHeight; y++)
+        {
+            memcpy(dest + (static_cast<size_t>(y) * destStride), origin + (static_cast<size_t>(y) * sourceStride), rowBytes);
+        }
+        return;
+    }
+
+    auto horizontal = ComputeTaps(sourceRect.Width, destWidth, filter);
+    auto vertical = ComputeTaps(sourceRect.Height, destHeight, filter);
+
+    // Every source row is filtered horizontally once, then each
+    // destination row filters a column of those
+    auto intermediate = BufferPool::Shared().Acquire(rowBytes * sourceRect.Height);
+    auto intermediateData = intermediate.Data();
+    ParallelFor(0, sourceRect.Height, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end; y++)
+        {
+            FilterRow(origin + (static_cast<size_t>(y) * sourceStride), intermediateData + (y * rowBytes), destWidth, horizontal);
+        }
+    }, priority);
+    ParallelFor(0, destHeight, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end; y++)
+        {
+            FilterColumns(intermediateData, rowBytes, dest + (static_cast<size_t>(y) * destStride), rowBytes, vertical.Starts[y], vertical.TapCount, vertical.WeightsFor(y));
+        }
+    }, priority);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "PixelRect.h"
+#include "TaskScheduler.h"
+
+enum class ResampleFilter : uint32_t
+{
+    Bilinear = 0,
+    // Sharper, at about three times the taps of bilinear
+    Lanczos3 = 1,
+};
+
+// Scales a region of a BGRA8 image on the CPU, for when the video
+// processor can't. The filter is separable: rows are filtered into an
+// intermediate image first, then columns. When shrinking, the filter is
+// widened by the scale factor so every source pixel contributes.
+// Premultiplied pixels stay premultiplied.
+class ImageResampler
+{
+public:
+    // Fixed point precision of the filter weights
+    static constexpr uint32_t WeightBits = 14;
+
+    // The largest size that fits in the bounds with the aspect ratio of
+    // the source, at least 1x1.
+    static std::pair<uint32_t, uint32_t> FitSize(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t maxWidth, uint32_t maxHeight);
+
+    // Samples outside of sourceRect are clamped to its edges.
+    static void Resample(
+        uint8_t const* source, uint32_t sourceStride, PixelRect const& sourceRect,
+        uint8_t* dest, uint32_t destWidth, uint32_t destHeight, uint32_t destStride,
+        ResampleFilter filter, TaskPriority priority = TaskPriority::Visible);
+};
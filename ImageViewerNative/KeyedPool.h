@@ -0,0 +1,135 @@
+#pragma once
+
+struct PoolStatistics
+{
+    uint64_t Allocations = 0;
+    uint64_t Reuses = 0;
+    // Returned values that were freed because the pool was over budget
+    uint64_t Discards = 0;
+    size_t IdleCost = 0;
+    size_t OutstandingCost = 0;
+};
+
+// Recycles expensive values (buffers, samples, textures) that are
+// interchangeable when their keys match. Values are taken out and handed
+// back explicitly; BufferPool wraps this in leases.
+//
+// Idle values are kept until either the idle budget runs out or Trim is
+// called. Trim keeps only as many idle values per key as were taken out
+// at the same time since the last Trim, so a pool trimmed periodically
+// shrinks back after a burst.
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
+class KeyedPool
+{
+public:
+    // The cost of a value of each key, in whatever unit the budget is in
+    using CostFunction = std::function<size_t(KeyT const& key)>;
+
+    KeyedPool(size_t maxIdleCost, CostFunction cost) : m_maxIdleCost(maxIdleCost), m_cost(std::move(cost)) {}
+    KeyedPool(KeyedPool const&) = delete;
+    KeyedPool& operator=(KeyedPool const&) = delete;
+
+    // Reuses an idle value with the same key, or calls create.
+    template <typename CreateFunctionT>
+    ValueT Take(KeyT const& key, CreateFunctionT const& create)
+    {
+        auto cost = m_cost(key);
+        {
+            std::lock_guard lock(m_lock);
+            auto& bucket = m_buckets[key];
+            bucket.Outstanding++;
+            bucket.PeakOutstanding = std::max(bucket.PeakOutstanding, bucket.Outstanding);
+            m_statistics.OutstandingCost += cost;
+            if (!bucket.Idle.empty())
+            {
+                auto value = std::move(bucket.Idle.back());
+                bucket.Idle.pop_back();
+                m_statistics.IdleCost -= cost;
+                m_statistics.Reuses++;
+                return value;
+            }
+            m_statistics.Allocations++;
+        }
+
+        // Created outside of the lock, allocations can be slow
+        try
+        {
+            return create();
+        }
+        catch (...)
+        {
+            std::lock_guard lock(m_lock);
+            m_buckets[key].Outstanding--;
+            m_statistics.OutstandingCost -= cost;
+            throw;
+        }
+    }
+
+    void Return(KeyT const& key, ValueT value)
+    {
+        auto cost = m_cost(key);
+        std::lock_guard lock(m_lock);
+        auto& bucket = m_buckets[key];
+        bucket.Outstanding--;
+        m_statistics.OutstandingCost -= cost;
+        if (m_statistics.IdleCost + cost > m_maxIdleCost)
+        {
+            // The value is freed with the parameter, after the lock is
+            // released
+            m_statistics.Discards++;
+            return;
+        }
+        bucket.Idle.push_back(std::move(value));
+        m_statistics.IdleCost += cost;
+    }
+
+    void Trim()
+    {
+        std::vector<ValueT> freed;
+        {
+            std::lock_guard lock(m_lock);
+            for (auto it = m_buckets.begin(); it != m_buckets.end();)
+            {
+                auto& bucket = it->second;
+                auto keep = bucket.PeakOutstanding - bucket.Outstanding;
+                auto cost = m_cost(it->first);
+                while (bucket.Idle.size() > keep)
+                {
+                    freed.push_back(std::move(bucket.Idle.back()));
+                    bucket.Idle.pop_back();
+                    m_statistics.IdleCost -= cost;
+                }
+                bucket.PeakOutstanding = bucket.Outstanding;
+                if (bucket.Idle.empty() && bucket.Outstanding == 0)
+                {
+                    it = m_buckets.erase(it);
+                }
+                else
+                {
+                    it++;
+                }
+            }
+        }
+    }
+
+    PoolStatistics Statistics() const
+    {
+        std::lock_guard lock(m_lock);
+        return m_statistics;
+    }
+
+private:
+    struct Bucket
+    {
+        std::vector<ValueT> Idle;
+        size_t Outstanding = 0;
+        size_t PeakOutstanding = 0;
+    };
+
+private:
+    size_t m_maxIdleCost = 0;
+    CostFunction m_cost;
+    mutable std::mutex m_lock;
+    std::unordered_map<KeyT, Bucket, HashT> m_buckets;
+    PoolStatistics m_statistics;
+};
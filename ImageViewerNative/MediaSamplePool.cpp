@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "MediaSamplePool.h"
+#include "BufferPool.h"
+#include "Profiler.h"
+
+static ProfileCounter AllocationCounter("MediaSamplePool.Allocations");
+static ProfileCounter ReuseCounter("MediaSamplePool.Reuses");
+
+// Called by a tracked sample when its last reference is released. The
+// sample is passed as the result's object.
+struct MediaSamplePool::ReturnCallback : winrt::implements<ReturnCallback, IMFAsyncCallback>
+{
+    ReturnCallback(std::weak_ptr<MediaSamplePool> pool) : m_pool(std::move(pool)) {}
+
+    IFACEMETHODIMP GetParameters(DWORD*, DWORD*) override
+    {
+        return E_NOTIMPL;
+    }
+
+    IFACEMETHODIMP Invoke(IMFAsyncResult* result) noexcept override
+    {
+        try
+        {
+            winrt::com_ptr<::IUnknown> object;
+            winrt::check_hresult(result->GetObject(object.put()));
+            // If the pool is gone the sample is freed with the last reference
+            if (auto pool = m_pool.lock())
+            {
+                pool->Return(object.as<IMFSample>());
+            }
+            return S_OK;
+        }
+        catch (...)
+        {
+            return winrt::to_hresult();
+        }
+    }
+
+private:
+    std::weak_ptr<MediaSamplePool> m_pool;
+};
+
+std::shared_ptr<MediaSamplePool> MediaSamplePool::Create()
+{
+    auto pool = std::shared_ptr<MediaSamplePool>(new MediaSamplePool());
+    pool->m_returnCallback = winrt::make<ReturnCallback>(pool->weak_from_this());
+    return pool;
+}
+
+MediaSamplePool::MediaSamplePool() : m_pool(DefaultMaxIdleBytes, [](size_t const& capacity) { return capacity; })
+{
+}
+
+winrt::com_ptr<IMFSample> MediaSamplePool::Acquire(DWORD size)
+{
+    auto capacity = BufferPool::ClassSize(size);
+    auto created = false;
+    auto sample = m_pool.Take(capacity, [&]()
+    {
+        created = true;
+        winrt::com_ptr<IMFTrackedSample> trackedSample;
+        winrt::check_hresult(MFCreateTrackedSample(trackedSample.put()));
+        auto newSample = trackedSample.as<IMFSample>();
+        winrt::com_ptr<IMFMediaBuffer> buffer;
+        winrt::check_hresult(MFCreateMemoryBuffer(static_cast<DWORD>(capacity), buffer.put()));
+        winrt::check_hresult(newSample->AddBuffer(buffer.get()));
+        return newSample;
+    });
+    if (created)
+    {
+        AllocationCounter.Add(1);
+    }
+    else
+    {
+        ReuseCounter.Add(1);
+        winrt::check_hresult(sample->DeleteAllItems());
+        winrt::check_hresult(sample->SetSampleFlags(0));
+        winrt::check_hresult(sample->SetSampleDuration(0));
+    }
+
+    winrt::com_ptr<IMFMediaBuffer> buffer;
+    winrt::check_hresult(sample->GetBufferByIndex(0, buffer.put()));
+    winrt::check_hresult(buffer->SetCurrentLength(size));
+
+    // The allocator is cleared every time the sample calls back, so it's
+    // set again for each use
+    winrt::check_hresult(sample.as<IMFTrackedSample>()->SetAllocator(m_returnCallback.get(), nullptr));
+    return sample;
+}
+
+void MediaSamplePool::Return(winrt::com_ptr<IMFSample> const& sample)
+{
+    winrt::com_ptr<IMFMediaBuffer> buffer;
+    winrt::check_hresult(sample->GetBufferByIndex(0, buffer.put()));
+    DWORD capacity = 0;
+    winrt::check_hresult(buffer->GetMaxLength(&capacity));
+    m_pool.Return(capacity, sample);
+}
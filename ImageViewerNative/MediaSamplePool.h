@@ -0,0 +1,30 @@
+#pragma once
+#include "KeyedPool.h"
+
+// Recycles memory-backed IMFSamples for compressed input. The samples
+// are tracked samples: one comes back to the pool only once the caller
+// and the decoder, which may hold on to input, have both released it.
+class MediaSamplePool : public std::enable_shared_from_this<MediaSamplePool>
+{
+public:
+    static constexpr size_t DefaultMaxIdleBytes = 64 * 1024 * 1024;
+
+    static std::shared_ptr<MediaSamplePool> Create();
+
+    // The sample has a single buffer of at least size bytes, with its
+    // current length set to size. Sample time, duration and attributes
+    // from its last use are cleared.
+    winrt::com_ptr<IMFSample> Acquire(DWORD size);
+    void Trim() { m_pool.Trim(); }
+    PoolStatistics Statistics() const { return m_pool.Statistics(); }
+
+private:
+    struct ReturnCallback;
+
+    MediaSamplePool();
+    void Return(winrt::com_ptr<IMFSample> const& sample);
+
+private:
+    KeyedPool<size_t, winrt::com_ptr<IMFSample>> m_pool;
+    winrt::com_ptr<IMFAsyncCallback> m_returnCallback;
+};
@@ -0,0 +1,44 @@
+#include "pch.h"
+#include "MipPyramid.h"
+#include "MipPyramid.g.cpp"
+
+namespace winrt
+{
+    using namespace Windows::Graphics;
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    MipPyramid::MipPyramid(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height)
+    {
+        if (bgraPixels.size() < static_cast<uint64_t>(width) * height * 4)
+        {
+            throw winrt::hresult_invalid_argument(L"The pixel buffer is smaller than the given size.");
+        }
+
+        m_builder = std::make_unique<MipPyramidBuilder>(bgraPixels.data(), width, height, width * 4);
+    }
+
+    winrt::SizeInt32 MipPyramid::GetLevelSize(uint32_t level)
+    {
+        if (level >= m_builder->LevelCount())
+        {
+            throw winrt::hresult_out_of_bounds();
+        }
+
+        auto [width, height] = m_builder->LevelSize(level);
+        return { static_cast<int32_t>(width), static_cast<int32_t>(height) };
+    }
+
+    winrt::com_array<uint8_t> MipPyramid::GetLevelPixels(uint32_t level)
+    {
+        // Level 0 is the caller's own image
+        if (level == 0 || level >= m_builder->LevelCount())
+        {
+            throw winrt::hresult_out_of_bounds();
+        }
+
+        auto& mipLevel = m_builder->Level(level);
+        return winrt::com_array<uint8_t>(mipLevel.Pixels.begin(), mipLevel.Pixels.end());
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "MipPyramid.g.h"
+#include "MipPyramidBuilder.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct MipPyramid : MipPyramidT<MipPyramid>
+    {
+        MipPyramid(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height);
+
+        uint32_t LevelCount() { return m_builder->LevelCount(); }
+        winrt::Windows::Graphics::SizeInt32 GetLevelSize(uint32_t level);
+        winrt::com_array<uint8_t> GetLevelPixels(uint32_t level);
+
+        static uint32_t LevelForView(uint32_t width, uint32_t height, float zoomFactor, uint32_t maxTextureSize) { return MipPyramidBuilder::LevelForView(width, height, zoomFactor, maxTextureSize); }
+
+    private:
+        std::unique_ptr<MipPyramidBuilder> m_builder;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct MipPyramid : MipPyramidT<MipPyramid, implementation::MipPyramid>
+    {
+    };
+}
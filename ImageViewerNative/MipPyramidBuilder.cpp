@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "MipPyramidBuilder.h"
+#include "ParallelFor.h"
+#include "SimdHelpers.h"
+
+MipPyramidBuilder::MipPyramidBuilder(uint8_t const* bgraPixels, uint32_t width, uint32_t height, uint32_t stride)
+{
+    m_width = width;
+    m_height = height;
+
+    m_levelCount = LevelCountForSize(width, height);
+    m_levels.resize(m_levelCount);
+
+    if (m_levelCount > 1)
+    {
+        auto level = std::make_unique<MipLevel>();
+        // Built ahead of time, before anyone zooms out
+        Downsample(bgraPixels, width, height, stride, *level, TaskPriority::Background);
+        m_levels[1] = std::move(level);
+    }
+}
+
+std::pair<uint32_t, uint32_t> MipPyramidBuilder::LevelSize(uint32_t level) const
+{
+    auto width = m_width;
+    auto height = m_height;
+    for (uint32_t i = 0; i < level; i++)
+    {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    return { width, height };
+}
+
+MipLevel const& MipPyramidBuilder::Level(uint32_t level)
+{
+    if (level == 0 || level >= m_levelCount)
+    {
+        throw std::out_of_range("level");
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto finest = level;
+    while (!m_levels[finest])
+    {
+        finest--;
+    }
+    for (auto i = finest + 1; i <= level; i++)
+    {
+        auto& source = *m_levels[i - 1];
+        auto dest = std::make_unique<MipLevel>();
+        Downsample(source.Pixels.data(), source.Width, source.Height, source.Width * 4, *dest, TaskPriority::Visible);
+        m_levels[i] = std::move(dest);
+    }
+    return *m_levels[level];
+}
+
+uint32_t MipPyramidBuilder::LevelCountForSize(uint32_t width, uint32_t height)
+{
+    uint32_t levelCount = 1;
+    auto largest = std::max(width, height);
+    while (largest > 1)
+    {
+        largest = (largest + 1) / 2;
+        levelCount++;
+    }
+    return levelCount;
+}
+
+uint32_t MipPyramidBuilder::LevelForZoomFactor(float zoomFactor, uint32_t levelCount)
+{
+    // Pick the finest level that is still drawn at or below 1:1
+    if (zoomFactor >= 1.0f || levelCount == 0 || zoomFactor <= 0.0f)
+    {
+        return 0;
+    }
+    auto level = static_cast<uint32_t>(std::floor(std::log2(1.0f / zoomFactor)));
+    return std::min(level, levelCount - 1);
+}
+
+uint32_t MipPyramidBuilder::LevelForView(uint32_t width, uint32_t height, float zoomFactor, uint32_t maxTextureSize)
+{
+    auto levelCount = LevelCountForSize(width, height);
+    auto level = LevelForZoomFactor(zoomFactor, levelCount);
+    auto largest = std::max(width, height);
+    for (uint32_t i = 0; i < level; i++)
+    {
+        largest = (largest + 1) / 2;
+    }
+    while (largest > std::max(maxTextureSize, 1u) && level + 1 < levelCount)
+    {
+        largest = (largest + 1) / 2;
+        level++;
+    }
+    return level;
+}
+
+static void AverageQuad(uint8_t const* topLeft, uint8_t const* topRight, uint8_t const* bottomLeft, uint8_t const* bottomRight, uint8_t* dest)
+{
+    for (size_t i = 0; i < 4; i++)
+    {
+        dest[i] = static_cast<uint8_t>((topLeft[i] + topRight[i] + bottomLeft[i] + bottomRight[i] + 2) / 4);
+    }
+}
+
+void MipPyramidBuilder::Downsample(uint8_t const* source, uint32_t sourceWidth, uint32_t sourceHeight, uint32_t sourceStride, MipLevel& dest, TaskPriority priority)
+{
+    dest.Width = (sourceWidth + 1) / 2;
+    dest.Height = (sourceHeight + 1) / 2;
+    dest.Pixels.resize(static_cast<size_t>(dest.Width) * dest.Height * 4);
+
+    // Odd edges are clamped, so the last row/column is averaged with itself
+#ifdef IMAGEVIEWER_SSE2
+    auto pairedWidth = sourceWidth / 2;
+#endif
+    ParallelFor(0, dest.Height, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end; y++)
+        {
+            auto row0 = source + (static_cast<size_t>(y) * 2 * sourceStride);
+            auto row1 = (y * 2) + 1 < sourceHeight ? row0 + sourceStride : row0;
+            auto destRow = dest.Pixels.data() + (static_cast<size_t>(y) * dest.Width * 4);
+
+            uint32_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+            auto zero = _mm_setzero_si128();
+            auto rounding = _mm_set1_epi16(2);
+            for (; x + 2 <= pairedWidth; x += 2)
+            {
+                // 4 source pixels from each row become 2 destination pixels
+                auto top = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row0 + (x * 8)));
+                auto bottom = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row1 + (x * 8)));
+                auto low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+                auto high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+                auto sums = _mm_add_epi16(_mm_unpacklo_epi64(low, high), _mm_unpackhi_epi64(low, high));
+                auto averages = _mm_srli_epi16(_mm_add_epi16(sums, rounding), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(destRow + (x * 4)), _mm_packus_epi16(averages, averages));
+            }
+#endif
+            for (; x < dest.Width; x++)
+            {
+                auto left = x * 2;
+                auto right = std::min(left + 1, sourceWidth - 1);
+                AverageQuad(row0 + (left * 4), row0 + (right * 4), row1 + (left * 4), row1 + (right * 4), destRow + (x * 4));
+            }
+        }
+    }, priority);
+}
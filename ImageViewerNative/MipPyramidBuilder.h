@@ -0,0 +1,39 @@
+#pragma once
+#include "TaskScheduler.h"
+
+struct MipLevel
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    std::vector<uint8_t> Pixels;
+};
+
+// Builds successive 2x box-filtered levels of a BGRA8 image. Level 0 is
+// the image itself, which the caller already owns, so only level 1 is
+// built up front (the one pass that touches every source pixel). The
+// coarser levels are built from the next finer one the first time they
+// are asked for, each costing a quarter of the one before it.
+class MipPyramidBuilder
+{
+public:
+    MipPyramidBuilder(uint8_t const* bgraPixels, uint32_t width, uint32_t height, uint32_t stride);
+
+    uint32_t LevelCount() const { return m_levelCount; }
+    std::pair<uint32_t, uint32_t> LevelSize(uint32_t level) const;
+    // Valid for levels 1 through LevelCount() - 1.
+    MipLevel const& Level(uint32_t level);
+
+    static uint32_t LevelCountForSize(uint32_t width, uint32_t height);
+    static uint32_t LevelForZoomFactor(float zoomFactor, uint32_t levelCount);
+    // The level to show an image at the given zoom: the finest one drawn
+    // at or below 1:1 that also fits in a texture of maxTextureSize.
+    static uint32_t LevelForView(uint32_t width, uint32_t height, float zoomFactor, uint32_t maxTextureSize);
+    static void Downsample(uint8_t const* source, uint32_t sourceWidth, uint32_t sourceHeight, uint32_t sourceStride, MipLevel& dest, TaskPriority priority);
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_levelCount = 0;
+    std::mutex m_lock;
+    std::vector<std::unique_ptr<MipLevel>> m_levels;
+};
@@ -0,0 +1,59 @@
+#include "pch.h"
+#include "MotionAnalysis.h"
+#include "MotionAnalysis.g.cpp"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    MotionAnalysis::MotionAnalysis(std::shared_ptr<MotionField const> field)
+    {
+        m_field = std::move(field);
+    }
+
+    winrt::ImageViewerNative::MotionAnalysis MotionAnalysis::Estimate(winrt::array_view<uint8_t const> const& previousPixels, winrt::array_view<uint8_t const> const& currentPixels, uint32_t width, uint32_t height, uint32_t searchRange)
+    {
+        if (width < MotionField::BlockSize || height < MotionField::BlockSize)
+        {
+            throw winrt::hresult_invalid_argument(L"Frames must be at least 16 pixels on each side.");
+        }
+        auto frameBytes = static_cast<uint64_t>(width) * height * 4;
+        if (previousPixels.size() < frameBytes || currentPixels.size() < frameBytes)
+        {
+            throw winrt::hresult_invalid_argument(L"The pixel buffer is smaller than the given size.");
+        }
+
+        auto field = EstimateMotion(previousPixels.data(), currentPixels.data(), width, height, width * 4, searchRange);
+        return winrt::make<MotionAnalysis>(std::make_shared<MotionField const>(std::move(field)));
+    }
+
+    winrt::com_array<int32_t> MotionAnalysis::GetVectors()
+    {
+        winrt::com_array<int32_t> vectors(static_cast<uint32_t>(m_field->BlockCount() * 2));
+        for (size_t i = 0; i < m_field->BlockCount(); i++)
+        {
+            vectors[static_cast<uint32_t>(i * 2)] = m_field->Vectors[i].X;
+            vectors[static_cast<uint32_t>((i * 2) + 1)] = m_field->Vectors[i].Y;
+        }
+        return vectors;
+    }
+
+    winrt::com_array<uint32_t> MotionAnalysis::GetSads()
+    {
+        return winrt::com_array<uint32_t>(m_field->Sads.begin(), m_field->Sads.end());
+    }
+
+    winrt::Windows::Graphics::PointInt32 MotionAnalysis::GlobalMotion()
+    {
+        return { m_field->GlobalMotion.X, m_field->GlobalMotion.Y };
+    }
+
+    winrt::com_array<uint8_t> MotionAnalysis::RenderOverlay(uint32_t width, uint32_t height)
+    {
+        if (width == 0 || height == 0)
+        {
+            throw winrt::hresult_invalid_argument(L"The overlay size must not be empty.");
+        }
+        winrt::com_array<uint8_t> pixels(width * height * 4);
+        RenderMotionOverlay(*m_field, pixels.data(), width, height);
+        return pixels;
+    }
+}
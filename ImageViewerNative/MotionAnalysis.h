@@ -0,0 +1,35 @@
+#pragma once
+#include "MotionAnalysis.g.h"
+#include "MotionEstimator.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct MotionAnalysis : MotionAnalysisT<MotionAnalysis>
+    {
+        MotionAnalysis(std::shared_ptr<MotionField const> field);
+
+        static winrt::ImageViewerNative::MotionAnalysis Estimate(winrt::array_view<uint8_t const> const& previousPixels, winrt::array_view<uint8_t const> const& currentPixels, uint32_t width, uint32_t height, uint32_t searchRange);
+        static uint32_t DefaultSearchRange() { return 64; }
+
+        uint32_t BlockSize() { return MotionField::BlockSize; }
+        uint32_t BlocksWide() { return m_field->BlocksWide; }
+        uint32_t BlocksHigh() { return m_field->BlocksHigh; }
+        winrt::com_array<int32_t> GetVectors();
+        winrt::com_array<uint32_t> GetSads();
+        winrt::Windows::Graphics::PointInt32 GlobalMotion();
+        float GlobalConfidence() { return m_field->GlobalConfidence; }
+        uint32_t TexturedBlockCount() { return m_field->TexturedBlockCount; }
+        double MeanSad() { return m_field->MeanSad(); }
+        double MeanStillSad() { return m_field->MeanStillSad(); }
+        winrt::com_array<uint8_t> RenderOverlay(uint32_t width, uint32_t height);
+
+    private:
+        std::shared_ptr<MotionField const> m_field;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct MotionAnalysis : MotionAnalysisT<MotionAnalysis, implementation::MotionAnalysis>
+    {
+    };
+}
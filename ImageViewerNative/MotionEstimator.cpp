@@ -0,0 +1,565 @@
+#include "pch.h"
+#include "MotionEstimator.h"
+#include "BufferPool.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "SimdHelpers.h"
+
+static ProfileStage EstimateStage("MotionEstimator.Estimate");
+static ProfileStage PyramidStage("MotionEstimator.BuildPyramids");
+
+static const uint32_t BlockSize = MotionField::BlockSize;
+static const uint32_t BlockPixels = BlockSize * BlockSize;
+// The coarsest level is searched this far in each direction, and as few
+// levels are built as that allows
+static const int32_t CoarseSearchRange = 8;
+static const uint32_t MaxLevels = 5;
+// Finer levels look this far around their best candidate
+static const int32_t RefineRange = 1;
+// The parent block and the four beside it
+static const int32_t ParentNeighbours[5][2] = { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+// A block needs this much difference against itself moved by a pixel,
+// both across and down, to be counted as textured (2 levels per pixel)
+static const uint32_t TexturedActivity = 2 * BlockPixels;
+// The residual per pixel drawn at full strength in the overlay
+static const float HeatmapFullScale = 24.0f;
+
+double MotionField::MeanSad() const
+{
+    if (Sads.empty())
+    {
+        return 0.0;
+    }
+    uint64_t total = 0;
+    for (auto sad : Sads)
+    {
+        total += sad;
+    }
+    return static_cast<double>(total) / (static_cast<double>(Sads.size()) * BlockPixels);
+}
+
+double MotionField::MeanStillSad() const
+{
+    if (StillSads.empty())
+    {
+        return 0.0;
+    }
+    uint64_t total = 0;
+    for (auto sad : StillSads)
+    {
+        total += sad;
+    }
+    return static_cast<double>(total) / (static_cast<double>(StillSads.size()) * BlockPixels);
+}
+
+struct LumaPlane
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    PooledBuffer Buffer;
+
+    uint8_t* Row(uint32_t y) { return Buffer.Data() + (static_cast<size_t>(y) * Width); }
+    uint8_t const* Row(uint32_t y) const { return Buffer.Data() + (static_cast<size_t>(y) * Width); }
+};
+
+// The same BT.709 weights as the scopes:
+//   Y = (54 R + 183 G + 19 B + 128) >> 8
+static void ConvertRowToLuma(uint8_t const* bgra, uint8_t* luma, uint32_t width)
+{
+    uint32_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+    auto mask = _mm_set1_epi32(0xFF);
+    auto quadLuma = [&](__m128i pixels)
+    {
+        // Every lane stays below 2^16, so 16-bit multiplies are enough
+        auto b = _mm_and_si128(pixels, mask);
+        auto g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+        auto r = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+        auto sum = _mm_add_epi32(
+            _mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(54)), _mm_mullo_epi16(g, _mm_set1_epi32(183))),
+            _mm_add_epi32(_mm_mullo_epi16(b, _mm_set1_epi32(19)), _mm_set1_epi32(128)));
+        return _mm_srli_epi32(sum, 8);
+    };
+    for (; x + 16 <= width; x += 16)
+    {
+        auto pixels = reinterpret_cast<__m128i const*>(bgra + (static_cast<size_t>(x) * 4));
+        auto first = _mm_packs_epi32(quadLuma(_mm_loadu_si128(pixels)), quadLuma(_mm_loadu_si128(pixels + 1)));
+        auto second = _mm_packs_epi32(quadLuma(_mm_loadu_si128(pixels + 2)), quadLuma(_mm_loadu_si128(pixels + 3)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(luma + x), _mm_packus_epi16(first, second));
+    }
+#endif
+    for (; x < width; x++)
+    {
+        auto pixel = bgra + (static_cast<size_t>(x) * 4);
+        luma[x] = static_cast<uint8_t>(((54 * pixel[2]) + (183 * pixel[1]) + (19 * pixel[0]) + 128) >> 8);
+    }
+}
+
+// Each pixel is the mean of a 2x2 square of the row pair above it
+static void HalveRow(uint8_t const* top, uint8_t const* bottom, uint8_t* dest, uint32_t destWidth)
+{
+    uint32_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+    // Averages of averages, which can round up by one more than the
+    // exact mean
+    auto evenMask = _mm_set1_epi16(0xFF);
+    for (; x + 16 <= destWidth; x += 16)
+    {
+        auto source = static_cast<size_t>(x) * 2;
+        auto first = _mm_avg_epu8(
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(top + source)),
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(bottom + source)));
+        auto second = _mm_avg_epu8(
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(top + source + 16)),
+            _mm_loadu_si128(reinterpret_cast<__m128i const*>(bottom + source + 16)));
+        first = _mm_avg_epu16(_mm_and_si128(first, evenMask), _mm_srli_epi16(first, 8));
+        second = _mm_avg_epu16(_mm_and_si128(second, evenMask), _mm_srli_epi16(second, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), _mm_packus_epi16(first, second));
+    }
+#endif
+    for (; x < destWidth; x++)
+    {
+        auto source = static_cast<size_t>(x) * 2;
+        dest[x] = static_cast<uint8_t>((top[source] + top[source + 1] + bottom[source] + bottom[source + 1] + 2) >> 2);
+    }
+}
+
+static std::vector<LumaPlane> BuildPyramid(uint8_t const* bgra, uint32_t width, uint32_t height, uint32_t stride, uint32_t levelCount, TaskPriority priority)
+{
+    std::vector<LumaPlane> levels(levelCount);
+    levels[0].Width = width;
+    levels[0].Height = height;
+    levels[0].Buffer = BufferPool::Shared().Acquire(static_cast<size_t>(width) * height);
+    auto& base = levels[0];
+    ParallelFor(0, height, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end; y++)
+        {
+            ConvertRowToLuma(bgra + (static_cast<size_t>(y) * stride), base.Row(y), width);
+        }
+    }, priority);
+
+    for (uint32_t level = 1; level < levelCount; level++)
+    {
+        auto& source = levels[level - 1];
+        auto& dest = levels[level];
+        dest.Width = source.Width / 2;
+        dest.Height = source.Height / 2;
+        dest.Buffer = BufferPool::Shared().Acquire(static_cast<size_t>(dest.Width) * dest.Height);
+        ParallelFor(0, dest.Height, [&](uint32_t begin, uint32_t end)
+        {
+            for (auto y = begin; y < end; y++)
+            {
+                HalveRow(source.Row(y * 2), source.Row((y * 2) + 1), dest.Row(y), dest.Width);
+            }
+        }, priority);
+    }
+    return levels;
+}
+
+// The SAD of two BlockSize squares with the same stride
+static uint32_t BlockSad(uint8_t const* first, uint8_t const* second, uint32_t stride)
+{
+#ifdef IMAGEVIEWER_SSE2
+    auto sum = _mm_setzero_si128();
+    for (uint32_t y = 0; y < BlockSize; y++)
+    {
+        auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(first));
+        auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(second));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(a, b));
+        first += stride;
+        second += stride;
+    }
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#else
+    uint32_t sum = 0;
+    for (uint32_t y = 0; y < BlockSize; y++)
+    {
+        for (uint32_t x = 0; x < BlockSize; x++)
+        {
+            sum += static_cast<uint32_t>(std::abs(first[x] - second[x]));
+        }
+        first += stride;
+        second += stride;
+    }
+    return sum;
+#endif
+}
+
+static uint32_t BlockCountFor(uint32_t size)
+{
+    return (size + BlockSize - 1) / BlockSize;
+}
+
+// The last block is moved in to end at the edge
+static uint32_t BlockOrigin(uint32_t block, uint32_t size)
+{
+    return std::min(block * BlockSize, size - BlockSize);
+}
+
+// A block one pixel along, or back at the far edge. Frames only one
+// block across have no room, and get the block itself, which says nothing
+// about texture in that direction.
+static uint32_t NeighbourOrigin(uint32_t origin, uint32_t size)
+{
+    if (origin + BlockSize < size)
+    {
+        return origin + 1;
+    }
+    return origin > 0 ? origin - 1 : origin;
+}
+
+struct LevelField
+{
+    uint32_t BlocksWide = 0;
+    uint32_t BlocksHigh = 0;
+    // Where each block of the current frame is found in the previous one,
+    // relative to where it is
+    std::vector<MotionVector> Offsets;
+    std::vector<uint32_t> Sads;
+};
+
+class BlockSearch
+{
+public:
+    BlockSearch(LumaPlane const& previous, LumaPlane const& current, uint32_t originX, uint32_t originY)
+        : m_previous(previous), m_origin(current.Row(originY) + originX), m_originX(originX), m_originY(originY)
+    {
+    }
+
+    void Try(int32_t dx, int32_t dy)
+    {
+        auto x = static_cast<int32_t>(m_originX) + dx;
+        auto y = static_cast<int32_t>(m_originY) + dy;
+        if (x < 0 || y < 0 || x > static_cast<int32_t>(m_previous.Width - BlockSize) || y > static_cast<int32_t>(m_previous.Height - BlockSize))
+        {
+            return;
+        }
+
+        // Ties go to the shorter vector, so flat areas stay still
+        auto sad = BlockSad(m_origin, m_previous.Row(y) + x, m_previous.Width);
+        auto length = std::abs(dx) + std::abs(dy);
+        if (!m_found || sad < m_bestSad || (sad == m_bestSad && length < m_bestLength))
+        {
+            m_found = true;
+            m_bestSad = sad;
+            m_bestLength = length;
+            m_best.X = static_cast<int16_t>(dx);
+            m_best.Y = static_cast<int16_t>(dy);
+        }
+    }
+
+    void TryAround(MotionVector center, int32_t range)
+    {
+        for (auto dy = -range; dy <= range; dy++)
+        {
+            for (auto dx = -range; dx <= range; dx++)
+            {
+                Try(center.X + dx, center.Y + dy);
+            }
+        }
+    }
+
+    MotionVector Best() const { return m_best; }
+    uint32_t BestSad() const { return m_bestSad; }
+
+private:
+    LumaPlane const& m_previous;
+    uint8_t const* m_origin = nullptr;
+    uint32_t m_originX = 0;
+    uint32_t m_originY = 0;
+    bool m_found = false;
+    MotionVector m_best;
+    uint32_t m_bestSad = 0;
+    int32_t m_bestLength = 0;
+};
+
+static LevelField SearchLevel(LumaPlane const& previous, LumaPlane const& current, LevelField const* coarser, int32_t searchRange, TaskPriority priority)
+{
+    LevelField field;
+    field.BlocksWide = BlockCountFor(current.Width);
+    field.BlocksHigh = BlockCountFor(current.Height);
+    auto blockCount = static_cast<size_t>(field.BlocksWide) * field.BlocksHigh;
+    field.Offsets.resize(blockCount);
+    field.Sads.resize(blockCount);
+
+    ParallelFor(0, field.BlocksHigh, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto by = begin; by < end; by++)
+        {
+            auto originY = BlockOrigin(by, current.Height);
+            for (uint32_t bx = 0; bx < field.BlocksWide; bx++)
+            {
+                auto index = (static_cast<size_t>(by) * field.BlocksWide) + bx;
+                BlockSearch search(previous, current, BlockOrigin(bx, current.Width), originY);
+                search.Try(0, 0);
+                if (coarser == nullptr)
+                {
+                    search.TryAround(MotionVector(), searchRange);
+                }
+                else
+                {
+                    // The block above at twice the scale and its
+                    // neighbours, which may have been nearer the middle of
+                    // what moved, and the block to the left, which this
+                    // thread already matched
+                    auto parentX = static_cast<int32_t>(std::min(bx / 2, coarser->BlocksWide - 1));
+                    auto parentY = static_cast<int32_t>(std::min(by / 2, coarser->BlocksHigh - 1));
+                    for (auto neighbour : ParentNeighbours)
+                    {
+                        auto x = parentX + neighbour[0];
+                        auto y = parentY + neighbour[1];
+                        if (x >= 0 && y >= 0 && x < static_cast<int32_t>(coarser->BlocksWide) && y < static_cast<int32_t>(coarser->BlocksHigh))
+                        {
+                            auto parent = coarser->Offsets[(static_cast<size_t>(y) * coarser->BlocksWide) + x];
+                            search.Try(parent.X * 2, parent.Y * 2);
+                        }
+                    }
+                    if (bx > 0)
+                    {
+                        auto left = field.Offsets[index - 1];
+                        search.Try(left.X, left.Y);
+                    }
+                    search.TryAround(search.Best(), RefineRange);
+                }
+                field.Offsets[index] = search.Best();
+                field.Sads[index] = search.BestSad();
+            }
+        }
+    }, priority);
+    return field;
+}
+
+static void FindGlobalMotion(MotionField& field)
+{
+    std::unordered_map<uint32_t, uint32_t> votes;
+    uint32_t bestVotes = 0;
+    for (size_t i = 0; i < field.BlockCount(); i++)
+    {
+        if (!field.Textured[i])
+        {
+            continue;
+        }
+        auto vector = field.Vectors[i];
+        auto key = (static_cast<uint32_t>(static_cast<uint16_t>(vector.X)) << 16) | static_cast<uint16_t>(vector.Y);
+        auto count = ++votes[key];
+        if (count > bestVotes)
+        {
+            bestVotes = count;
+            field.GlobalMotion = vector;
+        }
+    }
+
+    uint32_t agreeing = 0;
+    for (size_t i = 0; i < field.BlockCount(); i++)
+    {
+        auto vector = field.Vectors[i];
+        if (field.Textured[i] && std::abs(vector.X - field.GlobalMotion.X) <= 1 && std::abs(vector.Y - field.GlobalMotion.Y) <= 1)
+        {
+            agreeing++;
+        }
+    }
+    field.GlobalConfidence = field.TexturedBlockCount > 0 ? static_cast<float>(agreeing) / field.TexturedBlockCount : 0.0f;
+}
+
+MotionField EstimateMotion(
+    uint8_t const* previousBgra, uint8_t const* currentBgra,
+    uint32_t width, uint32_t height, uint32_t stride,
+    uint32_t searchRange, TaskPriority priority)
+{
+    if (width < BlockSize || height < BlockSize)
+    {
+        throw std::invalid_argument("Frames must be at least 16 pixels on each side.");
+    }
+
+    ProfileScope scope(EstimateStage);
+
+    // Enough levels that the coarsest search covers the range, as long as
+    // each level is still a couple of blocks across
+    uint32_t levelCount = 1;
+    while (levelCount < MaxLevels &&
+        (searchRange >> (levelCount - 1)) > static_cast<uint32_t>(CoarseSearchRange) &&
+        (width >> levelCount) >= BlockSize * 2 &&
+        (height >> levelCount) >= BlockSize * 2)
+    {
+        levelCount++;
+    }
+    auto coarseScale = 1u << (levelCount - 1);
+    auto coarseRange = static_cast<int32_t>((searchRange + coarseScale - 1) / coarseScale);
+
+    std::vector<LumaPlane> previous;
+    std::vector<LumaPlane> current;
+    {
+        ProfileScope pyramidScope(PyramidStage);
+        previous = BuildPyramid(previousBgra, width, height, stride, levelCount, priority);
+        current = BuildPyramid(currentBgra, width, height, stride, levelCount, priority);
+    }
+
+    LevelField levelField;
+    for (auto level = levelCount; level-- > 0;)
+    {
+        auto finer = SearchLevel(previous[level], current[level], level + 1 < levelCount ? &levelField : nullptr, coarseRange, priority);
+        levelField = std::move(finer);
+    }
+
+    MotionField field;
+    field.Width = width;
+    field.Height = height;
+    field.BlocksWide = levelField.BlocksWide;
+    field.BlocksHigh = levelField.BlocksHigh;
+    auto blockCount = levelField.Offsets.size();
+    field.Vectors.resize(blockCount);
+    field.Sads = std::move(levelField.Sads);
+    field.StillSads.resize(blockCount);
+    field.Textured.resize(blockCount);
+
+    // Content moved the opposite way to where it was found
+    auto& previousLuma = previous[0];
+    auto& currentLuma = current[0];
+    ParallelFor(0, field.BlocksHigh, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto by = begin; by < end; by++)
+        {
+            auto originY = BlockOrigin(by, height);
+            auto neighbourY = NeighbourOrigin(originY, height);
+            for (uint32_t bx = 0; bx < field.BlocksWide; bx++)
+            {
+                auto index = (static_cast<size_t>(by) * field.BlocksWide) + bx;
+                auto originX = BlockOrigin(bx, width);
+                auto neighbourX = NeighbourOrigin(originX, width);
+                auto offset = levelField.Offsets[index];
+                field.Vectors[index].X = static_cast<int16_t>(-offset.X);
+                field.Vectors[index].Y = static_cast<int16_t>(-offset.Y);
+
+                auto block = currentLuma.Row(originY) + originX;
+                field.StillSads[index] = BlockSad(block, previousLuma.Row(originY) + originX, width);
+                // Only the directions there's room to move in count, so a
+                // frame one block across can still be textured down it
+                std::optional<uint32_t> activity;
+                if (neighbourX != originX)
+                {
+                    activity = BlockSad(block, currentLuma.Row(originY) + neighbourX, width);
+                }
+                if (neighbourY != originY)
+                {
+                    auto down = BlockSad(block, currentLuma.Row(neighbourY) + originX, width);
+                    activity = activity ? std::min(*activity, down) : down;
+                }
+                field.Textured[index] = activity && *activity >= TexturedActivity ? 1 : 0;
+            }
+        }
+    }, priority);
+
+    for (auto textured : field.Textured)
+    {
+        field.TexturedBlockCount += textured;
+    }
+    FindGlobalMotion(field);
+    return field;
+}
+
+static void PutPixel(uint8_t* bgra, uint32_t width, uint32_t height, int32_t x, int32_t y, uint32_t color)
+{
+    if (x >= 0 && y >= 0 && x < static_cast<int32_t>(width) && y < static_cast<int32_t>(height))
+    {
+        memcpy(bgra + (((static_cast<size_t>(y) * width) + x) * 4), &color, 4);
+    }
+}
+
+static void DrawLine(uint8_t* bgra, uint32_t width, uint32_t height, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color)
+{
+    auto dx = std::abs(x1 - x0);
+    auto dy = -std::abs(y1 - y0);
+    auto stepX = x0 < x1 ? 1 : -1;
+    auto stepY = y0 < y1 ? 1 : -1;
+    auto error = dx + dy;
+    while (true)
+    {
+        PutPixel(bgra, width, height, x0, y0, color);
+        if (x0 == x1 && y0 == y1)
+        {
+            break;
+        }
+        auto doubled = error * 2;
+        if (doubled >= dy)
+        {
+            error += dy;
+            x0 += stepX;
+        }
+        if (doubled <= dx)
+        {
+            error += dx;
+            y0 += stepY;
+        }
+    }
+}
+
+void RenderMotionOverlay(MotionField const& field, uint8_t* bgra, uint32_t width, uint32_t height)
+{
+    if (field.BlockCount() == 0 || width == 0 || height == 0)
+    {
+        memset(bgra, 0, static_cast<size_t>(width) * height * 4);
+        return;
+    }
+
+    auto scaleX = static_cast<float>(width) / field.Width;
+    auto scaleY = static_cast<float>(height) / field.Height;
+
+    // Residuals from clear to red through yellow, premultiplied
+    std::vector<uint32_t> tints(field.BlockCount());
+    for (size_t i = 0; i < tints.size(); i++)
+    {
+        auto strength = std::min(field.Sads[i] / (BlockPixels * HeatmapFullScale), 1.0f);
+        auto alpha = static_cast<uint32_t>((strength * 160.0f) + 0.5f);
+        auto green = static_cast<uint32_t>((alpha * (1.0f - strength)) + 0.5f);
+        tints[i] = (alpha << 24) | (alpha << 16) | (green << 8);
+    }
+
+    ParallelFor(0, height, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end; y++)
+        {
+            auto by = std::min(static_cast<uint32_t>(y / scaleY) / BlockSize, field.BlocksHigh - 1);
+            auto row = reinterpret_cast<uint32_t*>(bgra + (static_cast<size_t>(y) * width * 4));
+            for (uint32_t x = 0; x < width; x++)
+            {
+                auto bx = std::min(static_cast<uint32_t>(x / scaleX) / BlockSize, field.BlocksWide - 1);
+                row[x] = tints[(static_cast<size_t>(by) * field.BlocksWide) + bx];
+            }
+        }
+    });
+
+    const uint32_t agreeingColor = 0xFF00FF00;
+    const uint32_t otherColor = 0xFFFFFFFF;
+    for (uint32_t by = 0; by < field.BlocksHigh; by++)
+    {
+        for (uint32_t bx = 0; bx < field.BlocksWide; bx++)
+        {
+            auto index = (static_cast<size_t>(by) * field.BlocksWide) + bx;
+            auto vector = field.Vectors[index];
+            if (vector.X == 0 && vector.Y == 0)
+            {
+                continue;
+            }
+
+            // From where the content was to where it is, with a dot on
+            // the end it moved to
+            auto centerX = (BlockOrigin(bx, field.Width) + (BlockSize / 2)) * scaleX;
+            auto centerY = (BlockOrigin(by, field.Height) + (BlockSize / 2)) * scaleY;
+            auto x0 = static_cast<int32_t>(centerX - (vector.X * scaleX));
+            auto y0 = static_cast<int32_t>(centerY - (vector.Y * scaleY));
+            auto x1 = static_cast<int32_t>(centerX);
+            auto y1 = static_cast<int32_t>(centerY);
+            auto agrees = std::abs(vector.X - field.GlobalMotion.X) <= 1 && std::abs(vector.Y - field.GlobalMotion.Y) <= 1;
+            auto color = agrees ? agreeingColor : otherColor;
+            DrawLine(bgra, width, height, x0, y0, x1, y1, color);
+            for (int32_t dy = -1; dy <= 1; dy++)
+            {
+                for (int32_t dx = -1; dx <= 1; dx++)
+                {
+                    PutPixel(bgra, width, height, x1 + dx, y1 + dy, color);
+                }
+            }
+        }
+    }
+}
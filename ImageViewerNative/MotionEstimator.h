@@ -0,0 +1,63 @@
+#pragma once
+#include "TaskScheduler.h"
+
+struct MotionVector
+{
+    int16_t X = 0;
+    int16_t Y = 0;
+
+    bool operator==(MotionVector const& other) const { return X == other.X && Y == other.Y; }
+    bool operator!=(MotionVector const& other) const { return !(*this == other); }
+};
+
+// How the luma of a frame moved since the frame before it, in blocks.
+// Blocks are BlockSize square; the last column and row of blocks are
+// moved in to end at the frame's edge, so they overlap their neighbours.
+struct MotionField
+{
+    static constexpr uint32_t BlockSize = 16;
+
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t BlocksWide = 0;
+    uint32_t BlocksHigh = 0;
+    // Block rows from the top. How far the content of each block moved,
+    // in pixels; it was at its position minus the vector.
+    std::vector<MotionVector> Vectors;
+    // The sum of absolute luma differences of each block against where
+    // it came from, and against the same place in the previous frame
+    std::vector<uint32_t> Sads;
+    std::vector<uint32_t> StillSads;
+    // Flat blocks and blocks that only have edges in one direction match
+    // too many places to say how they moved, and don't count towards the
+    // global motion.
+    std::vector<uint8_t> Textured;
+
+    // The most common vector of the textured blocks, and the share of
+    // them that are within a pixel of it. No textured blocks gives no
+    // motion and a confidence of 0.
+    MotionVector GlobalMotion;
+    float GlobalConfidence = 0.0f;
+    uint32_t TexturedBlockCount = 0;
+
+    size_t BlockCount() const { return Vectors.size(); }
+    // Per pixel, 0-255. A repeated frame has a mean still SAD near 0.
+    double MeanSad() const;
+    double MeanStillSad() const;
+};
+
+// Hierarchical block matching on luma pyramids of the two BGRA8 frames.
+// The coarsest level is searched exhaustively, each finer level refines
+// the vectors of the level above, its neighbour and no motion. Moves of
+// up to about searchRange pixels are found. Rows of blocks are matched
+// in parallel. Frames must be at least BlockSize on each side.
+MotionField EstimateMotion(
+    uint8_t const* previousBgra, uint8_t const* currentBgra,
+    uint32_t width, uint32_t height, uint32_t stride,
+    uint32_t searchRange, TaskPriority priority = TaskPriority::Visible);
+
+// A premultiplied BGRA8 overlay of the field, stretched to width by
+// height. Blocks are tinted by how badly they matched, and vectors are
+// drawn from block centres: green where they agree with the global
+// motion, white where they don't.
+void RenderMotionOverlay(MotionField const& field, uint8_t* bgra, uint32_t width, uint32_t height);
@@ -0,0 +1,34 @@
+#pragma once
+#include "TaskScheduler.h"
+
+// More bands than threads lets stealing even out bands that take longer
+// than others.
+static const uint32_t ParallelForBandsPerThread = 4;
+
+// Splits [begin, end) into contiguous bands and runs them on the shared
+// TaskScheduler. The calling thread runs bands too while it waits.
+// Throws TaskCanceledError if canceled before every band ran.
+template <typename FunctionT>
+void ParallelFor(uint32_t begin, uint32_t end, FunctionT const& function, TaskPriority priority = TaskPriority::Visible, CancellationToken const* cancellation = nullptr)
+{
+    if (end <= begin)
+    {
+        return;
+    }
+
+    auto& scheduler = TaskScheduler::Default();
+    auto count = end - begin;
+    auto bandCount = std::min(count, (scheduler.WorkerCount() + 1) * ParallelForBandsPerThread);
+    auto bandSize = (count + bandCount - 1) / bandCount;
+
+    TaskGroup group(scheduler, priority, cancellation);
+    for (uint32_t bandBegin = begin; bandBegin < end; bandBegin += std::min(bandSize, end - bandBegin))
+    {
+        auto bandEnd = bandBegin + std::min(bandSize, end - bandBegin);
+        group.Run([&function, bandBegin, bandEnd]()
+        {
+            function(bandBegin, bandEnd);
+        });
+    }
+    group.Wait();
+}
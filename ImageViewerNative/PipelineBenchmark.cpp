@@ -0,0 +1,50 @@
+#include "pch.h"
+#include "PipelineBenchmark.h"
+#include "PipelineBenchmark.g.cpp"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    PipelineBenchmark::PipelineBenchmark(double minimumSecondsPerBenchmark)
+    {
+        if (!(minimumSecondsPerBenchmark > 0))
+        {
+            throw winrt::hresult_invalid_argument(L"The benchmark duration must be positive.");
+        }
+
+        m_run = PipelineBenchmarks::Run(minimumSecondsPerBenchmark);
+    }
+
+    winrt::hstring PipelineBenchmark::ResultsJson()
+    {
+        return winrt::to_hstring(PipelineBenchmarks::ToJson(m_run));
+    }
+
+    winrt::hstring PipelineBenchmark::Summary()
+    {
+        return winrt::to_hstring(PipelineBenchmarks::Summary(m_run));
+    }
+
+    winrt::com_array<winrt::hstring> PipelineBenchmark::FindRegressions(winrt::hstring const& baselineJson, double threshold)
+    {
+        BenchmarkRun baseline;
+        try
+        {
+            baseline = PipelineBenchmarks::FromJson(winrt::to_string(baselineJson));
+        }
+        catch (std::invalid_argument const&)
+        {
+            throw winrt::hresult_invalid_argument(L"The baseline is not a benchmark results file.");
+        }
+
+        std::vector<winrt::hstring> lines;
+        for (auto& regression : PipelineBenchmarks::FindRegressions(m_run, baseline, threshold))
+        {
+            std::ostringstream stream;
+            stream.precision(1);
+            stream << std::fixed << regression.Name << ": " << regression.BaselineFramesPerSecond << " -> " << regression.FramesPerSecond
+                << " frames/s (" << (regression.FramesPerSecond / regression.BaselineFramesPerSecond - 1.0) * 100.0 << "%)";
+            lines.push_back(winrt::to_hstring(stream.str()));
+        }
+        return winrt::com_array<winrt::hstring>(lines.begin(), lines.end());
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "PipelineBenchmark.g.h"
+#include "PipelineBenchmarks.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct PipelineBenchmark : PipelineBenchmarkT<PipelineBenchmark>
+    {
+        PipelineBenchmark(double minimumSecondsPerBenchmark);
+
+        static double DefaultRegressionThreshold() { return PipelineBenchmarks::DefaultRegressionThreshold; }
+
+        winrt::hstring ResultsJson();
+        winrt::hstring Summary();
+        winrt::com_array<winrt::hstring> FindRegressions(winrt::hstring const& baselineJson, double threshold);
+
+    private:
+        BenchmarkRun m_run;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct PipelineBenchmark : PipelineBenchmarkT<PipelineBenchmark, implementation::PipelineBenchmark>
+    {
+    };
+}
@@ -0,0 +1,822 @@
+#include "pch.h"
+#include "PipelineBenchmarks.h"
+#include "BackgroundFrameWriter.h"
+#include "BlockDiffer.h"
+#include "ColorConverter.h"
+#include "FrameScopes.h"
+#include "HalfFloat.h"
+#include "ImageResampler.h"
+#include "MipPyramidBuilder.h"
+#include "MotionEstimator.h"
+#include "ParallelFor.h"
+#include "PixelDiffer.h"
+#include "PngEncoder.h"
+#include "RegionStatisticsTable.h"
+#include "RmRawFrameStream.h"
+#include "TaskScheduler.h"
+#include "ToneMapper.h"
+#include "YuvConverter.h"
+
+const std::array<PipelineBenchmarks::Resolution, 3> PipelineBenchmarks::Resolutions =
+{{
+    { "1080p", 1920, 1080 },
+    { "4K", 3840, 2160 },
+    { "8K", 7680, 4320 },
+}};
+
+static const uint32_t JsonVersion = 1;
+// Keeps quick benchmarks from running for thousands of iterations
+static const uint32_t MaximumIterations = 200;
+static const size_t RecordingQueueCapacity = 4;
+
+struct BenchmarkFrames
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    std::vector<uint8_t> First;
+    // The first frame with a square moved across it, covering about a
+    // sixteenth of the frame, like a window being dragged
+    std::vector<uint8_t> Second;
+
+    size_t FrameSize() const { return First.size(); }
+    uint8_t const* Frame(uint32_t index) const { return index % 2 == 0 ? First.data() : Second.data(); }
+};
+
+// Repeats a plane of bytes to fill a larger one
+static void Tile(uint8_t const* source, uint32_t sourceRowBytes, uint32_t sourceRows, uint8_t* dest, uint32_t destRowBytes, uint32_t destRows)
+{
+    for (uint32_t y = 0; y < destRows; y++)
+    {
+        auto sourceRow = source + (static_cast<size_t>(y % sourceRows) * sourceRowBytes);
+        auto destRow = dest + (static_cast<size_t>(y) * destRowBytes);
+        for (uint32_t x = 0; x < destRowBytes; x += sourceRowBytes)
+        {
+            memcpy(destRow + x, sourceRow, std::min(sourceRowBytes, destRowBytes - x));
+        }
+    }
+}
+
+static BenchmarkFrames CreateFrames(uint32_t width, uint32_t height, BenchmarkFixtures const& fixtures)
+{
+    BenchmarkFrames frames;
+    frames.Width = width;
+    frames.Height = height;
+    frames.First.resize(static_cast<size_t>(width) * height * 4);
+
+    if (!fixtures.Image.empty())
+    {
+        Tile(fixtures.Image.data(), fixtures.ImageWidth * 4, fixtures.ImageHeight, frames.First.data(), width * 4, height);
+    }
+    else
+    {
+        // Gradients with a little noise, so that compression and diffs
+        // see something closer to photographic content than flat color
+        uint32_t state = 0x9E3779B9;
+        auto pixels = frames.First.data();
+        for (uint32_t y = 0; y < height; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                auto noise = state & 7;
+                pixels[0] = static_cast<uint8_t>((x * 255 / width) ^ noise);
+                pixels[1] = static_cast<uint8_t>((y * 255 / height) ^ noise);
+                pixels[2] = static_cast<uint8_t>(((x + y) * 127 / (width + height)) ^ noise);
+                pixels[3] = 255;
+                pixels += 4;
+            }
+        }
+    }
+
+    frames.Second = frames.First;
+    auto squareWidth = width / 4;
+    auto squareHeight = height / 4;
+    for (uint32_t y = 0; y < squareHeight; y++)
+    {
+        auto row = frames.Second.data() + ((static_cast<size_t>(y) + height / 3) * width + width / 3) * 4;
+        for (uint32_t x = 0; x < squareWidth * 4; x += 4)
+        {
+            row[x] = static_cast<uint8_t>(~row[x]);
+            row[x + 1] = static_cast<uint8_t>(~row[x + 1]);
+            row[x + 2] = static_cast<uint8_t>(~row[x + 2]);
+        }
+    }
+    return frames;
+}
+
+// The clip's NV12 frames tiled to the resolution
+static std::vector<std::vector<uint8_t>> CreateClip(uint32_t width, uint32_t height, BenchmarkFixtures const& fixtures)
+{
+    auto clipLumaSize = static_cast<size_t>(fixtures.ClipWidth) * fixtures.ClipHeight;
+    auto lumaSize = static_cast<size_t>(width) * height;
+    std::vector<std::vector<uint8_t>> clip;
+    for (auto& clipFrame : fixtures.ClipFrames)
+    {
+        std::vector<uint8_t> frame(lumaSize + (lumaSize / 2));
+        Tile(clipFrame.data(), fixtures.ClipWidth, fixtures.ClipHeight, frame.data(), width, height);
+        Tile(clipFrame.data() + clipLumaSize, fixtures.ClipWidth, fixtures.ClipHeight / 2, frame.data() + lumaSize, width, height / 2);
+        clip.push_back(std::move(frame));
+    }
+    return clip;
+}
+
+static bool IsSelected(std::vector<std::string> const& names, std::string const& name)
+{
+    return names.empty() || std::find(names.begin(), names.end(), name) != names.end();
+}
+
+static std::vector<uint8_t> EncodeSequence(BenchmarkFrames const& frames)
+{
+    std::vector<uint8_t> stream;
+    RmRawFrameStreamWriter writer([&](uint8_t const* data, size_t size)
+    {
+        stream.insert(stream.end(), data, data + size);
+    }, frames.Width, frames.Height);
+    for (uint32_t i = 0; i < PipelineBenchmarks::SequenceLength; i++)
+    {
+        writer.WriteFrame(frames.Frame(i), frames.Width * 4, i);
+    }
+    writer.Finish();
+    return stream;
+}
+
+// Times iterations of function, which returns how many frames it
+// processed, and adds the result of its median iteration.
+template <typename FunctionT>
+static void Measure(BenchmarkRun& run, PipelineBenchmarks::Options const& options, char const* name, PipelineBenchmarks::Resolution const& resolution, size_t frameSize, FunctionT const& function)
+{
+    using Clock = std::chrono::steady_clock;
+
+    if (!IsSelected(options.BenchmarkNames, name))
+    {
+        return;
+    }
+    auto minimumSeconds = options.MinimumSeconds;
+
+    std::vector<double> framesPerSecond;
+    auto begin = Clock::now();
+    auto warmedUp = false;
+    while (framesPerSecond.size() < MaximumIterations)
+    {
+        auto iterationBegin = Clock::now();
+        auto frameCount = function();
+        auto seconds = std::chrono::duration<double>(Clock::now() - iterationBegin).count();
+
+        // A warm up run that already took long enough counts on its own
+        if (!warmedUp && seconds < minimumSeconds)
+        {
+            warmedUp = true;
+            begin = Clock::now();
+            continue;
+        }
+        warmedUp = true;
+        framesPerSecond.push_back(frameCount / std::max(seconds, 1e-9));
+        if (std::chrono::duration<double>(Clock::now() - begin).count() >= minimumSeconds)
+        {
+            break;
+        }
+    }
+
+    std::sort(framesPerSecond.begin(), framesPerSecond.end());
+    BenchmarkResult result;
+    result.Name = std::string(name) + "/" + resolution.Name;
+    result.Width = resolution.Width;
+    result.Height = resolution.Height;
+    result.Iterations = static_cast<uint32_t>(framesPerSecond.size());
+    result.FramesPerSecond = framesPerSecond[framesPerSecond.size() / 2];
+    result.MegabytesPerSecond = result.FramesPerSecond * frameSize / 1000000.0;
+    run.Results.push_back(result);
+}
+
+static void RunResolution(BenchmarkRun& run, PipelineBenchmarks::Resolution const& resolution, PipelineBenchmarks::Options const& options)
+{
+    auto frames = CreateFrames(resolution.Width, resolution.Height, options.Fixtures);
+    auto width = frames.Width;
+    auto height = frames.Height;
+    auto stride = width * 4;
+    auto frameSize = frames.FrameSize();
+
+    Measure(run, options, "DiffPixels", resolution, frameSize, [&]()
+    {
+        DiffPixels(frames.First.data(), frames.Second.data(), width, height);
+        return 1u;
+    });
+
+    {
+        BlockDiffer differ(width, height);
+        uint32_t frameIndex = 0;
+        differ.Compare(frames.Frame(frameIndex++), stride);
+        Measure(run, options, "BlockDiffer", resolution, frameSize, [&]()
+        {
+            differ.Compare(frames.Frame(frameIndex++), stride);
+            return 1u;
+        });
+    }
+
+    Measure(run, options, "RmRawEncode", resolution, frameSize, [&]()
+    {
+        EncodeSequence(frames);
+        return PipelineBenchmarks::SequenceLength;
+    });
+
+    {
+        auto stream = EncodeSequence(frames);
+        Measure(run, options, "RmRawDecode", resolution, frameSize, [&]()
+        {
+            RmRawFrameStreamReader reader([&](uint64_t offset, uint8_t* data, size_t size)
+            {
+                memcpy(data, stream.data() + offset, size);
+            }, stream.size());
+            for (uint32_t i = 0; i < reader.FrameCount(); i++)
+            {
+                reader.DecodeFrame(i);
+            }
+            return reader.FrameCount();
+        });
+    }
+
+    Measure(run, options, "CaptureRecording", resolution, frameSize, [&]()
+    {
+        std::vector<uint8_t> stream;
+        auto writer = std::make_unique<RmRawFrameStreamWriter>([&](uint8_t const* data, size_t size)
+        {
+            stream.insert(stream.end(), data, data + size);
+        }, width, height);
+        BackgroundFrameWriter recorder(std::move(writer), RecordingQueueCapacity);
+        for (uint32_t i = 0; i < PipelineBenchmarks::SequenceLength; i++)
+        {
+            // Wait for room instead of dropping, so that every run
+            // records the same frames
+            while (!recorder.TryEnqueue(frames.Frame(i), stride, i))
+            {
+                std::this_thread::yield();
+            }
+        }
+        recorder.Finish();
+        return PipelineBenchmarks::SequenceLength;
+    });
+
+    Measure(run, options, "PngEncode", resolution, frameSize, [&]()
+    {
+        size_t encodedSize = 0;
+        PngEncoder::Encode(frames.First.data(), width, height, stride, false, PngEncoder::DefaultLevel, [&](uint8_t const*, size_t size)
+        {
+            encodedSize += size;
+        });
+        return 1u;
+    });
+
+    Measure(run, options, "MipDownsample", resolution, frameSize, [&]()
+    {
+        MipLevel level;
+        MipPyramidBuilder::Downsample(frames.First.data(), width, height, stride, level, TaskPriority::Visible);
+        return 1u;
+    });
+
+    // Half size, the overview extraction case
+    std::vector<uint8_t> resampled(frameSize / 4);
+    for (auto filter : { ResampleFilter::Bilinear, ResampleFilter::Lanczos3 })
+    {
+        auto name = filter == ResampleFilter::Bilinear ? "ResampleBilinear" : "ResampleLanczos3";
+        Measure(run, options, name, resolution, frameSize, [&]()
+        {
+            ImageResampler::Resample(frames.First.data(), stride, { 0, 0, width, height }, resampled.data(), width / 2, height / 2, (width / 2) * 4, filter);
+            return 1u;
+        });
+    }
+
+    {
+        // The frame as HDR values up to 4.0 (320 nits)
+        std::vector<uint16_t> halfPixels(frames.First.size());
+        for (size_t i = 0; i < halfPixels.size(); i++)
+        {
+            halfPixels[i] = FloatToHalf(i % 4 == 3 ? 1.0f : frames.First[i] / 63.75f);
+        }
+        std::vector<uint8_t> toneMapped(frameSize);
+        Measure(run, options, "ToneMapFilmic", resolution, frameSize, [&]()
+        {
+            ToneMap(halfPixels.data(), static_cast<size_t>(width) * height, toneMapped.data(), 0.5f, ToneMapOperator::Filmic);
+            return 1u;
+        });
+    }
+
+    // Every pixel, and every other pixel of every other row as for live
+    // capture
+    Measure(run, options, "Scopes", resolution, frameSize, [&]()
+    {
+        ComputeScopes(frames.First.data(), width, height, stride, 1);
+        return 1u;
+    });
+    Measure(run, options, "ScopesSampled", resolution, frameSize, [&]()
+    {
+        ComputeScopes(frames.First.data(), width, height, stride, 2);
+        return 1u;
+    });
+
+    {
+        // BT.2020 video shown on an sRGB display, and a 33 point grading
+        // LUT (the common size) that lifts the shadows
+        std::vector<uint8_t> converted(frameSize);
+        auto parametric = ColorConverter::CreateParametric(
+            { ColorPrimaries::Bt2020, TransferFunction::Bt1886 },
+            { ColorPrimaries::Bt709, TransferFunction::Srgb });
+        Measure(run, options, "ColorTransformParametric", resolution, frameSize, [&]()
+        {
+            parametric->Apply(frames.First.data(), stride, converted.data(), stride, width, height);
+            return 1u;
+        });
+
+        CubeLut lut;
+        lut.Size = 33;
+        lut.Entries.resize(static_cast<size_t>(lut.Size) * lut.Size * lut.Size * 3);
+        for (size_t i = 0; i < lut.Entries.size(); i++)
+        {
+            auto lattice = (i / 3) / (i % 3 == 0 ? 1 : i % 3 == 1 ? lut.Size : lut.Size * lut.Size);
+            lut.Entries[i] = std::sqrt(static_cast<float>(lattice % lut.Size) / (lut.Size - 1));
+        }
+        auto lutConverter = ColorConverter::CreateFromCube(lut, "benchmark");
+        Measure(run, options, "ColorTransformLut", resolution, frameSize, [&]()
+        {
+            lutConverter->Apply(frames.First.data(), stride, converted.data(), stride, width, height);
+            return 1u;
+        });
+    }
+
+    // A frame step with the default search range of the viewer
+    Measure(run, options, "MotionEstimation", resolution, frameSize, [&]()
+    {
+        EstimateMotion(frames.First.data(), frames.Second.data(), width, height, stride, 64);
+        return 1u;
+    });
+
+    Measure(run, options, "RegionStatistics", resolution, frameSize, [&]()
+    {
+        RegionStatisticsTable table(frames.First.data(), width, height, stride);
+        return 1u;
+    });
+
+    // A little arithmetic per pixel and nothing else, so that how it
+    // scales with --threads is how the scheduler itself scales
+    Measure(run, options, "ParallelFor", resolution, frameSize, [&]()
+    {
+        std::atomic<uint64_t> sum = 0;
+        ParallelFor(0, height, [&](uint32_t begin, uint32_t end)
+        {
+            uint64_t bandSum = 0;
+            for (auto y = begin; y < end; y++)
+            {
+                for (uint64_t value = static_cast<uint64_t>(y) * width, rowEnd = value + width; value < rowEnd; value++)
+                {
+                    auto mixed = (value ^ (value >> 13)) * 0x9E3779B97F4A7C15ull;
+                    bandSum += mixed >> 40;
+                }
+            }
+            sum += bandSum;
+        }, TaskPriority::Visible);
+        return 1u;
+    });
+
+    if (!options.Fixtures.ClipFrames.empty())
+    {
+        auto clip = CreateClip(width, height, options.Fixtures);
+        auto clipLength = static_cast<uint32_t>(clip.size());
+        auto lumaSize = static_cast<size_t>(width) * height;
+        std::vector<uint8_t> converted(frameSize);
+        Measure(run, options, "Nv12ToBgra", resolution, frameSize, [&]()
+        {
+            for (auto& frame : clip)
+            {
+                ConvertNv12ToBgra(frame.data(), width, frame.data() + lumaSize, width, converted.data(), stride, width, height, YuvMatrix::Bt709);
+            }
+            return clipLength;
+        });
+
+        // Frame by frame extraction on the CPU: convert each frame, scale
+        // it to half size for the overview and find what changed since
+        // the frame before
+        Measure(run, options, "FramePipeline", resolution, frameSize, [&]()
+        {
+            BlockDiffer differ(width / 2, height / 2);
+            for (auto& frame : clip)
+            {
+                ConvertNv12ToBgra(frame.data(), width, frame.data() + lumaSize, width, converted.data(), stride, width, height, YuvMatrix::Bt709);
+                ImageResampler::Resample(converted.data(), stride, { 0, 0, width, height }, resampled.data(), width / 2, height / 2, (width / 2) * 4, ResampleFilter::Bilinear);
+                differ.Compare(resampled.data(), (width / 2) * 4);
+            }
+            return clipLength;
+        });
+    }
+
+    for (auto& benchmark : options.ExternalBenchmarks)
+    {
+        Measure(run, options, benchmark.Name.c_str(), resolution, frameSize, [&]()
+        {
+            return benchmark.Function(frames.First.data(), width, height);
+        });
+    }
+}
+
+BenchmarkRun PipelineBenchmarks::Run(double minimumSeconds)
+{
+    Options options;
+    options.MinimumSeconds = minimumSeconds;
+    return Run(options);
+}
+
+// Runs the kernels on a scheduler of their own for as long as it lives.
+// The thread that waits on the kernels counts as one of the threads.
+class ScopedScheduler
+{
+public:
+    explicit ScopedScheduler(uint32_t threadCount) : m_scheduler(threadCount - 1)
+    {
+        TaskScheduler::OverrideDefault(&m_scheduler);
+    }
+
+    ~ScopedScheduler()
+    {
+        TaskScheduler::OverrideDefault(nullptr);
+    }
+
+private:
+    TaskScheduler m_scheduler;
+};
+
+BenchmarkRun PipelineBenchmarks::Run(Options const& options)
+{
+    BenchmarkRun run;
+    run.ThreadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::optional<ScopedScheduler> scheduler;
+    if (options.ThreadCount != 0)
+    {
+        run.ThreadCount = options.ThreadCount;
+        scheduler.emplace(options.ThreadCount);
+    }
+
+    for (auto& resolution : Resolutions)
+    {
+        if (!IsSelected(options.ResolutionNames, resolution.Name))
+        {
+            continue;
+        }
+
+        // 8K frames are 130 MB each, which a 32-bit process may not fit
+        try
+        {
+            RunResolution(run, resolution, options);
+        }
+        catch (std::bad_alloc const&)
+        {
+            auto prefix = std::string("/") + resolution.Name;
+            run.Results.erase(std::remove_if(run.Results.begin(), run.Results.end(), [&](auto const& result)
+            {
+                return result.Name.size() > prefix.size() && result.Name.compare(result.Name.size() - prefix.size(), prefix.size(), prefix) == 0;
+            }), run.Results.end());
+            run.Skipped.push_back(resolution.Name);
+        }
+    }
+    return run;
+}
+
+static void WriteJsonString(std::ostringstream& stream, std::string const& text)
+{
+    stream << '"';
+    for (auto c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            stream << '\\';
+        }
+        stream << c;
+    }
+    stream << '"';
+}
+
+std::string PipelineBenchmarks::ToJson(BenchmarkRun const& run)
+{
+    std::ostringstream stream;
+    stream.precision(3);
+    stream << std::fixed;
+    stream << "{\n  \"version\": " << JsonVersion << ",\n  \"threadCount\": " << run.ThreadCount << ",\n  \"results\": [";
+    for (size_t i = 0; i < run.Results.size(); i++)
+    {
+        auto& result = run.Results[i];
+        stream << (i == 0 ? "\n" : ",\n") << "    { \"name\": ";
+        WriteJsonString(stream, result.Name);
+        stream << ", \"width\": " << result.Width
+            << ", \"height\": " << result.Height
+            << ", \"iterations\": " << result.Iterations
+            << ", \"framesPerSecond\": " << result.FramesPerSecond
+            << ", \"megabytesPerSecond\": " << result.MegabytesPerSecond << " }";
+    }
+    stream << "\n  ],\n  \"skipped\": [";
+    for (size_t i = 0; i < run.Skipped.size(); i++)
+    {
+        stream << (i == 0 ? "" : ", ");
+        WriteJsonString(stream, run.Skipped[i]);
+    }
+    stream << "]\n}\n";
+    return stream.str();
+}
+
+// Just enough JSON to read back what ToJson writes. Unknown keys are
+// skipped so that newer files still load.
+class BenchmarkJsonReader
+{
+public:
+    explicit BenchmarkJsonReader(std::string const& json) : m_json(json) {}
+
+    BenchmarkRun ReadRun()
+    {
+        BenchmarkRun run;
+        ReadObject([&](std::string const& key)
+        {
+            if (key == "threadCount")
+            {
+                run.ThreadCount = static_cast<uint32_t>(ReadNumber());
+            }
+            else if (key == "results")
+            {
+                ReadArray([&]()
+                {
+                    run.Results.push_back(ReadResult());
+                });
+            }
+            else if (key == "skipped")
+            {
+                ReadArray([&]()
+                {
+                    run.Skipped.push_back(ReadString());
+                });
+            }
+            else
+            {
+                SkipValue();
+            }
+        });
+        SkipWhitespace();
+        if (m_position != m_json.size())
+        {
+            Fail();
+        }
+        return run;
+    }
+
+private:
+    BenchmarkResult ReadResult()
+    {
+        BenchmarkResult result;
+        ReadObject([&](std::string const& key)
+        {
+            if (key == "name")
+            {
+                result.Name = ReadString();
+            }
+            else if (key == "width")
+            {
+                result.Width = static_cast<uint32_t>(ReadNumber());
+            }
+            else if (key == "height")
+            {
+                result.Height = static_cast<uint32_t>(ReadNumber());
+            }
+            else if (key == "iterations")
+            {
+                result.Iterations = static_cast<uint32_t>(ReadNumber());
+            }
+            else if (key == "framesPerSecond")
+            {
+                result.FramesPerSecond = ReadNumber();
+            }
+            else if (key == "megabytesPerSecond")
+            {
+                result.MegabytesPerSecond = ReadNumber();
+            }
+            else
+            {
+                SkipValue();
+            }
+        });
+        return result;
+    }
+
+    template <typename FunctionT>
+    void ReadObject(FunctionT const& readValue)
+    {
+        Expect('{');
+        if (TryConsume('}'))
+        {
+            return;
+        }
+        do
+        {
+            auto key = ReadString();
+            Expect(':');
+            readValue(key);
+        } while (TryConsume(','));
+        Expect('}');
+    }
+
+    template <typename FunctionT>
+    void ReadArray(FunctionT const& readElement)
+    {
+        Expect('[');
+        if (TryConsume(']'))
+        {
+            return;
+        }
+        do
+        {
+            readElement();
+        } while (TryConsume(','));
+        Expect(']');
+    }
+
+    std::string ReadString()
+    {
+        Expect('"');
+        std::string result;
+        while (m_position < m_json.size() && m_json[m_position] != '"')
+        {
+            if (m_json[m_position] == '\\')
+            {
+                m_position++;
+                if (m_position == m_json.size())
+                {
+                    Fail();
+                }
+            }
+            result.push_back(m_json[m_position++]);
+        }
+        Expect('"');
+        return result;
+    }
+
+    double ReadNumber()
+    {
+        SkipWhitespace();
+        auto begin = m_json.c_str() + m_position;
+        char* end = nullptr;
+        auto value = std::strtod(begin, &end);
+        if (end == begin)
+        {
+            Fail();
+        }
+        m_position += end - begin;
+        return value;
+    }
+
+    void SkipValue()
+    {
+        SkipWhitespace();
+        if (m_position == m_json.size())
+        {
+            Fail();
+        }
+        switch (m_json[m_position])
+        {
+        case '{':
+            ReadObject([&](std::string const&) { SkipValue(); });
+            break;
+        case '[':
+            ReadArray([&]() { SkipValue(); });
+            break;
+        case '"':
+            ReadString();
+            break;
+        default:
+            if (!TryConsumeWord("true") && !TryConsumeWord("false") && !TryConsumeWord("null"))
+            {
+                ReadNumber();
+            }
+            break;
+        }
+    }
+
+    void SkipWhitespace()
+    {
+        while (m_position < m_json.size() && std::isspace(static_cast<unsigned char>(m_json[m_position])))
+        {
+            m_position++;
+        }
+    }
+
+    bool TryConsume(char c)
+    {
+        SkipWhitespace();
+        if (m_position < m_json.size() && m_json[m_position] == c)
+        {
+            m_position++;
+            return true;
+        }
+        return false;
+    }
+
+    bool TryConsumeWord(char const* word)
+    {
+        auto length = strlen(word);
+        if (m_json.compare(m_position, length, word) == 0)
+        {
+            m_position += length;
+            return true;
+        }
+        return false;
+    }
+
+    void Expect(char c)
+    {
+        if (!TryConsume(c))
+        {
+            Fail();
+        }
+    }
+
+    [[noreturn]] void Fail()
+    {
+        throw std::invalid_argument("Not a benchmark results file.");
+    }
+
+private:
+    std::string const& m_json;
+    size_t m_position = 0;
+};
+
+BenchmarkRun PipelineBenchmarks::FromJson(std::string const& json)
+{
+    return BenchmarkJsonReader(json).ReadRun();
+}
+
+std::string PipelineBenchmarks::Summary(BenchmarkRun const& run)
+{
+    std::ostringstream stream;
+    stream.precision(1);
+    stream << std::fixed;
+    stream << run.ThreadCount << " threads\n";
+    for (auto& result : run.Results)
+    {
+        stream << result.Name << ": " << result.FramesPerSecond << " frames/s, " << result.MegabytesPerSecond << " MB/s\n";
+    }
+    for (auto& skipped : run.Skipped)
+    {
+        stream << skipped << ": skipped, out of memory\n";
+    }
+    return stream.str();
+}
+
+std::string PipelineBenchmarks::ScalingSummary(std::vector<BenchmarkRun> const& runs)
+{
+    std::ostringstream stream;
+    stream.precision(2);
+    stream << std::fixed;
+    if (runs.empty())
+    {
+        return stream.str();
+    }
+
+    stream << "Threads";
+    for (auto& run : runs)
+    {
+        stream << ' ' << run.ThreadCount;
+    }
+    stream << '\n';
+    for (auto& first : runs.front().Results)
+    {
+        stream << first.Name << ':';
+        for (auto& run : runs)
+        {
+            auto match = std::find_if(run.Results.begin(), run.Results.end(), [&](auto const& result)
+            {
+                return result.Name == first.Name;
+            });
+            if (match == run.Results.end() || first.FramesPerSecond <= 0)
+            {
+                stream << " -";
+            }
+            else
+            {
+                stream << ' ' << (match->FramesPerSecond / first.FramesPerSecond) << 'x';
+            }
+        }
+        stream << " of " << first.FramesPerSecond << " frames/s\n";
+    }
+    return stream.str();
+}
+
+std::vector<BenchmarkRegression> PipelineBenchmarks::FindRegressions(BenchmarkRun const& run, BenchmarkRun const& baseline, double threshold)
+{
+    std::vector<BenchmarkRegression> regressions;
+    for (auto& result : run.Results)
+    {
+        auto match = std::find_if(baseline.Results.begin(), baseline.Results.end(), [&](auto const& baselineResult)
+        {
+            return baselineResult.Name == result.Name;
+        });
+        if (match != baseline.Results.end() && result.FramesPerSecond < match->FramesPerSecond * (1.0 - threshold))
+        {
+            regressions.push_back({ result.Name, match->FramesPerSecond, result.FramesPerSecond });
+        }
+    }
+    return regressions;
+}
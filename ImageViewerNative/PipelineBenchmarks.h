@@ -0,0 +1,107 @@
+#pragma once
+
+struct BenchmarkResult
+{
+    // "<benchmark>/<resolution>", e.g. "DiffPixels/4K"
+    std::string Name;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t Iterations = 0;
+    // From the median iteration, counting BGRA8 frame bytes
+    double FramesPerSecond = 0;
+    double MegabytesPerSecond = 0;
+};
+
+struct BenchmarkRun
+{
+    uint32_t ThreadCount = 0;
+    std::vector<BenchmarkResult> Results;
+    // Resolutions that didn't fit in memory
+    std::vector<std::string> Skipped;
+};
+
+struct BenchmarkRegression
+{
+    std::string Name;
+    double BaselineFramesPerSecond = 0;
+    double FramesPerSecond = 0;
+};
+
+// Content to run the benchmarks on instead of generated frames. Both are
+// tiled to fill each resolution.
+struct BenchmarkFixtures
+{
+    // BGRA8 with tightly packed rows
+    uint32_t ImageWidth = 0;
+    uint32_t ImageHeight = 0;
+    std::vector<uint8_t> Image;
+    // NV12 frames with tightly packed rows and even dimensions, for the
+    // conversion and frame pipeline benchmarks, which only run with a clip
+    uint32_t ClipWidth = 0;
+    uint32_t ClipHeight = 0;
+    std::vector<std::vector<uint8_t>> ClipFrames;
+};
+
+// Measures the throughput of the native kernels on 1080p, 4K and 8K
+// frames: diffs, RmRaw encode and decode, PNG encode, scaling, region
+// statistics, the capture recording pipeline and, given a clip, NV12
+// conversion and the frame extraction pipeline. Results are saved as
+// JSON so later runs can be checked against them.
+class PipelineBenchmarks
+{
+public:
+    struct Resolution
+    {
+        char const* Name;
+        uint32_t Width;
+        uint32_t Height;
+    };
+
+    static const std::array<Resolution, 3> Resolutions;
+    // Frames in each RmRaw and recording iteration
+    static constexpr uint32_t SequenceLength = 8;
+    static constexpr double DefaultMinimumSeconds = 0.5;
+    static constexpr double DefaultRegressionThreshold = 0.1;
+
+    // A benchmark from outside the cores, such as a reference
+    // implementation to compare against. It's given each resolution's
+    // first frame as tightly packed BGRA8 and returns how many frames it
+    // processed.
+    struct ExternalBenchmark
+    {
+        std::string Name;
+        std::function<uint32_t(uint8_t const* bgraPixels, uint32_t width, uint32_t height)> Function;
+    };
+
+    struct Options
+    {
+        // Each benchmark runs once to warm up, then until it has run for
+        // this long.
+        double MinimumSeconds = DefaultMinimumSeconds;
+        // Names of resolutions and benchmarks to run, all when empty
+        std::vector<std::string> ResolutionNames;
+        std::vector<std::string> BenchmarkNames;
+        BenchmarkFixtures Fixtures;
+        // Run after the native benchmarks, and selected the same way
+        std::vector<ExternalBenchmark> ExternalBenchmarks;
+        // Threads the kernels run on, every core when 0
+        uint32_t ThreadCount = 0;
+    };
+
+    // Every benchmark at every resolution on generated frames
+    static BenchmarkRun Run(double minimumSeconds);
+    static BenchmarkRun Run(Options const& options);
+
+    static std::string ToJson(BenchmarkRun const& run);
+    // Reads the output of ToJson, throws std::invalid_argument otherwise.
+    static BenchmarkRun FromJson(std::string const& json);
+    static std::string Summary(BenchmarkRun const& run);
+    // Each benchmark's speedup in runs on different thread counts, over
+    // its frames per second in the first run
+    static std::string ScalingSummary(std::vector<BenchmarkRun> const& runs);
+
+    // Benchmarks whose frames per second dropped by more than threshold
+    // (0.1 is 10%) from the baseline. Benchmarks missing from either run
+    // are ignored.
+    static std::vector<BenchmarkRegression> FindRegressions(BenchmarkRun const& run, BenchmarkRun const& baseline, double threshold);
+};
@@ -0,0 +1,49 @@
+#include "pch.h"
+#include "PipelineProfiler.h"
+#include "PipelineProfiler.g.cpp"
+#include "Profiler.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    bool PipelineProfiler::IsEnabled()
+    {
+        return Profiler::IsEnabled();
+    }
+
+    void PipelineProfiler::IsEnabled(bool value)
+    {
+        Profiler::SetEnabled(value);
+    }
+
+    void PipelineProfiler::Reset()
+    {
+        Profiler::Reset();
+    }
+
+    winrt::hstring PipelineProfiler::ExportChromeTrace()
+    {
+        return winrt::to_hstring(Profiler::ExportChromeTrace());
+    }
+
+    winrt::hstring PipelineProfiler::GetSummary()
+    {
+        return winrt::to_hstring(Profiler::Summary());
+    }
+
+    void PipelineProfiler::AddCounter(winrt::hstring const& name, int64_t value)
+    {
+        // Skip the name conversion and lookup while disabled
+        if (Profiler::IsEnabled())
+        {
+            Profiler::Counter(winrt::to_string(name)).Add(value);
+        }
+    }
+
+    void PipelineProfiler::SetCounter(winrt::hstring const& name, int64_t value)
+    {
+        if (Profiler::IsEnabled())
+        {
+            Profiler::Counter(winrt::to_string(name)).Set(value);
+        }
+    }
+}
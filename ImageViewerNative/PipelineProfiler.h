@@ -0,0 +1,24 @@
+#pragma once
+#include "PipelineProfiler.g.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct PipelineProfiler
+    {
+        PipelineProfiler() = default;
+
+        static bool IsEnabled();
+        static void IsEnabled(bool value);
+        static void Reset();
+        static winrt::hstring ExportChromeTrace();
+        static winrt::hstring GetSummary();
+        static void AddCounter(winrt::hstring const& name, int64_t value);
+        static void SetCounter(winrt::hstring const& name, int64_t value);
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct PipelineProfiler : PipelineProfilerT<PipelineProfiler, implementation::PipelineProfiler>
+    {
+    };
+}
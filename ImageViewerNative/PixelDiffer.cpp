@@ -0,0 +1,162 @@
+#include "pch.h"
+#include "PixelDiffer.h"
+#include "HalfFloat.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "SimdHelpers.h"
+
+static const uint32_t AlphaMask = 0xFF000000;
+
+static ProfileStage DiffStage("PixelDiffer.DiffPixels");
+static ProfileStage HalfDiffStage("PixelDiffer.DiffHalfPixels");
+
+static uint32_t GrayFromAlpha(uint32_t difference)
+{
+    auto alpha = difference >> 24;
+    return AlphaMask | (alpha << 16) | (alpha << 8) | alpha;
+}
+
+static bool HalvesMatch(uint16_t first, uint16_t second)
+{
+    return first == second || ((first | second) & 0x7FFF) == 0;
+}
+
+// A difference of values as a level of the diff image. Values that
+// differ at all are at least 1, and infinities and NaNs are 255.
+static uint32_t DifferenceLevel(float first, float second)
+{
+    auto scaled = std::abs(first - second) * 255.0f;
+    if (!(scaled < 255.0f))
+    {
+        return 255;
+    }
+    return std::max(static_cast<uint32_t>(std::ceil(scaled)), 1u);
+}
+
+PixelDiff DiffPixels(uint8_t const* first, uint8_t const* second, uint32_t width, uint32_t height)
+{
+    ProfileScope scope(DiffStage);
+    PixelDiff result;
+    auto pixelCount = static_cast<size_t>(width) * height;
+    result.ColorPixels = BufferPool::Shared().Acquire(pixelCount * 4);
+    result.AlphaPixels = BufferPool::Shared().Acquire(pixelCount * 4);
+
+    std::atomic<bool> colorsDiffer = false;
+    std::atomic<bool> alphasDiffer = false;
+    ParallelFor(0, height, [&](uint32_t begin, uint32_t end)
+    {
+        auto offset = static_cast<size_t>(begin) * width;
+        auto count = static_cast<size_t>(end - begin) * width;
+        auto firstPixels = reinterpret_cast<uint32_t const*>(first) + offset;
+        auto secondPixels = reinterpret_cast<uint32_t const*>(second) + offset;
+        auto colorPixels = reinterpret_cast<uint32_t*>(result.ColorPixels.Data()) + offset;
+        auto alphaPixels = reinterpret_cast<uint32_t*>(result.AlphaPixels.Data()) + offset;
+
+        // OR together every difference and check once at the end
+        uint32_t differences = 0;
+        size_t i = 0;
+#ifdef IMAGEVIEWER_SSE2
+        auto alphaMask = _mm_set1_epi32(static_cast<int>(AlphaMask));
+        auto allDifferences = _mm_setzero_si128();
+        for (; i + 4 <= count; i += 4)
+        {
+            auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(firstPixels + i));
+            auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(secondPixels + i));
+            auto difference = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+            allDifferences = _mm_or_si128(allDifferences, difference);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(colorPixels + i), _mm_or_si128(difference, alphaMask));
+            auto alpha = _mm_srli_epi32(difference, 24);
+            auto gray = _mm_or_si128(alpha, _mm_or_si128(_mm_slli_epi32(alpha, 8), _mm_slli_epi32(alpha, 16)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(alphaPixels + i), _mm_or_si128(gray, alphaMask));
+        }
+        std::array<uint32_t, 4> lanes;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes.data()), allDifferences);
+        differences = lanes[0] | lanes[1] | lanes[2] | lanes[3];
+#endif
+        for (; i < count; i++)
+        {
+            uint32_t difference = 0;
+            for (uint32_t shift = 0; shift < 32; shift += 8)
+            {
+                auto a = static_cast<int32_t>((firstPixels[i] >> shift) & 0xFF);
+                auto b = static_cast<int32_t>((secondPixels[i] >> shift) & 0xFF);
+                difference |= static_cast<uint32_t>(std::abs(a - b)) << shift;
+            }
+            differences |= difference;
+            colorPixels[i] = difference | AlphaMask;
+            alphaPixels[i] = GrayFromAlpha(difference);
+        }
+
+        if ((differences & ~AlphaMask) != 0)
+        {
+            colorsDiffer = true;
+        }
+        if ((differences & AlphaMask) != 0)
+        {
+            alphasDiffer = true;
+        }
+    });
+
+    result.ColorChannelsMatch = !colorsDiffer;
+    result.AlphaChannelsMatch = !alphasDiffer;
+    return result;
+}
+
+PixelDiff DiffHalfPixels(uint16_t const* first, uint16_t const* second, uint32_t width, uint32_t height)
+{
+    ProfileScope scope(HalfDiffStage);
+    PixelDiff result;
+    auto pixelCount = static_cast<size_t>(width) * height;
+    result.ColorPixels = BufferPool::Shared().Acquire(pixelCount * 4);
+    result.AlphaPixels = BufferPool::Shared().Acquire(pixelCount * 4);
+
+    std::atomic<bool> colorsDiffer = false;
+    std::atomic<bool> alphasDiffer = false;
+    ParallelFor(0, height, [&](uint32_t begin, uint32_t end)
+    {
+        std::vector<float> firstRow(static_cast<size_t>(width) * 4);
+        std::vector<float> secondRow(firstRow.size());
+        uint32_t differences = 0;
+        for (auto y = begin; y < end; y++)
+        {
+            auto offset = static_cast<size_t>(y) * width;
+            auto firstHalves = first + (offset * 4);
+            auto secondHalves = second + (offset * 4);
+            auto colorPixels = reinterpret_cast<uint32_t*>(result.ColorPixels.Data()) + offset;
+            auto alphaPixels = reinterpret_cast<uint32_t*>(result.AlphaPixels.Data()) + offset;
+            HalfToFloat(firstHalves, firstRow.data(), firstRow.size());
+            HalfToFloat(secondHalves, secondRow.data(), secondRow.size());
+
+            for (size_t x = 0; x < width; x++)
+            {
+                // RGBA in, BGRA out
+                uint32_t difference = 0;
+                for (size_t c = 0; c < 4; c++)
+                {
+                    auto index = (x * 4) + c;
+                    if (!HalvesMatch(firstHalves[index], secondHalves[index]))
+                    {
+                        auto shift = c == 3 ? 24 : (2 - c) * 8;
+                        difference |= DifferenceLevel(firstRow[index], secondRow[index]) << shift;
+                    }
+                }
+                differences |= difference;
+                colorPixels[x] = difference | AlphaMask;
+                alphaPixels[x] = GrayFromAlpha(difference);
+            }
+        }
+
+        if ((differences & ~AlphaMask) != 0)
+        {
+            colorsDiffer = true;
+        }
+        if ((differences & AlphaMask) != 0)
+        {
+            alphasDiffer = true;
+        }
+    });
+
+    result.ColorChannelsMatch = !colorsDiffer;
+    result.AlphaChannelsMatch = !alphasDiffer;
+    return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "BufferPool.h"
+
+struct PixelDiff
+{
+    // Opaque BGRA8 images of the absolute color and alpha differences.
+    // The alpha difference is drawn in gray.
+    PooledBuffer ColorPixels;
+    PooledBuffer AlphaPixels;
+    bool ColorChannelsMatch = true;
+    bool AlphaChannelsMatch = true;
+};
+
+// Compares two BGRA8 images of the same size and tightly packed rows.
+PixelDiff DiffPixels(uint8_t const* first, uint8_t const* second, uint32_t width, uint32_t height);
+
+// Compares two RGBA half float images of the same size and tightly packed
+// rows. Any difference in value counts, however small, so a channel of
+// the diff images is at least 1 where the values differ. +0 and -0 are
+// the same value.
+PixelDiff DiffHalfPixels(uint16_t const* first, uint16_t const* second, uint32_t width, uint32_t height);
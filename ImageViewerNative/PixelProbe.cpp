@@ -0,0 +1,244 @@
+#include "pch.h"
+#include "PixelProbe.h"
+#include "PixelProbe.g.cpp"
+
+namespace winrt
+{
+    using namespace Windows::Foundation;
+    using namespace Windows::Graphics::DirectX::Direct3D11;
+    using namespace Windows::UI;
+}
+
+namespace util
+{
+    using namespace robmikh::common::uwp;
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    PixelProbe::PixelProbe(winrt::IDirect3DDevice const& device, winrt::IDirect3DSurface const& surface)
+    {
+        m_d3dDevice = GetDXGIInterfaceFromObject<ID3D11Device>(device);
+        m_d3dDevice->GetImmediateContext(m_d3dContext.put());
+        m_multithread = m_d3dDevice.as<ID3D11Multithread>();
+        SetSurface(surface);
+    }
+
+    winrt::IReference<winrt::Color> PixelProbe::GetColorFromPixel(int32_t x, int32_t y)
+    {
+        if (m_cache == nullptr || x < 0 || y < 0 || static_cast<uint32_t>(x) >= m_cache->Width() || static_cast<uint32_t>(y) >= m_cache->Height())
+        {
+            return nullptr;
+        }
+        auto pixelX = static_cast<uint32_t>(x);
+        auto pixelY = static_cast<uint32_t>(y);
+
+        auto lock = util::D3D11DeviceLock(m_multithread.get());
+        HarvestPrefetches();
+
+        auto tile = m_cache->TileFor(pixelX, pixelY);
+        auto pixels = m_cache->Find(tile);
+        if (pixels == nullptr)
+        {
+            pixels = ReadTile(tile);
+        }
+
+        auto pixel = pixels + m_cache->PixelOffset(pixelX, pixelY);
+        winrt::Color color = { pixel[3], pixel[2], pixel[1], pixel[0] };
+
+        // Start copying the tile we're heading towards so it's ready
+        // by the time we get there
+        if (auto next = m_cache->RecordProbe(pixelX, pixelY))
+        {
+            Prefetch(*next);
+        }
+
+        return winrt::IReference<winrt::Color>(color);
+    }
+
+    void PixelProbe::SetSurface(winrt::IDirect3DSurface const& surface)
+    {
+        auto texture = GetDXGIInterfaceFromObject<ID3D11Texture2D>(surface);
+        D3D11_TEXTURE2D_DESC desc = {};
+        texture->GetDesc(&desc);
+        if (desc.SampleDesc.Count != 1)
+        {
+            throw winrt::hresult_invalid_argument(L"Multisampled surfaces can't be probed.");
+        }
+        switch (desc.Format)
+        {
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            m_swapRedBlue = false;
+            break;
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+            m_swapRedBlue = true;
+            break;
+        default:
+            throw winrt::hresult_invalid_argument(L"Only 8-bit BGRA and RGBA surfaces can be probed.");
+        }
+
+        auto lock = util::D3D11DeviceLock(m_multithread.get());
+        m_texture = texture;
+        if (m_cache == nullptr || m_cache->Width() != desc.Width || m_cache->Height() != desc.Height)
+        {
+            m_cache = std::make_unique<PixelProbeCache>(desc.Width, desc.Height, TileSize, TileCapacity);
+        }
+        Invalidate();
+        EnsureSlots(desc.Format);
+    }
+
+    void PixelProbe::Invalidate()
+    {
+        if (m_cache == nullptr)
+        {
+            return;
+        }
+        m_cache->Clear();
+        for (auto& slot : m_slots)
+        {
+            slot.PendingTile.reset();
+        }
+    }
+
+    void PixelProbe::Close()
+    {
+        auto lock = util::D3D11DeviceLock(m_multithread.get());
+        for (auto& slot : m_slots)
+        {
+            slot.Texture = nullptr;
+            slot.PendingTile.reset();
+        }
+        m_slotFormat = DXGI_FORMAT_UNKNOWN;
+        m_texture = nullptr;
+        m_cache.reset();
+    }
+
+    void PixelProbe::EnsureSlots(DXGI_FORMAT format)
+    {
+        if (m_slotFormat == format)
+        {
+            return;
+        }
+
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = TileSize;
+        desc.Height = TileSize;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = format;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_STAGING;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        for (auto& slot : m_slots)
+        {
+            slot.Texture = nullptr;
+            winrt::check_hresult(m_d3dDevice->CreateTexture2D(&desc, nullptr, slot.Texture.put()));
+            slot.PendingTile.reset();
+        }
+        m_slotFormat = format;
+    }
+
+    void PixelProbe::CopyTileToSlot(TileCoordinate const& tile, StagingSlot& slot)
+    {
+        auto bounds = m_cache->TileBounds(tile);
+        D3D11_BOX box = {};
+        box.left = bounds.X;
+        box.top = bounds.Y;
+        box.front = 0;
+        box.right = bounds.X + bounds.Width;
+        box.bottom = bounds.Y + bounds.Height;
+        box.back = 1;
+        m_d3dContext->CopySubresourceRegion(slot.Texture.get(), 0, 0, 0, 0, m_texture.get(), 0, &box);
+        slot.PendingTile = tile;
+    }
+
+    uint8_t const* PixelProbe::ReadSlot(StagingSlot& slot, bool wait)
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        auto hr = m_d3dContext->Map(slot.Texture.get(), 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+        {
+            return nullptr;
+        }
+        winrt::check_hresult(hr);
+        auto unmap = wil::scope_exit([&]()
+        {
+            m_d3dContext->Unmap(slot.Texture.get(), 0);
+        });
+
+        auto tile = *slot.PendingTile;
+        slot.PendingTile.reset();
+        auto bounds = m_cache->TileBounds(tile);
+        auto dest = m_cache->Insert(tile);
+        auto source = reinterpret_cast<uint8_t const*>(mapped.pData);
+        auto rowSize = bounds.Width * 4;
+        for (uint32_t row = 0; row < bounds.Height; row++)
+        {
+            auto destRow = dest + (static_cast<size_t>(row) * TileSize * 4);
+            memcpy(destRow, source + (static_cast<size_t>(row) * mapped.RowPitch), rowSize);
+            if (m_swapRedBlue)
+            {
+                for (uint32_t i = 0; i < rowSize; i += 4)
+                {
+                    std::swap(destRow[i], destRow[i + 2]);
+                }
+            }
+        }
+        return dest;
+    }
+
+    uint8_t const* PixelProbe::ReadTile(TileCoordinate const& tile)
+    {
+        // The tile may already be on its way from a prefetch
+        for (auto& slot : m_slots)
+        {
+            if (slot.PendingTile.has_value() && slot.PendingTile->X == tile.X && slot.PendingTile->Y == tile.Y)
+            {
+                return ReadSlot(slot, true);
+            }
+        }
+
+        // Otherwise prefer an idle slot, and steal one round-robin if
+        // they're all busy with prefetches
+        auto slot = std::find_if(m_slots.begin(), m_slots.end(), [](auto const& slot) { return !slot.PendingTile.has_value(); });
+        if (slot == m_slots.end())
+        {
+            slot = m_slots.begin() + m_nextSlot;
+            m_nextSlot = (m_nextSlot + 1) % SlotCount;
+        }
+        CopyTileToSlot(tile, *slot);
+        return ReadSlot(*slot, true);
+    }
+
+    void PixelProbe::Prefetch(TileCoordinate const& tile)
+    {
+        for (auto& slot : m_slots)
+        {
+            if (slot.PendingTile.has_value() && slot.PendingTile->X == tile.X && slot.PendingTile->Y == tile.Y)
+            {
+                return;
+            }
+        }
+
+        // Never wait on a prefetch, drop it if there's no room
+        auto slot = std::find_if(m_slots.begin(), m_slots.end(), [](auto const& slot) { return !slot.PendingTile.has_value(); });
+        if (slot != m_slots.end())
+        {
+            CopyTileToSlot(tile, *slot);
+            m_d3dContext->Flush();
+        }
+    }
+
+    void PixelProbe::HarvestPrefetches()
+    {
+        for (auto& slot : m_slots)
+        {
+            if (slot.PendingTile.has_value())
+            {
+                ReadSlot(slot, false);
+            }
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "PixelProbe.g.h"
+#include "PixelProbeCache.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct PixelProbe : PixelProbeT<PixelProbe>
+    {
+        PixelProbe(winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device, winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DSurface const& surface);
+
+        winrt::Windows::Foundation::IReference<winrt::Windows::UI::Color> GetColorFromPixel(int32_t x, int32_t y);
+        void SetSurface(winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DSurface const& surface);
+        void Invalidate();
+        void Close();
+
+    private:
+        struct StagingSlot
+        {
+            winrt::com_ptr<ID3D11Texture2D> Texture;
+            // The tile that has been copied into the texture but not read yet
+            std::optional<TileCoordinate> PendingTile;
+        };
+
+        static constexpr uint32_t TileSize = 64;
+        static constexpr size_t TileCapacity = 64;
+        static constexpr size_t SlotCount = 4;
+
+        void EnsureSlots(DXGI_FORMAT format);
+        void CopyTileToSlot(TileCoordinate const& tile, StagingSlot& slot);
+        uint8_t const* ReadSlot(StagingSlot& slot, bool wait);
+        uint8_t const* ReadTile(TileCoordinate const& tile);
+        void Prefetch(TileCoordinate const& tile);
+        void HarvestPrefetches();
+
+    private:
+        winrt::com_ptr<ID3D11Device> m_d3dDevice;
+        winrt::com_ptr<ID3D11DeviceContext> m_d3dContext;
+        winrt::com_ptr<ID3D11Multithread> m_multithread;
+        winrt::com_ptr<ID3D11Texture2D> m_texture;
+        bool m_swapRedBlue = false;
+        std::unique_ptr<PixelProbeCache> m_cache;
+        std::array<StagingSlot, SlotCount> m_slots;
+        DXGI_FORMAT m_slotFormat = DXGI_FORMAT_UNKNOWN;
+        size_t m_nextSlot = 0;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct PixelProbe : PixelProbeT<PixelProbe, implementation::PixelProbe>
+    {
+    };
+}
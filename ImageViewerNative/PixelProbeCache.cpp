@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "PixelProbeCache.h"
+
+PixelProbeCache::PixelProbeCache(uint32_t width, uint32_t height, uint32_t tileSize, size_t capacity)
+{
+    m_width = width;
+    m_height = height;
+    m_tileSize = std::max(tileSize, 1u);
+    m_capacity = std::max<size_t>(capacity, 1);
+}
+
+PixelRect PixelProbeCache::TileBounds(TileCoordinate const& tile) const
+{
+    PixelRect bounds;
+    bounds.X = tile.X * m_tileSize;
+    bounds.Y = tile.Y * m_tileSize;
+    bounds.Width = std::min(m_tileSize, m_width - bounds.X);
+    bounds.Height = std::min(m_tileSize, m_height - bounds.Y);
+    return bounds;
+}
+
+uint8_t const* PixelProbeCache::Find(TileCoordinate const& tile)
+{
+    auto found = m_resident.find(Key(tile));
+    if (found == m_resident.end())
+    {
+        return nullptr;
+    }
+    m_lru.splice(m_lru.begin(), m_lru, found->second);
+    return found->second->Pixels.data();
+}
+
+uint8_t* PixelProbeCache::Insert(TileCoordinate const& tile)
+{
+    auto key = Key(tile);
+    auto found = m_resident.find(key);
+    if (found != m_resident.end())
+    {
+        m_lru.splice(m_lru.begin(), m_lru, found->second);
+        return found->second->Pixels.data();
+    }
+
+    // Recycle the least recently used buffer if we're full
+    std::vector<uint8_t> pixels;
+    if (m_lru.size() >= m_capacity)
+    {
+        auto& oldest = m_lru.back();
+        m_resident.erase(Key(oldest.Tile));
+        pixels = std::move(oldest.Pixels);
+        m_lru.pop_back();
+    }
+    pixels.resize(static_cast<size_t>(m_tileSize) * m_tileSize * 4);
+
+    m_lru.push_front({ tile, std::move(pixels) });
+    m_resident.emplace(key, m_lru.begin());
+    return m_lru.front().Pixels.data();
+}
+
+void PixelProbeCache::Clear()
+{
+    m_lru.clear();
+    m_resident.clear();
+}
+
+std::optional<TileCoordinate> PixelProbeCache::RecordProbe(uint32_t x, uint32_t y)
+{
+    auto currentX = static_cast<float>(x);
+    auto currentY = static_cast<float>(y);
+    if (!m_hasLastProbe)
+    {
+        m_hasLastProbe = true;
+        m_lastX = currentX;
+        m_lastY = currentY;
+        return std::nullopt;
+    }
+
+    // Smooth out the jitter between pointer events
+    const float smoothing = 0.5f;
+    m_velocityX = (smoothing * m_velocityX) + ((1.0f - smoothing) * (currentX - m_lastX));
+    m_velocityY = (smoothing * m_velocityY) + ((1.0f - smoothing) * (currentY - m_lastY));
+    m_lastX = currentX;
+    m_lastY = currentY;
+
+    // Look far enough ahead to reach the next tile within a few events
+    const float lookahead = 4.0f;
+    auto predictedX = currentX + (m_velocityX * lookahead);
+    auto predictedY = currentY + (m_velocityY * lookahead);
+    if (predictedX < 0.0f || predictedY < 0.0f || predictedX >= static_cast<float>(m_width) || predictedY >= static_cast<float>(m_height))
+    {
+        return std::nullopt;
+    }
+
+    auto predicted = TileFor(static_cast<uint32_t>(predictedX), static_cast<uint32_t>(predictedY));
+    auto current = TileFor(x, y);
+    if ((predicted.X == current.X && predicted.Y == current.Y) || Contains(predicted))
+    {
+        return std::nullopt;
+    }
+    return predicted;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "ViewportTileCache.h"
+
+// CPU copies of small tiles of an image, read back on demand around the
+// cursor. Recently read tiles are kept in an LRU, and the pointer's
+// recent motion is used to guess which tile will be needed next so it
+// can be read ahead of time.
+class PixelProbeCache
+{
+public:
+    PixelProbeCache(uint32_t width, uint32_t height, uint32_t tileSize, size_t capacity);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t TileSize() const { return m_tileSize; }
+
+    TileCoordinate TileFor(uint32_t x, uint32_t y) const { return { x / m_tileSize, y / m_tileSize }; }
+    PixelRect TileBounds(TileCoordinate const& tile) const;
+    // Where pixel (x, y) is in the buffer of the tile that holds it
+    size_t PixelOffset(uint32_t x, uint32_t y) const { return ((static_cast<size_t>(y % m_tileSize) * m_tileSize) + (x % m_tileSize)) * 4; }
+    bool Contains(TileCoordinate const& tile) const { return m_resident.find(Key(tile)) != m_resident.end(); }
+
+    // Returns the tile's BGRA8 pixels (TileSize() pixels per row), or
+    // nullptr if the tile isn't resident.
+    uint8_t const* Find(TileCoordinate const& tile);
+    // Makes room for the tile and returns its buffer to be filled.
+    uint8_t* Insert(TileCoordinate const& tile);
+    void Clear();
+
+    // Records a probe and returns the tile the pointer is heading
+    // towards, if it differs from the current one and isn't resident.
+    std::optional<TileCoordinate> RecordProbe(uint32_t x, uint32_t y);
+
+private:
+    struct Entry
+    {
+        TileCoordinate Tile;
+        std::vector<uint8_t> Pixels;
+    };
+
+    static uint64_t Key(TileCoordinate const& tile) { return (static_cast<uint64_t>(tile.Y) << 32) | tile.X; }
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_tileSize = 0;
+    size_t m_capacity = 0;
+    std::list<Entry> m_lru;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> m_resident;
+
+    bool m_hasLastProbe = false;
+    float m_lastX = 0.0f;
+    float m_lastY = 0.0f;
+    float m_velocityX = 0.0f;
+    float m_velocityY = 0.0f;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+struct PixelRect
+{
+    uint32_t X = 0;
+    uint32_t Y = 0;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+};
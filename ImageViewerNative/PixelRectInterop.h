@@ -0,0 +1,17 @@
+#pragma once
+#include "PixelRect.h"
+
+// Negative origins are clipped to zero, as are negative sizes.
+inline PixelRect ToPixelRect(winrt::Windows::Graphics::RectInt32 const& rect)
+{
+    auto x0 = std::max<int64_t>(rect.X, 0);
+    auto y0 = std::max<int64_t>(rect.Y, 0);
+    auto x1 = std::max<int64_t>(static_cast<int64_t>(rect.X) + rect.Width, x0);
+    auto y1 = std::max<int64_t>(static_cast<int64_t>(rect.Y) + rect.Height, y0);
+    return { static_cast<uint32_t>(x0), static_cast<uint32_t>(y0), static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(y1 - y0) };
+}
+
+inline winrt::Windows::Graphics::RectInt32 ToRectInt32(PixelRect const& rect)
+{
+    return { static_cast<int32_t>(rect.X), static_cast<int32_t>(rect.Y), static_cast<int32_t>(rect.Width), static_cast<int32_t>(rect.Height) };
+}
@@ -0,0 +1,413 @@
+#include "pch.h"
+#include "PngEncoder.h"
+#include "Checksums.h"
+#include "DeflateEncoder.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "SimdHelpers.h"
+
+static const uint8_t Signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+static const uint8_t ColorTypeRgb = 2;
+static const uint8_t ColorTypeRgba = 6;
+// Converted rows are kept behind this many zero bytes, so the pixel to
+// the left of the first one reads as zero without a special case
+static const size_t RowPadding = 16;
+
+static ProfileStage EncodeStage("PngEncoder.Encode");
+
+enum class PngFilter : uint8_t
+{
+    None = 0,
+    Sub = 1,
+    Up = 2,
+    Average = 3,
+    Paeth = 4,
+};
+
+static void StoreBigEndian(uint32_t value, uint8_t* data)
+{
+    data[0] = static_cast<uint8_t>(value >> 24);
+    data[1] = static_cast<uint8_t>(value >> 16);
+    data[2] = static_cast<uint8_t>(value >> 8);
+    data[3] = static_cast<uint8_t>(value);
+}
+
+static uint32_t ChunkCrc(char const* type, uint8_t const* data, size_t size)
+{
+    auto crc = Crc32(0, reinterpret_cast<uint8_t const*>(type), 4);
+    return Crc32(crc, data, size);
+}
+
+static void WriteChunk(PngEncoder::WriteFunction const& write, char const* type, uint8_t const* data, size_t size, uint32_t crc)
+{
+    std::array<uint8_t, 8> header;
+    StoreBigEndian(static_cast<uint32_t>(size), header.data());
+    memcpy(header.data() + 4, type, 4);
+    write(header.data(), header.size());
+    if (size > 0)
+    {
+        write(data, size);
+    }
+    std::array<uint8_t, 4> footer;
+    StoreBigEndian(crc, footer.data());
+    write(footer.data(), footer.size());
+}
+
+static bool IsOpaque(uint8_t const* bgraPixels, uint32_t width, uint32_t height, uint32_t stride)
+{
+    std::atomic<bool> opaque = true;
+    ParallelFor(0, height, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end && opaque.load(std::memory_order_relaxed); y++)
+        {
+            auto row = bgraPixels + (static_cast<size_t>(y) * stride);
+            uint32_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+            auto alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+            auto all = alphaMask;
+            for (; x + 4 <= width; x += 4)
+            {
+                auto pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + (x * 4)));
+                all = _mm_and_si128(all, pixels);
+            }
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(all, alphaMask), alphaMask)) != 0xFFFF)
+            {
+                opaque = false;
+            }
+#endif
+            for (; x < width; x++)
+            {
+                if (row[(x * 4) + 3] != 255)
+                {
+                    opaque = false;
+                }
+            }
+        }
+    }, TaskPriority::Background);
+    return opaque;
+}
+
+static void ConvertRow(uint8_t const* bgra, uint32_t width, bool opaque, bool premultiplied, uint8_t* output)
+{
+    if (opaque)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            output[0] = bgra[2];
+            output[1] = bgra[1];
+            output[2] = bgra[0];
+            output += 3;
+            bgra += 4;
+        }
+        return;
+    }
+
+    uint32_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+    // Swap red and blue in each 32-bit pixel. Premultiplied pixels can
+    // only take this path when they're all opaque.
+    auto alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    auto greenAlphaMask = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+    auto lowByteMask = _mm_set1_epi32(0xFF);
+    for (; x + 4 <= width; x += 4)
+    {
+        auto pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bgra + (x * 4)));
+        if (premultiplied && _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(pixels, alphaMask), alphaMask)) != 0xFFFF)
+        {
+            break;
+        }
+        auto swapped = _mm_or_si128(_mm_and_si128(pixels, greenAlphaMask),
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pixels, 16), lowByteMask), _mm_slli_epi32(_mm_and_si128(pixels, lowByteMask), 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + (x * 4)), swapped);
+    }
+#endif
+    for (; x < width; x++)
+    {
+        auto pixel = bgra + (x * 4);
+        auto result = output + (x * 4);
+        uint32_t alpha = pixel[3];
+        if (!premultiplied || alpha == 255)
+        {
+            result[0] = pixel[2];
+            result[1] = pixel[1];
+            result[2] = pixel[0];
+        }
+        else if (alpha == 0)
+        {
+            result[0] = 0;
+            result[1] = 0;
+            result[2] = 0;
+        }
+        else
+        {
+            auto unpremultiply = [alpha](uint32_t value)
+            {
+                return static_cast<uint8_t>(std::min(255u, ((value * 255) + (alpha / 2)) / alpha));
+            };
+            result[0] = unpremultiply(pixel[2]);
+            result[1] = unpremultiply(pixel[1]);
+            result[2] = unpremultiply(pixel[0]);
+        }
+        result[3] = static_cast<uint8_t>(alpha);
+    }
+}
+
+static uint8_t PaethPredictor(uint8_t left, uint8_t up, uint8_t upLeft)
+{
+    int32_t a = left;
+    int32_t b = up;
+    int32_t c = upLeft;
+    auto pa = std::abs(b - c);
+    auto pb = std::abs(a - c);
+    auto pc = std::abs(a + b - (2 * c));
+    if (pa <= pb && pa <= pc)
+    {
+        return left;
+    }
+    return pb <= pc ? up : upLeft;
+}
+
+#ifdef IMAGEVIEWER_SSE2
+static __m128i PaethPredictor16(__m128i a, __m128i b, __m128i c)
+{
+    auto zero = _mm_setzero_si128();
+    auto bc = _mm_sub_epi16(b, c);
+    auto ac = _mm_sub_epi16(a, c);
+    auto abc = _mm_add_epi16(bc, ac);
+    auto pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+    auto pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+    auto pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+    auto notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    auto notB = _mm_cmpgt_epi16(pb, pc);
+    auto bOrC = _mm_or_si128(_mm_andnot_si128(notB, b), _mm_and_si128(notB, c));
+    return _mm_or_si128(_mm_andnot_si128(notA, a), _mm_and_si128(notA, bOrC));
+}
+#endif
+
+// Filters one row. row and previousRow are preceded by at least
+// bytesPerPixel readable zero bytes.
+static void FilterRow(PngFilter filter, uint8_t const* row, uint8_t const* previousRow, size_t size, uint32_t bytesPerPixel, uint8_t* output)
+{
+    size_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+    auto zero = _mm_setzero_si128();
+    auto one = _mm_set1_epi8(1);
+    for (; x + 16 <= size; x += 16)
+    {
+        auto current = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + x));
+        auto left = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + x - bytesPerPixel));
+        auto up = _mm_loadu_si128(reinterpret_cast<__m128i const*>(previousRow + x));
+        __m128i prediction;
+        switch (filter)
+        {
+        case PngFilter::Sub:
+            prediction = left;
+            break;
+        case PngFilter::Up:
+            prediction = up;
+            break;
+        case PngFilter::Average:
+            // _mm_avg_epu8 rounds up, the filter rounds down
+            prediction = _mm_sub_epi8(_mm_avg_epu8(left, up), _mm_and_si128(_mm_xor_si128(left, up), one));
+            break;
+        case PngFilter::Paeth:
+            {
+                auto upLeft = _mm_loadu_si128(reinterpret_cast<__m128i const*>(previousRow + x - bytesPerPixel));
+                auto low = PaethPredictor16(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(up, zero), _mm_unpacklo_epi8(upLeft, zero));
+                auto high = PaethPredictor16(_mm_unpackhi_epi8(left, zero), _mm_unpackhi_epi8(up, zero), _mm_unpackhi_epi8(upLeft, zero));
+                prediction = _mm_packus_epi16(low, high);
+            }
+            break;
+        default:
+            prediction = zero;
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + x), _mm_sub_epi8(current, prediction));
+    }
+#endif
+    for (; x < size; x++)
+    {
+        uint8_t left = row[x - bytesPerPixel];
+        uint8_t up = previousRow[x];
+        uint8_t upLeft = previousRow[x - bytesPerPixel];
+        uint8_t prediction = 0;
+        switch (filter)
+        {
+        case PngFilter::Sub:
+            prediction = left;
+            break;
+        case PngFilter::Up:
+            prediction = up;
+            break;
+        case PngFilter::Average:
+            prediction = static_cast<uint8_t>((static_cast<uint32_t>(left) + up) / 2);
+            break;
+        case PngFilter::Paeth:
+            prediction = PaethPredictor(left, up, upLeft);
+            break;
+        default:
+            break;
+        }
+        output[x] = static_cast<uint8_t>(row[x] - prediction);
+    }
+}
+
+// The usual heuristic: the sum of the filtered bytes taken as signed
+// values. Rows closer to zero compress better.
+static uint64_t FilterScore(uint8_t const* data, size_t size)
+{
+    uint64_t score = 0;
+    size_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+    auto zero = _mm_setzero_si128();
+    auto sums = zero;
+    for (; x + 16 <= size; x += 16)
+    {
+        auto values = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + x));
+        auto magnitudes = _mm_min_epu8(values, _mm_sub_epi8(zero, values));
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(magnitudes, zero));
+    }
+    score = static_cast<uint64_t>(_mm_cvtsi128_si32(sums)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+#endif
+    for (; x < size; x++)
+    {
+        score += std::min<uint32_t>(data[x], 256 - data[x]);
+    }
+    return score;
+}
+
+void PngEncoder::Encode(uint8_t const* bgraPixels, uint32_t width, uint32_t height, uint32_t stride, bool premultiplied, uint32_t level, WriteFunction const& write)
+{
+    if (width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX)
+    {
+        throw std::invalid_argument("The image size is not valid for a PNG.");
+    }
+    ProfileScope scope(EncodeStage);
+    if (stride < static_cast<size_t>(width) * 4)
+    {
+        throw std::invalid_argument("The stride is smaller than a row of pixels.");
+    }
+    if (level > DeflateEncoder::MaxLevel)
+    {
+        throw std::invalid_argument("The compression level must be between 0 and 9.");
+    }
+
+    auto opaque = IsOpaque(bgraPixels, width, height, stride);
+    uint32_t bytesPerPixel = opaque ? 3 : 4;
+    auto rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+    auto filteredRowBytes = rowBytes + 1;
+    auto filteredSize = filteredRowBytes * height;
+    std::vector<uint8_t> filtered(filteredSize);
+
+    // Each band converts the row above it too, since filters look at it
+    ParallelFor(0, height, [&](uint32_t begin, uint32_t end)
+    {
+        std::vector<uint8_t> previousRow(RowPadding + rowBytes + 16, 0);
+        std::vector<uint8_t> currentRow(RowPadding + rowBytes + 16, 0);
+        std::array<std::vector<uint8_t>, 5> candidates;
+        if (level > 0)
+        {
+            for (auto& candidate : candidates)
+            {
+                candidate.resize(rowBytes);
+            }
+        }
+        if (begin > 0)
+        {
+            ConvertRow(bgraPixels + (static_cast<size_t>(begin - 1) * stride), width, opaque, premultiplied, previousRow.data() + RowPadding);
+        }
+
+        for (auto y = begin; y < end; y++)
+        {
+            auto row = currentRow.data() + RowPadding;
+            auto previous = previousRow.data() + RowPadding;
+            ConvertRow(bgraPixels + (static_cast<size_t>(y) * stride), width, opaque, premultiplied, row);
+
+            auto output = filtered.data() + (static_cast<size_t>(y) * filteredRowBytes);
+            if (level == 0)
+            {
+                output[0] = static_cast<uint8_t>(PngFilter::None);
+                memcpy(output + 1, row, rowBytes);
+            }
+            else
+            {
+                size_t best = 0;
+                uint64_t bestScore = FilterScore(row, rowBytes);
+                for (size_t filter = 1; filter < candidates.size(); filter++)
+                {
+                    FilterRow(static_cast<PngFilter>(filter), row, previous, rowBytes, bytesPerPixel, candidates[filter].data());
+                    auto score = FilterScore(candidates[filter].data(), rowBytes);
+                    if (score < bestScore)
+                    {
+                        best = filter;
+                        bestScore = score;
+                    }
+                }
+                output[0] = static_cast<uint8_t>(best);
+                memcpy(output + 1, best == 0 ? row : candidates[best].data(), rowBytes);
+            }
+            std::swap(currentRow, previousRow);
+        }
+    }, TaskPriority::Background);
+
+    // zlib header: deflate with a 32 KB window, and a check value that
+    // makes it a multiple of 31
+    uint8_t compressionInfo = 0x78;
+    uint8_t flags = static_cast<uint8_t>((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6);
+    flags = static_cast<uint8_t>(flags + ((31 - (((compressionInfo << 8) | flags) % 31)) % 31));
+
+    auto pieceCount = static_cast<uint32_t>(std::max<size_t>(1, (filteredSize + PieceSize - 1) / PieceSize));
+    std::vector<std::vector<uint8_t>> pieces(pieceCount);
+    std::vector<uint32_t> adlers(pieceCount);
+    std::vector<uint32_t> crcs(pieceCount);
+    ParallelFor(0, pieceCount, [&](uint32_t begin, uint32_t end)
+    {
+        DeflateEncoder encoder(level);
+        for (auto piece = begin; piece < end; piece++)
+        {
+            auto offset = static_cast<size_t>(piece) * PieceSize;
+            auto size = std::min(PieceSize, filteredSize - offset);
+            auto& output = pieces[piece];
+            output.reserve(level == 0 ? size + 64 : size / 2);
+            if (piece == 0)
+            {
+                output.push_back(compressionInfo);
+                output.push_back(flags);
+            }
+            auto last = piece + 1 == pieceCount;
+            encoder.Compress(filtered.data() + offset, size, std::min(offset, DeflateEncoder::WindowSize), last, output);
+            adlers[piece] = Adler32(1, filtered.data() + offset, size);
+            // The last piece gets the Adler-32 of everything first
+            if (!last)
+            {
+                crcs[piece] = ChunkCrc("IDAT", output.data(), output.size());
+            }
+        }
+    }, TaskPriority::Background);
+
+    auto adler = adlers[0];
+    for (uint32_t piece = 1; piece < pieceCount; piece++)
+    {
+        auto offset = static_cast<size_t>(piece) * PieceSize;
+        adler = Adler32Combine(adler, adlers[piece], std::min(PieceSize, filteredSize - offset));
+    }
+    auto& lastPiece = pieces.back();
+    std::array<uint8_t, 4> adlerBytes;
+    StoreBigEndian(adler, adlerBytes.data());
+    lastPiece.insert(lastPiece.end(), adlerBytes.begin(), adlerBytes.end());
+    crcs.back() = ChunkCrc("IDAT", lastPiece.data(), lastPiece.size());
+
+    std::array<uint8_t, 13> header = {};
+    StoreBigEndian(width, header.data());
+    StoreBigEndian(height, header.data() + 4);
+    header[8] = 8;
+    header[9] = opaque ? ColorTypeRgb : ColorTypeRgba;
+
+    write(Signature, sizeof(Signature));
+    WriteChunk(write, "IHDR", header.data(), header.size(), ChunkCrc("IHDR", header.data(), header.size()));
+    for (uint32_t piece = 0; piece < pieceCount; piece++)
+    {
+        WriteChunk(write, "IDAT", pieces[piece].data(), pieces[piece].size(), crcs[piece]);
+    }
+    WriteChunk(write, "IEND", nullptr, 0, ChunkCrc("IEND", nullptr, 0));
+}
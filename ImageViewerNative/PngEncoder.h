@@ -0,0 +1,20 @@
+#pragma once
+
+// Encodes BGRA8 pixels as an 8-bit PNG on all cores. Rows are filtered
+// in parallel with the filter picked per row, and the filtered image is
+// deflated in independent pieces (see DeflateEncoder), each written as
+// its own IDAT chunk.
+class PngEncoder
+{
+public:
+    using WriteFunction = std::function<void(uint8_t const* data, size_t size)>;
+
+    static constexpr uint32_t DefaultLevel = 6;
+    // Filtered bytes per deflate piece
+    static constexpr size_t PieceSize = 256 * 1024;
+
+    // Level 0 skips filtering and compression, for scratch output. 1-9
+    // trade speed for size like zlib. Opaque images are written as RGB,
+    // others as RGBA with the alpha unpremultiplied if needed.
+    static void Encode(uint8_t const* bgraPixels, uint32_t width, uint32_t height, uint32_t stride, bool premultiplied, uint32_t level, WriteFunction const& write);
+};
@@ -0,0 +1,43 @@
+#include "pch.h"
+#include "PngWriter.h"
+#include "PngWriter.g.cpp"
+#include "PngEncoder.h"
+#include "DeflateEncoder.h"
+#include "StreamInterop.h"
+
+namespace winrt
+{
+    using namespace Windows::Storage::Streams;
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    uint32_t PngWriter::DefaultCompressionLevel()
+    {
+        return PngEncoder::DefaultLevel;
+    }
+
+    void PngWriter::WriteToStream(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height, bool premultiplied, uint32_t compressionLevel, winrt::IRandomAccessStream const& stream)
+    {
+        if (width == 0 || height == 0)
+        {
+            throw winrt::hresult_invalid_argument(L"The image size must not be empty.");
+        }
+        if (bgraPixels.size() < static_cast<uint64_t>(width) * height * 4)
+        {
+            throw winrt::hresult_invalid_argument(L"The pixel buffer is smaller than the given size.");
+        }
+        if (compressionLevel > DeflateEncoder::MaxLevel)
+        {
+            throw winrt::hresult_invalid_argument(L"The compression level must be between 0 and 9.");
+        }
+
+        auto istream = CreateStreamOverRandomAccessStream(stream);
+        auto rawStream = istream.get();
+        PngEncoder::Encode(bgraPixels.data(), width, height, width * 4, premultiplied, compressionLevel, [rawStream](uint8_t const* data, size_t size)
+        {
+            ::WriteToStream(rawStream, data, size);
+        });
+        winrt::check_hresult(istream->Commit(STGC_DEFAULT));
+    }
+}
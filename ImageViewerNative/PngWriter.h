@@ -0,0 +1,19 @@
+#pragma once
+#include "PngWriter.g.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct PngWriter
+    {
+        PngWriter() = default;
+
+        static uint32_t DefaultCompressionLevel();
+        static void WriteToStream(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height, bool premultiplied, uint32_t compressionLevel, winrt::Windows::Storage::Streams::IRandomAccessStream const& stream);
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct PngWriter : PngWriterT<PngWriter, implementation::PngWriter>
+    {
+    };
+}
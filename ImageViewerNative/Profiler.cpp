@@ -0,0 +1,397 @@
+#include "pch.h"
+#include "Profiler.h"
+
+enum class ProfileEventKind : uint32_t
+{
+    Span,
+    Counter,
+};
+
+// Slots are atomics so that exporting while a thread records is well
+// defined. Relaxed stores are plain moves on x86 and ARM.
+struct ProfileEventSlot
+{
+    std::atomic<char const*> Name = nullptr;
+    std::atomic<uint32_t> Kind = 0;
+    std::atomic<int64_t> Start = 0;
+    // Duration for spans, value for counters
+    std::atomic<int64_t> Value = 0;
+};
+
+struct ProfileEvent
+{
+    char const* Name = nullptr;
+    ProfileEventKind Kind = ProfileEventKind::Span;
+    int64_t Start = 0;
+    int64_t Value = 0;
+    uint32_t ThreadId = 0;
+};
+
+// Written only by its own thread. Readers take the write index, copy the
+// slots, then drop any slot the writer may have lapped in the meantime.
+class ProfileRing
+{
+public:
+    explicit ProfileRing(uint32_t threadId) : m_threadId(threadId), m_slots(Profiler::RingCapacity) {}
+
+    void Write(char const* name, ProfileEventKind kind, int64_t start, int64_t value)
+    {
+        auto index = m_writeIndex.load(std::memory_order_relaxed);
+        auto& slot = m_slots[index % Profiler::RingCapacity];
+        slot.Name.store(name, std::memory_order_relaxed);
+        slot.Kind.store(static_cast<uint32_t>(kind), std::memory_order_relaxed);
+        slot.Start.store(start, std::memory_order_relaxed);
+        slot.Value.store(value, std::memory_order_relaxed);
+        m_writeIndex.store(index + 1, std::memory_order_release);
+    }
+
+    void Clear()
+    {
+        m_readIndex.store(m_writeIndex.load());
+    }
+
+    void Read(std::vector<ProfileEvent>& events) const
+    {
+        auto end = m_writeIndex.load(std::memory_order_acquire);
+        auto begin = std::max(m_readIndex.load(), end > Profiler::RingCapacity ? end - Profiler::RingCapacity : 0);
+        auto firstEvent = events.size();
+        for (auto index = begin; index < end; index++)
+        {
+            auto& slot = m_slots[index % Profiler::RingCapacity];
+            ProfileEvent event;
+            event.Name = slot.Name.load(std::memory_order_relaxed);
+            event.Kind = static_cast<ProfileEventKind>(slot.Kind.load(std::memory_order_relaxed));
+            event.Start = slot.Start.load(std::memory_order_relaxed);
+            event.Value = slot.Value.load(std::memory_order_relaxed);
+            event.ThreadId = m_threadId;
+            events.push_back(event);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto lappedEnd = m_writeIndex.load(std::memory_order_relaxed);
+        if (lappedEnd > begin + Profiler::RingCapacity)
+        {
+            auto lappedCount = std::min<size_t>(lappedEnd - Profiler::RingCapacity - begin, events.size() - firstEvent);
+            events.erase(events.begin() + firstEvent, events.begin() + firstEvent + lappedCount);
+        }
+    }
+
+private:
+    uint32_t m_threadId = 0;
+    std::vector<ProfileEventSlot> m_slots;
+    std::atomic<size_t> m_writeIndex = 0;
+    std::atomic<size_t> m_readIndex = 0;
+};
+
+struct ProfileRegistry
+{
+    std::mutex Lock;
+    std::vector<std::shared_ptr<ProfileRing>> Rings;
+    // Rings of exited threads. They still export until a new thread takes
+    // one over or Reset drops them, so short-lived threads don't each
+    // leave a ring behind.
+    std::vector<std::shared_ptr<ProfileRing>> FreeRings;
+    uint32_t NextThreadId = 1;
+    std::vector<ProfileStage*> Stages;
+    std::vector<ProfileCounter*> Counters;
+};
+
+static ProfileRegistry& Registry()
+{
+    static ProfileRegistry registry;
+    return registry;
+}
+
+// Owns the name of a counter created by Profiler::Counter
+struct NamedProfileCounter
+{
+    explicit NamedProfileCounter(std::string_view name) : Name(name), Counter(Name.c_str()) {}
+
+    std::string Name;
+    ProfileCounter Counter;
+};
+
+// Hands the thread's ring back to the registry when the thread exits
+struct ProfileRingOwner
+{
+    std::shared_ptr<ProfileRing> Ring;
+
+    ~ProfileRingOwner()
+    {
+        if (Ring)
+        {
+            auto& registry = Registry();
+            std::lock_guard lock(registry.Lock);
+            registry.FreeRings.push_back(std::move(Ring));
+        }
+    }
+};
+
+static thread_local ProfileRingOwner t_ring;
+
+static ProfileRing& CurrentRing()
+{
+    if (!t_ring.Ring)
+    {
+        auto& registry = Registry();
+        std::lock_guard lock(registry.Lock);
+        if (!registry.FreeRings.empty())
+        {
+            t_ring.Ring = std::move(registry.FreeRings.back());
+            registry.FreeRings.pop_back();
+        }
+        else
+        {
+            t_ring.Ring = std::make_shared<ProfileRing>(registry.NextThreadId++);
+            registry.Rings.push_back(t_ring.Ring);
+        }
+    }
+    return *t_ring.Ring;
+}
+
+static uint32_t CountLeadingZeros(uint64_t value)
+{
+    uint32_t count = 0;
+    for (uint64_t bit = 1ull << 63; bit != 0 && (value & bit) == 0; bit >>= 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+static size_t BucketIndex(uint64_t nanoseconds)
+{
+    if (nanoseconds < 4)
+    {
+        return static_cast<size_t>(nanoseconds);
+    }
+    auto exponent = 63 - CountLeadingZeros(nanoseconds);
+    auto fraction = (nanoseconds >> (exponent - 2)) & 3;
+    return std::min<size_t>((exponent - 1) * 4 + fraction, ProfileStage::BucketCount - 1);
+}
+
+static uint64_t BucketUpperBound(size_t index)
+{
+    if (index < 4)
+    {
+        return index;
+    }
+    auto exponent = index / 4 + 1;
+    auto fraction = index % 4;
+    return ((5 + fraction) << (exponent - 2)) - 1;
+}
+
+static void UpdateMax(std::atomic<uint64_t>& max, uint64_t value)
+{
+    auto current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void UpdateMax(std::atomic<int64_t>& max, int64_t value)
+{
+    auto current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+static void WriteJsonString(std::ostringstream& stream, char const* text)
+{
+    stream << '"';
+    for (auto c = text; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            stream << '\\';
+        }
+        stream << *c;
+    }
+    stream << '"';
+}
+
+ProfileStage::ProfileStage(char const* name) : m_name(name)
+{
+    auto& registry = Registry();
+    std::lock_guard lock(registry.Lock);
+    registry.Stages.push_back(this);
+}
+
+void ProfileStage::Record(int64_t durationNanoseconds)
+{
+    auto duration = static_cast<uint64_t>(std::max<int64_t>(durationNanoseconds, 0));
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_totalNanoseconds.fetch_add(duration, std::memory_order_relaxed);
+    m_buckets[BucketIndex(duration)].fetch_add(1, std::memory_order_relaxed);
+    UpdateMax(m_maxNanoseconds, duration);
+}
+
+ProfileCounter::ProfileCounter(char const* name) : m_name(name)
+{
+    auto& registry = Registry();
+    std::lock_guard lock(registry.Lock);
+    registry.Counters.push_back(this);
+}
+
+void ProfileCounter::Update(int64_t value)
+{
+    UpdateMax(m_maxValue, value);
+    Profiler::RecordCounter(*this, value);
+}
+
+void Profiler::Reset()
+{
+    auto& registry = Registry();
+    std::lock_guard lock(registry.Lock);
+    for (auto& ring : registry.FreeRings)
+    {
+        registry.Rings.erase(std::find(registry.Rings.begin(), registry.Rings.end(), ring));
+    }
+    registry.FreeRings.clear();
+    for (auto& ring : registry.Rings)
+    {
+        ring->Clear();
+    }
+    for (auto stage : registry.Stages)
+    {
+        stage->m_count = 0;
+        stage->m_totalNanoseconds = 0;
+        stage->m_maxNanoseconds = 0;
+        for (auto& bucket : stage->m_buckets)
+        {
+            bucket = 0;
+        }
+    }
+    for (auto counter : registry.Counters)
+    {
+        counter->m_value = 0;
+        counter->m_maxValue = 0;
+    }
+}
+
+ProfileCounter& Profiler::Counter(std::string_view name)
+{
+    // Separate from the registry lock, which creating a counter takes
+    static std::mutex lock;
+    static std::unordered_map<std::string, std::unique_ptr<NamedProfileCounter>> counters;
+    std::lock_guard guard(lock);
+    auto& counter = counters[std::string(name)];
+    if (!counter)
+    {
+        counter = std::make_unique<NamedProfileCounter>(name);
+    }
+    return counter->Counter;
+}
+
+int64_t Profiler::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::RecordSpan(ProfileStage const& stage, int64_t start, int64_t duration)
+{
+    CurrentRing().Write(stage.Name(), ProfileEventKind::Span, start, duration);
+}
+
+void Profiler::RecordCounter(ProfileCounter const& counter, int64_t value)
+{
+    CurrentRing().Write(counter.Name(), ProfileEventKind::Counter, Now(), value);
+}
+
+std::string Profiler::ExportChromeTrace()
+{
+    std::vector<ProfileEvent> events;
+    {
+        auto& registry = Registry();
+        std::lock_guard lock(registry.Lock);
+        for (auto& ring : registry.Rings)
+        {
+            ring->Read(events);
+        }
+    }
+    std::sort(events.begin(), events.end(), [](auto const& first, auto const& second) { return first.Start < second.Start; });
+
+    // Timestamps are microseconds, relative to the first event
+    auto origin = events.empty() ? 0 : events.front().Start;
+    std::ostringstream stream;
+    stream.precision(3);
+    stream << std::fixed;
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        auto& event = events[i];
+        stream << (i == 0 ? "\n" : ",\n") << "{\"name\":";
+        WriteJsonString(stream, event.Name);
+        stream << ",\"pid\":1,\"tid\":" << event.ThreadId << ",\"ts\":" << (event.Start - origin) / 1000.0;
+        if (event.Kind == ProfileEventKind::Span)
+        {
+            stream << ",\"ph\":\"X\",\"dur\":" << event.Value / 1000.0 << "}";
+        }
+        else
+        {
+            stream << ",\"ph\":\"C\",\"args\":{\"value\":" << event.Value << "}}";
+        }
+    }
+    stream << "\n]}\n";
+    return stream.str();
+}
+
+std::string Profiler::Summary()
+{
+    auto& registry = Registry();
+    std::lock_guard lock(registry.Lock);
+
+    std::ostringstream stream;
+    stream.precision(1);
+    stream << std::fixed;
+    for (auto stage : registry.Stages)
+    {
+        auto count = stage->m_count.load();
+        if (count == 0)
+        {
+            continue;
+        }
+
+        std::array<uint64_t, ProfileStage::BucketCount> buckets = {};
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            buckets[i] = stage->m_buckets[i].load();
+        }
+        auto maxNanoseconds = stage->m_maxNanoseconds.load();
+        auto percentile = [&](double fraction)
+        {
+            auto target = static_cast<uint64_t>(std::ceil(fraction * count));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < buckets.size(); i++)
+            {
+                seen += buckets[i];
+                if (seen >= target)
+                {
+                    return std::min(BucketUpperBound(i), maxNanoseconds) / 1000.0;
+                }
+            }
+            return maxNanoseconds / 1000.0;
+        };
+
+        auto total = stage->m_totalNanoseconds.load();
+        stream << stage->Name() << ": " << count << " runs, "
+            << total / 1000000.0 << " ms total, "
+            << total / 1000.0 / count << " us mean, "
+            << "p50 " << percentile(0.5) << " us, "
+            << "p90 " << percentile(0.9) << " us, "
+            << "p99 " << percentile(0.99) << " us, "
+            << "max " << maxNanoseconds / 1000.0 << " us\n";
+    }
+    for (auto counter : registry.Counters)
+    {
+        auto value = counter->m_value.load();
+        auto maxValue = counter->m_maxValue.load();
+        if (value == 0 && maxValue == 0)
+        {
+            continue;
+        }
+        stream << counter->Name() << ": " << value << " (max " << maxValue << ")\n";
+    }
+    return stream.str();
+}
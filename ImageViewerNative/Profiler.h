@@ -0,0 +1,142 @@
+#pragma once
+
+class ProfileStage;
+class ProfileCounter;
+
+// Collects stage timings and counter samples from the native pipeline.
+// Each thread records into its own ring buffer without taking locks; when
+// a ring fills up its oldest events are overwritten. While disabled,
+// scopes and counters cost a relaxed load and a branch.
+class Profiler
+{
+public:
+    static constexpr size_t RingCapacity = 64 * 1024;
+
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void SetEnabled(bool enabled) { s_enabled.store(enabled); }
+    // Drops recorded events and zeroes every stage and counter. The rings
+    // of threads that have exited are freed.
+    static void Reset();
+
+    // Nanoseconds on the steady clock
+    static int64_t Now();
+
+    // Chrome trace-event JSON, for chrome://tracing or Perfetto
+    static std::string ExportChromeTrace();
+    // Per-stage counts, totals and latency percentiles, then counters
+    static std::string Summary();
+
+    // For callers that can't declare a counter at namespace scope, such
+    // as the app. The counter is created on first use and is never freed.
+    static ProfileCounter& Counter(std::string_view name);
+
+private:
+    friend class ProfileStage;
+    friend class ProfileCounter;
+    friend class ProfileScope;
+
+    static void RecordSpan(ProfileStage const& stage, int64_t start, int64_t duration);
+    static void RecordCounter(ProfileCounter const& counter, int64_t value);
+
+    inline static std::atomic<bool> s_enabled = false;
+};
+
+// A named pipeline stage. Every timed run of the stage lands in its
+// latency histogram, and in the trace while the profiler is enabled.
+// Stages register themselves with the profiler, so declare them at
+// namespace scope.
+class ProfileStage
+{
+public:
+    // Four buckets per power of two nanoseconds, so percentiles are
+    // within 25%
+    static constexpr size_t BucketCount = 160;
+
+    explicit ProfileStage(char const* name);
+    ProfileStage(ProfileStage const&) = delete;
+    ProfileStage& operator=(ProfileStage const&) = delete;
+
+    char const* Name() const { return m_name; }
+    void Record(int64_t durationNanoseconds);
+
+private:
+    friend class Profiler;
+
+    char const* m_name = nullptr;
+    std::atomic<uint64_t> m_count = 0;
+    std::atomic<uint64_t> m_totalNanoseconds = 0;
+    std::atomic<uint64_t> m_maxNanoseconds = 0;
+    std::array<std::atomic<uint64_t>, BucketCount> m_buckets = {};
+};
+
+// A named running total (frames, bytes, stall time) or gauge (queue
+// depth). Like stages, counters are declared at namespace scope.
+class ProfileCounter
+{
+public:
+    explicit ProfileCounter(char const* name);
+    ProfileCounter(ProfileCounter const&) = delete;
+    ProfileCounter& operator=(ProfileCounter const&) = delete;
+
+    char const* Name() const { return m_name; }
+    void Add(int64_t value)
+    {
+        if (Profiler::IsEnabled())
+        {
+            Update(m_value.fetch_add(value) + value);
+        }
+    }
+    void Set(int64_t value)
+    {
+        if (Profiler::IsEnabled())
+        {
+            m_value.store(value);
+            Update(value);
+        }
+    }
+
+private:
+    friend class Profiler;
+
+    void Update(int64_t value);
+
+private:
+    char const* m_name = nullptr;
+    std::atomic<int64_t> m_value = 0;
+    std::atomic<int64_t> m_maxValue = 0;
+};
+
+// Times the enclosing scope as a run of the given stage. Stalls also
+// add their time to a counter, so that waits spread over several stages
+// add up to one total.
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfileStage& stage, ProfileCounter* stallCounter = nullptr) : m_stage(stage), m_stallCounter(stallCounter)
+    {
+        if (Profiler::IsEnabled())
+        {
+            m_start = Profiler::Now();
+        }
+    }
+    ~ProfileScope()
+    {
+        if (m_start >= 0)
+        {
+            auto duration = Profiler::Now() - m_start;
+            m_stage.Record(duration);
+            Profiler::RecordSpan(m_stage, m_start, duration);
+            if (m_stallCounter != nullptr)
+            {
+                m_stallCounter->Add(duration);
+            }
+        }
+    }
+    ProfileScope(ProfileScope const&) = delete;
+    ProfileScope& operator=(ProfileScope const&) = delete;
+
+private:
+    ProfileStage& m_stage;
+    ProfileCounter* m_stallCounter = nullptr;
+    int64_t m_start = -1;
+};
@@ -0,0 +1,54 @@
+#include "pch.h"
+#include "RegionStatistics.h"
+#include "RegionStatistics.g.cpp"
+#include "PixelRectInterop.h"
+
+namespace winrt
+{
+    using namespace Windows::Graphics;
+    using namespace ImageViewerNative;
+}
+
+static winrt::ChannelStatistics CreateChannelStatistics(ChannelAccumulator const& channel, uint64_t pixelCount)
+{
+    winrt::ChannelStatistics result = {};
+    if (pixelCount > 0)
+    {
+        auto count = static_cast<double>(pixelCount);
+        auto mean = static_cast<double>(channel.Sum) / count;
+        auto variance = (static_cast<double>(channel.SquaredSum) / count) - (mean * mean);
+        result.Mean = mean;
+        result.StandardDeviation = std::sqrt(std::max(variance, 0.0));
+        result.Minimum = channel.Minimum;
+        result.Maximum = channel.Maximum;
+        result.NonZeroCount = channel.NonZeroCount;
+    }
+    return result;
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    RegionStatistics::RegionStatistics(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height)
+    {
+        if (bgraPixels.size() < static_cast<uint64_t>(width) * height * 4)
+        {
+            throw winrt::hresult_invalid_argument(L"The pixel buffer is smaller than the given size.");
+        }
+
+        m_table = std::make_unique<RegionStatisticsTable>(bgraPixels.data(), width, height, width * 4);
+    }
+
+    winrt::RegionStatisticsResult RegionStatistics::Query(winrt::RectInt32 const& rect)
+    {
+        auto accumulator = m_table->Query(ToPixelRect(rect));
+        auto pixelCount = accumulator.PixelCount;
+
+        winrt::RegionStatisticsResult result = {};
+        result.Blue = CreateChannelStatistics(accumulator.Channels[0], pixelCount);
+        result.Green = CreateChannelStatistics(accumulator.Channels[1], pixelCount);
+        result.Red = CreateChannelStatistics(accumulator.Channels[2], pixelCount);
+        result.Alpha = CreateChannelStatistics(accumulator.Channels[3], pixelCount);
+        result.PixelCount = pixelCount;
+        return result;
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "RegionStatistics.g.h"
+#include "RegionStatisticsTable.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct RegionStatistics : RegionStatisticsT<RegionStatistics>
+    {
+        RegionStatistics(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height);
+
+        uint32_t Width() { return m_table->Width(); }
+        uint32_t Height() { return m_table->Height(); }
+
+        winrt::ImageViewerNative::RegionStatisticsResult Query(winrt::Windows::Graphics::RectInt32 const& rect);
+
+    private:
+        std::unique_ptr<RegionStatisticsTable> m_table;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct RegionStatistics : RegionStatisticsT<RegionStatistics, implementation::RegionStatistics>
+    {
+    };
+}
@@ -0,0 +1,400 @@
+#include "pch.h"
+#include "RegionStatisticsTable.h"
+#include "ParallelFor.h"
+#include "SimdHelpers.h"
+
+void RegionAccumulator::Add(RegionAccumulator const& other)
+{
+    for (size_t i = 0; i < Channels.size(); i++)
+    {
+        auto& channel = Channels[i];
+        auto& otherChannel = other.Channels[i];
+        channel.Sum += otherChannel.Sum;
+        channel.SquaredSum += otherChannel.SquaredSum;
+        channel.NonZeroCount += otherChannel.NonZeroCount;
+        channel.Minimum = std::min(channel.Minimum, otherChannel.Minimum);
+        channel.Maximum = std::max(channel.Maximum, otherChannel.Maximum);
+    }
+    PixelCount += other.PixelCount;
+}
+
+#ifdef IMAGEVIEWER_SSE2
+// Accumulates 4 BGRA pixels at a time in 16-bit and 32-bit lanes. The
+// lanes are flushed into the 64-bit totals before they can overflow.
+class SimdAccumulator
+{
+public:
+    SimdAccumulator(RegionAccumulator& result) : m_result(result)
+    {
+        Reset();
+    }
+
+    ~SimdAccumulator()
+    {
+        Flush();
+    }
+
+    void Add(__m128i const pixels)
+    {
+        auto low = _mm_unpacklo_epi8(pixels, m_zero);
+        auto high = _mm_unpackhi_epi8(pixels, m_zero);
+        m_sums = _mm_add_epi16(m_sums, _mm_add_epi16(low, high));
+
+        auto squaredLow = _mm_mullo_epi16(low, low);
+        auto squaredHigh = _mm_mullo_epi16(high, high);
+        m_squaredSums = _mm_add_epi32(m_squaredSums, _mm_add_epi32(_mm_unpacklo_epi16(squaredLow, m_zero), _mm_unpackhi_epi16(squaredLow, m_zero)));
+        m_squaredSums = _mm_add_epi32(m_squaredSums, _mm_add_epi32(_mm_unpacklo_epi16(squaredHigh, m_zero), _mm_unpackhi_epi16(squaredHigh, m_zero)));
+
+        // cmpeq yields 0xFF (-1) for zero bytes
+        m_zeroCounts = _mm_sub_epi8(m_zeroCounts, _mm_cmpeq_epi8(pixels, m_zero));
+        m_minimums = _mm_min_epu8(m_minimums, pixels);
+        m_maximums = _mm_max_epu8(m_maximums, pixels);
+
+        if (++m_count == MaxCount)
+        {
+            Flush();
+        }
+    }
+
+    void Flush()
+    {
+        if (m_count == 0)
+        {
+            return;
+        }
+
+        alignas(16) uint16_t sums[8];
+        alignas(16) uint32_t squaredSums[4];
+        alignas(16) uint8_t zeroCounts[16];
+        alignas(16) uint8_t minimums[16];
+        alignas(16) uint8_t maximums[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(sums), m_sums);
+        _mm_store_si128(reinterpret_cast<__m128i*>(squaredSums), m_squaredSums);
+        _mm_store_si128(reinterpret_cast<__m128i*>(zeroCounts), m_zeroCounts);
+        _mm_store_si128(reinterpret_cast<__m128i*>(minimums), m_minimums);
+        _mm_store_si128(reinterpret_cast<__m128i*>(maximums), m_maximums);
+
+        uint64_t pixelCount = m_count * 4;
+        for (size_t i = 0; i < 4; i++)
+        {
+            auto& channel = m_result.Channels[i];
+            channel.Sum += static_cast<uint64_t>(sums[i]) + sums[i + 4];
+            channel.SquaredSum += squaredSums[i];
+            uint64_t zeroCount = static_cast<uint64_t>(zeroCounts[i]) + zeroCounts[i + 4] + zeroCounts[i + 8] + zeroCounts[i + 12];
+            channel.NonZeroCount += pixelCount - zeroCount;
+            channel.Minimum = std::min({ channel.Minimum, minimums[i], minimums[i + 4], minimums[i + 8], minimums[i + 12] });
+            channel.Maximum = std::max({ channel.Maximum, maximums[i], maximums[i + 4], maximums[i + 8], maximums[i + 12] });
+        }
+        m_result.PixelCount += pixelCount;
+
+        Reset();
+    }
+
+private:
+    void Reset()
+    {
+        m_zero = _mm_setzero_si128();
+        m_sums = m_zero;
+        m_squaredSums = m_zero;
+        m_zeroCounts = m_zero;
+        m_minimums = _mm_set1_epi8(-1);
+        m_maximums = m_zero;
+        m_count = 0;
+    }
+
+private:
+    // Each 16-bit sum lane receives 2 pixels per Add (510 max),
+    // and each 8-bit zero counter receives at most 1.
+    static const uint32_t MaxCount = 128;
+
+    RegionAccumulator& m_result;
+    __m128i m_zero;
+    __m128i m_sums;
+    __m128i m_squaredSums;
+    __m128i m_zeroCounts;
+    __m128i m_minimums;
+    __m128i m_maximums;
+    uint32_t m_count = 0;
+};
+#endif
+
+static void AccumulatePixel(uint8_t const* pixel, RegionAccumulator& result)
+{
+    for (size_t i = 0; i < 4; i++)
+    {
+        auto value = pixel[i];
+        auto& channel = result.Channels[i];
+        channel.Sum += value;
+        channel.SquaredSum += static_cast<uint64_t>(value) * value;
+        channel.NonZeroCount += value != 0 ? 1 : 0;
+        channel.Minimum = std::min(channel.Minimum, value);
+        channel.Maximum = std::max(channel.Maximum, value);
+    }
+    result.PixelCount++;
+}
+
+static void AccumulateRect(uint8_t const* pixels, uint32_t stride, uint32_t width, uint32_t height, RegionAccumulator& result)
+{
+#ifdef IMAGEVIEWER_SSE2
+    SimdAccumulator accumulator(result);
+#endif
+    for (uint32_t y = 0; y < height; y++)
+    {
+        auto row = pixels + (static_cast<size_t>(y) * stride);
+        uint32_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+        for (; x + 4 <= width; x += 4)
+        {
+            accumulator.Add(_mm_loadu_si128(reinterpret_cast<__m128i const*>(row + (x * 4))));
+        }
+#endif
+        for (; x < width; x++)
+        {
+            AccumulatePixel(row + (x * 4), result);
+        }
+    }
+}
+
+RegionStatisticsTable::RegionStatisticsTable(uint8_t const* bgraPixels, uint32_t width, uint32_t height, uint32_t stride)
+{
+    m_width = width;
+    m_height = height;
+    m_blocksWide = width / BlockSize;
+    m_blocksHigh = height / BlockSize;
+
+    // Keep a tightly packed copy for the partial blocks along query edges
+    auto rowSize = static_cast<size_t>(width) * 4;
+    m_pixels = BufferPool::Shared().Acquire(rowSize * height);
+    ParallelFor(0, height, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end; y++)
+        {
+            memcpy(m_pixels.Data() + (rowSize * y), bgraPixels + (static_cast<size_t>(stride) * y), rowSize);
+        }
+    }, TaskPriority::Interactive);
+
+    std::vector<BlockExtents> blockExtents;
+    BuildBlocks(blockExtents);
+    BuildSummedAreaTable();
+    BuildExtentsPyramid(std::move(blockExtents));
+}
+
+void RegionStatisticsTable::BuildBlocks(std::vector<BlockExtents>& blockExtents)
+{
+    m_table.resize(static_cast<size_t>(m_blocksWide + 1) * (m_blocksHigh + 1), BlockSums{});
+    blockExtents.resize(static_cast<size_t>(m_blocksWide) * m_blocksHigh);
+
+    auto rowSize = m_width * 4;
+    ParallelFor(0, m_blocksHigh, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto blockY = begin; blockY < end; blockY++)
+        {
+            for (uint32_t blockX = 0; blockX < m_blocksWide; blockX++)
+            {
+                auto pixels = m_pixels.Data() + (static_cast<size_t>(blockY) * BlockSize * rowSize) + (blockX * BlockSize * 4);
+                RegionAccumulator block;
+                AccumulateRect(pixels, rowSize, BlockSize, BlockSize, block);
+
+                // Entry (x + 1, y + 1) holds block (x, y) until the prefix sums are taken
+                auto& sums = m_table[((blockY + 1) * (m_blocksWide + 1)) + blockX + 1];
+                auto& extents = blockExtents[(blockY * m_blocksWide) + blockX];
+                for (size_t i = 0; i < 4; i++)
+                {
+                    auto& channel = block.Channels[i];
+                    sums.Sum[i] = channel.Sum;
+                    sums.SquaredSum[i] = channel.SquaredSum;
+                    sums.NonZeroCount[i] = channel.NonZeroCount;
+                    extents.Minimum[i] = channel.Minimum;
+                    extents.Maximum[i] = channel.Maximum;
+                }
+            }
+        }
+    }, TaskPriority::Interactive);
+}
+
+void RegionStatisticsTable::BuildSummedAreaTable()
+{
+    auto tableWidth = m_blocksWide + 1;
+    auto addInto = [](BlockSums& dest, BlockSums const& source)
+    {
+        for (size_t i = 0; i < 4; i++)
+        {
+            dest.Sum[i] += source.Sum[i];
+            dest.SquaredSum[i] += source.SquaredSum[i];
+            dest.NonZeroCount[i] += source.NonZeroCount[i];
+        }
+    };
+
+    // Rows and columns are independent within each pass
+    ParallelFor(1, m_blocksHigh + 1, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end; y++)
+        {
+            for (uint32_t x = 1; x < tableWidth; x++)
+            {
+                addInto(m_table[(y * tableWidth) + x], m_table[(y * tableWidth) + x - 1]);
+            }
+        }
+    }, TaskPriority::Interactive);
+    ParallelFor(1, tableWidth, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = 1; y < m_blocksHigh + 1; y++)
+        {
+            for (auto x = begin; x < end; x++)
+            {
+                addInto(m_table[(y * tableWidth) + x], m_table[((y - 1) * tableWidth) + x]);
+            }
+        }
+    }, TaskPriority::Interactive);
+}
+
+void RegionStatisticsTable::BuildExtentsPyramid(std::vector<BlockExtents>&& blockExtents)
+{
+    if (m_blocksWide == 0 || m_blocksHigh == 0)
+    {
+        return;
+    }
+
+    m_extents.push_back({ m_blocksWide, m_blocksHigh, std::move(blockExtents) });
+    while (m_extents.back().Width > 1 || m_extents.back().Height > 1)
+    {
+        auto& previous = m_extents.back();
+        ExtentsLevel level;
+        level.Width = (previous.Width + 1) / 2;
+        level.Height = (previous.Height + 1) / 2;
+        level.Extents.resize(static_cast<size_t>(level.Width) * level.Height);
+        ParallelFor(0, level.Height, [&](uint32_t begin, uint32_t end)
+        {
+            for (auto y = begin; y < end; y++)
+            {
+                for (uint32_t x = 0; x < level.Width; x++)
+                {
+                    BlockExtents extents = { { 255, 255, 255, 255 }, { 0, 0, 0, 0 } };
+                    for (auto childY = y * 2; childY < std::min(y * 2 + 2, previous.Height); childY++)
+                    {
+                        for (auto childX = x * 2; childX < std::min(x * 2 + 2, previous.Width); childX++)
+                        {
+                            auto& child = previous.Extents[(childY * previous.Width) + childX];
+                            for (size_t i = 0; i < 4; i++)
+                            {
+                                extents.Minimum[i] = std::min(extents.Minimum[i], child.Minimum[i]);
+                                extents.Maximum[i] = std::max(extents.Maximum[i], child.Maximum[i]);
+                            }
+                        }
+                    }
+                    level.Extents[(y * level.Width) + x] = extents;
+                }
+            }
+        }, TaskPriority::Interactive);
+        m_extents.push_back(std::move(level));
+    }
+}
+
+RegionAccumulator RegionStatisticsTable::Query(PixelRect const& rect) const
+{
+    RegionAccumulator result;
+    auto x0 = std::min(rect.X, m_width);
+    auto y0 = std::min(rect.Y, m_height);
+    auto x1 = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(rect.X) + rect.Width, m_width));
+    auto y1 = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(rect.Y) + rect.Height, m_height));
+    if (x1 <= x0 || y1 <= y0)
+    {
+        return result;
+    }
+
+    // Whole blocks inside the rect
+    auto blockX0 = (x0 + BlockSize - 1) / BlockSize;
+    auto blockY0 = (y0 + BlockSize - 1) / BlockSize;
+    auto blockX1 = std::min(x1 / BlockSize, m_blocksWide);
+    auto blockY1 = std::min(y1 / BlockSize, m_blocksHigh);
+
+    if (blockX0 < blockX1 && blockY0 < blockY1)
+    {
+        AccumulateBlocks(blockX0, blockY0, blockX1, blockY1, result);
+
+        auto innerX0 = blockX0 * BlockSize;
+        auto innerY0 = blockY0 * BlockSize;
+        auto innerX1 = blockX1 * BlockSize;
+        auto innerY1 = blockY1 * BlockSize;
+        AccumulatePixels(x0, y0, x1 - x0, innerY0 - y0, result);
+        AccumulatePixels(x0, innerY1, x1 - x0, y1 - innerY1, result);
+        AccumulatePixels(x0, innerY0, innerX0 - x0, innerY1 - innerY0, result);
+        AccumulatePixels(innerX1, innerY0, x1 - innerX1, innerY1 - innerY0, result);
+    }
+    else
+    {
+        AccumulatePixels(x0, y0, x1 - x0, y1 - y0, result);
+    }
+
+    return result;
+}
+
+void RegionStatisticsTable::AccumulatePixels(uint32_t x, uint32_t y, uint32_t width, uint32_t height, RegionAccumulator& result) const
+{
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+
+    auto rowSize = m_width * 4;
+    auto pixels = m_pixels.Data() + (static_cast<size_t>(y) * rowSize) + (x * 4);
+    AccumulateRect(pixels, rowSize, width, height, result);
+}
+
+void RegionStatisticsTable::AccumulateBlocks(uint32_t blockX0, uint32_t blockY0, uint32_t blockX1, uint32_t blockY1, RegionAccumulator& result) const
+{
+    auto& bottomRight = TableAt(blockX1, blockY1);
+    auto& bottomLeft = TableAt(blockX0, blockY1);
+    auto& topRight = TableAt(blockX1, blockY0);
+    auto& topLeft = TableAt(blockX0, blockY0);
+
+    BlockExtents extents = { { 255, 255, 255, 255 }, { 0, 0, 0, 0 } };
+    auto topLevel = static_cast<uint32_t>(m_extents.size() - 1);
+    AccumulateExtents(topLevel, 0, 0, blockX0, blockY0, blockX1, blockY1, extents);
+
+    for (size_t i = 0; i < 4; i++)
+    {
+        auto& channel = result.Channels[i];
+        channel.Sum += bottomRight.Sum[i] - bottomLeft.Sum[i] - topRight.Sum[i] + topLeft.Sum[i];
+        channel.SquaredSum += bottomRight.SquaredSum[i] - bottomLeft.SquaredSum[i] - topRight.SquaredSum[i] + topLeft.SquaredSum[i];
+        channel.NonZeroCount += bottomRight.NonZeroCount[i] - bottomLeft.NonZeroCount[i] - topRight.NonZeroCount[i] + topLeft.NonZeroCount[i];
+        channel.Minimum = std::min(channel.Minimum, extents.Minimum[i]);
+        channel.Maximum = std::max(channel.Maximum, extents.Maximum[i]);
+    }
+    result.PixelCount += static_cast<uint64_t>(blockX1 - blockX0) * (blockY1 - blockY0) * BlockSize * BlockSize;
+}
+
+void RegionStatisticsTable::AccumulateExtents(uint32_t level, uint32_t nodeX, uint32_t nodeY, uint32_t blockX0, uint32_t blockY0, uint32_t blockX1, uint32_t blockY1, BlockExtents& result) const
+{
+    // Node (x, y) at a given level covers blocks [x << level, (x + 1) << level)
+    auto nodeX0 = nodeX << level;
+    auto nodeY0 = nodeY << level;
+    auto nodeX1 = std::min((nodeX + 1) << level, m_blocksWide);
+    auto nodeY1 = std::min((nodeY + 1) << level, m_blocksHigh);
+    if (nodeX1 <= blockX0 || nodeX0 >= blockX1 || nodeY1 <= blockY0 || nodeY0 >= blockY1)
+    {
+        return;
+    }
+
+    auto& extentsLevel = m_extents[level];
+    if (nodeX0 >= blockX0 && nodeX1 <= blockX1 && nodeY0 >= blockY0 && nodeY1 <= blockY1)
+    {
+        auto& extents = extentsLevel.Extents[(nodeY * extentsLevel.Width) + nodeX];
+        for (size_t i = 0; i < 4; i++)
+        {
+            result.Minimum[i] = std::min(result.Minimum[i], extents.Minimum[i]);
+            result.Maximum[i] = std::max(result.Maximum[i], extents.Maximum[i]);
+        }
+        return;
+    }
+
+    // Level 0 nodes are single blocks, which are always fully in or out
+    auto& childLevel = m_extents[level - 1];
+    for (auto childY = nodeY * 2; childY < std::min(nodeY * 2 + 2, childLevel.Height); childY++)
+    {
+        for (auto childX = nodeX * 2; childX < std::min(nodeX * 2 + 2, childLevel.Width); childX++)
+        {
+            AccumulateExtents(level - 1, childX, childY, blockX0, blockY0, blockX1, blockY1, result);
+        }
+    }
+}
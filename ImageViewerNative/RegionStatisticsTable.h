@@ -0,0 +1,85 @@
+#pragma once
+#include "PixelRect.h"
+#include "BufferPool.h"
+
+struct ChannelAccumulator
+{
+    uint64_t Sum = 0;
+    uint64_t SquaredSum = 0;
+    uint64_t NonZeroCount = 0;
+    uint8_t Minimum = 255;
+    uint8_t Maximum = 0;
+};
+
+// Channels are stored in BGRA order.
+struct RegionAccumulator
+{
+    std::array<ChannelAccumulator, 4> Channels;
+    uint64_t PixelCount = 0;
+
+    void Add(RegionAccumulator const& other);
+};
+
+// Answers per-channel sum, sum of squares, non-zero count and min/max
+// queries over arbitrary rectangles of a BGRA8 image.
+//
+// Sums are kept in summed-area tables at block granularity, and min/max
+// in a pyramid over the same blocks. Storing the tables per pixel would
+// cost ~80 bytes per pixel in 64-bit precision, which doesn't fit a
+// 100 MP image. Instead, only the partial blocks along the edges of a
+// query are read from the pixels themselves, so the cost of a query
+// depends on the perimeter of the rectangle and not its area.
+class RegionStatisticsTable
+{
+public:
+    static constexpr uint32_t BlockSize = 16;
+
+    RegionStatisticsTable(uint8_t const* bgraPixels, uint32_t width, uint32_t height, uint32_t stride);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+
+    RegionAccumulator Query(PixelRect const& rect) const;
+
+private:
+    struct BlockSums
+    {
+        std::array<uint64_t, 4> Sum;
+        std::array<uint64_t, 4> SquaredSum;
+        std::array<uint64_t, 4> NonZeroCount;
+    };
+
+    struct BlockExtents
+    {
+        std::array<uint8_t, 4> Minimum;
+        std::array<uint8_t, 4> Maximum;
+    };
+
+    struct ExtentsLevel
+    {
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+        std::vector<BlockExtents> Extents;
+    };
+
+    void BuildBlocks(std::vector<BlockExtents>& blockExtents);
+    void BuildSummedAreaTable();
+    void BuildExtentsPyramid(std::vector<BlockExtents>&& blockExtents);
+
+    void AccumulatePixels(uint32_t x, uint32_t y, uint32_t width, uint32_t height, RegionAccumulator& result) const;
+    void AccumulateBlocks(uint32_t blockX0, uint32_t blockY0, uint32_t blockX1, uint32_t blockY1, RegionAccumulator& result) const;
+    void AccumulateExtents(uint32_t level, uint32_t nodeX, uint32_t nodeY, uint32_t blockX0, uint32_t blockY0, uint32_t blockX1, uint32_t blockY1, BlockExtents& result) const;
+
+    BlockSums const& TableAt(uint32_t blockX, uint32_t blockY) const { return m_table[(blockY * (m_blocksWide + 1)) + blockX]; }
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_blocksWide = 0;
+    uint32_t m_blocksHigh = 0;
+    PooledBuffer m_pixels;
+    // (m_blocksWide + 1) x (m_blocksHigh + 1) entries, where entry (x, y)
+    // holds the totals of all whole blocks above and to the left of it.
+    std::vector<BlockSums> m_table;
+    std::vector<ExtentsLevel> m_extents;
+};
@@ -0,0 +1,342 @@
+#include "pch.h"
+#include "RmRawFrameStream.h"
+#include "SimdHelpers.h"
+#include "Profiler.h"
+
+// "rmraw\0"
+static const uint8_t Magic[] = { 'r', 'm', 'r', 'a', 'w', 0 };
+static const uint8_t FooterTag[] = { 'r', 'm', 'r', 'a', 'w', 'i', 'd', 'x' };
+static const uint32_t FrameStreamVersion = 3;
+static const uint32_t PixelFormatBgra8 = 0;
+static const uint32_t KeyFrameFlag = 1;
+static const size_t FooterSize = sizeof(uint64_t) + sizeof(FooterTag);
+static const size_t IndexEntrySize = sizeof(uint64_t) + sizeof(uint64_t) + sizeof(int64_t) + sizeof(uint32_t);
+// Unchanged runs shorter than this stay in the literal run, since a new
+// run costs 8 bytes
+static const size_t MinimumUnchangedRun = 4;
+
+static ProfileStage EncodeFrameStage("RmRawFrameStream.EncodeFrame");
+static ProfileStage DecodeFrameStage("RmRawFrameStream.DecodeFrame");
+static ProfileCounter WrittenBytesCounter("RmRawFrameStream.WrittenBytes");
+
+// The header matches the one written by DataWriter for the single image
+// versions, so its fields are big endian. Everything after it is little endian.
+static void StoreBigEndian(uint32_t value, uint8_t* data)
+{
+    data[0] = static_cast<uint8_t>(value >> 24);
+    data[1] = static_cast<uint8_t>(value >> 16);
+    data[2] = static_cast<uint8_t>(value >> 8);
+    data[3] = static_cast<uint8_t>(value);
+}
+
+static uint32_t LoadBigEndian(uint8_t const*& data)
+{
+    auto value = (static_cast<uint32_t>(data[0]) << 24) |
+        (static_cast<uint32_t>(data[1]) << 16) |
+        (static_cast<uint32_t>(data[2]) << 8) |
+        static_cast<uint32_t>(data[3]);
+    data += sizeof(value);
+    return value;
+}
+
+template <typename T>
+static T ReadValue(uint8_t const*& data)
+{
+    T value;
+    memcpy(&value, data, sizeof(value));
+    data += sizeof(value);
+    return value;
+}
+
+size_t RmRawDeltaCodec::CountUnchanged(uint32_t const* current, uint32_t const* previous, size_t count)
+{
+    size_t i = 0;
+#ifdef IMAGEVIEWER_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(current + i));
+        auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(previous + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) != 0xFFFF)
+        {
+            break;
+        }
+    }
+#endif
+    while (i < count && current[i] == previous[i])
+    {
+        i++;
+    }
+    return i;
+}
+
+void RmRawDeltaCodec::Encode(uint8_t const* current, uint8_t const* previous, size_t pixelCount, std::vector<uint8_t>& output)
+{
+    auto currentPixels = reinterpret_cast<uint32_t const*>(current);
+    auto previousPixels = reinterpret_cast<uint32_t const*>(previous);
+
+    size_t i = 0;
+    while (i < pixelCount)
+    {
+        auto unchanged = CountUnchanged(currentPixels + i, previousPixels + i, pixelCount - i);
+        auto literalBegin = i + unchanged;
+
+        // Extend the literal run until we find an unchanged run that's
+        // worth starting a new token for
+        auto literalEnd = literalBegin;
+        while (literalEnd < pixelCount)
+        {
+            if (currentPixels[literalEnd] != previousPixels[literalEnd])
+            {
+                literalEnd++;
+                continue;
+            }
+            auto run = CountUnchanged(currentPixels + literalEnd, previousPixels + literalEnd, std::min(MinimumUnchangedRun, pixelCount - literalEnd));
+            if (run == MinimumUnchangedRun || literalEnd + run == pixelCount)
+            {
+                break;
+            }
+            literalEnd += run;
+        }
+
+        auto literalCount = literalEnd - literalBegin;
+        auto offset = output.size();
+        output.resize(offset + (2 * sizeof(uint32_t)) + (literalCount * 4));
+        auto unchanged32 = static_cast<uint32_t>(unchanged);
+        auto literalCount32 = static_cast<uint32_t>(literalCount);
+        memcpy(output.data() + offset, &unchanged32, sizeof(unchanged32));
+        memcpy(output.data() + offset + sizeof(uint32_t), &literalCount32, sizeof(literalCount32));
+        memcpy(output.data() + offset + (2 * sizeof(uint32_t)), currentPixels + literalBegin, literalCount * 4);
+        i = literalEnd;
+    }
+}
+
+void RmRawDeltaCodec::Decode(uint8_t const* data, size_t size, uint8_t* pixels, size_t pixelCount)
+{
+    auto end = data + size;
+    size_t i = 0;
+    while (data < end)
+    {
+        if (static_cast<size_t>(end - data) < 2 * sizeof(uint32_t))
+        {
+            throw std::runtime_error("Truncated frame");
+        }
+        auto unchanged = ReadValue<uint32_t>(data);
+        auto literalCount = ReadValue<uint32_t>(data);
+        auto literalSize = static_cast<size_t>(literalCount) * 4;
+        if (static_cast<size_t>(unchanged) + literalCount > pixelCount - i || static_cast<size_t>(end - data) < literalSize)
+        {
+            throw std::runtime_error("Corrupt frame");
+        }
+        i += unchanged;
+        memcpy(pixels + (i * 4), data, literalSize);
+        data += literalSize;
+        i += literalCount;
+    }
+}
+
+RmRawFrameStreamWriter::RmRawFrameStreamWriter(WriteFunction write, uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0)
+    {
+        throw std::invalid_argument("The frame size must not be empty.");
+    }
+
+    m_write = std::move(write);
+    m_width = width;
+    m_height = height;
+    auto frameSize = static_cast<size_t>(width) * height * 4;
+    m_current.resize(frameSize);
+    m_previous.resize(frameSize);
+
+    std::array<uint8_t, RmRawFrameStreamReader::HeaderSize> header;
+    memcpy(header.data(), Magic, sizeof(Magic));
+    StoreBigEndian(FrameStreamVersion, header.data() + sizeof(Magic));
+    StoreBigEndian(m_width, header.data() + sizeof(Magic) + 4);
+    StoreBigEndian(m_height, header.data() + sizeof(Magic) + 8);
+    StoreBigEndian(PixelFormatBgra8, header.data() + sizeof(Magic) + 12);
+    Write(header.data(), header.size());
+}
+
+void RmRawFrameStreamWriter::WriteFrame(uint8_t const* bgraPixels, uint32_t stride, int64_t timestamp)
+{
+    if (m_finished)
+    {
+        throw std::logic_error("The stream has already been finished.");
+    }
+    ProfileScope scope(EncodeFrameStage);
+
+    auto rowSize = static_cast<size_t>(m_width) * 4;
+    for (uint32_t y = 0; y < m_height; y++)
+    {
+        memcpy(m_current.data() + (y * rowSize), bgraPixels + (static_cast<size_t>(y) * stride), rowSize);
+    }
+
+    RmRawFrameIndexEntry entry;
+    entry.Offset = m_position;
+    entry.Timestamp = timestamp;
+    if (m_index.size() % KeyFrameInterval == 0)
+    {
+        entry.Flags |= KeyFrameFlag;
+        std::fill(m_previous.begin(), m_previous.end(), static_cast<uint8_t>(0));
+    }
+
+    m_encoded.clear();
+    RmRawDeltaCodec::Encode(m_current.data(), m_previous.data(), static_cast<size_t>(m_width) * m_height, m_encoded);
+    Write(m_encoded.data(), m_encoded.size());
+    entry.Size = m_encoded.size();
+    m_index.push_back(entry);
+    WrittenBytesCounter.Add(static_cast<int64_t>(m_encoded.size()));
+
+    std::swap(m_current, m_previous);
+}
+
+void RmRawFrameStreamWriter::Finish()
+{
+    if (m_finished)
+    {
+        return;
+    }
+    m_finished = true;
+
+    auto indexOffset = m_position;
+    WriteValue(static_cast<uint32_t>(m_index.size()));
+    for (auto& entry : m_index)
+    {
+        WriteValue(entry.Offset);
+        WriteValue(entry.Size);
+        WriteValue(entry.Timestamp);
+        WriteValue(entry.Flags);
+    }
+    WriteValue(indexOffset);
+    Write(FooterTag, sizeof(FooterTag));
+}
+
+void RmRawFrameStreamWriter::Write(void const* data, size_t size)
+{
+    m_write(reinterpret_cast<uint8_t const*>(data), size);
+    m_position += size;
+}
+
+bool RmRawFrameStreamReader::IsFrameStream(uint8_t const* header, size_t size)
+{
+    if (size < HeaderSize || memcmp(header, Magic, sizeof(Magic)) != 0)
+    {
+        return false;
+    }
+    uint8_t const* versionData = header + sizeof(Magic);
+    return LoadBigEndian(versionData) == FrameStreamVersion;
+}
+
+RmRawFrameStreamReader::RmRawFrameStreamReader(ReadFunction read, uint64_t streamSize)
+{
+    m_read = std::move(read);
+    if (streamSize < HeaderSize + sizeof(uint32_t) + FooterSize)
+    {
+        throw std::runtime_error("Not an RmRaw frame stream");
+    }
+
+    std::array<uint8_t, HeaderSize> header;
+    m_read(0, header.data(), header.size());
+    if (!IsFrameStream(header.data(), header.size()))
+    {
+        throw std::runtime_error("Not an RmRaw frame stream");
+    }
+    uint8_t const* headerData = header.data() + sizeof(Magic) + sizeof(uint32_t);
+    m_width = LoadBigEndian(headerData);
+    m_height = LoadBigEndian(headerData);
+    auto format = LoadBigEndian(headerData);
+    if (format != PixelFormatBgra8 || m_width == 0 || m_height == 0)
+    {
+        throw std::runtime_error("Unsupported RmRaw frame stream");
+    }
+
+    // A stream without a footer was never finished
+    std::array<uint8_t, FooterSize> footer;
+    m_read(streamSize - FooterSize, footer.data(), footer.size());
+    if (memcmp(footer.data() + sizeof(uint64_t), FooterTag, sizeof(FooterTag)) != 0)
+    {
+        throw std::runtime_error("The RmRaw frame stream is missing its index");
+    }
+    uint8_t const* footerData = footer.data();
+    auto indexOffset = ReadValue<uint64_t>(footerData);
+    if (indexOffset < HeaderSize || indexOffset > streamSize - FooterSize - sizeof(uint32_t))
+    {
+        throw std::runtime_error("Corrupt RmRaw frame stream index");
+    }
+
+    uint32_t frameCount = 0;
+    m_read(indexOffset, reinterpret_cast<uint8_t*>(&frameCount), sizeof(frameCount));
+    auto indexSize = static_cast<uint64_t>(frameCount) * IndexEntrySize;
+    if (indexSize > streamSize - FooterSize - indexOffset - sizeof(uint32_t))
+    {
+        throw std::runtime_error("Corrupt RmRaw frame stream index");
+    }
+
+    std::vector<uint8_t> index(static_cast<size_t>(indexSize));
+    m_read(indexOffset + sizeof(uint32_t), index.data(), index.size());
+    uint8_t const* indexData = index.data();
+    m_index.resize(frameCount);
+    for (auto& entry : m_index)
+    {
+        entry.Offset = ReadValue<uint64_t>(indexData);
+        entry.Size = ReadValue<uint64_t>(indexData);
+        entry.Timestamp = ReadValue<int64_t>(indexData);
+        entry.Flags = ReadValue<uint32_t>(indexData);
+        if (entry.Offset < HeaderSize || entry.Offset > indexOffset || entry.Size > indexOffset - entry.Offset)
+        {
+            throw std::runtime_error("Corrupt RmRaw frame stream index");
+        }
+    }
+    if (!m_index.empty() && (m_index[0].Flags & KeyFrameFlag) == 0)
+    {
+        throw std::runtime_error("The first frame must be a key frame");
+    }
+
+    m_pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+}
+
+std::vector<uint8_t> const& RmRawFrameStreamReader::DecodeFrame(uint32_t index)
+{
+    if (index >= m_index.size())
+    {
+        throw std::out_of_range("index");
+    }
+    if (m_decodedIndex == index)
+    {
+        return m_pixels;
+    }
+    ProfileScope scope(DecodeFrameStage);
+
+    uint32_t start = index;
+    if (m_decodedIndex >= 0 && m_decodedIndex < index)
+    {
+        start = static_cast<uint32_t>(m_decodedIndex + 1);
+    }
+    // Don't replay more frames than we need to
+    auto keyFrame = index;
+    while ((m_index[keyFrame].Flags & KeyFrameFlag) == 0)
+    {
+        keyFrame--;
+    }
+    if (keyFrame > start || m_decodedIndex < 0 || m_decodedIndex > index)
+    {
+        start = keyFrame;
+    }
+
+    auto pixelCount = static_cast<size_t>(m_width) * m_height;
+    for (auto i = start; i <= index; i++)
+    {
+        auto& entry = m_index[i];
+        if (entry.Flags & KeyFrameFlag)
+        {
+            std::fill(m_pixels.begin(), m_pixels.end(), static_cast<uint8_t>(0));
+        }
+        m_payload.resize(static_cast<size_t>(entry.Size));
+        m_read(entry.Offset, m_payload.data(), m_payload.size());
+        // Leave the reader in a state that forces a restart if this throws
+        m_decodedIndex = -1;
+        RmRawDeltaCodec::Decode(m_payload.data(), m_payload.size(), m_pixels.data(), pixelCount);
+        m_decodedIndex = i;
+    }
+    return m_pixels;
+}
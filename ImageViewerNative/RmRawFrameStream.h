@@ -0,0 +1,103 @@
+#pragma once
+
+// The multi-frame variant of the RmRaw format (version 3), used to
+// record captures losslessly:
+//
+//   header: "rmraw\0", u32 version (3), u32 width, u32 height,
+//           u32 pixel format (always BGRA8), 22 bytes in all
+//   frames: encoded frames, back to back
+//   index:  u32 frame count, then for each frame u64 offset, u64 size,
+//           i64 timestamp (100ns units) and u32 flags
+//   footer: u64 offset of the index, "rmrawidx"
+//
+// The header's values are big-endian, like the single image versions
+// written by DataWriter. Everything after it, the frames, the index and
+// the footer, is little-endian.
+//
+// Each frame is a series of tokens: a u32 count of pixels that didn't
+// change since the previous frame, then a u32 count of literal pixels
+// followed by those BGRA8 pixels. Key frames are encoded against a black
+// frame so that decoding can start from any of them.
+struct RmRawFrameIndexEntry
+{
+    uint64_t Offset = 0;
+    uint64_t Size = 0;
+    int64_t Timestamp = 0;
+    uint32_t Flags = 0;
+};
+
+class RmRawDeltaCodec
+{
+public:
+    // Appends the encoded frame to output.
+    static void Encode(uint8_t const* current, uint8_t const* previous, size_t pixelCount, std::vector<uint8_t>& output);
+    // Applies an encoded frame to the previous frame's pixels in place.
+    static void Decode(uint8_t const* data, size_t size, uint8_t* pixels, size_t pixelCount);
+
+private:
+    static size_t CountUnchanged(uint32_t const* current, uint32_t const* previous, size_t count);
+};
+
+class RmRawFrameStreamWriter
+{
+public:
+    using WriteFunction = std::function<void(uint8_t const* data, size_t size)>;
+
+    static constexpr uint32_t KeyFrameInterval = 60;
+
+    RmRawFrameStreamWriter(WriteFunction write, uint32_t width, uint32_t height);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t FrameCount() const { return static_cast<uint32_t>(m_index.size()); }
+
+    void WriteFrame(uint8_t const* bgraPixels, uint32_t stride, int64_t timestamp);
+    // Writes the index and footer. No frames can be written afterwards.
+    void Finish();
+
+private:
+    void Write(void const* data, size_t size);
+    template <typename T>
+    void WriteValue(T value) { Write(&value, sizeof(value)); }
+
+private:
+    WriteFunction m_write;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint64_t m_position = 0;
+    bool m_finished = false;
+    std::vector<uint8_t> m_current;
+    std::vector<uint8_t> m_previous;
+    std::vector<uint8_t> m_encoded;
+    std::vector<RmRawFrameIndexEntry> m_index;
+};
+
+class RmRawFrameStreamReader
+{
+public:
+    using ReadFunction = std::function<void(uint64_t offset, uint8_t* data, size_t size)>;
+
+    static constexpr size_t HeaderSize = 22;
+    static bool IsFrameStream(uint8_t const* header, size_t size);
+
+    RmRawFrameStreamReader(ReadFunction read, uint64_t streamSize);
+
+    uint32_t Width() const { return m_width; }
+    uint32_t Height() const { return m_height; }
+    uint32_t FrameCount() const { return static_cast<uint32_t>(m_index.size()); }
+    RmRawFrameIndexEntry const& Entry(uint32_t index) const { return m_index.at(index); }
+
+    // Returns tightly packed BGRA8 pixels. Decoding picks up from the
+    // last decoded frame when reading forwards, otherwise it restarts
+    // from the closest key frame before the requested one.
+    std::vector<uint8_t> const& DecodeFrame(uint32_t index);
+
+private:
+    ReadFunction m_read;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    std::vector<RmRawFrameIndexEntry> m_index;
+    std::vector<uint8_t> m_pixels;
+    std::vector<uint8_t> m_payload;
+    int64_t m_decodedIndex = -1;
+};
@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "RmRawFrameStreamFile.h"
+#include "RmRawFrameStreamFile.g.cpp"
+#include "VideoFrameArgs.h"
+#include "StreamInterop.h"
+#include "FrameExtractionInterop.h"
+#include "BufferPool.h"
+#include "Profiler.h"
+
+namespace winrt
+{
+    using namespace Windows::Foundation;
+    using namespace Windows::Graphics;
+    using namespace Windows::Graphics::DirectX::Direct3D11;
+    using namespace Windows::Storage::Streams;
+}
+
+namespace util
+{
+    using namespace robmikh::common::uwp;
+}
+
+static ProfileStage UploadStage("RmRawFrameStreamFile.Upload");
+static ProfileStage CallbackStage("RmRawFrameStreamFile.Callback");
+
+namespace winrt::ImageViewerNative::implementation
+{
+    RmRawFrameStreamFile::RmRawFrameStreamFile(winrt::IRandomAccessStream const& stream)
+    {
+        m_stream = CreateStreamOverRandomAccessStream(stream);
+        auto rawStream = m_stream.get();
+        m_reader = std::make_unique<RmRawFrameStreamReader>([rawStream](uint64_t offset, uint8_t* data, size_t size)
+        {
+            ReadFromStream(rawStream, offset, data, size);
+        }, stream.Size());
+    }
+
+    winrt::SizeInt32 RmRawFrameStreamFile::Size()
+    {
+        return { static_cast<int32_t>(m_reader->Width()), static_cast<int32_t>(m_reader->Height()) };
+    }
+
+    winrt::TimeSpan RmRawFrameStreamFile::GetFrameTimestamp(uint32_t index)
+    {
+        if (index >= m_reader->FrameCount())
+        {
+            throw winrt::hresult_out_of_bounds();
+        }
+        return winrt::TimeSpan{ m_reader->Entry(index).Timestamp };
+    }
+
+    winrt::com_array<uint8_t> RmRawFrameStreamFile::DecodeFrame(uint32_t index)
+    {
+        if (index >= m_reader->FrameCount())
+        {
+            throw winrt::hresult_out_of_bounds();
+        }
+        auto& pixels = m_reader->DecodeFrame(index);
+        return winrt::com_array<uint8_t>(pixels.begin(), pixels.end());
+    }
+
+    void RmRawFrameStreamFile::ExtractFrames(
+        winrt::IDirect3DDevice const& device,
+        winrt::EventHandler<winrt::ImageViewerNative::VideoFrameArgs> const& callback)
+    {
+        ExtractFrames(device, winrt::ImageViewerNative::FrameExtractionOptions{}, callback);
+    }
+
+    void RmRawFrameStreamFile::ExtractFrames(
+        winrt::IDirect3DDevice const& device,
+        winrt::ImageViewerNative::FrameExtractionOptions const& options,
+        winrt::EventHandler<winrt::ImageViewerNative::VideoFrameArgs> const& callback)
+    {
+        auto region = ResolveFrameExtractionOptions(options, m_reader->Width(), m_reader->Height());
+        auto fullFrame = region.IsFullFrame(m_reader->Width(), m_reader->Height());
+        auto filter = ToResampleFilter(options.Filter);
+
+        auto d3dDevice = GetDXGIInterfaceFromObject<ID3D11Device>(device);
+        auto multithread = d3dDevice.as<ID3D11Multithread>();
+        winrt::com_ptr<ID3D11DeviceContext> d3dContext;
+        d3dDevice->GetImmediateContext(d3dContext.put());
+
+        // Like the video extractor, every frame is delivered in the same
+        // texture and it's up to the callback to copy it
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = region.OutputWidth;
+        desc.Height = region.OutputHeight;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        winrt::com_ptr<ID3D11Texture2D> texture;
+        winrt::check_hresult(d3dDevice->CreateTexture2D(&desc, nullptr, texture.put()));
+        auto args = winrt::make_self<implementation::VideoFrameArgs>(texture);
+
+        // Frames are decoded on the CPU anyway, so they are scaled there
+        // too, before they are uploaded
+        PooledBuffer scaledPixels;
+        if (!fullFrame)
+        {
+            scaledPixels = BufferPool::Shared().Acquire(static_cast<size_t>(desc.Width) * desc.Height * 4);
+        }
+
+        for (uint32_t i = 0; i < m_reader->FrameCount(); i++)
+        {
+            auto& pixels = m_reader->DecodeFrame(i);
+            auto upload = pixels.data();
+            if (!fullFrame)
+            {
+                ImageResampler::Resample(pixels.data(), m_reader->Width() * 4, region.SourceRect, scaledPixels.Data(), desc.Width, desc.Height, desc.Width * 4, filter);
+                upload = scaledPixels.Data();
+            }
+            {
+                ProfileScope scope(UploadStage);
+                auto lock = util::D3D11DeviceLock(multithread.get());
+                d3dContext->UpdateSubresource(texture.get(), 0, nullptr, upload, desc.Width * 4, 0);
+            }
+
+            args->Reset(m_reader->Entry(i).Timestamp, i);
+            ProfileScope scope(CallbackStage);
+            callback(nullptr, args.as<winrt::ImageViewerNative::VideoFrameArgs>());
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "RmRawFrameStreamFile.g.h"
+#include "RmRawFrameStream.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct RmRawFrameStreamFile : RmRawFrameStreamFileT<RmRawFrameStreamFile>
+    {
+        RmRawFrameStreamFile(winrt::Windows::Storage::Streams::IRandomAccessStream const& stream);
+
+        winrt::Windows::Graphics::SizeInt32 Size();
+        uint32_t FrameCount() { return m_reader->FrameCount(); }
+        winrt::Windows::Foundation::TimeSpan GetFrameTimestamp(uint32_t index);
+        winrt::com_array<uint8_t> DecodeFrame(uint32_t index);
+        void ExtractFrames(
+            winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device,
+            winrt::Windows::Foundation::EventHandler<winrt::ImageViewerNative::VideoFrameArgs> const& callback);
+        void ExtractFrames(
+            winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device,
+            winrt::ImageViewerNative::FrameExtractionOptions const& options,
+            winrt::Windows::Foundation::EventHandler<winrt::ImageViewerNative::VideoFrameArgs> const& callback);
+
+    private:
+        winrt::com_ptr<IStream> m_stream;
+        std::unique_ptr<RmRawFrameStreamReader> m_reader;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct RmRawFrameStreamFile : RmRawFrameStreamFileT<RmRawFrameStreamFile, implementation::RmRawFrameStreamFile>
+    {
+    };
+}
@@ -0,0 +1,37 @@
+#include "pch.h"
+#include "ScopeAnalyzer.h"
+#include "ScopeAnalyzer.g.cpp"
+#include "VideoScopes.h"
+
+namespace winrt
+{
+    using namespace Windows::Graphics;
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    ScopeAnalyzer::ScopeAnalyzer(winrt::SizeInt32 const& size, uint32_t sampleStep)
+    {
+        if (size.Width <= 0 || size.Height <= 0)
+        {
+            throw winrt::hresult_invalid_argument(L"The frame size must not be empty.");
+        }
+        if (sampleStep == 0)
+        {
+            throw winrt::hresult_invalid_argument(L"The sample step must be at least 1.");
+        }
+
+        m_size = size;
+        m_analyzer = std::make_unique<BackgroundScopeAnalyzer>(static_cast<uint32_t>(size.Width), static_cast<uint32_t>(size.Height), sampleStep);
+    }
+
+    winrt::ImageViewerNative::VideoScopes ScopeAnalyzer::TryGetLatest()
+    {
+        auto scopes = m_analyzer->Latest();
+        if (scopes == nullptr)
+        {
+            return nullptr;
+        }
+        return winrt::make<VideoScopes>(std::move(scopes));
+    }
+}
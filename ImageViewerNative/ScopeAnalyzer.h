@@ -0,0 +1,30 @@
+#pragma once
+#include "ScopeAnalyzer.g.h"
+#include "BackgroundScopeAnalyzer.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct ScopeAnalyzer : ScopeAnalyzerT<ScopeAnalyzer>
+    {
+        ScopeAnalyzer(winrt::Windows::Graphics::SizeInt32 const& size, uint32_t sampleStep);
+
+        winrt::Windows::Graphics::SizeInt32 Size() { return m_size; }
+        uint32_t SampleStep() { return m_analyzer->SampleStep(); }
+        uint64_t AnalyzedFrameCount() { return m_analyzer->AnalyzedFrameCount(); }
+        uint64_t SkippedFrameCount() { return m_analyzer->SkippedFrameCount(); }
+        winrt::ImageViewerNative::VideoScopes TryGetLatest();
+
+        // Called on the capture thread with the frame mapped. Only copies.
+        bool TryEnqueue(uint8_t const* bgraPixels, uint32_t stride) { return m_analyzer->TryEnqueue(bgraPixels, stride); }
+
+    private:
+        winrt::Windows::Graphics::SizeInt32 m_size = {};
+        std::unique_ptr<BackgroundScopeAnalyzer> m_analyzer;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct ScopeAnalyzer : ScopeAnalyzerT<ScopeAnalyzer, implementation::ScopeAnalyzer>
+    {
+    };
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// SSE2 is the baseline for x86 and x64. Other architectures (ARM, ARM64)
+// fall back to the scalar paths, which IMAGEVIEWER_NO_SIMD forces so that
+// they can be tested anywhere.
+#if !defined(IMAGEVIEWER_NO_SIMD) && (defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__))
+#define IMAGEVIEWER_SSE2 1
+#include <emmintrin.h>
+#endif
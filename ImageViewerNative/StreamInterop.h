@@ -0,0 +1,46 @@
+#pragma once
+
+// IRandomAccessStream -> IStream, for synchronous reads and writes off
+// the UI thread.
+inline winrt::com_ptr<IStream> CreateStreamOverRandomAccessStream(winrt::Windows::Storage::Streams::IRandomAccessStream const& stream)
+{
+    auto streamUnknown = stream.as<::IUnknown>();
+    winrt::com_ptr<IStream> istream;
+    winrt::check_hresult(::CreateStreamOverRandomAccessStream(streamUnknown.get(), winrt::guid_of<IStream>(), istream.put_void()));
+    return istream;
+}
+
+inline void WriteToStream(IStream* stream, uint8_t const* data, size_t size)
+{
+    while (size > 0)
+    {
+        auto chunkSize = static_cast<ULONG>(std::min<size_t>(size, 1u << 30));
+        ULONG written = 0;
+        winrt::check_hresult(stream->Write(data, chunkSize, &written));
+        if (written == 0)
+        {
+            throw winrt::hresult_error(STG_E_MEDIUMFULL);
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+inline void ReadFromStream(IStream* stream, uint64_t offset, uint8_t* data, size_t size)
+{
+    LARGE_INTEGER position = {};
+    position.QuadPart = static_cast<LONGLONG>(offset);
+    winrt::check_hresult(stream->Seek(position, STREAM_SEEK_SET, nullptr));
+    while (size > 0)
+    {
+        auto chunkSize = static_cast<ULONG>(std::min<size_t>(size, 1u << 30));
+        ULONG read = 0;
+        winrt::check_hresult(stream->Read(data, chunkSize, &read));
+        if (read == 0)
+        {
+            throw winrt::hresult_error(HRESULT_FROM_WIN32(ERROR_HANDLE_EOF));
+        }
+        data += read;
+        size -= read;
+    }
+}
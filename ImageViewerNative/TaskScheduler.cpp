@@ -0,0 +1,233 @@
+#include "pch.h"
+#include "TaskScheduler.h"
+
+static thread_local TaskScheduler const* t_currentScheduler = nullptr;
+static thread_local int32_t t_currentWorkerIndex = -1;
+static std::atomic<TaskScheduler*> s_defaultOverride = nullptr;
+
+TaskScheduler& TaskScheduler::Default()
+{
+    if (auto overridden = s_defaultOverride.load())
+    {
+        return *overridden;
+    }
+
+    // Never destroyed, joining the workers while the DLL unloads would
+    // deadlock on the loader lock
+    static auto scheduler = new TaskScheduler(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return *scheduler;
+}
+
+void TaskScheduler::OverrideDefault(TaskScheduler* scheduler)
+{
+    s_defaultOverride = scheduler;
+}
+
+TaskScheduler::TaskScheduler(uint32_t workerCount)
+{
+    for (uint32_t i = 0; i < workerCount + 1; i++)
+    {
+        m_queues.push_back(std::make_unique<TaskQueue>());
+    }
+    m_threads.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        m_threads.emplace_back([this, i]()
+        {
+            WorkerLoop(i);
+        });
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard lock(m_sleepLock);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+int32_t TaskScheduler::CurrentWorkerIndex() const
+{
+    return t_currentScheduler == this ? t_currentWorkerIndex : -1;
+}
+
+void TaskScheduler::Submit(Task task, TaskPriority priority)
+{
+    auto workerIndex = CurrentWorkerIndex();
+    auto& queue = workerIndex >= 0 ? *m_queues[workerIndex] : *m_queues.back();
+    {
+        std::lock_guard lock(queue.Lock);
+        queue.Tasks[static_cast<size_t>(priority)].push_back(std::move(task));
+    }
+    {
+        // Counted under the lock so a worker can't miss it between
+        // checking the count and going to sleep
+        std::lock_guard lock(m_sleepLock);
+        m_pendingCount++;
+    }
+    m_wake.notify_one();
+}
+
+bool TaskScheduler::TryRunPendingTask(TaskPriority lowestPriority)
+{
+    Task task;
+    if (TryTakeTask(task, lowestPriority))
+    {
+        task();
+        return true;
+    }
+    return false;
+}
+
+bool TaskScheduler::TryTakeTask(Task& task, TaskPriority lowestPriority)
+{
+    if (m_pendingCount.load() == 0)
+    {
+        return false;
+    }
+
+    auto workerIndex = CurrentWorkerIndex();
+    auto sharedIndex = m_queues.size() - 1;
+    for (size_t priority = 0; priority <= static_cast<size_t>(lowestPriority); priority++)
+    {
+        // Our own newest task first, since its data is most likely to
+        // still be in cache
+        if (workerIndex >= 0)
+        {
+            auto& queue = *m_queues[workerIndex];
+            std::lock_guard lock(queue.Lock);
+            auto& tasks = queue.Tasks[priority];
+            if (!tasks.empty())
+            {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+                m_pendingCount--;
+                return true;
+            }
+        }
+
+        // Then the shared queue, then the oldest task of the other
+        // workers, starting with our neighbor
+        auto firstVictim = workerIndex >= 0 ? static_cast<size_t>(workerIndex) + 1 : sharedIndex;
+        for (size_t i = 0; i < m_queues.size(); i++)
+        {
+            auto victim = (firstVictim + i) % m_queues.size();
+            if (static_cast<int32_t>(victim) == workerIndex)
+            {
+                continue;
+            }
+            auto& queue = *m_queues[victim];
+            std::lock_guard lock(queue.Lock);
+            auto& tasks = queue.Tasks[priority];
+            if (!tasks.empty())
+            {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+                m_pendingCount--;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::WorkerLoop(uint32_t workerIndex)
+{
+    t_currentScheduler = this;
+    t_currentWorkerIndex = static_cast<int32_t>(workerIndex);
+    while (true)
+    {
+        if (TryRunPendingTask())
+        {
+            continue;
+        }
+
+        std::unique_lock lock(m_sleepLock);
+        m_wake.wait(lock, [this]() { return m_stopping || m_pendingCount.load() > 0; });
+        if (m_stopping)
+        {
+            return;
+        }
+    }
+}
+
+TaskGroup::TaskGroup(TaskScheduler& scheduler, TaskPriority priority, CancellationToken const* cancellation) : m_scheduler(scheduler)
+{
+    m_priority = priority;
+    if (cancellation != nullptr)
+    {
+        m_cancellation = *cancellation;
+    }
+    m_state = std::make_shared<State>();
+}
+
+TaskGroup::~TaskGroup()
+{
+    WaitForTasks();
+}
+
+void TaskGroup::Run(TaskScheduler::Task task)
+{
+    m_state->RemainingCount++;
+    m_scheduler.Submit([state = m_state, cancellation = m_cancellation, task = std::move(task)]()
+    {
+        auto canceled = cancellation.has_value() && cancellation->IsCancellationRequested();
+        if (!canceled && !state->Failed.load())
+        {
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                std::lock_guard lock(state->Lock);
+                if (!state->Error)
+                {
+                    state->Error = std::current_exception();
+                }
+                state->Failed = true;
+            }
+        }
+
+        if (--state->RemainingCount == 0)
+        {
+            std::lock_guard lock(state->Lock);
+            state->Done.notify_all();
+        }
+    }, m_priority);
+}
+
+void TaskGroup::WaitForTasks()
+{
+    while (m_state->RemainingCount.load() > 0)
+    {
+        if (m_scheduler.TryRunPendingTask(m_priority))
+        {
+            continue;
+        }
+
+        // Nothing at the group's priority is queued, so whatever is left
+        // of the group is already running on other threads
+        std::unique_lock lock(m_state->Lock);
+        m_state->Done.wait(lock, [this]() { return m_state->RemainingCount.load() == 0; });
+    }
+}
+
+void TaskGroup::Wait()
+{
+    WaitForTasks();
+    if (m_state->Error)
+    {
+        std::rethrow_exception(m_state->Error);
+    }
+    if (m_cancellation.has_value() && m_cancellation->IsCancellationRequested())
+    {
+        throw TaskCanceledError();
+    }
+}
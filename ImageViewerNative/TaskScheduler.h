@@ -0,0 +1,121 @@
+#pragma once
+
+// Pending tasks are always taken highest priority first, from any queue.
+enum class TaskPriority : uint32_t
+{
+    // Work the user is waiting on, like probes and measurements
+    Interactive = 0,
+    // Work for what's on screen
+    Visible = 1,
+    // Prefetching, encoding and anything else nobody is watching
+    Background = 2,
+};
+
+class TaskCanceledError : public std::runtime_error
+{
+public:
+    TaskCanceledError() : std::runtime_error("The operation was canceled.") {}
+};
+
+// Copies share the same state, so the copy held by the work sees the
+// caller's Cancel. Cancellation is cooperative: tasks that haven't
+// started are skipped, running ones can check IsCancellationRequested.
+class CancellationToken
+{
+public:
+    CancellationToken() : m_canceled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void Cancel() { m_canceled->store(true); }
+    bool IsCancellationRequested() const { return m_canceled->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_canceled;
+};
+
+// A work-stealing pool shared by every native kernel, so that kernels
+// running at the same time split the cores instead of each starting a
+// thread per core. Each worker pushes and pops its own tasks at the back
+// of its deques and steals from the front of the others'. Tasks from
+// other threads go into a shared queue.
+class TaskScheduler
+{
+public:
+    using Task = std::function<void()>;
+
+    static TaskScheduler& Default();
+    // Makes Default return the given scheduler until called again with
+    // null, so that benchmarks can measure the kernels on fewer cores.
+    // Nothing else may be using Default while it changes.
+    static void OverrideDefault(TaskScheduler* scheduler);
+
+    // Threads that wait on a TaskGroup run tasks too, so the default
+    // scheduler has one worker less than there are cores.
+    explicit TaskScheduler(uint32_t workerCount);
+    ~TaskScheduler();
+
+    uint32_t WorkerCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+    void Submit(Task task, TaskPriority priority);
+    // Runs the highest priority pending task on the calling thread,
+    // leaving any below lowestPriority queued. Returns false if there was
+    // nothing to run.
+    bool TryRunPendingTask(TaskPriority lowestPriority = TaskPriority::Background);
+
+private:
+    static constexpr size_t PriorityCount = 3;
+
+    struct TaskQueue
+    {
+        std::mutex Lock;
+        std::array<std::deque<Task>, PriorityCount> Tasks;
+    };
+
+    void WorkerLoop(uint32_t workerIndex);
+    bool TryTakeTask(Task& task, TaskPriority lowestPriority);
+    int32_t CurrentWorkerIndex() const;
+
+private:
+    // One per worker, then the shared queue
+    std::vector<std::unique_ptr<TaskQueue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<uint64_t> m_pendingCount = 0;
+    std::mutex m_sleepLock;
+    std::condition_variable m_wake;
+    bool m_stopping = false;
+};
+
+// Runs tasks on a scheduler and waits for all of them. The first
+// exception thrown by a task is rethrown by Wait, and the remaining tasks
+// are skipped.
+class TaskGroup
+{
+public:
+    TaskGroup(TaskScheduler& scheduler, TaskPriority priority, CancellationToken const* cancellation = nullptr);
+    // Waits, but doesn't rethrow
+    ~TaskGroup();
+
+    void Run(TaskScheduler::Task task);
+    // Runs pending tasks on this thread until the group is done. Only
+    // tasks at the group's priority or higher are run, so an interactive
+    // wait doesn't end up running a long background task. Throws
+    // TaskCanceledError if the group was canceled.
+    void Wait();
+
+private:
+    struct State
+    {
+        std::atomic<uint32_t> RemainingCount = 0;
+        std::atomic<bool> Failed = false;
+        std::mutex Lock;
+        std::condition_variable Done;
+        std::exception_ptr Error;
+    };
+
+    void WaitForTasks();
+
+private:
+    TaskScheduler& m_scheduler;
+    TaskPriority m_priority = TaskPriority::Visible;
+    std::optional<CancellationToken> m_cancellation;
+    std::shared_ptr<State> m_state;
+};
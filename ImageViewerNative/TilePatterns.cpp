@@ -0,0 +1,35 @@
+#include "pch.h"
+#include "TilePatterns.h"
+
+void RasterizeCheckerboard(PixelRect const& bounds, uint32_t cellSize, uint32_t lightColor, uint32_t darkColor, uint8_t* dest, uint32_t stride)
+{
+    cellSize = std::max(cellSize, 1u);
+    for (uint32_t y = 0; y < bounds.Height; y++)
+    {
+        auto row = reinterpret_cast<uint32_t*>(dest + (static_cast<size_t>(y) * stride));
+        auto cellY = (bounds.Y + y) / cellSize;
+        for (uint32_t x = 0; x < bounds.Width; x++)
+        {
+            auto cellX = (bounds.X + x) / cellSize;
+            row[x] = ((cellX + cellY) % 2) == 0 ? lightColor : darkColor;
+        }
+    }
+}
+
+void RasterizeGridLines(PixelRect const& bounds, uint32_t spacing, uint32_t lineColor, uint8_t* dest, uint32_t stride)
+{
+    spacing = std::max(spacing, 1u);
+    for (uint32_t y = 0; y < bounds.Height; y++)
+    {
+        auto row = reinterpret_cast<uint32_t*>(dest + (static_cast<size_t>(y) * stride));
+        if (((bounds.Y + y) % spacing) == spacing - 1)
+        {
+            std::fill(row, row + bounds.Width, lineColor);
+            continue;
+        }
+        for (uint32_t x = 0; x < bounds.Width; x++)
+        {
+            row[x] = ((bounds.X + x) % spacing) == spacing - 1 ? lineColor : 0;
+        }
+    }
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "PixelRect.h"
+
+// Procedural BGRA8 (premultiplied) patterns, rasterized one tile at a
+// time in surface coordinates so that adjacent tiles line up.
+void RasterizeCheckerboard(PixelRect const& bounds, uint32_t cellSize, uint32_t lightColor, uint32_t darkColor, uint8_t* dest, uint32_t stride);
+void RasterizeGridLines(PixelRect const& bounds, uint32_t spacing, uint32_t lineColor, uint8_t* dest, uint32_t stride);
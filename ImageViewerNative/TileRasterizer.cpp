@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "TileRasterizer.h"
+#include "TileRasterizer.g.cpp"
+#include "PixelRectInterop.h"
+#include "TilePatterns.h"
+
+namespace winrt
+{
+    using namespace Windows::Graphics;
+    using namespace Windows::UI;
+}
+
+static uint32_t ToPremultipliedBgra(winrt::Color const& color)
+{
+    auto premultiply = [&color](uint8_t value)
+    {
+        return static_cast<uint32_t>(((value * color.A) + 127) / 255);
+    };
+    return (static_cast<uint32_t>(color.A) << 24) | (premultiply(color.R) << 16) | (premultiply(color.G) << 8) | premultiply(color.B);
+}
+
+static void CheckTileBuffer(PixelRect const& bounds, winrt::array_view<uint8_t> const& pixels)
+{
+    if (static_cast<uint64_t>(bounds.Width) * bounds.Height * 4 > pixels.size())
+    {
+        throw winrt::hresult_invalid_argument(L"The buffer is too small for the bounds.");
+    }
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    void TileRasterizer::RasterizeCheckerboard(winrt::RectInt32 const& bounds, int32_t cellSize, winrt::Color const& lightColor, winrt::Color const& darkColor, winrt::array_view<uint8_t> pixels)
+    {
+        auto pixelBounds = ToPixelRect(bounds);
+        CheckTileBuffer(pixelBounds, pixels);
+        ::RasterizeCheckerboard(pixelBounds, static_cast<uint32_t>(std::max(cellSize, 1)), ToPremultipliedBgra(lightColor), ToPremultipliedBgra(darkColor), pixels.data(), pixelBounds.Width * 4);
+    }
+
+    void TileRasterizer::RasterizeGridLines(winrt::RectInt32 const& bounds, int32_t spacing, winrt::Color const& lineColor, winrt::array_view<uint8_t> pixels)
+    {
+        auto pixelBounds = ToPixelRect(bounds);
+        CheckTileBuffer(pixelBounds, pixels);
+        ::RasterizeGridLines(pixelBounds, static_cast<uint32_t>(std::max(spacing, 1)), ToPremultipliedBgra(lineColor), pixels.data(), pixelBounds.Width * 4);
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "TileRasterizer.g.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct TileRasterizer
+    {
+        TileRasterizer() = default;
+
+        static void RasterizeCheckerboard(winrt::Windows::Graphics::RectInt32 const& bounds, int32_t cellSize, winrt::Windows::UI::Color const& lightColor, winrt::Windows::UI::Color const& darkColor, winrt::array_view<uint8_t> pixels);
+        static void RasterizeGridLines(winrt::Windows::Graphics::RectInt32 const& bounds, int32_t spacing, winrt::Windows::UI::Color const& lineColor, winrt::array_view<uint8_t> pixels);
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct TileRasterizer : TileRasterizerT<TileRasterizer, implementation::TileRasterizer>
+    {
+    };
+}
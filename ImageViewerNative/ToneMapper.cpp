@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "ToneMapper.h"
+#include "HalfFloat.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "SimdHelpers.h"
+
+static ProfileStage ToneMapStage("ToneMapper.ToneMap");
+
+// Entries in the linear to sRGB table. Fine enough that the steepest part
+// of the curve, near black, moves less than a level between entries.
+static const uint32_t EncodeTableSize = 16384;
+// Pixels decoded from half floats at a time
+static const size_t ChunkPixels = 1024;
+// Pixels per band handed to the scheduler
+static const size_t BandPixels = 64 * 1024;
+
+static std::array<uint8_t, EncodeTableSize> const& EncodeTable()
+{
+    static auto const table = []()
+    {
+        std::array<uint8_t, EncodeTableSize> values = {};
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            auto linear = static_cast<double>(i) / (EncodeTableSize - 1);
+            auto encoded = linear <= 0.0031308 ? linear * 12.92 : (1.055 * std::pow(linear, 1.0 / 2.4)) - 0.055;
+            values[i] = static_cast<uint8_t>(std::lround(std::clamp(encoded, 0.0, 1.0) * 255.0));
+        }
+        return values;
+    }();
+    return table;
+}
+
+static uint32_t Premultiply(uint8_t encoded, int32_t alpha)
+{
+    if (alpha == 255)
+    {
+        return encoded;
+    }
+    return static_cast<uint32_t>(((encoded * alpha) + 127) / 255);
+}
+
+#ifndef IMAGEVIEWER_SSE2
+// The comparisons are written so that NaNs end up where _mm_max_ps and
+// _mm_min_ps put them in the vectorized version
+static int32_t MapChannel(float value, float factor, ToneMapOperator op)
+{
+    value *= factor;
+    value = value > 0.0f ? value : 0.0f;
+    if (op == ToneMapOperator::Filmic)
+    {
+        value = (value * ((2.51f * value) + 0.03f)) / ((value * ((2.43f * value) + 0.59f)) + 0.14f);
+    }
+    value = value < 1.0f ? value : 1.0f;
+    return static_cast<int32_t>((value * (EncodeTableSize - 1)) + 0.5f);
+}
+#endif
+
+// The table indices of the colors and the alpha bytes of four RGBA pixels,
+// stored as RRRR GGGG BBBB AAAA
+static void MapPixels(float const* rgba, float scale, ToneMapOperator op, int32_t* indices)
+{
+#ifdef IMAGEVIEWER_SSE2
+    auto zero = _mm_setzero_ps();
+    auto one = _mm_set1_ps(1.0f);
+    auto half = _mm_set1_ps(0.5f);
+    auto tableRange = _mm_set1_ps(EncodeTableSize - 1);
+    __m128 channels[4] =
+    {
+        _mm_loadu_ps(rgba),
+        _mm_loadu_ps(rgba + 4),
+        _mm_loadu_ps(rgba + 8),
+        _mm_loadu_ps(rgba + 12),
+    };
+    _MM_TRANSPOSE4_PS(channels[0], channels[1], channels[2], channels[3]);
+
+    // Unpremultiplying and the exposure are one multiply
+    auto alpha = _mm_min_ps(_mm_max_ps(channels[3], zero), one);
+    auto factor = _mm_div_ps(_mm_set1_ps(scale), alpha);
+    for (size_t c = 0; c < 3; c++)
+    {
+        auto value = _mm_max_ps(_mm_mul_ps(channels[c], factor), zero);
+        if (op == ToneMapOperator::Filmic)
+        {
+            auto numerator = _mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(2.51f)), _mm_set1_ps(0.03f)));
+            auto denominator = _mm_add_ps(_mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(2.43f)), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+            value = _mm_div_ps(numerator, denominator);
+        }
+        value = _mm_min_ps(value, one);
+        auto rounded = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, tableRange), half));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + (c * 4)), rounded);
+    }
+    auto alphaBytes = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(alpha, _mm_set1_ps(255.0f)), half));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + 12), alphaBytes);
+#else
+    for (size_t i = 0; i < 4; i++)
+    {
+        auto pixel = rgba + (i * 4);
+        auto alpha = pixel[3] > 0.0f ? pixel[3] : 0.0f;
+        alpha = alpha < 1.0f ? alpha : 1.0f;
+        auto factor = scale / alpha;
+        for (size_t c = 0; c < 3; c++)
+        {
+            indices[(c * 4) + i] = MapChannel(pixel[c], factor, op);
+        }
+        indices[12 + i] = static_cast<int32_t>((alpha * 255.0f) + 0.5f);
+    }
+#endif
+}
+
+void ToneMap(
+    uint16_t const* halfRgba, size_t pixelCount, uint8_t* bgra,
+    float exposureStops, ToneMapOperator op, TaskPriority priority)
+{
+    ProfileScope scope(ToneMapStage);
+    auto const& table = EncodeTable();
+    auto scale = std::exp2(exposureStops);
+
+    auto bandCount = static_cast<uint32_t>((pixelCount + BandPixels - 1) / BandPixels);
+    ParallelFor(0, bandCount, [&](uint32_t begin, uint32_t end)
+    {
+        auto last = std::min(static_cast<size_t>(end) * BandPixels, pixelCount);
+        std::array<float, ChunkPixels * 4> floats;
+        for (auto first = static_cast<size_t>(begin) * BandPixels; first < last; first += ChunkPixels)
+        {
+            auto count = std::min(ChunkPixels, last - first);
+            HalfToFloat(halfRgba + (first * 4), floats.data(), count * 4);
+            // Pixels past the end of the last group of four are zero
+            std::fill(floats.begin() + (count * 4), floats.begin() + (((count + 3) & ~size_t(3)) * 4), 0.0f);
+
+            for (size_t i = 0; i < count; i += 4)
+            {
+                int32_t indices[16];
+                MapPixels(floats.data() + (i * 4), scale, op, indices);
+                for (size_t j = 0; j < std::min<size_t>(4, count - i); j++)
+                {
+                    auto alpha = indices[12 + j];
+                    uint32_t pixel =
+                        Premultiply(table[indices[8 + j]], alpha) |
+                        (Premultiply(table[indices[4 + j]], alpha) << 8) |
+                        (Premultiply(table[indices[j]], alpha) << 16) |
+                        (static_cast<uint32_t>(alpha) << 24);
+                    memcpy(bgra + ((first + i + j) * 4), &pixel, sizeof(pixel));
+                }
+            }
+        }
+    }, priority);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "TaskScheduler.h"
+
+enum class ToneMapOperator : uint32_t
+{
+    // Everything above 1.0 (80 nits) is white
+    Clip = 0,
+    // The ACES filmic curve fitted by Krzysztof Narkowicz. Rolls off
+    // highlights instead of clipping them.
+    Filmic = 1,
+};
+
+// Maps premultiplied RGBA half float scRGB pixels to premultiplied sRGB
+// BGRA8 for display. Colors are unpremultiplied, scaled by 2^exposureStops,
+// mapped with the operator and encoded with the sRGB curve. Negative
+// values and NaNs become 0.
+void ToneMap(
+    uint16_t const* halfRgba, size_t pixelCount, uint8_t* bgra,
+    float exposureStops, ToneMapOperator op, TaskPriority priority = TaskPriority::Visible);
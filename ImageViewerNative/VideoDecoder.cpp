@@ -1,6 +1,7 @@
 ﻿#include "pch.h"
 #include "VideoDecoder.h"
 #include "VideoDecoderDevice.h"
+#include "Profiler.h"
 
 namespace winrt
 {
@@ -14,6 +15,9 @@ namespace util
     using namespace robmikh::common::uwp;
 }
 
+static ProfileStage ProcessInputStage("VideoDecoder.ProcessInput");
+static ProfileStage ProcessOutputStage("VideoDecoder.ProcessOutput");
+
 inline winrt::com_ptr<ID3D11Texture2D> CreateNV12Texture(
     winrt::com_ptr<ID3D11Device> const& d3dDevice,
     winrt::SizeInt32 const& resolution,
@@ -318,8 +322,9 @@ winrt::com_ptr<IMFSample> VideoDecoder::CreateMFSample(VideoDecoderInputSample c
 {
     auto buffer = inputSample.Buffer;
     auto bufferLength = buffer.Length();
+    auto mfSample = m_samplePool->Acquire(bufferLength);
     winrt::com_ptr<IMFMediaBuffer> inputBuffer;
-    winrt::check_hresult(MFCreateMemoryBuffer(bufferLength, inputBuffer.put()));
+    winrt::check_hresult(mfSample->GetBufferByIndex(0, inputBuffer.put()));
     {
         byte* bytes = nullptr;
         auto byteAccess = buffer.as<::Windows::Storage::Streams::IBufferByteAccess>();
@@ -330,22 +335,20 @@ winrt::com_ptr<IMFSample> VideoDecoder::CreateMFSample(VideoDecoderInputSample c
 
         memcpy_s(reinterpret_cast<void*>(info.Bits), info.MaxLength, reinterpret_cast<void*>(bytes), bufferLength);
     }
-    winrt::check_hresult(inputBuffer->SetCurrentLength(bufferLength));
-    winrt::com_ptr<IMFSample> mfSample;
-    winrt::check_hresult(MFCreateSample(mfSample.put()));
-    winrt::check_hresult(mfSample->AddBuffer(inputBuffer.get()));
     winrt::check_hresult(mfSample->SetSampleTime(inputSample.TimeStamp));
     return mfSample;
 }
 
 HRESULT VideoDecoder::ProcessInput(winrt::com_ptr<IMFSample> const& mfSample)
 {
+    ProfileScope scope(ProcessInputStage);
     RETURN_IF_FAILED(m_transform->ProcessInput(m_inputStreamId, mfSample.get(), 0));
     return S_OK;
 }
 
 SampleProcessResult VideoDecoder::ProcessOutput(winrt::com_ptr<ID3D11Texture2D>& result, int64_t& timeStamp)
 {
+    ProfileScope scope(ProcessOutputStage);
     winrt::com_ptr<ID3D11Texture2D> resultTexture;
 
     DWORD status = 0;
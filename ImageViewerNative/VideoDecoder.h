@@ -1,4 +1,5 @@
 #pragma once
+#include "MediaSamplePool.h"
 
 class VideoDecoderDevice;
 
@@ -64,4 +65,6 @@ private:
     
     winrt::Windows::Graphics::SizeInt32 m_fullOutputResolution = { 0, 0 };
     std::optional<D3D11_BOX> m_outputBox = std::nullopt;
+
+    std::shared_ptr<MediaSamplePool> m_samplePool = MediaSamplePool::Create();
 };
\ No newline at end of file
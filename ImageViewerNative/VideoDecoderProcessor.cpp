@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "VideoDecoderProcessor.h"
+#include "PixelRectInterop.h"
+#include "Profiler.h"
 
 namespace winrt
 {
@@ -8,56 +10,159 @@ namespace winrt
     using namespace Windows::Graphics;
 }
 
-//float ComputeScaleFactor(winrt::float2 const outputSize, winrt::float2 const inputSize)
-//{
-//    auto outputRatio = outputSize.x / outputSize.y;
-//    auto inputRatio = inputSize.x / inputSize.y;
-//
-//    auto scaleFactor = outputSize.x / inputSize.x;
-//    if (outputRatio > inputRatio)
-//    {
-//        scaleFactor = outputSize.y / inputSize.y;
-//    }
-//
-//    return scaleFactor;
-//}
-
-//winrt::RectInt32 ComputeDestRect(winrt::SizeInt32 const outputSize, winrt::SizeInt32 const inputSize)
-//{
-//    auto scale = ComputeScaleFactor({ (float)outputSize.Width, (float)outputSize.Height }, { (float)inputSize.Width, (float)inputSize.Height });
-//    winrt::SizeInt32 newSize{ (int)(inputSize.Width * scale), (int)(inputSize.Height * scale) };
-//    auto offsetX = 0;
-//    auto offsetY = 0;
-//    if (newSize.Width != outputSize.Width)
-//    {
-//        offsetX = (outputSize.Width - newSize.Width) / 2;
-//    }
-//    if (newSize.Height != outputSize.Height)
-//    {
-//        offsetY = (outputSize.Height - newSize.Height) / 2;
-//    }
-//    return winrt::RectInt32{
-//        offsetX,
-//        offsetY,
-//        newSize.Width,
-//        newSize.Height
-//    };
-//}
+static ProfileStage ConvertStage("VideoDecoderProcessor.Convert");
+static ProfileStage FenceWaitStage("VideoDecoderProcessor.FenceWait");
+static ProfileStage CpuScaleStage("VideoDecoderProcessor.CpuScale");
+static ProfileStage ReadbackWaitStage("VideoDecoderProcessor.ReadbackWait");
+// Nanoseconds spent waiting on the GPU, by either path
+static ProfileCounter GpuStallCounter("VideoDecoderProcessor.GpuStallNanoseconds");
+
+static float ComputeScaleFactor(winrt::float2 const outputSize, winrt::float2 const inputSize)
+{
+    auto outputRatio = outputSize.x / outputSize.y;
+    auto inputRatio = inputSize.x / inputSize.y;
+
+    auto scaleFactor = outputSize.x / inputSize.x;
+    if (outputRatio > inputRatio)
+    {
+        scaleFactor = outputSize.y / inputSize.y;
+    }
+
+    return scaleFactor;
+}
+
+static winrt::RectInt32 ComputeDestRect(winrt::SizeInt32 const outputSize, winrt::SizeInt32 const inputSize)
+{
+    auto scale = ComputeScaleFactor({ (float)outputSize.Width, (float)outputSize.Height }, { (float)inputSize.Width, (float)inputSize.Height });
+    // Rounded rather than truncated, so that a size that was scaled by the
+    // same factor in both dimensions fills the output
+    winrt::SizeInt32 newSize
+    {
+        std::clamp((int)std::lround(inputSize.Width * scale), 1, outputSize.Width),
+        std::clamp((int)std::lround(inputSize.Height * scale), 1, outputSize.Height)
+    };
+    auto offsetX = 0;
+    auto offsetY = 0;
+    if (newSize.Width != outputSize.Width)
+    {
+        offsetX = (outputSize.Width - newSize.Width) / 2;
+    }
+    if (newSize.Height != outputSize.Height)
+    {
+        offsetY = (outputSize.Height - newSize.Height) / 2;
+    }
+    return winrt::RectInt32{
+        offsetX,
+        offsetY,
+        newSize.Width,
+        newSize.Height
+    };
+}
+
+static RECT ToRECT(winrt::RectInt32 const& rect)
+{
+    return RECT{
+        rect.X,
+        rect.Y,
+        rect.X + rect.Width,
+        rect.Y + rect.Height,
+    };
+}
 
 VideoDecoderProcessor::VideoDecoderProcessor(
     winrt::com_ptr<ID3D11Device> const& d3dDevice,
     DXGI_FORMAT const inputFormat,
     winrt::SizeInt32 const& inputSize,
     DXGI_FORMAT const outputFormat,
-    winrt::SizeInt32 const& outputSize)
+    winrt::SizeInt32 const& outputSize,
+    std::optional<winrt::RectInt32> const& sourceRect,
+    ResampleFilter cpuFilter)
 {
     m_d3dDevice = d3dDevice;
     m_d3dDevice->GetImmediateContext(m_d3dContext.put());
+    m_cpuFilter = cpuFilter;
 
     // Setup video conversion
     m_videoDevice = m_d3dDevice.as<ID3D11VideoDevice>();
     m_videoContext = m_d3dContext.as<ID3D11VideoContext>();
 
+    auto device5 = m_d3dDevice.as<ID3D11Device5>();
+    auto context4 = m_d3dContext.as<ID3D11DeviceContext4>();
+    m_fence = CreateD3D11Fence(device5, context4);
+
+    auto sourceSize = sourceRect.has_value() ? winrt::SizeInt32{ sourceRect->Width, sourceRect->Height } : inputSize;
+    auto scaling = sourceSize.Width != outputSize.Width || sourceSize.Height != outputSize.Height;
+    try
+    {
+        CreateVideoProcessor(inputFormat, inputSize, outputFormat, outputSize, sourceRect);
+        if (scaling)
+        {
+            // Drivers only report scaling they can't do once asked to
+            // do it, so convert a frame up front
+            D3D11_VIDEO_PROCESSOR_STREAM videoStream = {};
+            videoStream.Enable = true;
+            videoStream.pInputSurface = m_videoInput.get();
+            winrt::check_hresult(m_videoContext->VideoProcessorBlt(m_videoProcessor.get(), m_videoOutput.get(), 0, 1, &videoStream));
+        }
+    }
+    catch (winrt::hresult_error const&)
+    {
+        if (!scaling || outputFormat != DXGI_FORMAT_B8G8R8A8_UNORM)
+        {
+            throw;
+        }
+        m_cpuScaling = true;
+    }
+
+    if (m_cpuScaling)
+    {
+        CreateVideoProcessor(inputFormat, inputSize, outputFormat, inputSize, std::nullopt);
+        m_convertedTexture = m_videoOutputTexture;
+
+        D3D11_TEXTURE2D_DESC textureDesc = {};
+        textureDesc.Width = inputSize.Width;
+        textureDesc.Height = inputSize.Height;
+        textureDesc.ArraySize = 1;
+        textureDesc.MipLevels = 1;
+        textureDesc.Format = outputFormat;
+        textureDesc.SampleDesc.Count = 1;
+        textureDesc.Usage = D3D11_USAGE_STAGING;
+        textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        winrt::check_hresult(m_d3dDevice->CreateTexture2D(&textureDesc, nullptr, m_stagingTexture.put()));
+
+        textureDesc.Width = outputSize.Width;
+        textureDesc.Height = outputSize.Height;
+        textureDesc.Usage = D3D11_USAGE_DEFAULT;
+        textureDesc.CPUAccessFlags = 0;
+        textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+        m_videoOutputTexture = nullptr;
+        winrt::check_hresult(m_d3dDevice->CreateTexture2D(&textureDesc, nullptr, m_videoOutputTexture.put()));
+
+        m_cpuSourceRect = sourceRect.has_value() ? ToPixelRect(sourceRect.value()) : PixelRect{ 0, 0, static_cast<uint32_t>(inputSize.Width), static_cast<uint32_t>(inputSize.Height) };
+        m_cpuDestRect = ToPixelRect(ComputeDestRect(outputSize, sourceSize));
+        auto pixelCount = static_cast<size_t>(outputSize.Width) * outputSize.Height;
+        m_scaledPixels = BufferPool::Shared().Acquire(pixelCount * 4);
+        // Letterboxing is opaque black, like the video processor's
+        // default background. Only the dest rect is written per frame.
+        auto pixels = reinterpret_cast<uint32_t*>(m_scaledPixels.Data());
+        std::fill(pixels, pixels + pixelCount, 0xFF000000u);
+    }
+}
+
+void VideoDecoderProcessor::CreateVideoProcessor(
+    DXGI_FORMAT const inputFormat,
+    winrt::SizeInt32 const& inputSize,
+    DXGI_FORMAT const outputFormat,
+    winrt::SizeInt32 const& outputSize,
+    std::optional<winrt::RectInt32> const& sourceRect)
+{
+    // We may be trying again after failing part way through
+    m_videoProcessor = nullptr;
+    m_videoOutputTexture = nullptr;
+    m_videoOutput = nullptr;
+    m_videoInputTexture = nullptr;
+    m_videoInput = nullptr;
+
     winrt::com_ptr<ID3D11VideoProcessorEnumerator> videoEnum;
     D3D11_VIDEO_PROCESSOR_CONTENT_DESC videoDesc = {};
     videoDesc.InputFrameFormat = D3D11_VIDEO_FRAME_FORMAT_PROGRESSIVE;
@@ -81,19 +186,21 @@ VideoDecoderProcessor::VideoDecoderProcessor(
     colorSpace.Nominal_Range = D3D11_VIDEO_PROCESSOR_NOMINAL_RANGE_16_235;
     m_videoContext->VideoProcessorSetStreamColorSpace(m_videoProcessor.get(), 0, &colorSpace);
 
-    // If the input and output resolutions don't match, setup the
-    // video processor to preserve the aspect ratio when scaling.
-    //if (inputSize.Width != outputSize.Width || inputSize.Height != outputSize.Height)
-    //{
-    //    auto destRect = ComputeDestRect(outputSize, inputSize);
-    //    auto rect = RECT{
-    //        destRect.X,
-    //        destRect.Y,
-    //        destRect.X + destRect.Width,
-    //        destRect.Y + destRect.Height,
-    //    };
-    //    m_videoContext->VideoProcessorSetStreamDestRect(m_videoProcessor.get(), 0, true, &rect);
-    //}
+    // Only the source rect is converted, and if its size doesn't match
+    // the output, setup the video processor to preserve the aspect ratio
+    // when scaling.
+    auto sourceSize = inputSize;
+    if (sourceRect.has_value())
+    {
+        auto rect = ToRECT(sourceRect.value());
+        m_videoContext->VideoProcessorSetStreamSourceRect(m_videoProcessor.get(), 0, true, &rect);
+        sourceSize = { sourceRect->Width, sourceRect->Height };
+    }
+    if (sourceSize.Width != outputSize.Width || sourceSize.Height != outputSize.Height)
+    {
+        auto rect = ToRECT(ComputeDestRect(outputSize, sourceSize));
+        m_videoContext->VideoProcessorSetStreamDestRect(m_videoProcessor.get(), 0, true, &rect);
+    }
 
     D3D11_TEXTURE2D_DESC textureDesc = {};
     textureDesc.Width = outputSize.Width;
@@ -121,16 +228,13 @@ VideoDecoderProcessor::VideoDecoderProcessor(
     inputViewDesc.ViewDimension = D3D11_VPIV_DIMENSION_TEXTURE2D;
     inputViewDesc.Texture2D.MipSlice = 0;
     winrt::check_hresult(m_videoDevice->CreateVideoProcessorInputView(m_videoInputTexture.get(), videoEnum.get(), &inputViewDesc, m_videoInput.put()));
-
-    auto device5 = m_d3dDevice.as<ID3D11Device5>();
-    auto context4 = m_d3dContext.as<ID3D11DeviceContext4>();
-    m_fence = CreateD3D11Fence(device5, context4);
 }
 
 void VideoDecoderProcessor::ProcessTexture(winrt::com_ptr<ID3D11Texture2D> const& inputTexture, std::optional<D3D11_BOX> const& box)
 {
     // The caller is responsible for making sure they give us a
     // texture that matches the input size we were initialized with.
+    ProfileScope scope(ConvertStage);
 
     // Copy the texture to the video input texture
     if (box.has_value())
@@ -151,5 +255,37 @@ void VideoDecoderProcessor::ProcessTexture(winrt::com_ptr<ID3D11Texture2D> const
     videoStream.pInputSurface = m_videoInput.get();
     winrt::check_hresult(m_videoContext->VideoProcessorBlt(m_videoProcessor.get(), m_videoOutput.get(), 0, 1, &videoStream));
 
+    if (m_cpuScaling)
+    {
+        // Mapping the readback waits for the conversion
+        ScaleOnCpu();
+        return;
+    }
+
+    ProfileScope fenceScope(FenceWaitStage, &GpuStallCounter);
     m_fence->WaitForGpu();
-}
\ No newline at end of file
+}
+
+void VideoDecoderProcessor::ScaleOnCpu()
+{
+    ProfileScope scope(CpuScaleStage);
+    m_d3dContext->CopyResource(m_stagingTexture.get(), m_convertedTexture.get());
+
+    D3D11_TEXTURE2D_DESC outputDesc = {};
+    m_videoOutputTexture->GetDesc(&outputDesc);
+    auto outputStride = outputDesc.Width * 4;
+    auto dest = m_scaledPixels.Data() + (static_cast<size_t>(m_cpuDestRect.Y) * outputStride) + (static_cast<size_t>(m_cpuDestRect.X) * 4);
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        {
+            ProfileScope waitScope(ReadbackWaitStage, &GpuStallCounter);
+            winrt::check_hresult(m_d3dContext->Map(m_stagingTexture.get(), 0, D3D11_MAP_READ, 0, &mapped));
+        }
+        auto unmap = wil::scope_exit([&]()
+        {
+            m_d3dContext->Unmap(m_stagingTexture.get(), 0);
+        });
+        ImageResampler::Resample(reinterpret_cast<uint8_t const*>(mapped.pData), mapped.RowPitch, m_cpuSourceRect, dest, m_cpuDestRect.Width, m_cpuDestRect.Height, outputStride, m_cpuFilter);
+    }
+    m_d3dContext->UpdateSubresource(m_videoOutputTexture.get(), 0, nullptr, m_scaledPixels.Data(), outputStride, 0);
+}
@@ -1,20 +1,38 @@
 #pragma once
 #include "Fence.h"
+#include "BufferPool.h"
+#include "ImageResampler.h"
 
 class VideoDecoderProcessor
 {
 public:
+    // The source rect (the whole input by default) is scaled to fit the
+    // output with its aspect ratio kept. If the video processor can't
+    // scale between the two sizes, frames are converted at full size and
+    // scaled on the CPU with cpuFilter, which needs a BGRA8 output.
     VideoDecoderProcessor(
         winrt::com_ptr<ID3D11Device> const& d3dDevice,
         DXGI_FORMAT const inputFormat,
         winrt::Windows::Graphics::SizeInt32 const& inputSize,
         DXGI_FORMAT const outputFormat,
-        winrt::Windows::Graphics::SizeInt32 const& outputSize);
+        winrt::Windows::Graphics::SizeInt32 const& outputSize,
+        std::optional<winrt::Windows::Graphics::RectInt32> const& sourceRect = std::nullopt,
+        ResampleFilter cpuFilter = ResampleFilter::Bilinear);
 
     winrt::com_ptr<ID3D11Texture2D> const& OutputTexture() { return m_videoOutputTexture; }
+    bool IsScalingOnCpu() const { return m_cpuScaling; }
 
     void ProcessTexture(winrt::com_ptr<ID3D11Texture2D> const& inputTexture, std::optional<D3D11_BOX> const& box);
 
+private:
+    void CreateVideoProcessor(
+        DXGI_FORMAT const inputFormat,
+        winrt::Windows::Graphics::SizeInt32 const& inputSize,
+        DXGI_FORMAT const outputFormat,
+        winrt::Windows::Graphics::SizeInt32 const& outputSize,
+        std::optional<winrt::Windows::Graphics::RectInt32> const& sourceRect);
+    void ScaleOnCpu();
+
 private:
     winrt::com_ptr<ID3D11Device> m_d3dDevice;
     winrt::com_ptr<ID3D11DeviceContext> m_d3dContext;
@@ -27,5 +45,16 @@ private:
     winrt::com_ptr<ID3D11Texture2D> m_videoInputTexture;
     winrt::com_ptr<ID3D11VideoProcessorInputView> m_videoInput;
 
+    // Only used when scaling on the CPU. The video processor converts
+    // into the full size texture, which is read back and scaled into the
+    // output texture.
+    bool m_cpuScaling = false;
+    ResampleFilter m_cpuFilter = ResampleFilter::Bilinear;
+    PixelRect m_cpuSourceRect;
+    PixelRect m_cpuDestRect;
+    winrt::com_ptr<ID3D11Texture2D> m_convertedTexture;
+    winrt::com_ptr<ID3D11Texture2D> m_stagingTexture;
+    PooledBuffer m_scaledPixels;
+
     std::shared_ptr<D3D11Fence> m_fence;
-};
\ No newline at end of file
+};
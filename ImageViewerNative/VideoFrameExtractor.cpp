@@ -5,6 +5,8 @@
 #include "VideoDecoderDevice.h"
 #include "VideoDecoder.h"
 #include "VideoDecoderProcessor.h"
+#include "FrameExtractionInterop.h"
+#include "Profiler.h"
 
 namespace winrt
 {
@@ -17,12 +19,28 @@ namespace util
     using namespace robmikh::common::uwp;
 }
 
+static ProfileStage ReadSampleStage("SourceReader.ReadSample");
+static ProfileStage CallbackStage("VideoFrameExtractor.Callback");
+static ProfileCounter FrameCounter("VideoFrameExtractor.Frames");
+static ProfileCounter InputBytesCounter("VideoFrameExtractor.InputBytes");
+static ProfileCounter NotAcceptingCounter("VideoFrameExtractor.InputNotAccepted");
+static ProfileCounter ReaderSampleCounter("SourceReader.Samples");
+
 namespace winrt::ImageViewerNative::implementation
 {
     void VideoFrameExtractor::ExtractFromStream(
         winrt::Windows::Storage::Streams::IRandomAccessStream const& stream, 
         winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device, 
         winrt::Windows::Foundation::EventHandler<winrt::ImageViewerNative::VideoFrameArgs> const& callback)
+    {
+        ExtractFromStream(stream, device, winrt::ImageViewerNative::FrameExtractionOptions{}, callback);
+    }
+
+    void VideoFrameExtractor::ExtractFromStream(
+        winrt::Windows::Storage::Streams::IRandomAccessStream const& stream,
+        winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device,
+        winrt::ImageViewerNative::FrameExtractionOptions const& options,
+        winrt::Windows::Foundation::EventHandler<winrt::ImageViewerNative::VideoFrameArgs> const& callback)
     {
         auto d3dDevice = GetDXGIInterfaceFromObject<ID3D11Device>(device);
         auto multithread = d3dDevice.as<ID3D11Multithread>();
@@ -56,8 +74,18 @@ namespace winrt::ImageViewerNative::implementation
         
         winrt::SizeInt32 resolution{ static_cast<int32_t>(width), static_cast<int32_t>(height) };
 
+        // Cropping and scaling happen during the conversion, so frames
+        // are never copied at full size
+        auto region = ResolveFrameExtractionOptions(options, width, height);
+        std::optional<winrt::RectInt32> sourceRect;
+        if (region.SourceRect.Width != width || region.SourceRect.Height != height)
+        {
+            sourceRect = ToRectInt32(region.SourceRect);
+        }
+        winrt::SizeInt32 outputSize{ static_cast<int32_t>(region.OutputWidth), static_cast<int32_t>(region.OutputHeight) };
+
         // Setup our video decoder pipeline
-        auto videoProcessor = VideoDecoderProcessor(d3dDevice, DXGI_FORMAT_NV12, resolution, DXGI_FORMAT_B8G8R8A8_UNORM, resolution);
+        auto videoProcessor = VideoDecoderProcessor(d3dDevice, DXGI_FORMAT_NV12, resolution, DXGI_FORMAT_B8G8R8A8_UNORM, outputSize, sourceRect, ToResampleFilter(options.Filter));
         auto decoderDevices = VideoDecoderDevice::EnumerateAll(videoSubtype);
         auto decoderDevice = decoderDevices[0];
         auto videoDecoder = VideoDecoder(decoderDevice, d3dDevice, inputType);
@@ -73,20 +101,36 @@ namespace winrt::ImageViewerNative::implementation
             DWORD flags = 0;
             LONGLONG timeStamp = 0;
             winrt::com_ptr<IMFSample> videoSample;
-            winrt::check_hresult(sourceReader->ReadSample(MF_SOURCE_READER_FIRST_VIDEO_STREAM, 0, &streamIndex, &flags, &timeStamp, videoSample.put()));
+            {
+                ProfileScope scope(ReadSampleStage);
+                winrt::check_hresult(sourceReader->ReadSample(MF_SOURCE_READER_FIRST_VIDEO_STREAM, 0, &streamIndex, &flags, &timeStamp, videoSample.put()));
+            }
 
             if (flags & MF_SOURCE_READERF_ENDOFSTREAM)
             {
                 break;
             }
 
+            // The reader allocates every compressed sample itself and has no
+            // way to hand it pooled ones. The samples go to the decoder as
+            // they are rather than being copied into a MediaSamplePool
+            // sample, so this path allocates once per input sample. The
+            // counter puts that next to the pool's numbers.
             assert(videoSample.get() != nullptr);
+            ReaderSampleCounter.Add(1);
+            if (Profiler::IsEnabled())
+            {
+                DWORD sampleLength = 0;
+                winrt::check_hresult(videoSample->GetTotalLength(&sampleLength));
+                InputBytesCounter.Add(sampleLength);
+            }
 
             bool processedInput = true;
             auto inputResult = videoDecoder.ProcessInputSample(videoSample);
             if (inputResult == MF_E_NOTACCEPTING)
             {
                 processedInput = false;
+                NotAcceptingCounter.Add(1);
             }
             else
             {
@@ -125,7 +169,11 @@ namespace winrt::ImageViewerNative::implementation
                     // Callback
                     auto currentFrameId = frameId++;
                     args->Reset(timeStamp, currentFrameId);
-                    callback(nullptr, args.as<winrt::ImageViewerNative::VideoFrameArgs>());
+                    {
+                        ProfileScope scope(CallbackStage);
+                        callback(nullptr, args.as<winrt::ImageViewerNative::VideoFrameArgs>());
+                    }
+                    FrameCounter.Add(1);
                 }
 
             } while (decodeResult != SampleProcessResult::NeedsMoreInput);
@@ -8,6 +8,7 @@ namespace winrt::ImageViewerNative::implementation
         VideoFrameExtractor() = default;
 
         static void ExtractFromStream(winrt::Windows::Storage::Streams::IRandomAccessStream const& stream, winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device, winrt::Windows::Foundation::EventHandler<winrt::ImageViewerNative::VideoFrameArgs> const& callback);
+        static void ExtractFromStream(winrt::Windows::Storage::Streams::IRandomAccessStream const& stream, winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device, winrt::ImageViewerNative::FrameExtractionOptions const& options, winrt::Windows::Foundation::EventHandler<winrt::ImageViewerNative::VideoFrameArgs> const& callback);
     };
 }
 namespace winrt::ImageViewerNative::factory_implementation
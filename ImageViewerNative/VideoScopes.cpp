@@ -0,0 +1,88 @@
+#include "pch.h"
+#include "VideoScopes.h"
+#include "VideoScopes.g.cpp"
+
+static ScopeChannel ToScopeChannel(winrt::ImageViewerNative::ScopeChannel const& channel)
+{
+    switch (channel)
+    {
+    case winrt::ImageViewerNative::ScopeChannel::Luma:
+        return ScopeChannel::Luma;
+    case winrt::ImageViewerNative::ScopeChannel::Red:
+        return ScopeChannel::Red;
+    case winrt::ImageViewerNative::ScopeChannel::Green:
+        return ScopeChannel::Green;
+    case winrt::ImageViewerNative::ScopeChannel::Blue:
+        return ScopeChannel::Blue;
+    default:
+        throw winrt::hresult_invalid_argument(L"Unknown scope channel.");
+    }
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    VideoScopes::VideoScopes(std::shared_ptr<FrameScopes const> scopes)
+    {
+        m_scopes = std::move(scopes);
+    }
+
+    winrt::ImageViewerNative::VideoScopes VideoScopes::Analyze(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height, uint32_t sampleStep)
+    {
+        if (width == 0 || height == 0)
+        {
+            throw winrt::hresult_invalid_argument(L"The frame size must not be empty.");
+        }
+        if (sampleStep == 0)
+        {
+            throw winrt::hresult_invalid_argument(L"The sample step must be at least 1.");
+        }
+        if (bgraPixels.size() < static_cast<uint64_t>(width) * height * 4)
+        {
+            throw winrt::hresult_invalid_argument(L"The pixel buffer is smaller than the given size.");
+        }
+
+        auto scopes = ComputeScopes(bgraPixels.data(), width, height, width * 4, sampleStep);
+        return winrt::make<VideoScopes>(std::make_shared<FrameScopes const>(std::move(scopes)));
+    }
+
+    winrt::com_array<uint32_t> VideoScopes::GetHistogram(winrt::ImageViewerNative::ScopeChannel const& channel)
+    {
+        auto& histogram = m_scopes->Histogram(ToScopeChannel(channel));
+        return winrt::com_array<uint32_t>(histogram.begin(), histogram.end());
+    }
+
+    uint32_t VideoScopes::GetLowestLevel(winrt::ImageViewerNative::ScopeChannel const& channel)
+    {
+        return m_scopes->LowestLevel(ToScopeChannel(channel));
+    }
+
+    uint32_t VideoScopes::GetHighestLevel(winrt::ImageViewerNative::ScopeChannel const& channel)
+    {
+        return m_scopes->HighestLevel(ToScopeChannel(channel));
+    }
+
+    winrt::com_array<uint8_t> VideoScopes::RenderHistogram(uint32_t height)
+    {
+        if (height == 0)
+        {
+            throw winrt::hresult_invalid_argument(L"The height must not be 0.");
+        }
+        winrt::com_array<uint8_t> pixels(static_cast<uint32_t>(FrameScopes::Levels * height * 4));
+        ::RenderHistogram(*m_scopes, pixels.data(), height);
+        return pixels;
+    }
+
+    winrt::com_array<uint8_t> VideoScopes::RenderWaveform()
+    {
+        winrt::com_array<uint8_t> pixels(m_scopes->WaveformWidth * FrameScopes::Levels * 4);
+        ::RenderWaveform(*m_scopes, pixels.data());
+        return pixels;
+    }
+
+    winrt::com_array<uint8_t> VideoScopes::RenderVectorscope()
+    {
+        winrt::com_array<uint8_t> pixels(FrameScopes::Levels * FrameScopes::Levels * 4);
+        ::RenderVectorscope(*m_scopes, pixels.data());
+        return pixels;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "VideoScopes.g.h"
+#include "FrameScopes.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct VideoScopes : VideoScopesT<VideoScopes>
+    {
+        VideoScopes(std::shared_ptr<FrameScopes const> scopes);
+
+        static winrt::ImageViewerNative::VideoScopes Analyze(winrt::array_view<uint8_t const> const& bgraPixels, uint32_t width, uint32_t height, uint32_t sampleStep);
+
+        uint32_t SampledWidth() { return m_scopes->SampledWidth; }
+        uint32_t SampledHeight() { return m_scopes->SampledHeight; }
+        uint64_t SampleCount() { return m_scopes->SampleCount(); }
+        uint32_t WaveformWidth() { return m_scopes->WaveformWidth; }
+        winrt::com_array<uint32_t> GetHistogram(winrt::ImageViewerNative::ScopeChannel const& channel);
+        uint32_t GetLowestLevel(winrt::ImageViewerNative::ScopeChannel const& channel);
+        uint32_t GetHighestLevel(winrt::ImageViewerNative::ScopeChannel const& channel);
+        winrt::com_array<uint8_t> RenderHistogram(uint32_t height);
+        winrt::com_array<uint8_t> RenderWaveform();
+        winrt::com_array<uint8_t> RenderVectorscope();
+
+    private:
+        std::shared_ptr<FrameScopes const> m_scopes;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct VideoScopes : VideoScopesT<VideoScopes, implementation::VideoScopes>
+    {
+    };
+}
@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "ViewportTileCache.h"
+
+ViewportTileCache::ViewportTileCache(uint32_t surfaceWidth, uint32_t surfaceHeight, uint32_t tileSize, uint32_t capacity)
+{
+    m_surfaceWidth = surfaceWidth;
+    m_surfaceHeight = surfaceHeight;
+    m_tileSize = std::max(tileSize, 1u);
+    m_capacity = capacity;
+}
+
+void ViewportTileCache::UpdateViewport(PixelRect const& viewport, std::vector<TileCoordinate>& toRender, std::vector<TileCoordinate>& toEvict)
+{
+    toRender.clear();
+    toEvict.clear();
+
+    auto x0 = std::min(viewport.X, m_surfaceWidth);
+    auto y0 = std::min(viewport.Y, m_surfaceHeight);
+    auto x1 = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(viewport.X) + viewport.Width, m_surfaceWidth));
+    auto y1 = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(viewport.Y) + viewport.Height, m_surfaceHeight));
+    if (x1 <= x0 || y1 <= y0)
+    {
+        return;
+    }
+
+    auto tileX0 = x0 / m_tileSize;
+    auto tileY0 = y0 / m_tileSize;
+    auto tileX1 = (x1 + m_tileSize - 1) / m_tileSize;
+    auto tileY1 = (y1 + m_tileSize - 1) / m_tileSize;
+
+    std::vector<TileCoordinate> visible;
+    visible.reserve(static_cast<size_t>(tileX1 - tileX0) * (tileY1 - tileY0));
+    for (auto y = tileY0; y < tileY1; y++)
+    {
+        for (auto x = tileX0; x < tileX1; x++)
+        {
+            visible.push_back({ x, y });
+        }
+    }
+
+    // Center out, so the middle of the screen fills in first
+    auto centerX = static_cast<int64_t>(tileX0) + tileX1 - 1;
+    auto centerY = static_cast<int64_t>(tileY0) + tileY1 - 1;
+    auto distance = [centerX, centerY](TileCoordinate const& tile)
+    {
+        auto dx = (static_cast<int64_t>(tile.X) * 2) - centerX;
+        auto dy = (static_cast<int64_t>(tile.Y) * 2) - centerY;
+        return (dx * dx) + (dy * dy);
+    };
+    std::stable_sort(visible.begin(), visible.end(), [&distance](TileCoordinate const& left, TileCoordinate const& right)
+    {
+        return distance(left) < distance(right);
+    });
+
+    // Walk from the outside in so the center ends up most recent
+    for (auto it = visible.rbegin(); it != visible.rend(); it++)
+    {
+        auto key = Key(*it);
+        auto found = m_resident.find(key);
+        if (found != m_resident.end())
+        {
+            m_lru.splice(m_lru.begin(), m_lru, found->second);
+        }
+        else
+        {
+            m_lru.push_front(*it);
+            m_resident.emplace(key, m_lru.begin());
+            toRender.push_back(*it);
+        }
+    }
+    std::reverse(toRender.begin(), toRender.end());
+
+    // Never evict what's on screen, even if the viewport outgrew the capacity
+    auto capacity = std::max<size_t>(m_capacity, visible.size());
+    while (m_lru.size() > capacity)
+    {
+        auto& tile = m_lru.back();
+        toEvict.push_back(tile);
+        m_resident.erase(Key(tile));
+        m_lru.pop_back();
+    }
+}
+
+void ViewportTileCache::Clear()
+{
+    m_lru.clear();
+    m_resident.clear();
+}
+
+PixelRect ViewportTileCache::TileBounds(TileCoordinate const& tile) const
+{
+    PixelRect bounds;
+    bounds.X = tile.X * m_tileSize;
+    bounds.Y = tile.Y * m_tileSize;
+    bounds.Width = std::min(m_tileSize, m_surfaceWidth - bounds.X);
+    bounds.Height = std::min(m_tileSize, m_surfaceHeight - bounds.Y);
+    return bounds;
+}
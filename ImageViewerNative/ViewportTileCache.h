@@ -0,0 +1,40 @@
+#pragma once
+#include "PixelRect.h"
+
+struct TileCoordinate
+{
+    uint32_t X = 0;
+    uint32_t Y = 0;
+};
+
+// Tracks which tiles of a (possibly huge) surface have been drawn. Only
+// the tiles that intersect the current viewport are ever handed out for
+// rendering, and the least recently visible ones are evicted once the
+// cache is over capacity, so the resident set stays proportional to the
+// size of the screen and not the size of the surface.
+class ViewportTileCache
+{
+public:
+    ViewportTileCache(uint32_t surfaceWidth, uint32_t surfaceHeight, uint32_t tileSize, uint32_t capacity);
+
+    // Fills toRender with the visible tiles that aren't resident yet,
+    // ordered from the center of the viewport outwards, and toEvict with
+    // the tiles that fell out of the cache.
+    void UpdateViewport(PixelRect const& viewport, std::vector<TileCoordinate>& toRender, std::vector<TileCoordinate>& toEvict);
+    void Clear();
+
+    PixelRect TileBounds(TileCoordinate const& tile) const;
+    size_t ResidentCount() const { return m_lru.size(); }
+
+private:
+    static uint64_t Key(TileCoordinate const& tile) { return (static_cast<uint64_t>(tile.Y) << 32) | tile.X; }
+
+private:
+    uint32_t m_surfaceWidth = 0;
+    uint32_t m_surfaceHeight = 0;
+    uint32_t m_tileSize = 0;
+    uint32_t m_capacity = 0;
+    // Most recently visible at the front
+    std::list<TileCoordinate> m_lru;
+    std::unordered_map<uint64_t, std::list<TileCoordinate>::iterator> m_resident;
+};
@@ -0,0 +1,38 @@
+#include "pch.h"
+#include "ViewportTiles.h"
+#include "ViewportTiles.g.cpp"
+#include "PixelRectInterop.h"
+
+namespace winrt
+{
+    using namespace Windows::Graphics;
+}
+
+namespace winrt::ImageViewerNative::implementation
+{
+    ViewportTiles::ViewportTiles(winrt::SizeInt32 const& surfaceSize, int32_t tileSize, uint32_t capacity) :
+        m_cache(static_cast<uint32_t>(std::max(surfaceSize.Width, 0)), static_cast<uint32_t>(std::max(surfaceSize.Height, 0)), static_cast<uint32_t>(std::max(tileSize, 1)), capacity)
+    {
+    }
+
+    winrt::com_array<winrt::RectInt32> ViewportTiles::Update(winrt::RectInt32 const& viewport, winrt::com_array<winrt::RectInt32>& evicted)
+    {
+        m_cache.UpdateViewport(ToPixelRect(viewport), m_toRender, m_toEvict);
+
+        std::vector<winrt::RectInt32> evictedRects;
+        evictedRects.reserve(m_toEvict.size());
+        for (auto& tile : m_toEvict)
+        {
+            evictedRects.push_back(ToRectInt32(m_cache.TileBounds(tile)));
+        }
+        evicted = winrt::com_array<winrt::RectInt32>(evictedRects);
+
+        std::vector<winrt::RectInt32> renderRects;
+        renderRects.reserve(m_toRender.size());
+        for (auto& tile : m_toRender)
+        {
+            renderRects.push_back(ToRectInt32(m_cache.TileBounds(tile)));
+        }
+        return winrt::com_array<winrt::RectInt32>(renderRects);
+    }
+}
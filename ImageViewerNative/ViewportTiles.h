@@ -0,0 +1,25 @@
+#pragma once
+#include "ViewportTiles.g.h"
+#include "ViewportTileCache.h"
+
+namespace winrt::ImageViewerNative::implementation
+{
+    struct ViewportTiles : ViewportTilesT<ViewportTiles>
+    {
+        ViewportTiles(winrt::Windows::Graphics::SizeInt32 const& surfaceSize, int32_t tileSize, uint32_t capacity);
+
+        winrt::com_array<winrt::Windows::Graphics::RectInt32> Update(winrt::Windows::Graphics::RectInt32 const& viewport, winrt::com_array<winrt::Windows::Graphics::RectInt32>& evicted);
+        void Clear() { m_cache.Clear(); }
+
+    private:
+        ViewportTileCache m_cache;
+        std::vector<TileCoordinate> m_toRender;
+        std::vector<TileCoordinate> m_toEvict;
+    };
+}
+namespace winrt::ImageViewerNative::factory_implementation
+{
+    struct ViewportTiles : ViewportTilesT<ViewportTiles, implementation::ViewportTiles>
+    {
+    };
+}
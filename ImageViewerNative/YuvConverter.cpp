@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "YuvConverter.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include "SimdHelpers.h"
+
+static ProfileStage ConvertNv12Stage("YuvConverter.ConvertNv12ToBgra");
+
+// The matrices scaled by 2^13. The vectorized and scalar paths do the same
+// integer math, so they give the same bytes.
+static const int32_t CoefficientBits = 13;
+static const int32_t Rounding = 1 << (CoefficientBits - 1);
+
+struct YuvCoefficients
+{
+    int16_t Y;
+    int16_t RedV;
+    int16_t GreenU;
+    int16_t GreenV;
+    int16_t BlueU;
+};
+
+static const YuvCoefficients Bt601Coefficients = { 9539, 13075, -3209, -6660, 16525 };
+static const YuvCoefficients Bt709Coefficients = { 9539, 14686, -1747, -4366, 17305 };
+
+static uint8_t ToLevel(int32_t value)
+{
+    return static_cast<uint8_t>(std::clamp(value >> CoefficientBits, 0, 255));
+}
+
+static void ConvertPixel(int32_t y, int32_t u, int32_t v, YuvCoefficients const& coefficients, uint8_t* bgra)
+{
+    auto luma = (coefficients.Y * (y - 16)) + Rounding;
+    u -= 128;
+    v -= 128;
+    bgra[0] = ToLevel(luma + (coefficients.BlueU * u));
+    bgra[1] = ToLevel(luma + (coefficients.GreenU * u) + (coefficients.GreenV * v));
+    bgra[2] = ToLevel(luma + (coefficients.RedV * v));
+    bgra[3] = 255;
+}
+
+static void ConvertRow(uint8_t const* luma, uint8_t const* chroma, uint8_t* bgra, uint32_t width, YuvCoefficients const& coefficients)
+{
+    uint32_t x = 0;
+#ifdef IMAGEVIEWER_SSE2
+    auto zero = _mm_setzero_si128();
+    auto lumaOffset = _mm_set1_epi16(16);
+    auto chromaOffset = _mm_set1_epi16(128);
+    // Luma is paired with 1 so that one multiply-add also adds the rounding
+    auto lumaFactors = _mm_set_epi16(Rounding, coefficients.Y, Rounding, coefficients.Y, Rounding, coefficients.Y, Rounding, coefficients.Y);
+    auto one = _mm_set1_epi16(1);
+    auto redFactors = _mm_set_epi16(coefficients.RedV, 0, coefficients.RedV, 0, coefficients.RedV, 0, coefficients.RedV, 0);
+    auto greenFactors = _mm_set_epi16(coefficients.GreenV, coefficients.GreenU, coefficients.GreenV, coefficients.GreenU, coefficients.GreenV, coefficients.GreenU, coefficients.GreenV, coefficients.GreenU);
+    auto blueFactors = _mm_set_epi16(0, coefficients.BlueU, 0, coefficients.BlueU, 0, coefficients.BlueU, 0, coefficients.BlueU);
+    auto opaque = _mm_set1_epi8(static_cast<char>(0xFF));
+    for (; x + 8 <= width; x += 8)
+    {
+        // Eight pixels share four Cb, Cr pairs
+        auto y = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(luma + x)), zero), lumaOffset);
+        auto uv = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(chroma + x)), zero), chromaOffset);
+        auto lumaLow = _mm_madd_epi16(_mm_unpacklo_epi16(y, one), lumaFactors);
+        auto lumaHigh = _mm_madd_epi16(_mm_unpackhi_epi16(y, one), lumaFactors);
+
+        __m128i levels[3];
+        __m128i const factors[3] = { blueFactors, greenFactors, redFactors };
+        for (size_t c = 0; c < 3; c++)
+        {
+            auto chromaTerms = _mm_madd_epi16(uv, factors[c]);
+            auto low = _mm_srai_epi32(_mm_add_epi32(lumaLow, _mm_unpacklo_epi32(chromaTerms, chromaTerms)), CoefficientBits);
+            auto high = _mm_srai_epi32(_mm_add_epi32(lumaHigh, _mm_unpackhi_epi32(chromaTerms, chromaTerms)), CoefficientBits);
+            levels[c] = _mm_packus_epi16(_mm_packs_epi32(low, high), zero);
+        }
+
+        auto blueGreen = _mm_unpacklo_epi8(levels[0], levels[1]);
+        auto redAlpha = _mm_unpacklo_epi8(levels[2], opaque);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bgra + (x * 4)), _mm_unpacklo_epi16(blueGreen, redAlpha));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bgra + (x * 4) + 16), _mm_unpackhi_epi16(blueGreen, redAlpha));
+    }
+#endif
+    for (; x < width; x++)
+    {
+        auto pair = chroma + (x & ~1u);
+        ConvertPixel(luma[x], pair[0], pair[1], coefficients, bgra + (x * 4));
+    }
+}
+
+void ConvertNv12ToBgra(
+    uint8_t const* luma, uint32_t lumaStride,
+    uint8_t const* chroma, uint32_t chromaStride,
+    uint8_t* bgra, uint32_t bgraStride, uint32_t width, uint32_t height,
+    YuvMatrix matrix, TaskPriority priority)
+{
+    ProfileScope scope(ConvertNv12Stage);
+    auto const& coefficients = matrix == YuvMatrix::Bt601 ? Bt601Coefficients : Bt709Coefficients;
+    ParallelFor(0, height, [&](uint32_t begin, uint32_t end)
+    {
+        for (auto y = begin; y < end; y++)
+        {
+            ConvertRow(
+                luma + (static_cast<size_t>(y) * lumaStride),
+                chroma + (static_cast<size_t>(y / 2) * chromaStride),
+                bgra + (static_cast<size_t>(y) * bgraStride),
+                width, coefficients);
+        }
+    }, priority);
+}
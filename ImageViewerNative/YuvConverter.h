@@ -0,0 +1,18 @@
+#pragma once
+#include "TaskScheduler.h"
+
+enum class YuvMatrix : uint32_t
+{
+    Bt601 = 0,
+    Bt709 = 1,
+};
+
+// Converts limited range NV12, a full resolution luma plane followed by a
+// half resolution plane of interleaved Cb and Cr, to opaque BGRA8. This is
+// the conversion the video processor does on the GPU, for headless use and
+// benchmarking. Each chroma sample is repeated over its 2x2 pixels.
+void ConvertNv12ToBgra(
+    uint8_t const* luma, uint32_t lumaStride,
+    uint8_t const* chroma, uint32_t chromaStride,
+    uint8_t* bgra, uint32_t bgraStride, uint32_t width, uint32_t height,
+    YuvMatrix matrix, TaskPriority priority = TaskPriority::Visible);
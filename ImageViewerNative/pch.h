@@ -1,5 +1,9 @@
 ﻿#pragma once
 
+// The platform-neutral cores also build on their own for the tests and
+// benchmarks (see CMakeLists.txt in the repository root), with only the
+// STL.
+#ifndef IMAGEVIEWER_CORES_ONLY
 // Windows SDK
 #include <unknwn.h>
 #include <inspectable.h>
@@ -9,10 +13,12 @@
 // WinRT
 #include <winrt/Windows.Foundation.h>
 #include <winrt/Windows.Foundation.Collections.h>
+#include <winrt/Windows.Foundation.Numerics.h>
 #include <winrt/Windows.Graphics.h>
 #include <winrt/Windows.Graphics.DirectX.h>
 #include <winrt/Windows.Graphics.DirectX.Direct3D11.h>
 #include <winrt/Windows.Storage.Streams.h>
+#include <winrt/Windows.UI.h>
 
 // WinRT Interop
 #include <robuffer.h>
@@ -34,8 +40,11 @@
 #include <mferror.h>
 #include <wmcodecdsp.h>
 #include <codecapi.h>
+#endif
 
 // STL
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <atomic>
@@ -43,8 +52,26 @@
 #include <algorithm>
 #include <mutex>
 #include <sstream>
+#include <array>
+#include <thread>
+#include <cmath>
+#include <list>
+#include <optional>
+#include <functional>
+#include <deque>
+#include <condition_variable>
+#include <stdexcept>
+#include <unordered_map>
+#include <queue>
+#include <chrono>
+#include <utility>
+#include <string_view>
+#include <charconv>
+#include <future>
 
+#ifndef IMAGEVIEWER_CORES_ONLY
 // robmikh.common
 #include <robmikh.common/d3dHelpers.h>
 #include <robmikh.common/direct3d11.interop.h>
 #include <robmikh.common/mfHelpers.h>
+#endif